@@ -0,0 +1,49 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_BENCH_H__
+#define __LIGHTNING_BENCH_H__
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+#include <fmt/format.h>
+
+
+namespace bench {
+
+// ----------------------------------------------------------------------------
+// doNotOptimize
+// ----------------------------------------------------------------------------
+template<typename T>
+inline void doNotOptimize (const T &value) {
+  asm volatile ("" : : "r,m" (value) : "memory");
+}
+
+// ----------------------------------------------------------------------------
+// run
+// ----------------------------------------------------------------------------
+// Calls fn() `iterations` times (after a short warm up) and prints the mean time per call.
+template<typename Fn>
+inline double run (std::string_view name, size_t iterations, Fn &&fn) {
+  for (size_t i { 0 }; i < iterations / 10; ++i)
+    fn();
+
+  const auto start { std::chrono::steady_clock::now() };
+
+  for (size_t i { 0 }; i < iterations; ++i)
+    fn();
+
+  const std::chrono::duration<double, std::nano> elapsed { std::chrono::steady_clock::now() - start };
+  const double ns { elapsed.count() / static_cast<double> (iterations) };
+
+  fmt::print ("{:<48} {:>12.1f} ns/op\n", name, ns);
+
+  return ns;
+}
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <lightning/http_header.h>
+
+#include "bench.h"
+
+
+// ----------------------------------------------------------------------------
+// MapHttpHeader
+// ----------------------------------------------------------------------------
+// The previous implementation: an unordered_map keyed by a lower case copy of the name.
+class MapHttpHeader {
+  public:
+    bool contains (std::string_view name) const {
+      return _headers.find (_lower (name)) != _headers.end();
+    }
+
+    std::optional<std::string_view> get (std::string_view name) const {
+      if (auto it = _headers.find (_lower (name)); it != _headers.end())
+        return { it->second };
+
+      return std::nullopt;
+    }
+
+    void set (std::string_view name, std::string_view value) {
+      _headers[_lower (name)] = value;
+    }
+
+  private:
+    std::unordered_map<std::string, std::string_view> _headers;
+
+    static std::string _lower (std::string_view name) {
+      std::string lower;
+      lower.resize (name.size());
+      std::transform (std::begin (name), std::end (name), std::begin (lower), [] (unsigned char c) {
+        return std::tolower (c);
+      });
+
+      return lower;
+    }
+};
+
+static constexpr std::array<std::pair<std::string_view, std::string_view>, 9> kRequestHeaders { {
+  { "Host", "localhost:8080" },
+  { "User-Agent", "Mozilla/5.0 (X11; Linux x86_64; rv:124.0) Gecko/20100101 Firefox/124.0" },
+  { "Accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8" },
+  { "Accept-Language", "en-US,en;q=0.5" },
+  { "Accept-Encoding", "gzip, deflate, br" },
+  { "Connection", "keep-alive" },
+  { "Cookie", "session=0123456789abcdef" },
+  { "X-Request-Id", "5b4a5f2e-0d5c-4b0e-9f5e-2c1b8a7d6e3f" },
+  { "Cache-Control", "max-age=0" }
+} };
+
+// ----------------------------------------------------------------------------
+// request
+// ----------------------------------------------------------------------------
+// Headers of a typical request are stored, then looked up by the framework.
+template<typename Header>
+static void request() {
+  Header header;
+
+  for (const auto &[ name, value ]: kRequestHeaders)
+    header.set (name, value);
+
+  bench::doNotOptimize (header.get ("host"));
+  bench::doNotOptimize (header.get ("content-length"));
+  bench::doNotOptimize (header.get ("transfer-encoding"));
+  bench::doNotOptimize (header.get ("connection"));
+  bench::doNotOptimize (header.get ("x-request-id"));
+}
+
+// ----------------------------------------------------------------------------
+// response
+// ----------------------------------------------------------------------------
+// A handler sets a couple of headers, then the response is serialized.
+template<typename Header>
+static void response() {
+  Header header;
+
+  header.set ("Content-Type", "application/json");
+  header.set ("X-Request-Id", "5b4a5f2e-0d5c-4b0e-9f5e-2c1b8a7d6e3f");
+
+  bench::doNotOptimize (header.contains ("content-type"));
+  bench::doNotOptimize (header.contains ("content-length"));
+  bench::doNotOptimize (header.contains ("connection"));
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+int main() {
+  constexpr size_t kIterations { 1000000 };
+
+  const auto mapRequest { bench::run ("request headers, unordered_map", kIterations, request<MapHttpHeader>) };
+  const auto flatRequest { bench::run ("request headers, HttpHeader", kIterations, request<lightning::HttpHeader>) };
+
+  const auto mapResponse { bench::run ("response headers, unordered_map", kIterations, response<MapHttpHeader>) };
+  const auto flatResponse { bench::run ("response headers, HttpHeader", kIterations, response<lightning::HttpHeader>) };
+
+  fmt::print ("speedup: request x{:.1f}, response x{:.1f}\n", mapRequest / flatRequest, mapResponse / flatResponse);
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <lightning/http_server.h>
+
+#include "bench.h"
+
+
+static constexpr uint16_t kPort { 8091 };
+static constexpr size_t kConnections { 4 };
+static constexpr std::chrono::seconds kDuration { 2 };
+
+static constexpr std::string_view kRequest { "GET /plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n" };
+
+// ----------------------------------------------------------------------------
+// runClient
+// ----------------------------------------------------------------------------
+// Sends `depth` requests with a single write and waits for all the responses,
+// until `stop` is set. Every response has the same size.
+static size_t runClient (size_t depth, const std::atomic<bool> &stop) {
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+  socket.set_option (asio::ip::tcp::no_delay (true));
+
+  std::string batch;
+  for (size_t i { 0 }; i < depth; ++i)
+    batch += kRequest;
+
+  // the size of a response is learnt from the first one
+  std::string response;
+  asio::write (socket, asio::buffer (kRequest));
+  asio::read_until (socket, asio::dynamic_buffer (response), "Hello, World!");
+
+  const size_t batchSize { response.size() * depth };
+  std::vector<char> data (batchSize);
+  size_t requests { 0 };
+
+  while (!stop.load (std::memory_order_relaxed)) {
+    asio::write (socket, asio::buffer (batch));
+    asio::read (socket, asio::buffer (data));
+
+    requests += depth;
+  }
+
+  return requests;
+}
+
+// ----------------------------------------------------------------------------
+// measure
+// ----------------------------------------------------------------------------
+static double measure (size_t depth) {
+  lightning::HttpServer server { kPort, 1, lightning::LogLevel::kError };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/plaintext", [] (const auto &, auto &response) {
+    response.headers().set ("Content-Type", "text/plain");
+    response.status (200).send ("Hello, World!");
+  });
+
+  std::atomic<bool> stop { false };
+  std::atomic<size_t> total { 0 };
+  std::vector<std::thread> clients;
+
+  for (size_t i { 0 }; i < kConnections; ++i)
+    clients.emplace_back ([ & ] { total += runClient (depth, stop); });
+
+  std::this_thread::sleep_for (kDuration);
+  stop = true;
+
+  for (auto &c: clients)
+    c.join();
+
+  const double rps { static_cast<double> (total.load()) / static_cast<double> (kDuration.count()) };
+
+  fmt::print ("{:<48} {:>12.0f} req/s\n", fmt::format ("pipeline depth={}", depth), rps);
+
+  return rps;
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+// Keep-alive plaintext requests sent in pipelined batches. The server answers a
+// batch with a single gather write, so the number of write syscalls per request
+// drops with the depth (check it with `strace -c -f -e trace=sendmsg`).
+int main() {
+  const double base { measure (1) };
+
+  for (const size_t depth: { 4, 16, 64 }) {
+    const double rps { measure (depth) };
+
+    fmt::print ("{:<48} {:>12.2f}x\n", "speed-up", rps / base);
+  }
+
+  return 0;
+}
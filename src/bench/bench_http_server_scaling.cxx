@@ -0,0 +1,113 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <lightning/http_server.h>
+
+#include "bench.h"
+
+
+static constexpr uint16_t kPort { 8090 };
+static constexpr size_t kConnectionsPerThread { 4 };
+static constexpr std::chrono::seconds kDuration { 2 };
+
+static constexpr std::string_view kRequest { "GET /plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n" };
+static constexpr std::string_view kBody { "Hello, World!" };
+
+// ----------------------------------------------------------------------------
+// runClient
+// ----------------------------------------------------------------------------
+// Sends requests over a keep-alive connection, one at a time, until `stop` is set.
+static size_t runClient (const std::atomic<bool> &stop) {
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+  socket.set_option (asio::ip::tcp::no_delay (true));
+
+  std::string response;
+  size_t requests { 0 };
+
+  while (!stop.load (std::memory_order_relaxed)) {
+    asio::write (socket, asio::buffer (kRequest));
+
+    response.clear();
+
+    // every response has the same body, so it is complete once the body follows the headers
+    for (;;) {
+      const auto pos { response.find ("\r\n\r\n") };
+
+      if ((pos != std::string::npos) && (response.size() >= pos + 4 + kBody.size()))
+        break;
+
+      char data[1024];
+      const auto n { socket.read_some (asio::buffer (data)) };
+      response.append (data, n);
+    }
+
+    ++requests;
+  }
+
+  return requests;
+}
+
+// ----------------------------------------------------------------------------
+// measure
+// ----------------------------------------------------------------------------
+static double measure (size_t threads, bool sharded) {
+  lightning::HttpServer server { kPort, threads, lightning::LogLevel::kError, { .sharded = sharded } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/plaintext", [] (const auto &, auto &response) {
+    response.headers().set ("Content-Type", "text/plain");
+    response.status (200).send (std::string { kBody });
+  });
+
+  std::atomic<bool> stop { false };
+  std::atomic<size_t> total { 0 };
+  std::vector<std::thread> clients;
+
+  for (size_t i { 0 }; i < threads * kConnectionsPerThread; ++i)
+    clients.emplace_back ([ & ] { total += runClient (stop); });
+
+  std::this_thread::sleep_for (kDuration);
+  stop = true;
+
+  for (auto &c: clients)
+    c.join();
+
+  const double rps { static_cast<double> (total.load()) / static_cast<double> (kDuration.count()) };
+
+  fmt::print ("{:<48} {:>12.0f} req/s\n", fmt::format ("{} threads={}", sharded ? "sharded" : "shared", threads), rps);
+
+  return rps;
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+// Keep-alive plaintext requests against a shared io_context and against one
+// io_context per core. The clients run on the same machine, so the numbers are
+// only comparable between modes, not absolute.
+int main() {
+  const size_t cores { std::max (std::thread::hardware_concurrency(), 1u) };
+
+  for (size_t threads { 1 }; threads <= cores; threads *= 2) {
+    const double shared { measure (threads, false) };
+    const double sharded { measure (threads, true) };
+
+    fmt::print ("{:<48} {:>12.2f}x\n\n", "sharded / shared", sharded / shared);
+  }
+
+  return 0;
+}
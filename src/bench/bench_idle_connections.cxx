@@ -0,0 +1,108 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <asio.hpp>
+
+#include <lightning/http_server.h>
+
+#include "bench.h"
+
+
+static constexpr uint16_t kPort { 8092 };
+static constexpr size_t kConnections { 4000 };
+
+static constexpr std::string_view kRequest { "GET /plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n" };
+
+// ----------------------------------------------------------------------------
+// residentBytes
+// ----------------------------------------------------------------------------
+// Resident set size of the process (Linux only, 0 elsewhere)
+static size_t residentBytes() {
+  std::ifstream statm { "/proc/self/statm" };
+  size_t size { 0 }, resident { 0 };
+
+  statm >> size >> resident;
+
+  return resident * static_cast<size_t> (::sysconf (_SC_PAGESIZE));
+}
+
+// ----------------------------------------------------------------------------
+// measure
+// ----------------------------------------------------------------------------
+static void measure (bool releaseIdleBuffers) {
+  lightning::HttpServer server {
+    kPort,
+    1,
+    lightning::LogLevel::kError,
+    { .maxRequestsPerConnection = 0, .keepAliveTimeout = std::chrono::milliseconds { 0 }, .releaseIdleBuffers = releaseIdleBuffers }
+  };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/plaintext", [] (const auto &, auto &response) {
+    response.headers().set ("Content-Type", "text/plain");
+    response.status (200).send ("Hello, World!");
+  });
+
+  asio::io_context io;
+  std::vector<asio::ip::tcp::socket> sockets;
+  sockets.reserve (kConnections);
+
+  const size_t before { residentBytes() };
+
+  // every connection serves a request and then stays idle
+  for (size_t i { 0 }; i < kConnections; ++i) {
+    auto &socket { sockets.emplace_back (io) };
+
+    socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+    asio::write (socket, asio::buffer (kRequest));
+
+    std::string response;
+    asio::read_until (socket, asio::dynamic_buffer (response), "Hello, World!");
+  }
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+
+  const auto usage { server.memoryUsage() };
+  const size_t rss { residentBytes() - before };
+
+  fmt::print (
+    "{:<40} connections={} buffers={} KB footprint={} B/conn rss={} B/conn\n",
+    releaseIdleBuffers ? "idle buffers released" : "idle buffers kept",
+    usage.connections,
+    usage.inputBufferBytes / 1024,
+    usage.perConnection(),
+    rss / kConnections
+  );
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+// Memory held by idle keep-alive connections, with and without
+// HttpConfig::releaseIdleBuffers. Each run is made by a new process, so the RSS
+// is not lowered by memory freed by the previous one. It includes the client
+// sockets, which are the same in both runs.
+int main() {
+  for (const bool releaseIdleBuffers: { false, true }) {
+    if (const pid_t pid { ::fork() }; pid == 0) {
+      measure (releaseIdleBuffers);
+      return 0;
+    }
+    else if (pid > 0) {
+      ::waitpid (pid, nullptr, 0);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <lightning/http_server.h>
+
+#include "bench.h"
+
+
+static constexpr uint16_t kPort { 8094 };
+static constexpr size_t kConnectionsPerThread { 4 };
+static constexpr std::chrono::seconds kDuration { 2 };
+
+static constexpr std::string_view kRequest { "GET /plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n" };
+static constexpr std::string_view kCloseRequest { "GET /plaintext HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n" };
+static constexpr std::string_view kBody { "Hello, World!" };
+
+// ----------------------------------------------------------------------------
+// connect
+// ----------------------------------------------------------------------------
+static void connect (asio::ip::tcp::socket &socket) {
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+  socket.set_option (asio::ip::tcp::no_delay (true));
+}
+
+// ----------------------------------------------------------------------------
+// runKeepAlive
+// ----------------------------------------------------------------------------
+// Sends requests over a keep-alive connection, one at a time, until `stop` is set.
+static size_t runKeepAlive (const std::atomic<bool> &stop) {
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+  connect (socket);
+
+  std::string response;
+  size_t requests { 0 };
+
+  while (!stop.load (std::memory_order_relaxed)) {
+    asio::write (socket, asio::buffer (kRequest));
+
+    response.clear();
+
+    // every response has the same body, so it is complete once the body follows the headers
+    for (;;) {
+      const auto pos { response.find ("\r\n\r\n") };
+
+      if ((pos != std::string::npos) && (response.size() >= pos + 4 + kBody.size()))
+        break;
+
+      char data[1024];
+      const auto n { socket.read_some (asio::buffer (data)) };
+      response.append (data, n);
+    }
+
+    ++requests;
+  }
+
+  return requests;
+}
+
+// ----------------------------------------------------------------------------
+// runChurn
+// ----------------------------------------------------------------------------
+// Opens a connection per request, which the server closes, until `stop` is set.
+static size_t runChurn (const std::atomic<bool> &stop) {
+  asio::io_context io;
+  size_t requests { 0 };
+
+  while (!stop.load (std::memory_order_relaxed)) {
+    asio::ip::tcp::socket socket { io };
+    connect (socket);
+
+    asio::write (socket, asio::buffer (kCloseRequest));
+
+    std::string response;
+    asio::error_code ec;
+    asio::read (socket, asio::dynamic_buffer (response), ec);
+
+    ++requests;
+  }
+
+  return requests;
+}
+
+// ----------------------------------------------------------------------------
+// measure
+// ----------------------------------------------------------------------------
+static double measure (size_t threads, bool ioUring, bool churn) {
+  lightning::HttpServer server { kPort, threads, lightning::LogLevel::kError, { .maxRequestsPerConnection = 0, .sharded = true, .ioUring = ioUring } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/plaintext", [] (const auto &, auto &response) {
+    response.headers().set ("Content-Type", "text/plain");
+    response.status (200).send (std::string { kBody });
+  });
+
+  std::atomic<bool> stop { false };
+  std::atomic<size_t> total { 0 };
+  std::vector<std::thread> clients;
+
+  for (size_t i { 0 }; i < threads * kConnectionsPerThread; ++i)
+    clients.emplace_back ([ & ] { total += churn ? runChurn (stop) : runKeepAlive (stop); });
+
+  std::this_thread::sleep_for (kDuration);
+  stop = true;
+
+  for (auto &c: clients)
+    c.join();
+
+  const double rps { static_cast<double> (total.load()) / static_cast<double> (kDuration.count()) };
+
+  const auto backend { ioUring ? (server.ioUring() ? "io_uring" : "io_uring (unavailable, epoll)") : "epoll" };
+  fmt::print ("{:<48} {:>12.0f} req/s\n", fmt::format ("{} {} threads={}", churn ? "churn" : "keep-alive", backend, threads), rps);
+
+  return rps;
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+// Plaintext requests against the epoll reactor of asio and against an io_uring per
+// worker (sharded mode): over keep-alive connections, and with a new connection per
+// request, which also measures accepting. The clients run on the same machine, so
+// the numbers are only comparable between backends, not absolute.
+int main() {
+  const size_t cores { std::max (std::thread::hardware_concurrency(), 1u) };
+
+  for (const bool churn: { false, true }) {
+    for (size_t threads { 1 }; threads <= cores; threads *= 2) {
+      const double epoll { measure (threads, false, churn) };
+      const double ring { measure (threads, true, churn) };
+
+      fmt::print ("{:<48} {:>12.2f}x\n\n", "io_uring / epoll", ring / epoll);
+    }
+  }
+
+  return 0;
+}
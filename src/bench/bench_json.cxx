@@ -0,0 +1,90 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include <lightning/http_response.h>
+#include <lightning/json.h>
+
+#include "bench.h"
+
+
+static constexpr std::string_view kOrder {
+  R"({ "id": 1234567, "customer": { "name": "Jane \"JD\" Doe", "email": "jane@example.com" }, )"
+  R"("items": [ { "sku": "A-100", "qty": 2, "price": 19.99 }, { "sku": "B-200", "qty": 1, "price": 5.5 }, )"
+  R"({ "sku": "C-300", "qty": 10, "price": 0.99 } ], "notes": "leave at the door\nthanks", "paid": true })"
+};
+
+// ----------------------------------------------------------------------------
+// parse
+// ----------------------------------------------------------------------------
+// A request body parsed in place (the text is restored every time, as the body of
+// each request would be new) with the elements taken from an arena.
+static void parse() {
+  std::string text { kOrder };
+  std::byte arenaBuffer[4096];
+
+  bench::run ("parse (in place, arena)", 200000, [ & ] {
+    text.assign (kOrder);
+
+    std::pmr::monotonic_buffer_resource arena { arenaBuffer, sizeof (arenaBuffer) };
+    lightning::JsonDocument document { &arena };
+
+    document.parse (text.data(), text.size());
+    bench::doNotOptimize (document.root().find ("items")->at (2)->find ("qty")->get<int>());
+  });
+}
+
+// ----------------------------------------------------------------------------
+// serialize
+// ----------------------------------------------------------------------------
+// The same document serialized into the body of a response, and into a string that
+// is then given to send(), as handlers did before.
+static void serialize() {
+  const auto write = [] (lightning::JsonWriter &&writer) {
+    writer.startObject()
+      .key ("id").value (1234567)
+      .key ("customer").startObject().key ("name").value ("Jane \"JD\" Doe").key ("email").value ("jane@example.com").endObject()
+      .key ("items").startArray();
+
+    for (int i { 0 }; i < 3; ++i)
+      writer.startObject().key ("sku").value ("A-100").key ("qty").value (i + 1).key ("price").value (19.99).endObject();
+
+    writer.endArray()
+      .key ("notes").value ("leave at the door\nthanks")
+      .key ("paid").value (true)
+    .endObject();
+  };
+
+  lightning::HttpResponse response;
+
+  bench::run ("serialize into the response body", 200000, [ & ] {
+    write (response.json());
+    bench::doNotOptimize (response.body().size());
+    response.reset();
+  });
+
+  bench::run ("serialize into a string + send", 200000, [ & ] {
+    std::string out;
+    write (lightning::JsonWriter { out });
+
+    response.send (std::string { out });
+    bench::doNotOptimize (response.body().size());
+    response.reset();
+  });
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+int main() {
+  parse();
+  serialize();
+
+  return 0;
+}
@@ -0,0 +1,241 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <lightning/http_server.h>
+
+#include "bench.h"
+
+
+static constexpr uint16_t kPort { 8093 };
+static constexpr size_t kConnections { 4 };
+static constexpr std::chrono::seconds kDuration { 2 };
+
+using TlsClient = asio::ssl::stream<asio::ip::tcp::socket>;
+
+// ----------------------------------------------------------------------------
+// serverContext
+// ----------------------------------------------------------------------------
+// A self-signed P-256 certificate for localhost
+static asio::ssl::context serverContext() {
+  asio::ssl::context context { asio::ssl::context::tls_server };
+
+  EVP_PKEY *key { EVP_EC_gen ("P-256") };
+  X509 *cert { X509_new() };
+
+  ASN1_INTEGER_set (X509_get_serialNumber (cert), 1);
+  X509_gmtime_adj (X509_getm_notBefore (cert), 0);
+  X509_gmtime_adj (X509_getm_notAfter (cert), 3600);
+  X509_set_pubkey (cert, key);
+
+  X509_NAME *name { X509_get_subject_name (cert) };
+  X509_NAME_add_entry_by_txt (name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *> ("localhost"), -1, -1, 0);
+  X509_set_issuer_name (cert, name);
+  X509_sign (cert, key, EVP_sha256());
+
+  SSL_CTX_use_certificate (context.native_handle(), cert);
+  SSL_CTX_use_PrivateKey (context.native_handle(), key);
+
+  X509_free (cert);
+  EVP_PKEY_free (key);
+
+  return context;
+}
+
+// ----------------------------------------------------------------------------
+// kernelTlsAvailable
+// ----------------------------------------------------------------------------
+static bool kernelTlsAvailable() {
+  std::ifstream ulps { "/proc/sys/net/ipv4/tcp_available_ulp" };
+  std::string ulp;
+
+  while (ulps >> ulp) {
+    if (ulp == "tls")
+      return true;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// get
+// ----------------------------------------------------------------------------
+// Sends a GET request and reads its response, which must have a Content-Length
+template<typename Stream>
+static size_t get (Stream &stream, std::string_view request, std::string &response) {
+  asio::write (stream, asio::buffer (request));
+
+  response.clear();
+  const size_t headers { asio::read_until (stream, asio::dynamic_buffer (response), "\r\n\r\n") };
+
+  constexpr std::string_view kLength { "content-length: " };
+  const auto start { response.find (kLength) + kLength.size() };
+
+  size_t length { 0 };
+  std::from_chars (response.data() + start, response.data() + response.size(), length);
+
+  if (response.size() < headers + length)
+    asio::read (stream, asio::dynamic_buffer (response), asio::transfer_exactly (headers + length - response.size()));
+
+  return length;
+}
+
+// ----------------------------------------------------------------------------
+// benchHandshakes
+// ----------------------------------------------------------------------------
+// Clients open a connection, send a request and close it, in a loop. A resuming client
+// offers the session of its previous connection.
+static void benchHandshakes (std::string_view name, const lightning::HttpConfig &config, bool resume) {
+  lightning::HttpServer server { kPort, 2, lightning::LogLevel::kError, serverContext(), config };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/", [] (const auto &, auto &response) {
+    response.status (200).send ("ok");
+  });
+
+  std::atomic<bool> stop { false };
+  std::atomic<size_t> total { 0 };
+  std::atomic<size_t> resumed { 0 };
+  std::vector<std::thread> clients;
+
+  for (size_t c { 0 }; c < kConnections; ++c) {
+    clients.emplace_back ([ & ] {
+      asio::io_context io;
+      asio::ssl::context context { asio::ssl::context::tls_client };
+      SSL_SESSION *session { nullptr };
+      std::string response;
+      size_t handshakes { 0 };
+      size_t reused { 0 };
+
+      while (!stop.load (std::memory_order_relaxed)) {
+        TlsClient client { io, context };
+        client.next_layer().connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+        client.next_layer().set_option (asio::ip::tcp::no_delay (true));
+
+        if (session != nullptr)
+          SSL_set_session (client.native_handle(), session);
+
+        client.handshake (asio::ssl::stream_base::client);
+        get (client, "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n", response);
+
+        reused += (SSL_session_reused (client.native_handle()) == 1) ? 1 : 0;
+
+        if (resume) {
+          SSL_SESSION_free (session);
+          session = SSL_get1_session (client.native_handle());
+        }
+
+        asio::error_code ignored;
+        client.shutdown (ignored);
+
+        ++handshakes;
+      }
+
+      SSL_SESSION_free (session);
+
+      total += handshakes;
+      resumed += reused;
+    });
+  }
+
+  std::this_thread::sleep_for (kDuration);
+  stop = true;
+
+  for (auto &c: clients)
+    c.join();
+
+  const double rate { static_cast<double> (total.load()) / static_cast<double> (kDuration.count()) };
+
+  fmt::print ("{:<48} {:>12.0f} handshakes/s ({:.0f}% resumed)\n", name, rate, 100.0 * static_cast<double> (resumed.load()) / static_cast<double> (total.load()));
+}
+
+// ----------------------------------------------------------------------------
+// benchBulk
+// ----------------------------------------------------------------------------
+// A client downloads a file (sent from its descriptor) or an in-memory body over a
+// kept-alive connection, in a loop.
+static void benchBulk (std::string_view name, std::optional<lightning::HttpConfig> tls, std::string_view path) {
+  constexpr size_t kSize { 16 * 1024 * 1024 };
+
+  const auto directory { std::filesystem::temp_directory_path() / "lightning_bench_tls" };
+  std::filesystem::create_directories (directory);
+  std::ofstream { directory / "bulk.bin", std::ios::binary } << std::string (kSize, 'f');
+
+  const auto body { std::make_shared<const std::string> (kSize, 'm') };
+
+  std::optional<lightning::HttpServer> server;
+
+  if (tls)
+    server.emplace (kPort, 2, lightning::LogLevel::kError, serverContext(), *tls);
+  else
+    server.emplace (kPort, 2, lightning::LogLevel::kError);
+
+  server->addRoute (lightning::HttpMethod::kGet, "/memory", [ body ] (const auto &, auto &response) {
+    response.status (200).send (body);
+  });
+
+  server->addStaticRoute ("/files", directory);
+
+  const std::string request { "GET " + std::string { path } + " HTTP/1.1\r\nHost: localhost\r\n\r\n" };
+
+  asio::io_context io;
+  asio::ssl::context context { asio::ssl::context::tls_client };
+  TlsClient client { io, context };
+  client.next_layer().connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+
+  if (tls)
+    client.handshake (asio::ssl::stream_base::client);
+
+  std::string response;
+  response.reserve (kSize + 1024);
+
+  size_t bytes { 0 };
+  const auto start { std::chrono::steady_clock::now() };
+
+  while (std::chrono::steady_clock::now() - start < kDuration)
+    bytes += tls ? get (client, request, response) : get (client.next_layer(), request, response);
+
+  const std::chrono::duration<double> elapsed { std::chrono::steady_clock::now() - start };
+
+  fmt::print ("{:<48} {:>12.0f} MB/s\n", name, static_cast<double> (bytes) / elapsed.count() / (1024.0 * 1024.0));
+
+  std::filesystem::remove_all (directory);
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+// Handshake rate, full and resumed, and bulk throughput of HTTPS over loopback, with a
+// self-signed certificate.
+int main() {
+  benchHandshakes ("handshakes, full", { .tlsSessionCacheSize = 0, .tlsSessionTickets = false }, false);
+  benchHandshakes ("handshakes, resumed (session cache)", { .tlsSessionTickets = false }, true);
+  benchHandshakes ("handshakes, resumed (tickets)", { .tlsSessionCacheSize = 0 }, true);
+
+  const bool ktls { kernelTlsAvailable() };
+
+  for (const std::string_view path: { "/memory", "/files/bulk.bin" }) {
+    benchBulk (fmt::format ("bulk {}, plain", path), std::nullopt, path);
+    benchBulk (fmt::format ("bulk {}, tls", path), lightning::HttpConfig {}, path);
+    benchBulk (fmt::format ("bulk {}, tls{}", path, ktls ? " + ktls" : " (no ktls module)"), lightning::HttpConfig { .kernelTls = true }, path);
+  }
+
+  return 0;
+}
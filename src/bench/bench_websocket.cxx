@@ -0,0 +1,232 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <lightning/http_server.h>
+
+#include "bench.h"
+
+
+static constexpr uint16_t kPort { 8092 };
+static constexpr std::chrono::seconds kDuration { 2 };
+
+static constexpr std::string_view kHandshake {
+  "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+};
+
+// ----------------------------------------------------------------------------
+// maskedFrame
+// ----------------------------------------------------------------------------
+static std::string maskedFrame (std::string_view payload) {
+  const std::array<uint8_t, 4> key { 0x12, 0x34, 0x56, 0x78 };
+
+  std::string frame;
+  lightning::WebSocket::appendFrame (frame, payload, lightning::WebSocketOpcode::kText);
+
+  // the mask bit and key go after the length
+  const size_t headerLength { frame.size() - payload.size() };
+  frame[1] = static_cast<char> (frame[1] | 0x80);
+  frame.insert (headerLength, reinterpret_cast<const char *> (key.data()), key.size());
+
+  lightning::WebSocket::unmask (frame.data() + headerLength + key.size(), payload.size(), key);
+
+  return frame;
+}
+
+// ----------------------------------------------------------------------------
+// connect
+// ----------------------------------------------------------------------------
+static void connect (asio::ip::tcp::socket &socket) {
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+  socket.set_option (asio::ip::tcp::no_delay (true));
+
+  asio::write (socket, asio::buffer (kHandshake));
+
+  std::string response;
+  asio::read_until (socket, asio::dynamic_buffer (response), "\r\n\r\n");
+}
+
+// ----------------------------------------------------------------------------
+// benchUnmask
+// ----------------------------------------------------------------------------
+static void benchUnmask() {
+  const std::array<uint8_t, 4> key { 0x12, 0x34, 0x56, 0x78 };
+
+  for (const size_t size: { 64, 1024, 16 * 1024 }) {
+    std::string data (size, 'x');
+
+    const double scalar {
+      bench::run (fmt::format ("unmask bytewise, {} bytes", size), 100000, [ & ] {
+        for (size_t i { 0 }; i < data.size(); ++i)
+          data[i] = static_cast<char> (data[i] ^ key[i & 3]);
+
+        bench::doNotOptimize (data);
+      })
+    };
+
+    const double vectorized {
+      bench::run (fmt::format ("unmask vectorized, {} bytes", size), 100000, [ & ] {
+        lightning::WebSocket::unmask (data.data(), data.size(), key);
+        bench::doNotOptimize (data);
+      })
+    };
+
+    fmt::print ("{:<48} {:>12.2f}x\n", "speed-up", scalar / vectorized);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// benchEcho
+// ----------------------------------------------------------------------------
+// Clients send batches of `depth` messages with a single write and wait for the echoes
+static void benchEcho (size_t connections, size_t depth, size_t messageSize) {
+  lightning::HttpServer server { kPort, 2, lightning::LogLevel::kError };
+
+  server.addWebSocketRoute ("/ws", {
+    .onMessage = [] (auto &ws, std::string_view message, bool binary) { ws.send (message, binary); }
+  });
+
+  std::atomic<bool> stop { false };
+  std::atomic<size_t> total { 0 };
+  std::vector<std::thread> clients;
+
+  for (size_t c { 0 }; c < connections; ++c) {
+    clients.emplace_back ([ & ] {
+      asio::io_context io;
+      asio::ip::tcp::socket socket { io };
+      connect (socket);
+
+      std::string batch;
+      for (size_t i { 0 }; i < depth; ++i)
+        batch += maskedFrame (std::string (messageSize, 'm'));
+
+      // server frames are not masked, so the echoes are 4 bytes shorter
+      std::vector<char> echoes (batch.size() - depth * 4);
+      size_t messages { 0 };
+
+      while (!stop.load (std::memory_order_relaxed)) {
+        asio::write (socket, asio::buffer (batch));
+        asio::read (socket, asio::buffer (echoes));
+
+        messages += depth;
+      }
+
+      total += messages;
+    });
+  }
+
+  std::this_thread::sleep_for (kDuration);
+  stop = true;
+
+  for (auto &c: clients)
+    c.join();
+
+  const double rate { static_cast<double> (total.load()) / static_cast<double> (kDuration.count()) };
+
+  fmt::print ("{:<48} {:>12.0f} msg/s\n", fmt::format ("echo, {} connections, depth={}, {} bytes", connections, depth, messageSize), rate);
+}
+
+// ----------------------------------------------------------------------------
+// benchBroadcast
+// ----------------------------------------------------------------------------
+// The server sends `messages` messages to every subscriber, framing each one once
+// (shared) or once per subscriber.
+static void benchBroadcast (size_t subscribers, size_t messages, size_t messageSize, bool shared) {
+  lightning::HttpServer server { kPort, 2, lightning::LogLevel::kError };
+
+  std::mutex mutex;
+  std::vector<lightning::WebSocket> sockets;
+
+  server.addWebSocketRoute ("/ws", {
+    .onOpen = [ & ] (const auto &, auto &ws) {
+      std::lock_guard lock { mutex };
+      sockets.push_back (ws);
+    }
+  });
+
+  const size_t frameSize { lightning::WebSocket::frame (std::string (messageSize, 'b'))->size() };
+  std::vector<std::thread> clients;
+
+  for (size_t c { 0 }; c < subscribers; ++c) {
+    clients.emplace_back ([ & ] {
+      asio::io_context io;
+      asio::ip::tcp::socket socket { io };
+      connect (socket);
+
+      std::vector<char> data (frameSize * messages);
+      asio::read (socket, asio::buffer (data));
+    });
+  }
+
+  while (true) {
+    std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    std::lock_guard lock { mutex };
+    if (sockets.size() == subscribers)
+      break;
+  }
+
+  const std::string payload (messageSize, 'b');
+  const auto start { std::chrono::steady_clock::now() };
+
+  {
+    std::lock_guard lock { mutex };
+
+    for (size_t i { 0 }; i < messages; ++i) {
+      if (shared) {
+        const auto frame { lightning::WebSocket::frame (payload) };
+
+        for (auto &ws: sockets)
+          ws.send (frame);
+      }
+      else {
+        for (auto &ws: sockets)
+          ws.send (payload);
+      }
+    }
+  }
+
+  for (auto &c: clients)
+    c.join();
+
+  const std::chrono::duration<double> elapsed { std::chrono::steady_clock::now() - start };
+  const double rate { static_cast<double> (messages * subscribers) / elapsed.count() };
+
+  fmt::print (
+    "{:<48} {:>12.0f} msg/s\n",
+    fmt::format ("broadcast {}, {} subscribers, {} bytes", shared ? "shared" : "copied", subscribers, messageSize),
+    rate
+  );
+
+  std::lock_guard lock { mutex };
+  sockets.clear();
+}
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+// Unmasking, echo round trips and broadcast fan-out over loopback.
+int main() {
+  benchUnmask();
+
+  for (const size_t depth: { 1, 16 })
+    benchEcho (4, depth, 128);
+
+  benchEcho (4, 16, 16 * 1024);
+
+  for (const bool shared: { false, true })
+    benchBroadcast (64, 2000, 1024, shared);
+
+  return 0;
+}
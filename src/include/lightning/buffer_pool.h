@@ -0,0 +1,39 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_BUFFER_POOL_H__
+#define __LIGHTNING_BUFFER_POOL_H__
+#include <cstddef>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// BufferPool
+// ----------------------------------------------------------------------------
+// Per-thread cache of I/O buffers. Every thread keeps up to kMaxCached free buffers
+// of a single size (the last one requested), so the buffers of connections that go
+// idle are reused by the ones that become active on the same thread. Buffers of
+// other sizes are allocated and freed as usual. A buffer may be released by a
+// thread other than the one that acquired it.
+class BufferPool {
+  public:
+    static constexpr size_t kMaxCached { 64 };
+
+    struct Stats {
+      size_t usedBytes; // acquired and not released yet
+      size_t cachedBytes; // free, kept by the threads
+    };
+
+    static char * acquire (size_t size);
+    static void release (char *buffer, size_t size);
+
+    /// @brief Process-wide statistics
+    static Stats stats();
+};
+
+}
+
+#endif
@@ -0,0 +1,137 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_CACHE_H__
+#define __LIGHTNING_HTTP_CACHE_H__
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <lightning/http_request.h>
+#include <lightning/http_response.h>
+#include <lightning/http_router.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpCacheConfig
+// ----------------------------------------------------------------------------
+struct HttpCacheConfig {
+  /// @brief Time a response is served from the cache.
+  std::chrono::milliseconds ttl { 1000 };
+
+  /// @brief Maximum size (in bytes) of the cached responses. The least recently used ones are evicted first.
+  size_t maxBytes { 16 * 1024 * 1024 };
+
+  /// @brief Request headers that select a different response (e.g. "Accept-Language"); method,
+  /// path and query are always part of the key.
+  std::vector<std::string> varyHeaders;
+};
+
+// ----------------------------------------------------------------------------
+// HttpCachedResponse
+// ----------------------------------------------------------------------------
+// An immutable response, shared by every request served from it: the headers are
+// views into `headerData`, and the body is given to the responses as it is, along
+// with its compressed forms (made by the first response of each coding, and not
+// counted in size()).
+//
+// The header block is not kept serialized: the connection still writes it for
+// every request, because part of it is per request. Connection depends on the
+// connection; a conditional request turns the response into a 304 or a 206;
+// compression adds Content-Encoding and Vary and weakens the ETag. Setting the
+// cached headers only copies views, so what is repeated is the serialization,
+// which is the same as for any other response.
+struct HttpCachedResponse {
+  uint32_t status;
+  std::string headerData;
+  std::vector<HttpHeader::HeaderData> headers;
+  std::shared_ptr<const std::string> body;
+  std::shared_ptr<HttpCompressedBodies> compressed;
+  std::shared_ptr<const StaticFile> file; // never cached, only handed to coalesced requests
+
+  /// @brief Memory held by the response, in bytes
+  inline size_t size() const { return sizeof (*this) + headerData.size() + (body ? body->size() : 0); }
+};
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache
+// ----------------------------------------------------------------------------
+// Response cache of a route (see HttpServer::addCachedRoute). Successful responses
+// (200, with a body in memory, no Set-Cookie and no "Cache-Control: no-store/private")
+// are kept for the TTL.
+//
+// Misses are coalesced: while the handler runs for a key, other requests for the
+// same key are deferred and get its response when it completes, whether it is
+// cached or not. If that response is never completed (its connection is closed) or
+// it is streamed, they get a 503.
+class HttpResponseCache {
+  public:
+    /// @param autoETag Give the cached responses without an ETag one, computed once (see HttpConfig::autoETag)
+    explicit HttpResponseCache (const HttpCacheConfig &config = {}, bool autoETag = false);
+
+    /// @brief Respond from the cache, or run the handler (sync or deferred) and cache its response
+    void handle (const HttpRequest &request, HttpResponse &response, const RequestHandler &handler);
+
+    /// @brief Cache key of a request
+    std::string key (const HttpRequest &request) const;
+
+    /// @brief Number of cached responses
+    inline size_t size() const {
+      std::lock_guard lock { _mutex };
+      return _entries.size();
+    }
+
+    /// @brief Memory held by the cached responses, in bytes
+    inline size_t bytes() const {
+      std::lock_guard lock { _mutex };
+      return _bytes;
+    }
+
+  private:
+    struct Entry {
+      std::shared_ptr<const HttpCachedResponse> response;
+      std::chrono::steady_clock::time_point expires;
+      std::list<std::string>::iterator lru;
+    };
+
+    // requests waiting for the response of a handler in progress
+    struct Flight {
+      struct Waiter {
+        HttpResponse *response;
+        HttpResponder responder;
+      };
+
+      std::string key;
+      std::vector<Waiter> waiters;
+      bool landed { false };
+    };
+
+    HttpCacheConfig _config;
+    bool _autoETag;
+    mutable std::mutex _mutex; // handlers run on every I/O thread
+    std::unordered_map<std::string, Entry> _entries;
+    std::list<std::string> _lru; // most recently used first
+    size_t _bytes { 0 };
+    std::unordered_map<std::string_view, std::shared_ptr<Flight>> _flights; // keys point into the flights
+
+    void _land (const std::shared_ptr<Flight> &flight, HttpResponse *response);
+    void _insert (const std::string &key, std::shared_ptr<const HttpCachedResponse> cached);
+    void _erase (std::unordered_map<std::string, Entry>::iterator it);
+    static std::shared_ptr<HttpCachedResponse> _capture (HttpResponse &response, bool autoETag);
+    static bool _cacheable (const HttpResponse &response);
+    static void _replay (const std::shared_ptr<const HttpCachedResponse> &cached, HttpResponse &response);
+};
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_COMPRESSION_H__
+#define __LIGHTNING_HTTP_COMPRESSION_H__
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <lightning/http_config.h>
+#include <lightning/http_request.h>
+#include <lightning/http_response.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpCompression
+// ----------------------------------------------------------------------------
+// Content coding of responses (gzip and deflate, with zlib). The connection applies
+// it to every response once the handler has finished (see HttpConfig::compression).
+//
+// Every I/O thread keeps its deflate streams (reset, not reinitialized, for every
+// response) and an output buffer that grows to the biggest compressed body, so only
+// the compressed bytes are copied into the body. The streams take about 256 KB per
+// encoding and thread, allocated the first time the thread compresses with it.
+class HttpCompression {
+  public:
+    enum class Encoding {
+      kIdentity,
+      kGzip,
+      kDeflate
+    };
+
+    /// @brief Compress the body of a response if the request accepts it and the response
+    /// qualifies: an in-memory body of at least config.compressionMinSize bytes, a media type
+    /// in config.compressionTypes, no Content-Encoding, Content-Length or ranges. Bodies sent
+    /// with their HttpCompressedBodies are compressed once per coding; files without them are
+    /// sent as they are.
+    static void apply (const HttpRequest &request, HttpResponse &response, const HttpConfig &config);
+
+    /// @brief Preferred coding of an Accept-Encoding value (gzip over deflate when both are as good)
+    static Encoding negotiate (std::string_view acceptEncoding);
+
+    /// @brief Check whether a media type starts with any of the given prefixes (case insensitive)
+    static bool compressible (std::string_view contentType, const std::vector<std::string> &types);
+
+    /// @brief Compress data with the streams of the calling thread
+    ///
+    /// @param level zlib compression level (1: fastest, 9: smallest)
+    ///
+    /// @return False if it fails or the result is not smaller than the input
+    static bool compress (Encoding encoding, std::string_view data, int level, std::string &out);
+
+    /// @brief Token of a coding ("gzip" or "deflate")
+    static std::string_view name (Encoding encoding);
+};
+
+// ----------------------------------------------------------------------------
+// HttpCompressedBodies
+// ----------------------------------------------------------------------------
+// Compressed forms of a body sent by many responses (a cached response or a static
+// file), kept next to it: each coding is compressed by the first response that
+// needs it and shared by the ones after it. A body that does not get smaller is
+// only tried once.
+class HttpCompressedBodies {
+  public:
+    /// @brief The body compressed with a coding, or nullptr if it is not smaller
+    ///
+    /// @param data The body, the same for every call
+    std::shared_ptr<const std::string> get (HttpCompression::Encoding encoding, std::string_view data, int level);
+
+  private:
+    struct Slot {
+      std::shared_ptr<const std::string> body;
+      bool tried { false };
+    };
+
+    std::mutex _mutex; // responses of every I/O thread
+    std::array<Slot, 2> _slots; // gzip and deflate
+};
+
+}
+
+#endif
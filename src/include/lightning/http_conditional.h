@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_CONDITIONAL_H__
+#define __LIGHTNING_HTTP_CONDITIONAL_H__
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <lightning/http_request.h>
+#include <lightning/http_response.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpConditional
+// ----------------------------------------------------------------------------
+// Validators, conditional requests and byte ranges (RFC 9110, sections 13 and 14).
+// The connection evaluates every 200 response to a GET or HEAD request before its
+// header block is serialized:
+//   - If-None-Match (or, without it, If-Modified-Since) turns it into a 304 and
+//     drops the body.
+//   - Range (honoured only if If-Range, when present, still matches) restricts
+//     the body of a GET to the requested ranges: a 206, multipart/byteranges if
+//     there are several, or a 416 if none can be satisfied.
+class HttpConditional {
+  public:
+    static constexpr size_t kMaxRanges { 16 }; // requests with more ranges get the whole body
+
+    /// @brief Apply the conditional headers of a request to its response
+    ///
+    /// @param autoETag Add a strong ETag, a hash of the body, to in-memory bodies without one
+    static void evaluate (const HttpRequest &request, HttpResponse &response, bool autoETag);
+
+    /// @brief Fast 64-bit (non-cryptographic) hash
+    static uint64_t hash (std::string_view data);
+
+    /// @brief Strong entity tag of a body, as added by `autoETag`: its quoted hash
+    static std::string etag (std::string_view body);
+
+    /// @brief Parse an HTTP date in the preferred format (IMF-fixdate), e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+    ///
+    /// @return Seconds since the epoch
+    static std::optional<int64_t> parseDate (std::string_view date);
+
+    /// @brief Parse the value of a Range header
+    ///
+    /// @param size Size of the whole content
+    ///
+    /// @return The satisfiable ranges (empty if there is none), or nullopt if the header
+    /// is not valid or has too many ranges, in which case it is ignored
+    static std::optional<std::vector<HttpResponseBody::Range>> parseRanges (std::string_view value, uint64_t size);
+
+    /// @brief Check whether an If-None-Match list matches an entity tag (weak comparison)
+    static bool matchesAny (std::string_view list, std::string_view etag);
+};
+
+}
+
+#endif
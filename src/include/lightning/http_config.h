@@ -0,0 +1,132 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_CONFIG_H__
+#define __LIGHTNING_HTTP_CONFIG_H__
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpConfig
+// ----------------------------------------------------------------------------
+struct HttpConfig {
+  /// @brief Initial size (in bytes) of the input buffer owned by every connection.
+  size_t inputBufferSize { 4096 };
+
+  /// @brief Maximum size (in bytes) of the request line plus headers. Bigger requests are rejected with 431.
+  size_t maxHeaderSize { 64 * 1024 };
+
+  /// @brief Maximum size (in bytes) of a collected request body. Bigger requests are rejected with 413.
+  /// Bodies streamed to a BodyHandler are not limited.
+  size_t maxBodySize { 1024 * 1024 };
+
+  /// @brief Maximum number of requests served by a connection before it is closed (0: no limit).
+  size_t maxRequestsPerConnection { 1000 };
+
+  /// @brief Maximum number of open connections of the server (0: no limit). While it is reached,
+  /// new connections are not accepted (they wait in the listen backlog).
+  size_t maxConnections { 0 };
+
+  /// @brief Time allowed to receive the request line and headers (0: no limit), counted from the
+  /// connection being accepted or, on a kept-alive connection, from the first byte of the request.
+  std::chrono::milliseconds headerTimeout { 10000 };
+
+  /// @brief Maximum time between two reads of a request body (0: no limit).
+  std::chrono::milliseconds bodyTimeout { 30000 };
+
+  /// @brief Time a kept-alive connection may stay idle waiting for the next request (0: no limit).
+  std::chrono::milliseconds keepAliveTimeout { 5000 };
+
+  /// @brief Time allowed to write the pending responses (0: no limit).
+  std::chrono::milliseconds writeTimeout { 30000 };
+
+  /// @brief Idle connections wait for the socket to be readable without an input buffer, and take
+  /// one from a per-thread pool when data arrives. It saves inputBufferSize bytes per idle keep-alive
+  /// connection, at the cost of an extra poll per request.
+  bool releaseIdleBuffers { false };
+
+  /// @brief Give 200 responses to GET and HEAD requests with an in-memory body and without an ETag
+  /// a strong one, a hash of the body, so clients can revalidate them (If-None-Match, If-Range).
+  /// Hashing costs a pass over every such body (over each cached one only once, see HttpServer::addCachedRoute).
+  bool autoETag { false };
+
+  /// @brief Bytes of a streamed response that may wait to be sent before its writes stop
+  /// completing (see HttpStream).
+  size_t streamHighWaterMark { 64 * 1024 };
+
+  /// @brief Maximum size (in bytes) of a WebSocket message, with all its fragments. Bigger
+  /// ones close the connection (status 1009).
+  size_t maxWebSocketMessageSize { 1024 * 1024 };
+
+  /// @brief Compress response bodies with gzip or deflate, as negotiated with Accept-Encoding
+  /// (see HttpCompression). Strong ETags of compressed responses are made weak.
+  bool compression { false };
+
+  /// @brief zlib level used to compress responses (1: fastest, 9: smallest).
+  int compressionLevel { 6 };
+
+  /// @brief Smaller bodies (in bytes) are not worth compressing.
+  size_t compressionMinSize { 1024 };
+
+  /// @brief Media types (prefixes) that are compressed.
+  std::vector<std::string> compressionTypes {
+    "text/", "application/json", "application/javascript", "application/xml", "image/svg+xml"
+  };
+
+  /// @brief Initial size (in bytes) of the per-connection arena that requests and responses allocate from.
+  /// It is released after every response. Must be greater than 0.
+  size_t arenaSize { 4096 };
+
+  /// @brief Maximum number of closed connections (per worker) kept to be reused by new ones.
+  size_t connectionPoolSize { 256 };
+
+  /// @brief Run one io_context per worker thread, each one with its own SO_REUSEPORT acceptor,
+  /// instead of sharing a single io_context between all of them. Connections stay on the worker
+  /// that accepted them.
+  bool sharded { false };
+
+  /// @brief Pin every worker thread to a core (sharded mode, Linux only).
+  bool pinWorkers { true };
+
+  /// @brief Sessions kept by the server-side TLS session cache, which clients resume with an
+  /// abbreviated handshake (0: no cache). The cache is shared by every worker.
+  size_t tlsSessionCacheSize { 20 * 1024 };
+
+  /// @brief Lifetime of a TLS session, cached or in a ticket.
+  std::chrono::seconds tlsSessionTimeout { 3600 };
+
+  /// @brief Issue TLS session tickets, which let clients resume a session the server has not
+  /// kept. Their keys are generated when the server starts.
+  bool tlsSessionTickets { true };
+
+  /// @brief Let the kernel encrypt and decrypt TLS records (kTLS, Linux with the tls module and an
+  /// AES-GCM or ChaCha20-Poly1305 cipher), which also lets files be sent with sendfile(2).
+  /// Connections where it cannot be enabled encrypt in user space.
+  bool kernelTls { false };
+
+  /// @brief Accept connections, and read and write plain (not TLS) ones, through an io_uring per
+  /// worker (Linux 5.19 or later) instead of the epoll reactor of asio: operations are submitted
+  /// in batches and completions reaped without a syscall each. Idle connections receive into
+  /// buffers the kernel picks from a ring (ioUringBuffers), so they hold no input buffer either.
+  /// The completions of a worker are handled by the thread that reaps them, which suits sharded
+  /// mode. Servers fall back to epoll where io_uring is not available.
+  bool ioUring { false };
+
+  /// @brief Entries of the submission queue of every ring (rounded up to a power of two).
+  size_t ioUringEntries { 1024 };
+
+  /// @brief Buffers, of inputBufferSize bytes, provided to every ring for idle connections
+  /// (rounded up to a power of two; 0: none, idle connections keep their buffer).
+  size_t ioUringBuffers { 256 };
+};
+
+}
+
+#endif
@@ -5,77 +5,373 @@
 // ----------------------------------------------------------------------------
 #ifndef __LIGHTNING_HTTP_CONNECTION_H__
 #define __LIGHTNING_HTTP_CONNECTION_H__
-#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
 #include <string_view>
 #include <system_error>
+#include <vector>
 
 #include <asio.hpp>
+#include <llhttp.h>
 
 #include <lightning/types.h>
+#include <lightning/buffer_pool.h>
+#include <lightning/http_config.h>
 #include <lightning/http_request.h>
 #include <lightning/http_response.h>
+#include <lightning/http_router.h>
+#include <lightning/http_stream.h>
+#include <lightning/http_websocket.h>
+#include <lightning/io_uring.h>
+#include <lightning/timer_wheel.h>
+#include <lightning/tls_stream.h>
 
 
 namespace lightning {
 
+// ----------------------------------------------------------------------------
+// InputBuffer
+// ----------------------------------------------------------------------------
+// Contiguous storage for the bytes read from a socket. The region between the
+// start of the current message and the parsed position stays in place while the
+// message is handled; the remaining bytes (a partial or pipelined request) are
+// fed to the parser afterwards, so every byte is parsed exactly once.
+//
+// The storage comes from the BufferPool of the thread, when the first read needs it,
+// and can be given back while the buffer is empty.
 class InputBuffer {
   public:
+    explicit InputBuffer (size_t size): _size { size } {
+      // empty
+    }
+
+    InputBuffer (const InputBuffer &) = delete;
+    InputBuffer & operator= (const InputBuffer &) = delete;
+
+    ~InputBuffer() {
+      BufferPool::release (_buf, _capacity);
+    }
+
+    // Makes room for the next read: bytes of already handled messages are discarded and,
+    // if the buffer is still full, its capacity is doubled. The current message may move.
+    void reserve() {
+      if (_buf == nullptr) {
+        _buf = BufferPool::acquire (_size);
+        _capacity = _size;
+      }
+
+      if (_end < _capacity)
+        return;
+
+      if (_start > 0) {
+        std::memmove (_buf, _buf + _start, _end - _start);
+        _parsed -= _start;
+        _end -= _start;
+        _start = 0;
+      }
+      else {
+        char *buf { BufferPool::acquire (_capacity * 2) };
+        std::memcpy (buf, _buf, _end);
+        BufferPool::release (_buf, _capacity);
+        _buf = buf;
+        _capacity *= 2;
+      }
+    }
+
+    // Gives the storage back to the pool. The buffer must not hold any byte.
+    void release() {
+      BufferPool::release (_buf, _capacity);
+
+      _buf = nullptr;
+      _capacity = 0;
+      _start = _parsed = _end = 0;
+    }
+
     auto makeAsioBuffer() {
-      return asio::buffer (_buf.data(), _buf.size());
+      return asio::buffer (_buf + _end, _capacity - _end);
     }
 
     void obtainedBytes (size_t length) {
-      _readyLength = length; // current bytes in buffer
-      _readyPos = 0; // reset current pos
+      _end += length; // bytes appended by the last read
+    }
+
+    void parsedBytes (size_t length) {
+      _parsed += length; // bytes fed to the parser
     }
 
-    void consumedBytes (size_t length) {
-      _readyLength -= length; // decrement buffer length.
-      _readyPos += length; // shift current pos.
+    // Forget every byte, going back to the initial capacity if the buffer has grown.
+    void clear (size_t size) {
+      if (_capacity != size)
+        release();
+
+      _start = _parsed = _end = 0;
+      _size = size;
     }
 
-    inline size_t length() const { return _readyLength; }
+    // Drop the parsed bytes of the current message that follow its first `keep` bytes
+    // (e.g. a streamed body), moving the unparsed ones back.
+    void discardParsed (size_t keep) {
+      const size_t from { _start + keep };
 
-    const char * bytes() const { return _buf.data(); }
+      std::memmove (_buf + from, _buf + _parsed, _end - _parsed);
+      _end -= _parsed - from;
+      _parsed = from;
+    }
+
+    void consumedBytes() {
+      _start = _parsed; // the current message is no longer referenced
 
-    inline std::string_view str() const {
-      return std::string_view (_buf.data());
+      if (_start == _end)
+        _start = _parsed = _end = 0;
     }
 
+    inline size_t length() const { return _end - _start; }
+    inline size_t parsedLength() const { return _parsed - _start; }
+    inline size_t capacity() const { return _capacity; }
+
+    inline const char * message() const { return _buf + _start; }
+
+    inline std::string_view unparsed() const {
+      return std::string_view { _buf + _parsed, _end - _parsed };
+    }
+
+    // The unparsed bytes may be modified in place (e.g. unmasked)
+    inline char * unparsedData() { return _buf + _parsed; }
+
   private:
-    std::array<char, 4096> _buf {};
-    size_t _readyPos { 0 };
-    size_t _readyLength { 0 };
+    char *_buf { nullptr };
+    size_t _size; // initial capacity
+    size_t _capacity { 0 };
+    size_t _start { 0 }; // beginning of the current message
+    size_t _parsed { 0 }; // end of the bytes fed to the parser
+    size_t _end { 0 }; // end of the bytes obtained from the socket
 };
 
 
+// Resolves the route of a request once its headers have been parsed.
+using RouteResolver = std::function<const HttpRoute & (HttpRequest &)>;
+
+// ----------------------------------------------------------------------------
+// HttpConnection
+// ----------------------------------------------------------------------------
+// Request and response allocate from a per-connection monotonic arena, which is
+// released when the next message begins. Read, idle and write deadlines are kept in the
+// timing wheel of the io_context the connection runs on.
+//
+// With a TLS context, the socket is read and written through a TlsStream, whose
+// handshake comes before the first request. Otherwise, with an IoUring, it is read
+// and written through the ring.
 class HttpConnection: public std::enable_shared_from_this<HttpConnection> {
   public:
     HttpConnection (
       asio::ip::tcp::socket && socket,
-      std::function<void (HttpRequest &, HttpResponse &)> receivedRequest,
-      const Logger &logger
+      RouteResolver findRoute,
+      TimerWheel &timers,
+      const HttpConfig &config,
+      const Logger &logger,
+      asio::ssl::context *tls = nullptr,
+      IoUring *ring = nullptr
     ):
       _socket { std::move (socket) },
-      _onReceivedRequest { receivedRequest },
+      _ring { (tls == nullptr) ? ring : nullptr },
+      _findRoute { std::move (findRoute) },
+      _timers { timers },
+      _timeout { [ this ] { _expired(); } },
+      _inputBuffer { config.inputBufferSize },
+      _arenaBuffer { new std::byte[config.arenaSize] },
+      _arena { _arenaBuffer.get(), config.arenaSize, std::pmr::new_delete_resource() },
+      _request { logger, &_arena },
+      _response { &_arena },
+      _config { config },
       _logger { logger }
     {
-      // empty
+      _response.setResponderFactory ([ this ] { return _makeResponder(); });
+      _response.setStreamFactory ([ this ] { return _makeStream(); });
+
+      if (tls != nullptr)
+        _tls.emplace (_socket, *tls, config.kernelTls);
+
+      _open();
     }
 
+    /// @brief Serve the socket: the TLS handshake, if any, then the requests
+    void start();
+
     void waitForHttpMessage();
 
+    /// @brief Reuse a closed connection (and its buffers) for a new socket
+    void reuse (asio::ip::tcp::socket &&socket);
+
+    /// @brief Close the socket, if it is still open
+    void close();
+
   private:
+    // What the connection is waiting for, and so which timeout applies
+    enum class Deadline: uint8_t {
+      kNone = 0,
+      kHeaders,
+      kBody,
+      kIdle,
+      kWrite
+    };
+
     asio::ip::tcp::socket _socket;
-    std::function<void (HttpRequest &, HttpResponse &)> _onReceivedRequest;
+    std::optional<TlsStream> _tls; // of an HTTPS connection
+    IoUring *_ring; // of the worker, if the socket is read and written through it
+    RouteResolver _findRoute;
+    std::reference_wrapper<TimerWheel> _timers;
+    TimerWheel::Entry _timeout;
+    Deadline _deadline { Deadline::kNone };
     InputBuffer _inputBuffer;
+    std::unique_ptr<std::byte[]> _arenaBuffer;
+    std::pmr::monotonic_buffer_resource _arena;
+    llhttp_t _parser;
+    HttpRequest _request;
+    HttpResponse _response; // owned by the connection until it has been written
+    const HttpRoute *_route { nullptr }; // route of the current request
+    size_t _bodyOffset { 0 }; // start of the body in the current message
+    size_t _requests { 0 }; // requests served
+    bool _closing { false }; // closed once the queued responses have been written
+    std::string _outputBuffer; // header blocks of the queued responses
+
+    struct QueuedResponse {
+      size_t headersEnd; // end of its header block in _outputBuffer
+      HttpResponseBody body;
+    };
+
+    std::vector<QueuedResponse> _queued; // responses of pipelined requests, in order
+    std::vector<asio::const_buffer> _writeBuffers;
+    uint64_t _fileOffset { 0 }; // bytes of the file range being sent
+    std::string _fileBuffer; // piece of a file being sent through TLS encrypted in user space
+
+    // A streamed response, shared with its HttpStream handles (which can be used from any thread)
+    struct StreamState {
+      std::mutex mutex;
+      std::vector<HttpStream::Chunk> chunks; // written by the handler, not taken by the connection yet
+      std::vector<HttpStream::Completion> blocked; // writes waiting for the pending bytes to go down
+      size_t pendingBytes { 0 }; // written by the handler and not sent yet
+      bool writing { true }; // the connection is sending; it takes the new chunks when it is done
+      bool ended { false };
+      std::error_code error;
+      asio::any_io_executor executor; // runs the writes (a strand for a WebSocket, which also reads)
+    };
+
+    class StreamSink; // the connection as seen by the handles
+    std::shared_ptr<StreamState> _stream; // of the response being streamed
+    std::vector<HttpStream::Chunk> _streamChunks; // being sent
+    std::string _chunkHeaders; // sizes of the chunks being sent
+    bool _streamChunked { true }; // chunked transfer coding (HTTP/1.1)
+    bool _streamBody { true }; // false for HEAD requests
+    bool _handling { false }; // the route handler is running
+    size_t _streamedRequest { SIZE_MAX }; // index (in _requests) of the last streamed response
+    std::shared_ptr<const WebSocketHandler> _wsHandler; // of an upgraded connection
+    WebSocket _webSocket; // keeps the connection alive until it is closed
+    std::string _wsMessage; // fragments of the message being received
+    bool _wsFragmented { false }; // a message is being received in fragments
+    bool _wsBinary { false }; // type of the fragmented message
+    uint16_t _wsCloseCode { 1006 }; // of the close frame received
+    std::string _ip;
+    std::reference_wrapper<const HttpConfig> _config;
     std::reference_wrapper<const Logger> _logger;
 
+    void _open();
+    void _handshake();
     void _consumeMessage();
+    void _read();
     void _afterRead (const std::error_code & ec, size_t length);
-    void _consumeData (const char *data, size_t length);
-    void _writeResponseMessage (const HttpResponse &);
+    void _afterIdleRead (const std::error_code &ec, std::string_view data);
+    void _consumeData();
+    bool _beginBody();
+    void _completeMessage();
+    void _queueResponse();
+    void _flush (bool close = false);
+    void _write (size_t first, size_t range, bool close);
+    void _sendFile (size_t index, size_t range, bool close);
+    void _readFile (size_t index, size_t range, bool close);
+    void _written (bool close);
+    std::shared_ptr<StreamState> _openStream (asio::any_io_executor executor);
+    HttpStream _makeStream();
+    void _beginStream();
+    void _streamFlush();
+    void _streamWritten (const std::error_code &ec, bool end);
+    void _streamFailed (const std::error_code &ec);
+    void _beginWebSocket();
+    void _readFrames();
+    void _framesRead (const std::error_code &ec, size_t length);
+    bool _webSocketFrame (WebSocketOpcode opcode, bool fin, std::string_view payload);
+    void _writeError (uint32_t status);
+    void _setDeadline (Deadline deadline);
+    void _expired();
+    HttpResponder _makeResponder();
+
+    template<typename Handler>
+    void _readSome (asio::mutable_buffer buffer, Handler &&handler);
+
+    template<typename Handler>
+    void _writeAll (std::span<const asio::const_buffer> buffers, Handler &&handler);
+};
+
+// ----------------------------------------------------------------------------
+// HttpConnectionPool
+// ----------------------------------------------------------------------------
+// Free list of connections. When the last reference to a connection is dropped,
+// the object (buffers and arena included) is kept and handed to the next
+// accepted socket instead of being deallocated.
+class HttpConnectionPool: public std::enable_shared_from_this<HttpConnectionPool> {
+  public:
+    HttpConnectionPool (
+      RouteResolver findRoute,
+      std::function<void ()> closed,
+      TimerWheel &timers,
+      const HttpConfig &config,
+      const Logger &logger,
+      asio::ssl::context *tls = nullptr,
+      IoUring *ring = nullptr
+    ):
+      _findRoute { std::move (findRoute) },
+      _closed { std::move (closed) },
+      _timers { timers },
+      _config { config },
+      _logger { logger },
+      _tls { tls },
+      _ring { ring }
+    {
+      // empty
+    }
+
+    /// @brief Get a connection for a socket, reusing a free one if possible
+    std::shared_ptr<HttpConnection> acquire (asio::ip::tcp::socket &&socket);
+
+    /// @brief Number of free connections
+    inline size_t size() const {
+      std::lock_guard lock { _mutex };
+      return _free.size();
+    }
+
+    /// @brief Number of connections in use
+    inline size_t active() const { return _active.load (std::memory_order_relaxed); }
+
+  private:
+    RouteResolver _findRoute;
+    std::function<void ()> _closed; // called when a connection is released
+    std::reference_wrapper<TimerWheel> _timers;
+    std::reference_wrapper<const HttpConfig> _config;
+    std::reference_wrapper<const Logger> _logger;
+    asio::ssl::context *_tls; // of the server, if it is HTTPS
+    IoUring *_ring; // of the worker, if it uses io_uring
+    mutable std::mutex _mutex; // connections may be released from any thread
+    std::vector<std::unique_ptr<HttpConnection>> _free;
+    std::atomic<size_t> _active { 0 };
+
+    void _release (HttpConnection *connection);
 };
 
 }
@@ -0,0 +1,115 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_EVENTS_H__
+#define __LIGHTNING_HTTP_EVENTS_H__
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <lightning/http_response.h>
+#include <lightning/http_stream.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpEventChannelConfig
+// ----------------------------------------------------------------------------
+struct HttpEventChannelConfig {
+  enum class Overflow {
+    kDrop,      // the subscriber misses the event
+    kDisconnect // the subscriber is disconnected (and can reconnect with a fresh state)
+  };
+
+  /// @brief Bytes of events published to a subscriber and not sent yet, beyond which the
+  /// overflow policy applies to the next events.
+  size_t maxQueuedBytes { 256 * 1024 };
+
+  /// @brief What to do with a subscriber that does not keep up
+  Overflow overflow { Overflow::kDrop };
+
+  /// @brief Reconnection time sent to the subscribers ("retry" field), none if zero
+  std::chrono::milliseconds retry { 0 };
+};
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel
+// ----------------------------------------------------------------------------
+// Server-Sent Events (text/event-stream) broadcast to the responses subscribed to it:
+//
+//   server.addRoute (HttpMethod::kGet, "/events", [ &channel ] (const auto &, auto &response) {
+//     channel.subscribe (response);
+//   });
+//
+//   channel.publish ("{\"price\":42}", "quote");
+//
+// An event is serialized once, into an immutable buffer that the streams of every
+// subscriber share until they have sent it. Publishing never waits for a client: the
+// events of a subscriber that falls behind by more than maxQueuedBytes are dropped, or
+// the subscriber is disconnected (see HttpEventChannelConfig::overflow).
+//
+// Subscribers whose connection is gone are removed by the next publish() or ping().
+// The channel can be used from any thread.
+class HttpEventChannel {
+  public:
+    explicit HttpEventChannel (const HttpEventChannelConfig &config = {});
+
+    HttpEventChannel (const HttpEventChannel &) = delete;
+    HttpEventChannel & operator= (const HttpEventChannel &) = delete;
+
+    /// @brief End the streams of the remaining subscribers
+    ~HttpEventChannel();
+
+    /// @brief Respond to a request with the event stream (the status and headers set before are kept)
+    void subscribe (HttpResponse &response);
+
+    /// @brief Publish an event to every subscriber
+    ///
+    /// @param data Payload; every line is sent in its own "data" field
+    /// @param event Event type (none: "message"), without CR or LF (they are removed)
+    /// @param id Last event ID reported by the client when it reconnects, without CR, LF or NUL
+    /// (they are removed)
+    ///
+    /// @return Number of subscribers the event has been queued for
+    size_t publish (std::string_view data, std::string_view event = {}, std::string_view id = {});
+
+    /// @brief Publish an event serialized with format()
+    size_t publish (std::shared_ptr<const std::string> event);
+
+    /// @brief Send a comment, which keeps idle connections open through proxies and detects
+    /// the subscribers that are gone
+    size_t ping();
+
+    /// @brief End every stream and remove the subscribers
+    void close();
+
+    /// @brief Serialize an event (the text of the event stream, with its trailing blank line)
+    static std::shared_ptr<const std::string> format (std::string_view data, std::string_view event = {}, std::string_view id = {});
+
+    /// @brief Number of subscribers
+    inline size_t size() const {
+      std::lock_guard lock { _mutex };
+      return _subscribers.size();
+    }
+
+    /// @brief Events not queued for a subscriber because of the overflow policy
+    inline uint64_t dropped() const { return _dropped.load (std::memory_order_relaxed); }
+
+  private:
+    HttpEventChannelConfig _config;
+    mutable std::mutex _mutex;
+    std::vector<HttpStream> _subscribers;
+    std::atomic<uint64_t> _dropped { 0 };
+};
+
+}
+
+#endif
@@ -5,54 +5,230 @@
 // ----------------------------------------------------------------------------
 #ifndef __LIGHTNING_HTTP_HEADER_H__
 #define __LIGHTNING_HTTP_HEADER_H__
+#include <array>
+#include <cinttypes>
 #include <iostream>
-#include <unordered_map>
+#include <memory_resource>
 #include <optional>
-#include <string>
 #include <string_view>
 
+#include <lightning/small_vector.h>
+#include <lightning/string_util.h>
+
 
 namespace lightning {
 
+// ----------------------------------------------------------------------------
+// HttpHeaderName
+// ----------------------------------------------------------------------------
+// Well-known headers. They have a fixed slot in HttpHeader, found with a perfect hash.
+enum class HttpHeaderName: uint8_t {
+  kAccept = 0,
+  kAcceptEncoding,
+  kAcceptLanguage,
+  kAcceptRanges,
+  kAuthorization,
+  kCacheControl,
+  kConnection,
+  kContentEncoding,
+  kContentLength,
+  kContentRange,
+  kContentType,
+  kCookie,
+  kDate,
+  kETag,
+  kExpect,
+  kHost,
+  kIfMatch,
+  kIfModifiedSince,
+  kIfNoneMatch,
+  kIfRange,
+  kKeepAlive,
+  kLastEventId,
+  kLastModified,
+  kLocation,
+  kOrigin,
+  kRange,
+  kReferer,
+  kSecWebSocketAccept,
+  kSecWebSocketKey,
+  kSecWebSocketProtocol,
+  kSecWebSocketVersion,
+  kServer,
+  kSetCookie,
+  kTransferEncoding,
+  kUpgrade,
+  kUserAgent,
+  kVary,
+  kXForwardedFor,
+  kUnknown
+};
+
+constexpr size_t kNumHttpHeaderNames { static_cast<size_t> (HttpHeaderName::kUnknown) };
+
+// ----------------------------------------------------------------------------
+// Perfect hash of the well-known header names
+// ----------------------------------------------------------------------------
+namespace detail {
+
+constexpr std::array<std::string_view, kNumHttpHeaderNames> kHttpHeaderNames {
+  "accept",
+  "accept-encoding",
+  "accept-language",
+  "accept-ranges",
+  "authorization",
+  "cache-control",
+  "connection",
+  "content-encoding",
+  "content-length",
+  "content-range",
+  "content-type",
+  "cookie",
+  "date",
+  "etag",
+  "expect",
+  "host",
+  "if-match",
+  "if-modified-since",
+  "if-none-match",
+  "if-range",
+  "keep-alive",
+  "last-event-id",
+  "last-modified",
+  "location",
+  "origin",
+  "range",
+  "referer",
+  "sec-websocket-accept",
+  "sec-websocket-key",
+  "sec-websocket-protocol",
+  "sec-websocket-version",
+  "server",
+  "set-cookie",
+  "transfer-encoding",
+  "upgrade",
+  "user-agent",
+  "vary",
+  "x-forwarded-for"
+};
+
+constexpr uint8_t kHttpHeaderEmptySlot { 0xff };
+constexpr size_t kHttpHeaderTableSize { 128 };
+
+// The coefficients were chosen so that every well-known name gets a different slot.
+constexpr size_t httpHeaderHash (std::string_view name) {
+  const auto c = [ &name ] (size_t i) { return static_cast<size_t> (StringUtil::toLower (name[i])); };
+
+  return (name.size() * 3 + c (0) + c (name.size() - 1) * 33 + c (name.size() / 2)) % kHttpHeaderTableSize;
+}
+
+constexpr std::array<uint8_t, kHttpHeaderTableSize> kHttpHeaderTable { [] {
+  std::array<uint8_t, kHttpHeaderTableSize> table {};
+  table.fill (kHttpHeaderEmptySlot);
+
+  for (size_t i { 0 }; i < kHttpHeaderNames.size(); ++i)
+    table[httpHeaderHash (kHttpHeaderNames[i])] = static_cast<uint8_t> (i);
+
+  return table;
+}() };
+
+constexpr bool isPerfectHttpHeaderHash() {
+  for (size_t i { 0 }; i < kHttpHeaderNames.size(); ++i) {
+    if (kHttpHeaderTable[httpHeaderHash (kHttpHeaderNames[i])] != i)
+      return false;
+  }
+
+  return true;
+}
+
+static_assert (isPerfectHttpHeaderHash(), "hash collision between well-known header names");
+
+}
+
 // ----------------------------------------------------------------------------
 // HttpHeader
 // ----------------------------------------------------------------------------
+// Flat list of fields in insertion order. Names and values are views: they must
+// outlive the header (request headers point into the connection buffer). Names
+// keep their original case and are compared ignoring it.
 class HttpHeader {
   public:
-    // struct HeaderData {
-    //   std::string_view name;
-    //   std::string_view value;
-    // };
+    struct HeaderData {
+      std::string_view name;
+      std::string_view value;
+    };
+
+    using iterator = SmallVector<HeaderData, 16>::iterator;
+    using const_iterator = SmallVector<HeaderData, 16>::const_iterator;
+
+    /// @param resource Memory resource used when there are more than 16 fields
+    explicit HttpHeader (std::pmr::memory_resource *resource = std::pmr::get_default_resource()):
+      _headers { resource }
+    {
+      // empty
+    }
+
+    /// @brief Canonical (lower case) name of a well-known header
+    static constexpr std::string_view name (HttpHeaderName id) {
+      return detail::kHttpHeaderNames[static_cast<size_t> (id)];
+    }
+
+    /// @brief Find the well-known header matching a name (case insensitive)
+    ///
+    /// @return The header identifier or HttpHeaderName::kUnknown
+    static constexpr HttpHeaderName lookup (std::string_view name) {
+      if (name.empty())
+        return HttpHeaderName::kUnknown;
 
-    using iterator = std::unordered_map<std::string, std::string_view>::iterator;
-    using const_iterator = std::unordered_map<std::string, std::string_view>::const_iterator;
+      const auto index { detail::kHttpHeaderTable[detail::httpHeaderHash (name)] };
+
+      if ((index != detail::kHttpHeaderEmptySlot) && StringUtil::iequals (detail::kHttpHeaderNames[index], name))
+        return static_cast<HttpHeaderName> (index);
+
+      return HttpHeaderName::kUnknown;
+    }
 
     bool contains (std::string_view name) const;
+    inline bool contains (HttpHeaderName id) const { return _known[static_cast<size_t> (id)] != 0; }
 
     std::optional<std::string_view> get (std::string_view name) const;
+    std::optional<std::string_view> get (HttpHeaderName id) const;
 
     void set (std::string_view name, std::string_view value);
+    void set (HttpHeaderName id, std::string_view value);
 
     inline size_t size() const { return _headers.size(); }
 
+    inline void clear() {
+      _headers.clear();
+      _known.fill (0);
+    }
+
+    /// @brief Like clear(), but also gives back the memory allocated from the resource
+    inline void reset() {
+      _headers.reset();
+      _known.fill (0);
+    }
+
     inline iterator begin () { return _headers.begin(); }
     inline iterator end () { return _headers.end(); }
 
     inline const_iterator cbegin () const { return _headers.begin(); }
     inline const_iterator cend () const { return _headers.end(); }
 
-    inline iterator last() const { return _last; }
-
     friend std::ostream & operator<< (std::ostream &os, const HttpHeader &obj) {
-      for (const auto &kv: obj._headers)
-        os << kv.first << ": " << kv.second << std::endl;
+      for (const auto &h: obj._headers)
+        os << h.name << ": " << h.value << std::endl;
 
       return os;
     }
 
   private:
-    std::unordered_map<std::string, std::string_view> _headers;
-    iterator _last;
+    SmallVector<HeaderData, 16> _headers;
+    std::array<uint16_t, kNumHttpHeaderNames> _known {}; // position + 1 in _headers (0 if not present)
+
+    HeaderData * _find (std::string_view name);
+    const HeaderData * _find (std::string_view name) const;
 };
 
 }
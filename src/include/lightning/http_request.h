@@ -8,11 +8,18 @@
 #include <cinttypes>
 #include <functional>
 #include <map>
+#include <memory_resource>
+#include <optional>
 #include <string>
-#include <vector>
+#include <string_view>
+
+#include <llhttp.h>
 
 #include <lightning/http_method.h>
 #include <lightning/http_header.h>
+#include <lightning/http_url_encoded.h>
+#include <lightning/json.h>
+#include <lightning/small_vector.h>
 #include <lightning/types.h>
 
 
@@ -20,51 +27,157 @@ namespace lightning {
 
 enum class ProtocolType: int {
   kUnknown = 0,
-  kHttp = 1
-//  kHttps = 2,
-//  kWs = 3,
-//  kWss = 4
+  kHttp = 1,
+  kHttps = 2,
+  kWs = 3,
+  kWss = 4
+};
+
+class HttpRequest;
+
+// Receives the body of a request as it arrives, instead of collecting it in request.body.
+// Every chunk is only valid during the call.
+using BodyHandler = std::function<void (const HttpRequest &, std::string_view chunk)>;
+
+// ----------------------------------------------------------------------------
+// HttpParams
+// ----------------------------------------------------------------------------
+// Parameters captured by the route of a request (":name" and "*name" elements).
+class HttpParams {
+  public:
+    struct Param {
+      std::string_view name;
+      std::string_view value;
+    };
+
+    using const_iterator = SmallVector<Param, 8>::const_iterator;
+
+    explicit HttpParams (std::pmr::memory_resource *resource = std::pmr::get_default_resource()):
+      _params { resource }
+    {
+      // empty
+    }
+
+    std::optional<std::string_view> get (std::string_view name) const {
+      for (const auto &p: _params) {
+        if (p.name == name)
+          return { p.value };
+      }
+
+      return std::nullopt;
+    }
+
+    inline size_t size() const { return _params.size(); }
+
+    inline const_iterator begin() const { return _params.begin(); }
+    inline const_iterator end() const { return _params.end(); }
+
+    inline void push_back (const Param &param) { _params.push_back (param); }
+    inline void pop_back() { _params.pop_back(); }
+    inline void clear() { _params.clear(); }
+    inline void reset() { _params.reset(); }
+
+    /// @brief Move the values from a buffer to a copy of it (see HttpRequest::rebase). The names
+    /// belong to the router, so they are kept.
+    void rebase (const char *from, const char *to);
+
+  private:
+    SmallVector<Param, 8> _params;
 };
 
+// ----------------------------------------------------------------------------
+// HttpRequest
+// ----------------------------------------------------------------------------
+// The string fields are views into the connection buffer (ip into the connection
+// itself); they are valid until the response has been written. Containers allocate
+// from the memory resource given at construction (the connection's arena).
 class HttpRequest {
   public:
     // using ParseHandler = std::function<void (HttpRequest &)>;
 
-    HttpRequest (std::reference_wrapper<const Logger> _logger): _logger { std::move (_logger) } {
+    HttpRequest (
+      std::reference_wrapper<const Logger> _logger,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource()
+    ):
+      headers { resource },
+      params { resource },
+      _logger { std::move (_logger) },
+      _queryParams { resource },
+      _formParams { resource },
+      _json { resource }
+    {
       // empty
     }
 
     HttpMethod method;
-    std::string path;
-    std::string query;
-    std::string url;
+    std::string_view path;
+    std::string_view query;
+    std::string_view url;
     struct {
       uint16_t major;
       uint16_t minor;
     } version;
-    std::string host; // from headers (host)
+    std::string_view host; // from headers (host)
     // uint16_t port;
-    std::string ip;
+    std::string_view ip;
     ProtocolType protocol { ProtocolType::kUnknown };
     HttpHeader headers;
-    // struct {
-    //   std::map<std::string, std::string> path;
-    //   std::map<std::string, std::string> query;
-    //   std::map<std::string, std::string> body; // parsed
-    // } params;
+    HttpParams params; // filled by the router
     int32_t statusCode;
-    std::vector<const uint8_t *> body;
+    std::string_view body; // collected body (empty if it is streamed to a BodyHandler)
 
-    bool parse (std::string_view data);
+    /// @brief Initialize an incremental parser whose callbacks fill this request.
+    ///
+    /// @param parser Parser to be fed with llhttp_execute. It pauses (HPE_PAUSED) at the end of every message.
+    void initParser (llhttp_t &parser);
 
-    // void use (ParseHandler &&handler) { _parsers.push_back (handler); }
+    /// @brief Shift the views into the input buffer after it has been moved.
+    ///
+    /// @param from Previous location of the message
+    /// @param to Current location of the message
+    void rebase (const char *from, const char *to);
 
-    // static void queryParser (HttpRequest &req);
-    // static void bodyParser (HttpRequest &req);
+    /// @brief Clear every field, so the same object can be reused for the next request.
+    /// Memory allocated from the resource is given back.
+    void reset();
+
+    inline bool headersComplete() const { return _headersComplete; }
+    inline bool messageComplete() const { return _messageComplete; }
+
+    /// @brief Stream the body of the current message to a handler instead of collecting it
+    inline void streamBody (const BodyHandler *handler) { _onBody = handler; }
+    inline bool streamingBody() const { return _onBody != nullptr; }
+
+    /// @brief Parameters of the query string, split on first access
+    inline const HttpUrlEncoded & queryParams() const { return _queryParams; }
+
+    /// @brief Fields of a collected application/x-www-form-urlencoded body, split on first
+    /// access (none for other bodies)
+    inline const HttpUrlEncoded & formParams() const { return _formParams; }
+
+    /// @brief The collected body parsed as JSON, on first call, in place (see JsonDocument):
+    /// strings are views of the body, whose escaped ones are unescaped over it. Values are
+    /// valid until the response has been written.
+    ///
+    /// @return The root value, or nullptr if the body is not valid JSON (or empty, or streamed)
+    const JsonValue * json() const;
+
+    // void use (ParseHandler &&handler) { _parsers.push_back (handler); }
 
   private:
     // std::vector<ParseHandler> _parsers;
     std::reference_wrapper<const Logger> _logger;
+    std::string_view _headerName; // header field being parsed
+    std::string_view _headerValue; // header value being parsed
+    bool _headersComplete { false };
+    bool _messageComplete { false };
+    const BodyHandler *_onBody { nullptr };
+    HttpUrlEncoded _queryParams; // of query
+    HttpUrlEncoded _formParams; // of body
+    mutable JsonDocument _json; // of body
+    mutable std::optional<bool> _jsonValid; // parsed on first access
+
+    void _assignForm();
 };
 
 }
@@ -0,0 +1,53 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_RESPONDER_H__
+#define __LIGHTNING_HTTP_RESPONDER_H__
+#include <functional>
+#include <utility>
+
+#include <asio.hpp>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpResponder
+// ----------------------------------------------------------------------------
+// Handle of a deferred response, obtained with HttpResponse::defer(). It keeps the
+// connection alive: the request and the response stay valid, and the connection
+// neither reads nor writes, until finish() is called. Dropping the last copy
+// without finishing it closes the connection.
+class HttpResponder {
+  public:
+    HttpResponder() = default;
+
+    HttpResponder (asio::any_io_executor executor, std::function<void ()> finish):
+      _executor { std::move (executor) },
+      _finish { std::move (finish) }
+    {
+      // empty
+    }
+
+    /// @brief Executor of the connection (the I/O thread that owns it)
+    inline const asio::any_io_executor & executor() const { return _executor; }
+
+    /// @brief Write the response. It can be called from any thread and on any copy; only the
+    /// first call has effect.
+    void finish() {
+      if (auto finish { std::exchange (_finish, nullptr) })
+        finish();
+    }
+
+    explicit operator bool() const { return static_cast<bool> (_finish); }
+
+  private:
+    asio::any_io_executor _executor;
+    std::function<void ()> _finish;
+};
+
+}
+
+#endif
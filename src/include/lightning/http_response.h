@@ -6,29 +6,206 @@
 #ifndef __LIGHTNING_HTTP_RESPONSE_H__
 #define __LIGHTNING_HTTP_RESPONSE_H__
 #include <cinttypes>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <lightning/http_header.h>
+#include <lightning/http_responder.h>
+#include <lightning/http_stream.h>
+#include <lightning/http_websocket.h>
+#include <lightning/json.h>
+#include <lightning/static_file.h>
 
 
 namespace lightning {
 
+class HttpCompressedBodies;
+
+// ----------------------------------------------------------------------------
+// HttpResponseBody
+// ----------------------------------------------------------------------------
+// Body detached from its response, so it stays alive until it has been written
+// while the response object is reused for the next (pipelined) request.
+//
+// The content (a string, a shared string or a file) can be restricted to byte
+// ranges; every range is preceded by a piece of `framing` (the part headers of a
+// multipart/byteranges body), and the rest of `framing` follows the last one.
+struct HttpResponseBody {
+  struct Range {
+    uint64_t offset;
+    uint64_t length;
+    size_t framingEnd; // end of the framing that precedes the range
+  };
+
+  std::string data;
+  std::shared_ptr<const std::string> shared;
+  std::shared_ptr<const StaticFile> file;
+  std::shared_ptr<HttpCompressedBodies> compressed; // compressed forms of a shared body or a file
+  std::vector<Range> ranges; // empty: the whole content
+  std::string framing;
+
+  /// @brief The content is sent from the descriptor of a file (sendfile), not from memory
+  inline bool sendFile() const { return file && (file->fd() >= 0); }
+
+  /// @brief Whole content in memory (a mapped file included); empty for sendFile() bodies
+  inline std::string_view view() const {
+    if (file)
+      return file->mapped();
+
+    return shared ? std::string_view { *shared } : std::string_view { data };
+  }
+
+  /// @brief Size of the whole content
+  inline uint64_t contentSize() const {
+    return file ? file->size() : view().size();
+  }
+
+  /// @brief Size of the body as written: the ranges and their framing, or the whole content
+  inline uint64_t size() const {
+    if (ranges.empty())
+      return contentSize();
+
+    uint64_t size { framing.size() };
+    for (const auto &r: ranges)
+      size += r.length;
+
+    return size;
+  }
+
+  inline size_t rangeCount() const { return ranges.empty() ? 1 : ranges.size(); }
+
+  inline Range range (size_t index) const {
+    return ranges.empty() ? Range { 0, contentSize(), 0 } : ranges[index];
+  }
+};
+
+// ----------------------------------------------------------------------------
+// HttpResponse
+// ----------------------------------------------------------------------------
+// The connection owns the response until it has been written, so the body is
+// sent straight from the memory given to send().
 class HttpResponse {
   public:
-    std::string data() const;
+    /// @param resource Memory resource of the headers and the stored strings (the connection's arena)
+    explicit HttpResponse (std::pmr::memory_resource *resource = std::pmr::get_default_resource()):
+      _headers { resource },
+      _strings { resource }
+    {
+      // empty
+    }
 
     HttpResponse & status (uint32_t status) {
       _status = status;
       return *this;
     }
-    HttpResponse & send (const std::string &data);
+
+    /// @brief Set the body, taking ownership of the string (no copy if it is moved in)
+    HttpResponse & send (std::string data);
+
+    /// @brief Set a body shared with other responses (e.g. a cached document)
+    ///
+    /// @param compressed Compressed forms of the body, shared with those responses too (see
+    /// HttpCompressedBodies); without them it is compressed again for every response.
+    HttpResponse & send (std::shared_ptr<const std::string> data, std::shared_ptr<HttpCompressedBodies> compressed = nullptr);
+
+    /// @brief Send a file. Its bytes are not copied: it is written from its mapping or with sendfile(2).
+    /// Without `compressed` (see HttpCompressedBodies) it is never compressed.
+    HttpResponse & send (std::shared_ptr<const StaticFile> file, std::shared_ptr<HttpCompressedBodies> compressed = nullptr);
+
+    /// @brief Serialize a JSON body through the returned writer, straight into the body of the
+    /// response, which is written as it is: there is no intermediate string. Content-Type is
+    /// application/json (unless set already) and Content-Length is that of the serialized body.
+    JsonWriter json();
 
     HttpHeader & headers() { return _headers; }
+    const HttpHeader & headers() const { return _headers; }
+
+    inline uint32_t statusCode() const { return _status; }
+
+    /// @brief Copy a string into memory owned by the response (e.g. a computed header value)
+    ///
+    /// @return A view of the copy, valid until the response is reset
+    std::string_view store (std::string_view value);
+
+    inline std::string_view body() const { return _body.view(); }
+
+    /// @brief Size of the whole content of the body
+    inline uint64_t contentSize() const { return _body.contentSize(); }
+
+    /// @brief The body is a file (mapped or sent with sendfile(2))
+    inline bool fileBody() const { return static_cast<bool> (_body.file); }
+
+    /// @brief Compressed forms of the body, given to send() with it
+    inline const std::shared_ptr<HttpCompressedBodies> & compressedBodies() const { return _body.compressed; }
+
+    /// @brief Only send some ranges of the body (see HttpResponseBody)
+    inline void setRanges (std::vector<HttpResponseBody::Range> ranges, std::string framing) {
+      _body.ranges = std::move (ranges);
+      _body.framing = std::move (framing);
+    }
+
+    /// @brief Drop the body, keeping status and headers (e.g. for a 304 response)
+    inline void discardBody() { _body = {}; }
+
+    /// @brief Move the body out of the response, leaving it empty
+    inline HttpResponseBody takeBody() { return std::exchange (_body, {}); }
+
+    /// @brief Write the status line and the headers (without the body)
+    ///
+    /// @param out Output buffer. The header block is appended to it, growing it at most once.
+    void serialize (std::string &out) const;
+
+    /// @brief Respond later: the connection does not write the response when the handler returns,
+    /// but when HttpResponder::finish() is called.
+    HttpResponder defer();
+
+    inline bool deferred() const { return _deferred; }
+
+    /// @brief Stream the body: it is written in chunks, through the returned handle, after the
+    /// status and headers set so far (see HttpStream). The response is deferred until the stream ends.
+    HttpStream stream();
+
+    inline bool streaming() const { return _streaming; }
+
+    /// @brief Switch the connection to WebSocket once the (101) response has been written (see WebSocket::accept)
+    inline void upgrade (std::shared_ptr<const WebSocketHandler> handler) { _webSocket = std::move (handler); }
+
+    inline const std::shared_ptr<const WebSocketHandler> & webSocket() const { return _webSocket; }
+
+    /// @brief Set by the connection: creates the responders of its deferred responses
+    inline void setResponderFactory (std::function<HttpResponder ()> factory) {
+      _responderFactory = std::move (factory);
+    }
+
+    inline const std::function<HttpResponder ()> & responderFactory() const { return _responderFactory; }
+
+    /// @brief Set by the connection: creates the handles of its streamed responses
+    inline void setStreamFactory (std::function<HttpStream ()> factory) {
+      _streamFactory = std::move (factory);
+    }
+
+    /// @brief Keep an object alive until the response is reset (e.g. the owner of header values)
+    inline void retain (std::shared_ptr<const void> object) { _retained = std::move (object); }
+
+    /// @brief Clear status, headers and body, so the same object can be reused for the next response.
+    void reset();
 
   private:
     uint32_t _status = 0;
     HttpHeader _headers;
-    std::string _data;
+    HttpResponseBody _body;
+    std::pmr::monotonic_buffer_resource _strings; // memory of store()
+    bool _deferred { false };
+    bool _streaming { false };
+    std::function<HttpResponder ()> _responderFactory;
+    std::function<HttpStream ()> _streamFactory;
+    std::shared_ptr<const WebSocketHandler> _webSocket;
+    std::shared_ptr<const void> _retained;
 };
 
 }
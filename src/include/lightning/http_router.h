@@ -0,0 +1,82 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_ROUTER_H__
+#define __LIGHTNING_HTTP_ROUTER_H__
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <lightning/http_request.h>
+#include <lightning/http_response.h>
+
+
+namespace lightning {
+
+using RequestHandler = std::function<void (const HttpRequest &, HttpResponse &)>;
+
+// The response is written when the coroutine completes; the I/O thread serves other
+// connections while it is suspended. The request and the response stay valid until then.
+using AsyncRequestHandler = std::function<asio::awaitable<void> (const HttpRequest &, HttpResponse &)>;
+
+// ----------------------------------------------------------------------------
+// HttpRoute
+// ----------------------------------------------------------------------------
+struct HttpRoute {
+  RequestHandler handler; // called once the whole request has been received
+  BodyHandler onBody; // if set, the body is streamed to it instead of being collected
+};
+
+// ----------------------------------------------------------------------------
+// HttpRouter
+// ----------------------------------------------------------------------------
+// Compressed radix tree of route paths. A path may contain parameters:
+//   - ":name" matches one non-empty segment (up to the next '/')
+//   - "*name" matches the rest of the path (it must be the last element)
+// Static text has priority over a parameter, and a parameter over a wildcard.
+class HttpRouter {
+  public:
+    /// @brief Add a route
+    ///
+    /// @param path Route path, e.g. "/users/:id/orders/:oid" or "/static/*file"
+    /// @param handler Handler of the route
+    /// @param onBody Optional handler the body is streamed to
+    ///
+    /// @throw std::invalid_argument if the route already exists or conflicts with another one
+    void add (std::string_view path, RequestHandler &&handler, BodyHandler &&onBody = nullptr);
+
+    /// @brief Find the route of a path
+    ///
+    /// @param path Request path
+    /// @param params Filled with views of the parameters (names point into the router, values into path)
+    ///
+    /// @return The route (owned by the router) or nullptr if no route matches
+    const HttpRoute * find (std::string_view path, HttpParams &params) const;
+
+  private:
+    struct Node {
+      std::string prefix; // static text matched by this node
+      std::string indices; // first character of every static child
+      std::vector<std::unique_ptr<Node>> children;
+      std::unique_ptr<Node> param;
+      std::string paramName;
+      std::unique_ptr<Node> wildcard;
+      std::string wildcardName;
+      HttpRoute route;
+    };
+
+    Node _root;
+
+    static Node * _insertStatic (Node *node, std::string_view text);
+    static const HttpRoute * _match (const Node &node, std::string_view path, HttpParams &params);
+};
+
+}
+
+#endif
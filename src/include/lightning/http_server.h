@@ -5,26 +5,67 @@
 // ----------------------------------------------------------------------------
 #ifndef __LIGHTNING_HTTP_SERVER_H__
 #define __LIGHTNING_HTTP_SERVER_H__
+#include <atomic>
+#include <filesystem>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string_view>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 #include <asio.hpp>
+#include <asio/ssl.hpp>
 
 #include <lightning/types.h>
+#include <lightning/http_cache.h>
+#include <lightning/http_config.h>
+#include <lightning/http_connection.h>
+#include <lightning/http_events.h>
 #include <lightning/http_method.h>
 #include <lightning/http_request.h>
 #include <lightning/http_response.h>
+#include <lightning/http_router.h>
+#include <lightning/http_static.h>
+#include <lightning/http_websocket.h>
+#include <lightning/io_uring.h>
+#include <lightning/timer_wheel.h>
 
 
 namespace lightning {
 
-using RequestHandler = std::function<void (const HttpRequest &, HttpResponse &)>;
+// ----------------------------------------------------------------------------
+// HttpMemoryUsage
+// ----------------------------------------------------------------------------
+// Memory held by the connections of a server. Input buffers come from per-thread
+// pools shared by every server of the process, so their figures are process-wide.
+struct HttpMemoryUsage {
+  size_t connections; // open connections
+  size_t pooledConnections; // closed connections kept to be reused
+  size_t connectionBytes; // connection objects and their initial arena (open and pooled)
+  size_t inputBufferBytes; // input buffers held by open connections
+  size_t cachedBufferBytes; // free input buffers kept by the I/O threads
+
+  /// @brief Average footprint of an open connection, in bytes
+  inline size_t perConnection() const {
+    const size_t total { connectionBytes + inputBufferBytes + cachedBufferBytes };
+    return (connections > 0) ? total / connections : 0;
+  }
+};
 
+// ----------------------------------------------------------------------------
+// HttpServer
+// ----------------------------------------------------------------------------
 class HttpServer {
   public:
-    HttpServer (uint16_t port, size_t poolSize, LogLevel logLevel);
+    HttpServer (uint16_t port, size_t poolSize, LogLevel logLevel, const HttpConfig &config = {});
+
+    /// @brief HTTPS server, with the certificate, key and protocol settings of `tls`. Its session
+    /// cache and tickets are set up from `config` (tlsSessionCacheSize, tlsSessionTimeout,
+    /// tlsSessionTickets).
+    HttpServer (uint16_t port, size_t poolSize, LogLevel logLevel, asio::ssl::context &&tls, const HttpConfig &config = {});
 
     inline HttpServer (uint16_t port = 8080, LogLevel logLevel = LogLevel::kInfo): HttpServer { port, 1, logLevel } {
       // empty
@@ -32,31 +73,94 @@ class HttpServer {
 
     ~HttpServer();
 
-    void addRoute (HttpMethod method, std::string_view path, RequestHandler &&handler);
-    void setDefault (RequestHandler &&handler) { _routeNotFound = handler; }
+    /// @brief Add a route
+    ///
+    /// @param handler A RequestHandler, or an AsyncRequestHandler (a coroutine returning asio::awaitable<void>)
+    /// @param onBody If set, the body is streamed to it as it arrives (and request.body is empty)
+    template<typename Handler>
+    void addRoute (HttpMethod method, std::string_view path, Handler &&handler, BodyHandler &&onBody = nullptr) {
+      using Result = std::invoke_result_t<Handler &, const HttpRequest &, HttpResponse &>;
+
+      if constexpr (std::is_same_v<Result, asio::awaitable<void>>)
+        _addRoute (method, path, _makeAsync (AsyncRequestHandler { std::forward<Handler> (handler) }), std::move (onBody));
+      else
+        _addRoute (method, path, RequestHandler { std::forward<Handler> (handler) }, std::move (onBody));
+    }
+
+    /// @brief Add a route whose responses are cached for a while (see HttpResponseCache). Concurrent
+    /// requests for a response that is not cached yet wait for a single call to the handler.
+    ///
+    /// @param handler A RequestHandler or an AsyncRequestHandler
+    ///
+    /// @return The cache of the route
+    template<typename Handler>
+    std::shared_ptr<HttpResponseCache> addCachedRoute (HttpMethod method, std::string_view path, Handler &&handler, const HttpCacheConfig &config = {}) {
+      using Result = std::invoke_result_t<Handler &, const HttpRequest &, HttpResponse &>;
+
+      if constexpr (std::is_same_v<Result, asio::awaitable<void>>)
+        return _addCachedRoute (method, path, _makeAsync (AsyncRequestHandler { std::forward<Handler> (handler) }), config);
+      else
+        return _addCachedRoute (method, path, RequestHandler { std::forward<Handler> (handler) }, config);
+    }
+
+    /// @brief Serve the files of a directory (GET and HEAD) under a URL prefix,
+    /// e.g. "/assets" maps "/assets/css/site.css" to "<directory>/css/site.css".
+    void addStaticRoute (std::string_view prefix, const std::filesystem::path &directory, const HttpStaticConfig &config = {});
+
+    /// @brief Accept WebSocket connections (RFC 6455) on a path. Requests that are not a valid
+    /// handshake get a 426 or 400 response.
+    void addWebSocketRoute (std::string_view path, WebSocketHandler handler);
+
+    void setDefault (RequestHandler &&handler) { _routeNotFound.handler = handler; }
 
     inline void setLogLevel (LogLevel level) {
       _logger.setLevel (level);
     }
 
-  private:
-    struct Route {
-      std::string_view path;
-      RequestHandler handler;
-    };
+    /// @brief Memory footprint of the connections (it can be called from any thread)
+    HttpMemoryUsage memoryUsage() const;
 
-    Logger _logger;
+    /// @brief The workers do their I/O through io_uring (HttpConfig::ioUring, if the kernel supports it)
+    inline bool ioUring() const { return _workers.front()->ring != nullptr; }
 
-    asio::io_service _ioService;
-    asio::ip::tcp::acceptor _acceptor { _ioService };
-    asio::ip::tcp::socket _socket { _ioService };
-
-    std::vector<std::thread> _asioPool;
-    std::array<std::vector<Route>, kNumHttpMethods> _routes {};
-    RequestHandler _routeNotFound = nullptr;
+  private:
+    Logger _logger;
+    HttpConfig _config;
+    std::optional<asio::ssl::context> _tls;
+
+    // An io_context and the threads running it. There is a single worker run by the
+    // whole pool in shared mode, and one worker per thread in sharded mode.
+    struct Worker {
+      asio::io_context ioContext;
+      std::unique_ptr<IoUring> ring; // of the worker, with HttpConfig::ioUring
+      asio::ip::tcp::acceptor acceptor { ioContext };
+      TimerWheel timers { ioContext.get_executor() }; // deadlines of the connections of the worker
+      std::vector<std::thread> threads;
+      std::shared_ptr<HttpConnectionPool> connections;
+      bool acceptPaused { false }; // by HttpConfig::maxConnections
+      bool multishotAccept { true }; // supported by the ring
+    };
 
-    void _acceptNext();
-    std::optional<RequestHandler> _find (const HttpRequest &) const;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    bool _reusePort { false };
+    size_t _nextWorker { 0 }; // round-robin hand-off when the acceptor is not per worker
+    std::atomic<size_t> _openConnections { 0 }; // including the ones being accepted
+    std::mutex _acceptMutex;
+
+    std::array<HttpRouter, kNumHttpMethods> _routes {};
+    HttpRoute _routeNotFound;
+
+    HttpServer (uint16_t port, size_t poolSize, LogLevel logLevel, const HttpConfig &config, std::optional<asio::ssl::context> &&tls);
+
+    void _addRoute (HttpMethod method, std::string_view path, RequestHandler &&handler, BodyHandler &&onBody);
+    std::shared_ptr<HttpResponseCache> _addCachedRoute (HttpMethod method, std::string_view path, RequestHandler &&handler, const HttpCacheConfig &config);
+    static RequestHandler _makeAsync (AsyncRequestHandler &&handler);
+    void _listen (Worker &worker, const asio::ip::tcp::endpoint &ep);
+    void _acceptNext (Worker &worker);
+    void _acceptMultishot (Worker &worker);
+    void _accepted (Worker &worker, Worker &target, asio::ip::tcp::socket &&socket);
+    void _connectionClosed();
+    const HttpRoute & _findRoute (HttpRequest &) const;
 };
 
 }
@@ -0,0 +1,112 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_STATIC_H__
+#define __LIGHTNING_HTTP_STATIC_H__
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <lightning/http_request.h>
+#include <lightning/http_response.h>
+#include <lightning/static_file.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpStaticConfig
+// ----------------------------------------------------------------------------
+struct HttpStaticConfig {
+  /// @brief File served for a path ending with '/'.
+  std::string indexFile { "index.html" };
+
+  /// @brief Files up to this size (in bytes) are mapped into memory; bigger ones are sent with sendfile(2).
+  uint64_t mmapThreshold { 64 * 1024 };
+
+  /// @brief Maximum number of files kept open. The least recently used ones are closed first.
+  size_t maxOpenFiles { 1024 };
+
+  /// @brief A cached file is checked (stat) again when it is requested after this time, and
+  /// reopened if it has been modified or replaced.
+  std::chrono::milliseconds revalidateAfter { 1000 };
+
+  /// @brief Serve "<file>.gz", if it exists, instead of a file to clients that accept gzip.
+  bool precompressed { true };
+};
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles
+// ----------------------------------------------------------------------------
+// Serves the files of a directory, keeping a cache of open (or mapped) files. The
+// path of the request is the "path" parameter of the route (see HttpServer::addStaticRoute).
+// Paths with ".." segments are rejected.
+//
+// The precompressed sibling of a file ("<file>.gz") is looked up, and cached, along
+// with it, so it costs nothing more to clients that do not accept gzip. Mapped files
+// that the connection compresses (see HttpConfig::compression) are compressed once
+// per coding, and the result is cached with the file too.
+class HttpStaticFiles {
+  public:
+    HttpStaticFiles (std::filesystem::path root, const HttpStaticConfig &config = {});
+
+    /// @brief Request handler (GET and HEAD)
+    void serve (const HttpRequest &request, HttpResponse &response);
+
+    /// @brief Find a file, from the cache or from the file system
+    ///
+    /// @param path Path relative to the root, already decoded
+    ///
+    /// @return The file, or nullptr if it does not exist
+    std::shared_ptr<const StaticFile> find (const std::string &path);
+
+    /// @brief Like find(), also returning the precompressed sibling ("<path>.gz") if there is one
+    std::pair<std::shared_ptr<const StaticFile>, std::shared_ptr<const StaticFile>> findWithGzip (const std::string &path);
+
+    /// @brief Decode the percent-encoded path of a request, rejecting the ones that are not
+    /// valid or that could escape the root ("..").
+    static std::optional<std::string> decodePath (std::string_view path);
+
+    /// @brief Number of files in the cache
+    inline size_t size() const {
+      std::lock_guard lock { _mutex };
+      return _files.size();
+    }
+
+  private:
+    // A file, with its precompressed sibling and the forms of it compressed by the connections
+    struct Found {
+      std::shared_ptr<const StaticFile> file;
+      std::shared_ptr<const StaticFile> gzip;
+      std::shared_ptr<HttpCompressedBodies> compressed;
+    };
+
+    struct Entry {
+      Found found;
+      std::chrono::steady_clock::time_point checked; // last stat
+      std::list<std::string>::iterator lru;
+    };
+
+    std::filesystem::path _root;
+    HttpStaticConfig _config;
+    mutable std::mutex _mutex; // handlers run on every I/O thread
+    std::unordered_map<std::string, Entry> _files;
+    std::list<std::string> _lru; // most recently used first
+
+    Found _find (const std::string &path);
+    void _insert (const std::string &path, const Found &found);
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_STREAM_H__
+#define __LIGHTNING_HTTP_STREAM_H__
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <asio.hpp>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpStream
+// ----------------------------------------------------------------------------
+// Handle of a streamed response, obtained with HttpResponse::stream(). The status and
+// headers are written as soon as the handler has returned (or right away, if it had
+// deferred the response), and then every chunk as it is written, with
+// "Transfer-Encoding: chunked" (HTTP/1.0 clients get the raw bytes and the connection
+// is closed at the end).
+//
+// Flow control: a write completes once the bytes waiting to be sent are no more than
+// HttpConfig::streamHighWaterMark, so a producer that waits for every write before the
+// next one never holds more than that (plus a chunk) in memory, however big the response.
+// Writes fail (std::errc::broken_pipe) once the connection is gone.
+//
+// Handles can be copied and used from any thread. The connection stays open until
+// end() is called or every handle is dropped.
+class HttpStream {
+  public:
+    using Completion = std::function<void (std::error_code)>;
+
+    // A chunk of the body, owned by the stream or shared with other streams (e.g. an
+    // event broadcast to many clients, which is not copied for any of them)
+    struct Chunk {
+      std::string data;
+      std::shared_ptr<const std::string> shared;
+
+      inline std::string_view view() const { return shared ? std::string_view { *shared } : std::string_view { data }; }
+    };
+
+    // Implemented by the connection that writes the stream
+    class Sink {
+      public:
+        virtual ~Sink() = default;
+
+        /// @brief Queue a chunk. `done` (if any) is called once the chunk may be followed by another one.
+        ///
+        /// @return False if the stream has failed or ended (`done` is called with the error)
+        virtual bool write (Chunk chunk, Completion done) = 0;
+
+        virtual void end() = 0;
+
+        /// @brief Close the connection without ending the stream
+        virtual void abort() = 0;
+
+        /// @brief Bytes written and not sent yet
+        virtual size_t pendingBytes() const = 0;
+    };
+
+    HttpStream() = default;
+
+    HttpStream (asio::any_io_executor executor, std::shared_ptr<Sink> sink):
+      _executor { std::move (executor) },
+      _sink { std::move (sink) }
+    {
+      // empty
+    }
+
+    /// @brief Executor of the connection (the I/O thread that owns it)
+    inline const asio::any_io_executor & executor() const { return _executor; }
+
+    /// @brief Send a chunk of the body
+    ///
+    /// @param token Completion token (a handler, asio::use_awaitable, asio::detached, ...) with the
+    /// signature void (std::error_code), called on its associated executor (the connection's by default).
+    template<typename CompletionToken>
+    auto write (std::string chunk, CompletionToken &&token) {
+      return _write (Chunk { std::move (chunk), nullptr }, std::forward<CompletionToken> (token));
+    }
+
+    /// @brief Send a chunk shared with other streams
+    template<typename CompletionToken>
+    auto write (std::shared_ptr<const std::string> chunk, CompletionToken &&token) {
+      return _write (Chunk { {}, std::move (chunk) }, std::forward<CompletionToken> (token));
+    }
+
+    /// @brief Queue a shared chunk without waiting for the stream to drain (the caller decides
+    /// what to do with a slow client, see pendingBytes())
+    ///
+    /// @return False if the stream has failed or ended
+    inline bool push (std::shared_ptr<const std::string> chunk) {
+      return _sink && _sink->write (Chunk { {}, std::move (chunk) }, nullptr);
+    }
+
+    /// @brief Bytes written and not sent to the client yet
+    inline size_t pendingBytes() const { return _sink ? _sink->pendingBytes() : 0; }
+
+    /// @brief Finish the response. Chunks written before are sent first.
+    inline void end() { if (_sink) _sink->end(); }
+
+    /// @brief Close the connection, dropping the chunks not sent yet
+    inline void abort() { if (_sink) _sink->abort(); }
+
+    explicit operator bool() const { return static_cast<bool> (_sink); }
+
+  private:
+    asio::any_io_executor _executor;
+    std::shared_ptr<Sink> _sink;
+
+    template<typename CompletionToken>
+    auto _write (Chunk chunk, CompletionToken &&token) {
+      return asio::async_initiate<CompletionToken, void (std::error_code)> (
+        // the initiation may run later (e.g. when awaited), so it does not refer to the handle
+        [ sink = _sink, connection = _executor ] (auto handler, Chunk chunk) {
+          const auto executor { asio::get_associated_executor (handler, connection) };
+          auto shared { std::make_shared<decltype (handler)> (std::move (handler)) };
+
+          sink->write (std::move (chunk), [ executor, shared ] (std::error_code ec) {
+            asio::post (executor, [ shared, ec ] { (*shared) (ec); });
+          });
+        },
+        token,
+        std::move (chunk)
+      );
+    }
+};
+
+}
+
+#endif
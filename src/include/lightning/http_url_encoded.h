@@ -0,0 +1,112 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_URL_ENCODED_H__
+#define __LIGHTNING_HTTP_URL_ENCODED_H__
+#include <charconv>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include <lightning/small_vector.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded
+// ----------------------------------------------------------------------------
+// Parameters of a query string or of an application/x-www-form-urlencoded body.
+// They are split on first access into views of the source, still encoded: values
+// are only percent-decoded when asked, into a buffer of the caller or one taken
+// from the memory resource (the connection's arena).
+class HttpUrlEncoded {
+  public:
+    struct Param {
+      std::string_view name; // encoded
+      std::string_view value; // encoded
+    };
+
+    using const_iterator = SmallVector<Param, 8>::const_iterator;
+
+    explicit HttpUrlEncoded (std::pmr::memory_resource *resource = std::pmr::get_default_resource()):
+      _params { resource },
+      _resource { resource }
+    {
+      // empty
+    }
+
+    /// @brief Set the encoded parameters ("a=1&b=2"). They are not split until accessed.
+    void assign (std::string_view source);
+
+    /// @brief Raw (encoded) value of the first parameter with a name, which is compared
+    /// decoded. A parameter without "=" has an empty value.
+    std::optional<std::string_view> get (std::string_view name) const;
+
+    /// @brief Value of the first parameter with a name, as a number (std::from_chars).
+    /// Empty if the parameter is missing or the whole value is not a valid T.
+    template<typename T> requires (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+    std::optional<T> get (std::string_view name) const {
+      const auto raw { get (name) };
+      if (!raw)
+        return std::nullopt;
+
+      // long enough for any number that from_chars accepts in practice
+      char buffer[128];
+      const auto value { decode (*raw, buffer) };
+      if (!value)
+        return std::nullopt;
+
+      T result;
+      const auto [ end, ec ] { std::from_chars (value->data(), value->data() + value->size(), result) };
+
+      if ((ec != std::errc {}) || (end != value->data() + value->size()))
+        return std::nullopt;
+
+      return result;
+    }
+
+    /// @brief Decoded value of the first parameter with a name. Only values with escapes
+    /// are copied, to memory of the resource that lives as long as it (the arena of the
+    /// connection, until the response has been written).
+    std::optional<std::string_view> decoded (std::string_view name) const;
+
+    /// @brief Whether a parameter is present
+    inline bool contains (std::string_view name) const { return get (name).has_value(); }
+
+    inline size_t size() const { _parse(); return _params.size(); }
+    inline bool empty() const { return size() == 0; }
+
+    inline const_iterator begin() const { _parse(); return _params.begin(); }
+    inline const_iterator end() const { _parse(); return _params.end(); }
+
+    /// @brief Forget the parameters (and the memory of the split ones).
+    void reset();
+
+    /// @brief Percent-decode an encoded name or value ("+" is a space). Invalid escapes are
+    /// kept as they are.
+    ///
+    /// @param encoded Text to decode
+    /// @param buffer Where the decoded text is written, if it has any escape
+    ///
+    /// @return The decoded text: `encoded` itself if it has no escapes, or a view of
+    /// `buffer`. Empty if the buffer is too small.
+    static std::optional<std::string_view> decode (std::string_view encoded, std::span<char> buffer);
+
+  private:
+    std::string_view _source;
+    mutable SmallVector<Param, 8> _params; // split on first access
+    mutable bool _parsed { true };
+    std::pmr::memory_resource *_resource;
+
+    void _parse() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_HTTP_WEBSOCKET_H__
+#define __LIGHTNING_HTTP_WEBSOCKET_H__
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <lightning/http_stream.h>
+
+
+namespace lightning {
+
+class HttpRequest;
+class HttpResponse;
+class WebSocket;
+
+// ----------------------------------------------------------------------------
+// WebSocketOpcode
+// ----------------------------------------------------------------------------
+enum class WebSocketOpcode: uint8_t {
+  kContinuation = 0x0,
+  kText = 0x1,
+  kBinary = 0x2,
+  kClose = 0x8,
+  kPing = 0x9,
+  kPong = 0xa
+};
+
+// ----------------------------------------------------------------------------
+// WebSocketHandler
+// ----------------------------------------------------------------------------
+// Callbacks of a WebSocket route (see HttpServer::addWebSocketRoute), called on the
+// thread of the connection. Every one is optional.
+struct WebSocketHandler {
+  /// @brief The handshake has been accepted (the request is only valid during the call)
+  std::function<void (const HttpRequest &, WebSocket &)> onOpen {};
+
+  /// @brief A whole message. The payload is only valid during the call.
+  std::function<void (WebSocket &, std::string_view message, bool binary)> onMessage {};
+
+  /// @brief The connection is closing (1005 if the close frame has no code, 1006 if there is no close frame)
+  std::function<void (WebSocket &, uint16_t code)> onClose {};
+};
+
+// ----------------------------------------------------------------------------
+// WebSocket
+// ----------------------------------------------------------------------------
+// Handle of an upgraded connection (RFC 6455). Frames are written through the
+// HttpStream of the 101 response; they are read from the input buffer of the
+// connection and unmasked in place, so an unfragmented message is handed to
+// onMessage without a copy. Text messages are not checked to be valid UTF-8.
+//
+// Server frames are not masked, so a message sent to many clients can be framed once,
+// with frame(), and shared by all of them.
+//
+// Handles can be copied and used from any thread.
+class WebSocket {
+  public:
+    WebSocket() = default;
+
+    explicit WebSocket (HttpStream stream): _stream { std::move (stream) } {
+      // empty
+    }
+
+    /// @brief Send a message
+    ///
+    /// @return False if the connection is closing or gone
+    inline bool send (std::string_view message, bool binary = false) {
+      return _stream.push (frame (message, binary ? WebSocketOpcode::kBinary : WebSocketOpcode::kText));
+    }
+
+    /// @brief Send a frame built with frame(), possibly shared with other connections
+    inline bool send (std::shared_ptr<const std::string> frame) { return _stream.push (std::move (frame)); }
+
+    /// @brief Send a close frame; the connection is closed once it has been written
+    void close (uint16_t code = 1000, std::string_view reason = {});
+
+    /// @brief Bytes sent and not written to the socket yet (for the caller to handle slow clients)
+    inline size_t pendingBytes() const { return _stream.pendingBytes(); }
+
+    /// @brief Executor of the connection, which runs its callbacks
+    inline const asio::any_io_executor & executor() const { return _stream.executor(); }
+
+    explicit operator bool() const { return static_cast<bool> (_stream); }
+
+    /// @brief Build an unmasked, unfragmented frame
+    static std::shared_ptr<const std::string> frame (std::string_view payload, WebSocketOpcode opcode = WebSocketOpcode::kText);
+
+    /// @brief Append an unmasked, unfragmented frame to a buffer
+    static void appendFrame (std::string &out, std::string_view payload, WebSocketOpcode opcode);
+
+    /// @brief Check the handshake of a request and set the 101 response
+    ///
+    /// @return False (and an error response) if the request is not a valid handshake
+    static bool accept (const HttpRequest &request, HttpResponse &response);
+
+    /// @brief Sec-WebSocket-Accept of a Sec-WebSocket-Key
+    static std::string acceptKey (std::string_view key);
+
+    /// @brief XOR data with a masking key, `offset` being the position of data in the payload.
+    /// Vectorized (AVX2 or SSE2, chosen at run time, on x86-64).
+    static void unmask (char *data, size_t size, const std::array<uint8_t, 4> &key, size_t offset = 0);
+
+  private:
+    HttpStream _stream;
+};
+
+// ----------------------------------------------------------------------------
+// WebSocketFrameHeader
+// ----------------------------------------------------------------------------
+struct WebSocketFrameHeader {
+  bool fin;
+  uint8_t rsv; // reserved bits (there are no extensions, so they must be 0)
+  WebSocketOpcode opcode;
+  bool masked;
+  std::array<uint8_t, 4> key;
+  uint64_t payloadLength;
+  size_t headerLength;
+
+  /// @brief Parse the header of a frame
+  ///
+  /// @return False if `data` does not hold the whole header yet
+  static bool parse (std::string_view data, WebSocketFrameHeader &header);
+};
+
+}
+
+#endif
@@ -0,0 +1,245 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_IO_URING_H__
+#define __LIGHTNING_IO_URING_H__
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <asio.hpp>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// IoUring
+// ----------------------------------------------------------------------------
+// Accepts, receives and sends of the sockets of an io_context through an io_uring
+// (Linux 5.19 or later). Operations are queued in the submission ring and submitted
+// together, with a single io_uring_enter(2), by a handler posted to the io_context;
+// completions are reaped from the completion ring when the eventfd registered with
+// the ring, watched by the io_context, becomes readable. A batch of operations costs
+// two syscalls, whatever its size.
+//
+// Idle sockets can receive into a ring of provided buffers (a buffer group), which
+// the kernel picks from when data arrives, so no memory is tied to a socket while
+// it waits.
+//
+// Operations may be started from any thread. The sockets of pending operations must
+// not be closed: the ring holds a reference to them, so a shutdown(2) is what makes
+// them complete (after submit(), if they may not have been submitted yet).
+class IoUring {
+  public:
+    /// @brief handler: void (int result, bool more), where result is a descriptor or -errno and
+    /// `more` tells whether a multishot accept goes on
+    using AcceptHandler = std::function<void (int result, bool more)>;
+
+    /// @brief A ring for the sockets of `io`, or nullptr (and the reason in `ec`) if the kernel
+    /// does not provide what is needed.
+    ///
+    /// @param entries Size of the submission ring (rounded up to a power of two)
+    /// @param buffers Provided buffers (rounded up to a power of two; 0: none)
+    /// @param bufferSize Size of every provided buffer, in bytes
+    static std::unique_ptr<IoUring> create (asio::io_context &io, size_t entries, size_t buffers, size_t bufferSize, std::error_code &ec);
+
+    IoUring (const IoUring &) = delete;
+    IoUring & operator= (const IoUring &) = delete;
+
+    ~IoUring();
+
+    /// @brief Accept connections on a listening socket. A multishot accept completes once per
+    /// connection until it fails; the handler runs on the thread that reaps the completions.
+    void accept (int fd, bool multishot, AcceptHandler handler);
+
+    /// @brief handler: void (std::error_code, size_t), run by its associated executor
+    template<typename Handler>
+    void receive (int fd, asio::mutable_buffer buffer, Handler &&handler) {
+      const auto op { new ReceiveCompletion<std::decay_t<Handler>> { std::forward<Handler> (handler) } };
+
+      _receive (op, fd, buffer.data(), buffer.size());
+    }
+
+    /// @brief Receive into a provided buffer (only if providesBuffers()). handler: void (std::error_code,
+    /// std::string_view), run on the thread that reaps the completions; the data is only valid during
+    /// the call. It fails with ENOBUFS when every buffer is in use.
+    template<typename Handler>
+    void receiveProvided (int fd, Handler &&handler) {
+      const auto op { new ProvidedCompletion<std::decay_t<Handler>> { std::forward<Handler> (handler) } };
+
+      _receive (op, fd, nullptr, 0);
+    }
+
+    /// @brief Send every byte of `buffers` (gather write). handler: void (std::error_code, size_t),
+    /// run by its associated executor
+    template<typename Handler>
+    void send (int fd, std::span<const asio::const_buffer> buffers, Handler &&handler) {
+      const auto op { new SendCompletion<std::decay_t<Handler>> { std::forward<Handler> (handler) } };
+
+      op->fd = fd;
+      op->iov.reserve (buffers.size());
+
+      for (const auto &b: buffers) {
+        if (b.size() > 0)
+          op->iov.push_back ({ const_cast<void *> (b.data()), b.size() });
+      }
+
+      _send (op, false);
+    }
+
+    /// @brief Submit the queued operations now, rather than from the posted handler
+    void submit();
+
+    /// @brief The ring has provided buffers (see receiveProvided())
+    inline bool providesBuffers() const { return _bufferRing != nullptr; }
+
+  private:
+    // An operation in flight, linked in the list of the ring
+    struct Operation {
+      Operation *prev { nullptr };
+      Operation *next { nullptr };
+
+      virtual ~Operation() = default;
+
+      // Returns true if the operation is finished (false: it goes on, or it has been submitted again)
+      virtual bool complete (IoUring &ring, int result, uint32_t flags) = 0;
+    };
+
+    struct AcceptOperation: Operation {
+      AcceptHandler handler;
+
+      bool complete (IoUring &ring, int result, uint32_t flags) override;
+    };
+
+    template<typename Handler>
+    struct ReceiveCompletion: Operation {
+      Handler handler;
+
+      explicit ReceiveCompletion (Handler &&h): handler { std::move (h) } {}
+
+      bool complete (IoUring &ring, int result, uint32_t) override {
+        ring._dispatch (handler, _error (result, true), static_cast<size_t> (std::max (result, 0)));
+        return true;
+      }
+    };
+
+    template<typename Handler>
+    struct ProvidedCompletion: Operation {
+      Handler handler;
+
+      explicit ProvidedCompletion (Handler &&h): handler { std::move (h) } {}
+
+      bool complete (IoUring &ring, int result, uint32_t flags) override {
+        const auto buffer { ring._provided (result, flags) };
+
+        handler (_error (result, true), buffer.second);
+
+        if (buffer.first >= 0)
+          ring._recycle (static_cast<uint16_t> (buffer.first));
+
+        return true;
+      }
+    };
+
+    // A gather write, submitted again with what is left after a short send
+    struct SendOperation: Operation {
+      int fd { -1 };
+      std::vector<iovec> iov;
+      size_t first { 0 }; // first buffer not sent completely
+      size_t sent { 0 };
+      msghdr message {};
+
+      bool complete (IoUring &ring, int result, uint32_t flags) override;
+
+      virtual void done (IoUring &ring, const std::error_code &ec) = 0;
+    };
+
+    template<typename Handler>
+    struct SendCompletion: SendOperation {
+      Handler handler;
+
+      explicit SendCompletion (Handler &&h): handler { std::move (h) } {}
+
+      void done (IoUring &ring, const std::error_code &ec) override {
+        ring._dispatch (handler, ec, sent);
+      }
+    };
+
+    asio::io_context::executor_type _executor;
+    int _fd { -1 };
+    asio::posix::stream_descriptor _event; // eventfd signalled by every completion
+    uint64_t _eventCount { 0 };
+    std::mutex _mutex; // submission ring, operation list and flags
+
+    // rings shared with the kernel
+    void *_rings { nullptr };
+    size_t _ringsSize { 0 };
+    void *_sqes { nullptr };
+    size_t _sqesSize { 0 };
+    unsigned *_sqHead { nullptr };
+    unsigned *_sqTail { nullptr };
+    unsigned _sqMask { 0 };
+    unsigned _sqEntries { 0 };
+    unsigned *_sqFlags { nullptr };
+    unsigned *_cqHead { nullptr };
+    unsigned *_cqTail { nullptr };
+    unsigned _cqMask { 0 };
+    void *_cqes { nullptr };
+
+    // provided buffers
+    void *_bufferRing { nullptr };
+    size_t _bufferRingSize { 0 };
+    std::unique_ptr<char[]> _buffers;
+    size_t _bufferSize { 0 };
+    unsigned _bufferCount { 0 };
+    uint16_t _bufferTail { 0 };
+
+    Operation *_operations { nullptr }; // in flight
+    size_t _pending { 0 }; // operations in flight
+    unsigned _queued { 0 }; // entries not submitted yet
+    bool _armed { false }; // a read of the eventfd is pending
+    bool _flushPosted { false };
+
+    explicit IoUring (asio::io_context &io);
+
+    std::error_code _setup (size_t entries);
+    void _provideBuffers (size_t buffers, size_t bufferSize);
+    void _receive (Operation *op, int fd, void *data, size_t size); // into a provided buffer if data is null
+    void _send (SendOperation *op, bool again);
+    void _track (Operation *op);
+    void * _entry (int &error);
+    void _queue();
+    void _fail (Operation *op, int error);
+    int _submit();
+    void _arm();
+    void _reap();
+    void _finish (Operation *op);
+    std::pair<int, std::string_view> _provided (int result, uint32_t flags) const;
+    void _recycle (uint16_t id);
+
+    static std::error_code _error (int result, bool eof);
+
+    template<typename Handler>
+    void _dispatch (Handler &handler, const std::error_code &ec, size_t bytes) {
+      const auto executor { asio::get_associated_executor (handler, _executor) };
+
+      asio::dispatch (executor, [ handler = std::move (handler), ec, bytes ] () mutable { handler (ec, bytes); });
+    }
+};
+
+}
+
+#endif
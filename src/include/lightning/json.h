@@ -0,0 +1,250 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_JSON_H__
+#define __LIGHTNING_JSON_H__
+#include <charconv>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+
+namespace lightning {
+
+struct JsonMember;
+
+// ----------------------------------------------------------------------------
+// JsonValue
+// ----------------------------------------------------------------------------
+// A value of a JsonDocument. Strings and numbers are views of the parsed text
+// (numbers are converted when asked); the elements of arrays and objects are
+// stored contiguously, in the order of the text, in memory of the document.
+class JsonValue {
+  public:
+    enum class Type: uint8_t {
+      kNull = 0,
+      kBool,
+      kNumber,
+      kString,
+      kArray,
+      kObject
+    };
+
+    inline Type type() const { return _type; }
+
+    inline bool isNull() const { return _type == Type::kNull; }
+    inline bool isBool() const { return _type == Type::kBool; }
+    inline bool isNumber() const { return _type == Type::kNumber; }
+    inline bool isString() const { return _type == Type::kString; }
+    inline bool isArray() const { return _type == Type::kArray; }
+    inline bool isObject() const { return _type == Type::kObject; }
+
+    inline std::optional<bool> getBool() const {
+      return isBool() ? std::optional<bool> { _bool } : std::nullopt;
+    }
+
+    /// @brief The (unescaped) content of a string
+    inline std::optional<std::string_view> getString() const {
+      return isString() ? std::optional<std::string_view> { text() } : std::nullopt;
+    }
+
+    /// @brief A number as T (std::from_chars). Empty if it is not a number or does not fit a T
+    /// exactly (e.g. 1.5 as an int).
+    template<typename T> requires (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+    std::optional<T> get() const {
+      if (!isNumber())
+        return std::nullopt;
+
+      const auto s { text() };
+
+      T result;
+      const auto [ end, ec ] { std::from_chars (s.data(), s.data() + s.size(), result) };
+
+      if ((ec != std::errc {}) || (end != s.data() + s.size()))
+        return std::nullopt;
+
+      return result;
+    }
+
+    /// @brief Text of a number as it was written, or content of a string
+    inline std::string_view text() const {
+      return ((_type == Type::kNumber) || (_type == Type::kString)) ? std::string_view { static_cast<const char *> (_data), _size } : std::string_view {};
+    }
+
+    /// @brief Elements of an array or members of an object (0 for other values)
+    inline size_t size() const {
+      return ((_type == Type::kArray) || (_type == Type::kObject)) ? _size : 0;
+    }
+
+    /// @brief Elements of an array (none for other values)
+    inline std::span<const JsonValue> items() const;
+
+    /// @brief Members of an object (none for other values)
+    inline std::span<const JsonMember> members() const;
+
+    /// @brief Value of the first member of an object with a name, nullptr if there is none
+    const JsonValue * find (std::string_view name) const;
+
+    /// @brief Element of an array, nullptr if it is out of range
+    inline const JsonValue * at (size_t index) const {
+      return (index < items().size()) ? &items()[index] : nullptr;
+    }
+
+  private:
+    friend class JsonParser;
+
+    Type _type { Type::kNull };
+    bool _bool { false };
+    uint32_t _size { 0 }; // of the text or the elements
+    const void *_data { nullptr }; // text, elements (JsonValue) or members (JsonMember)
+};
+
+// ----------------------------------------------------------------------------
+// JsonMember
+// ----------------------------------------------------------------------------
+struct JsonMember {
+  std::string_view name; // unescaped
+  JsonValue value;
+};
+
+inline std::span<const JsonValue> JsonValue::items() const {
+  if (_type != Type::kArray)
+    return {};
+
+  return { static_cast<const JsonValue *> (_data), _size };
+}
+
+inline std::span<const JsonMember> JsonValue::members() const {
+  if (_type != Type::kObject)
+    return {};
+
+  return { static_cast<const JsonMember *> (_data), _size };
+}
+
+// ----------------------------------------------------------------------------
+// JsonDocument
+// ----------------------------------------------------------------------------
+// Parses a JSON text in place (insitu): the values are views of the text, and
+// strings with escape sequences are unescaped over it, so no string is copied.
+// The elements of arrays and objects are allocated from the memory resource
+// (the connection's arena), or from memory of the document itself if there is none;
+// the text and the resource must outlive the document.
+class JsonDocument {
+  public:
+    /// @brief Maximum nesting of arrays and objects
+    static constexpr size_t kMaxDepth { 256 };
+
+    explicit JsonDocument (std::pmr::memory_resource *resource = nullptr):
+      _resource { (resource != nullptr) ? resource : &_owned }
+    {
+      // empty
+    }
+
+    JsonDocument (const JsonDocument &) = delete;
+    JsonDocument & operator= (const JsonDocument &) = delete;
+
+    /// @brief Parse a text, which is modified: unescaped strings overwrite their escaped form.
+    ///
+    /// @param data Text to be parsed
+    /// @param size Length of the text
+    ///
+    /// @return true if the whole text is a valid JSON value. Otherwise the root is null
+    /// and errorOffset() tells where parsing stopped.
+    bool parse (char *data, size_t size);
+
+    inline const JsonValue & root() const { return _root; }
+
+    /// @brief Offset in the text of the first error of the last parse
+    inline size_t errorOffset() const { return _errorOffset; }
+
+    /// @brief Forget the values. Their memory is given back now if it is the document's,
+    /// otherwise with the resource.
+    inline void reset() {
+      _root = {};
+      _errorOffset = 0;
+
+      _owned.release();
+    }
+
+  private:
+    std::pmr::monotonic_buffer_resource _owned; // without a resource of the caller
+    std::pmr::memory_resource *_resource;
+    JsonValue _root;
+    size_t _errorOffset { 0 };
+};
+
+// ----------------------------------------------------------------------------
+// JsonWriter
+// ----------------------------------------------------------------------------
+// Serializes JSON straight into a string (see HttpResponse::json), adding the
+// separators between elements and members. The calls must describe a valid value:
+// every name is followed by a value, and containers are closed in order.
+class JsonWriter {
+  public:
+    explicit JsonWriter (std::string &out):
+      _out { out }
+    {
+      // empty
+    }
+
+    JsonWriter & startObject() { _separate(); _out.push_back ('{'); _comma = false; return *this; }
+    JsonWriter & endObject() { _out.push_back ('}'); _comma = true; return *this; }
+    JsonWriter & startArray() { _separate(); _out.push_back ('['); _comma = false; return *this; }
+    JsonWriter & endArray() { _out.push_back (']'); _comma = true; return *this; }
+
+    /// @brief Name of the next member of an object
+    JsonWriter & key (std::string_view name);
+
+    JsonWriter & value (std::string_view s);
+    JsonWriter & value (const char *s) { return value (std::string_view { s }); }
+    JsonWriter & value (const std::string &s) { return value (std::string_view { s }); }
+    JsonWriter & value (bool b);
+    JsonWriter & value (std::nullptr_t);
+
+    /// @brief A number (written with std::to_chars). NaN and infinities, which JSON cannot
+    /// represent, are written as null.
+    template<typename T> requires (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+    JsonWriter & value (T number) {
+      if constexpr (std::is_floating_point_v<T>) {
+        if (!std::isfinite (number))
+          return value (nullptr);
+      }
+
+      char buffer[32];
+      const auto end { std::to_chars (buffer, buffer + sizeof (buffer), number).ptr };
+
+      _separate();
+      _out.append (buffer, static_cast<size_t> (end - buffer));
+      _comma = true;
+
+      return *this;
+    }
+
+    /// @brief A parsed value, with all its elements
+    JsonWriter & value (const JsonValue &v);
+
+    /// @brief Append a string as a JSON string literal (quoted and escaped)
+    static void quote (std::string &out, std::string_view s);
+
+  private:
+    std::string &_out;
+    bool _comma { false }; // a value has been written at the current level
+
+    inline void _separate() {
+      if (_comma)
+        _out.push_back (',');
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_SMALL_VECTOR_H__
+#define __LIGHTNING_SMALL_VECTOR_H__
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// SmallVector
+// ----------------------------------------------------------------------------
+// Vector that keeps the first N elements inline and only allocates when it grows
+// beyond them, from the given memory resource. clear() keeps the allocated
+// capacity; reset() gives it back and returns to the inline storage.
+template<typename T, size_t N>
+class SmallVector {
+  static_assert (std::is_trivially_copyable_v<T>, "SmallVector only supports trivially copyable types");
+
+  public:
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    explicit SmallVector (std::pmr::memory_resource *resource = std::pmr::get_default_resource()):
+      _resource { resource }
+    {
+      // empty
+    }
+
+    SmallVector (const SmallVector &other) {
+      *this = other;
+    }
+
+    SmallVector (SmallVector &&other) noexcept {
+      *this = std::move (other);
+    }
+
+    ~SmallVector() {
+      _deallocate();
+    }
+
+    SmallVector & operator= (const SmallVector &other) {
+      if (this != &other) {
+        _size = 0;
+        reserve (other._size);
+        std::copy (other.begin(), other.end(), data());
+        _size = other._size;
+      }
+
+      return *this;
+    }
+
+    // The allocated storage (and its resource) is taken from `other`.
+    SmallVector & operator= (SmallVector &&other) noexcept {
+      if (this != &other) {
+        _deallocate();
+        _heap = nullptr;
+
+        if (other._heap) {
+          _heap = std::exchange (other._heap, nullptr);
+          _resource = other._resource;
+          _capacity = other._capacity;
+        }
+        else {
+          _capacity = N;
+          std::copy (other.begin(), other.end(), _inline.begin());
+        }
+
+        _size = other._size;
+
+        other._size = 0;
+        other._capacity = N;
+      }
+
+      return *this;
+    }
+
+    void reserve (size_t capacity) {
+      if (capacity <= _capacity)
+        return;
+
+      T *heap { static_cast<T *> (_resource->allocate (capacity * sizeof (T), alignof (T))) };
+      std::copy (begin(), end(), heap);
+
+      _deallocate();
+
+      _heap = heap;
+      _capacity = capacity;
+    }
+
+    void push_back (const T &value) {
+      if (_size == _capacity)
+        reserve (_capacity * 2);
+
+      data()[_size++] = value;
+    }
+
+    inline void pop_back() { --_size; }
+
+    inline void clear() { _size = 0; }
+
+    void reset() {
+      _deallocate();
+
+      _heap = nullptr;
+      _size = 0;
+      _capacity = N;
+    }
+
+    inline size_t size() const { return _size; }
+    inline size_t capacity() const { return _capacity; }
+    inline bool empty() const { return _size == 0; }
+
+    inline T * data() { return _heap ? _heap : _inline.data(); }
+    inline const T * data() const { return _heap ? _heap : _inline.data(); }
+
+    inline T & operator[] (size_t index) { return data()[index]; }
+    inline const T & operator[] (size_t index) const { return data()[index]; }
+
+    inline iterator begin() { return data(); }
+    inline iterator end() { return data() + _size; }
+
+    inline const_iterator begin() const { return data(); }
+    inline const_iterator end() const { return data() + _size; }
+
+  private:
+    std::array<T, N> _inline {};
+    T *_heap { nullptr };
+    std::pmr::memory_resource *_resource { std::pmr::get_default_resource() };
+    size_t _size { 0 };
+    size_t _capacity { N };
+
+    void _deallocate() {
+      if (_heap)
+        _resource->deallocate (_heap, _capacity * sizeof (T), alignof (T));
+    }
+};
+
+}
+
+#endif
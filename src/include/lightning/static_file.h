@@ -0,0 +1,84 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_STATIC_FILE_H__
+#define __LIGHTNING_STATIC_FILE_H__
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+#include <sys/stat.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// StaticFile
+// ----------------------------------------------------------------------------
+// An open regular file, ready to be sent as a response body. Files up to the mmap
+// threshold are mapped (and their descriptor closed), so they are written from the
+// page cache along with the headers; bigger ones keep the descriptor open and are
+// sent with sendfile(2), without their bytes passing through user space. Without
+// sendfile(2) (non-Linux systems) every file is mapped.
+//
+// The object is immutable, so it can be shared by any number of responses and threads.
+class StaticFile {
+  public:
+    /// @brief Open a regular file
+    ///
+    /// @param mmapThreshold Files up to this size (in bytes) are mapped into memory
+    ///
+    /// @return The file, or nullptr if it does not exist or it is not a regular file
+    static std::shared_ptr<const StaticFile> open (const std::filesystem::path &path, uint64_t mmapThreshold);
+
+    /// @brief Media type of a file name, from its extension ("application/octet-stream" if unknown)
+    static std::string_view contentType (std::string_view fileName);
+
+    StaticFile (const StaticFile &) = delete;
+    StaticFile & operator= (const StaticFile &) = delete;
+
+    ~StaticFile();
+
+    /// @brief Descriptor to be used with sendfile(2); -1 if the file is mapped (or empty)
+    inline int fd() const { return _fd; }
+
+    inline uint64_t size() const { return _size; }
+
+    /// @brief Contents of a mapped file (empty if it is not mapped)
+    inline std::string_view mapped() const {
+      return std::string_view { static_cast<const char *> (_map), _map ? _size : 0 };
+    }
+
+    inline std::string_view contentType() const { return _contentType; }
+
+    /// @brief Modification time as an HTTP date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+    inline std::string_view lastModified() const { return _lastModified; }
+
+    /// @brief Strong entity tag made of the size and the modification time (in hexadecimal)
+    inline std::string_view etag() const { return _etag; }
+
+    /// @brief True if the file that was opened is not the one described by `st` anymore
+    bool changed (const struct stat &st) const;
+
+  private:
+    int _fd { -1 };
+    void *_map { nullptr };
+    uint64_t _size { 0 };
+    dev_t _device { 0 };
+    ino_t _inode { 0 };
+    int64_t _modified { 0 }; // nanoseconds since the epoch
+    std::string_view _contentType;
+    char _lastModifiedData[32] {};
+    std::string_view _lastModified;
+    char _etagData[40] {};
+    std::string_view _etag;
+
+    StaticFile() = default;
+};
+
+}
+
+#endif
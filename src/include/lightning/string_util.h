@@ -8,6 +8,7 @@
 #include <cinttypes>
 #include <iomanip>
 #include <string>
+#include <string_view>
 #include <sstream>
 
 
@@ -15,6 +16,85 @@ namespace lightning {
 
 class StringUtil {
   public:
+    /// @brief Convert an ASCII character to lower case (locale independent)
+    ///
+    /// @param c Character to be converted
+    ///
+    /// @return The lower case character
+    static constexpr char toLower (char c) {
+      return ((c >= 'A') && (c <= 'Z')) ? static_cast<char> (c | 0x20) : c;
+    }
+
+    /// @brief Compare two ASCII strings ignoring case
+    ///
+    /// @param a First string
+    /// @param b Second string
+    ///
+    /// @return true if both strings are equal
+    static constexpr bool iequals (std::string_view a, std::string_view b) {
+      if (a.size() != b.size())
+        return false;
+
+      for (size_t i { 0 }; i < a.size(); ++i) {
+        if (toLower (a[i]) != toLower (b[i]))
+          return false;
+      }
+
+      return true;
+    }
+
+    /// @brief Value of a hexadecimal digit
+    ///
+    /// @param c Character to be converted
+    ///
+    /// @return The value (0-15), or -1 if the character is not a hexadecimal digit
+    static constexpr int hexValue (char c) {
+      if ((c >= '0') && (c <= '9'))
+        return c - '0';
+
+      if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+
+      if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+
+      return -1;
+    }
+
+    /// @brief Remove the leading and trailing spaces and tabs (optional whitespace of HTTP)
+    ///
+    /// @param s String to be trimmed
+    ///
+    /// @return The trimmed view of the string
+    static constexpr std::string_view trim (std::string_view s) {
+      while (!s.empty() && ((s.front() == ' ') || (s.front() == '\t')))
+        s.remove_prefix (1);
+
+      while (!s.empty() && ((s.back() == ' ') || (s.back() == '\t')))
+        s.remove_suffix (1);
+
+      return s;
+    }
+
+    /// @brief Whether a comma-separated list (e.g. "keep-alive, Upgrade") has a token, ignoring case
+    ///
+    /// @param list Comma-separated list
+    /// @param token Token to look for
+    ///
+    /// @return true if one of the (trimmed) items is the token
+    static constexpr bool hasToken (std::string_view list, std::string_view token) {
+      while (!list.empty()) {
+        const auto comma { list.find (',') };
+
+        if (iequals (trim (list.substr (0, comma)), token))
+          return true;
+
+        list.remove_prefix ((comma == std::string_view::npos) ? list.size() : comma + 1);
+      }
+
+      return false;
+    }
+
     /// @brief format a float32_t array
     ///
     /// @param buffer Pointer to the float32_t array to be formatted
@@ -0,0 +1,98 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_TIMER_WHEEL_H__
+#define __LIGHTNING_TIMER_WHEEL_H__
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <asio.hpp>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// TimerWheel
+// ----------------------------------------------------------------------------
+// Hashed timing wheel: deadlines are rounded up to a tick and kept in intrusive
+// lists, one per slot, so scheduling and cancelling are O(1) whatever the number
+// of entries. A single steady_timer drives the wheel, and only while it is not
+// empty. The entries of a slot that expire together are handled as a batch.
+//
+// Expiry callbacks run with the wheel locked: they must be short and must not use
+// the wheel. In return, an entry cancelled by another thread is never called
+// after cancel() has returned.
+class TimerWheel {
+  public:
+    using Duration = std::chrono::milliseconds;
+
+    class Entry {
+      public:
+        explicit Entry (std::function<void ()> onExpire): _onExpire { std::move (onExpire) } {
+          // empty
+        }
+
+        Entry (const Entry &) = delete;
+        Entry & operator= (const Entry &) = delete;
+
+      private:
+        friend class TimerWheel;
+
+        std::function<void ()> _onExpire;
+        Entry *_prev { nullptr };
+        Entry *_next { nullptr };
+        size_t _slot { kUnscheduled };
+        size_t _rounds { 0 }; // full turns left before it expires
+    };
+
+    /// @param tick Resolution of the deadlines
+    /// @param slots Number of slots; deadlines beyond tick * slots take several turns
+    explicit TimerWheel (
+      const asio::any_io_executor &executor,
+      Duration tick = Duration { 100 },
+      size_t slots = 512
+    );
+
+    TimerWheel (const TimerWheel &) = delete;
+    TimerWheel & operator= (const TimerWheel &) = delete;
+
+    /// @brief (Re)schedule an entry. It expires no earlier than `timeout` from now, and at most a tick later.
+    void schedule (Entry &entry, Duration timeout);
+
+    /// @brief Unschedule an entry, if it is scheduled
+    void cancel (Entry &entry);
+
+    /// @brief Number of scheduled entries
+    inline size_t size() const {
+      std::lock_guard lock { _mutex };
+      return _size;
+    }
+
+  private:
+    static constexpr size_t kUnscheduled { static_cast<size_t> (-1) };
+
+    asio::steady_timer _timer;
+    Duration _tick;
+    std::vector<Entry *> _slots; // head of the list of every slot
+    size_t _current { 0 }; // slot of the last tick
+    size_t _size { 0 };
+    bool _running { false }; // the timer is waiting for the next tick
+    std::chrono::steady_clock::time_point _next; // time of the next tick
+    std::vector<Entry *> _expired;
+    mutable std::mutex _mutex; // the io_context may be run by several threads
+
+    void _link (Entry &entry, size_t slot);
+    void _unlink (Entry &entry);
+    void _wait();
+    void _advance();
+};
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_TLS_STREAM_H__
+#define __LIGHTNING_TLS_STREAM_H__
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <sys/types.h>
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+
+#include <openssl/ssl.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// TlsStream
+// ----------------------------------------------------------------------------
+// Server side of a TLS connection over a TCP socket. OpenSSL reads and writes the
+// socket itself (a socket BIO), instead of going through the memory BIO pair of
+// asio::ssl::stream: records are not copied through an intermediate buffer and,
+// once the handshake is done, OpenSSL can hand their encryption to the kernel
+// (kTLS, Linux), so writes and sendfile(2) go out as plain data.
+//
+// It is an asio AsyncReadStream and AsyncWriteStream (asio::async_write works with
+// it) for completion handlers, which are run by their associated executor and never
+// inside the call that starts the operation. As with a socket, a read and a write can
+// be in progress at the same time, as long as they are started from a single thread
+// or strand.
+class TlsStream {
+  public:
+    using executor_type = asio::ip::tcp::socket::executor_type;
+
+    /// @brief Records are at most 16 KB; smaller buffers of a gather write are joined up to it
+    static constexpr size_t kMaxRecordSize { 16 * 1024 };
+
+    /// @param kernelTls Let OpenSSL enable kTLS when the handshake is done (if the kernel
+    /// supports the negotiated cipher; otherwise, records are encrypted in user space)
+    TlsStream (asio::ip::tcp::socket &socket, asio::ssl::context &context, bool kernelTls);
+
+    TlsStream (const TlsStream &) = delete;
+    TlsStream & operator= (const TlsStream &) = delete;
+
+    ~TlsStream();
+
+    /// @brief Start over with the current descriptor of the socket (e.g. a pooled connection
+    /// reused for a new client)
+    void reset();
+
+    /// @brief Server handshake; handler: void (asio::error_code)
+    template<typename Handler>
+    void async_handshake (Handler &&handler) {
+      const auto executor { asio::get_associated_executor (handler, get_executor()) };
+
+      _run (
+        [ this ] (asio::error_code &ec, size_t &) { return _handshake (ec); },
+        asio::bind_executor (executor, [ handler = std::forward<Handler> (handler) ] (const asio::error_code &ec, size_t) mutable {
+          handler (ec);
+        }),
+        false
+      );
+    }
+
+    /// @brief handler: void (asio::error_code, size_t)
+    template<typename MutableBuffers, typename Handler>
+    void async_read_some (const MutableBuffers &buffers, Handler &&handler) {
+      const asio::mutable_buffer buffer { *asio::buffer_sequence_begin (buffers) };
+
+      _run ([ this, buffer ] (asio::error_code &ec, size_t &bytes) { return _read (buffer, ec, bytes); }, std::forward<Handler> (handler), false);
+    }
+
+    /// @brief handler: void (asio::error_code, size_t)
+    template<typename ConstBuffers, typename Handler>
+    void async_write_some (const ConstBuffers &buffers, Handler &&handler) {
+      const asio::const_buffer buffer { _join (buffers) };
+
+      _run ([ this, buffer ] (asio::error_code &ec, size_t &bytes) { return _write (buffer, ec, bytes); }, std::forward<Handler> (handler), false);
+    }
+
+    /// @brief Send a range of a file with SSL_sendfile (only when kernelSend())
+    ///
+    /// @return As sendfile(2): bytes sent, or -1 and errno (EAGAIN if the socket is full)
+    ssize_t sendFile (int fd, off_t offset, size_t size);
+
+    /// @brief Send a close_notify alert, if it can be done without waiting. Sessions of connections
+    /// closed without it are not resumed.
+    void shutdown();
+
+    /// @brief Decrypted bytes (or records) that a read gets without waiting for the socket
+    inline bool pending() const { return SSL_has_pending (_ssl) == 1; }
+
+    /// @brief The kernel encrypts the records sent (kTLS)
+    bool kernelSend() const;
+
+    /// @brief The kernel decrypts the records received (kTLS)
+    bool kernelReceive() const;
+
+    /// @brief The handshake resumed a session (from the cache or a ticket)
+    inline bool resumed() const { return SSL_session_reused (_ssl) == 1; }
+
+    inline executor_type get_executor() { return _socket.get_executor(); }
+
+    inline SSL * native_handle() { return _ssl; }
+
+  private:
+    // Outcome of an OpenSSL call
+    enum class Status {
+      kDone,
+      kWantRead,
+      kWantWrite,
+      kFailed
+    };
+
+    asio::ip::tcp::socket &_socket;
+    SSL_CTX *_context;
+    bool _kernelTls;
+    SSL *_ssl { nullptr };
+    std::string _joined; // small buffers of a gather write, joined in a single record
+    bool _failed { false }; // a fatal error happened, no alert can be sent
+
+    Status _handshake (asio::error_code &ec);
+    Status _read (asio::mutable_buffer buffer, asio::error_code &ec, size_t &bytes);
+    Status _write (asio::const_buffer buffer, asio::error_code &ec, size_t &bytes);
+    Status _status (int result, asio::error_code &ec);
+
+    // Calls `operation` until it does not need to wait for the socket, then completes the handler
+    template<typename Operation, typename Handler>
+    void _run (Operation operation, Handler &&handler, bool waited) {
+      asio::error_code ec;
+      size_t bytes { 0 };
+
+      const auto status { operation (ec, bytes) };
+
+      if ((status == Status::kWantRead) || (status == Status::kWantWrite)) {
+        const auto executor { asio::get_associated_executor (handler, get_executor()) };
+
+        _socket.async_wait(
+          (status == Status::kWantRead) ? asio::ip::tcp::socket::wait_read : asio::ip::tcp::socket::wait_write,
+          asio::bind_executor (executor, [ this, operation, handler = std::forward<Handler> (handler) ] (const asio::error_code &error) mutable {
+            if (error)
+              handler (error, size_t { 0 });
+            else
+              _run (std::move (operation), std::move (handler), true);
+          })
+        );
+
+        return;
+      }
+
+      // completed by a wait handler, which already runs on the handler's executor
+      if (waited) {
+        handler (ec, bytes);
+      }
+      else {
+        const auto executor { asio::get_associated_executor (handler, get_executor()) };
+        asio::post (executor, [ handler = std::forward<Handler> (handler), ec, bytes ] () mutable { handler (ec, bytes); });
+      }
+    }
+
+    // Buffer for the next record: the first one, or the first ones joined if they are small
+    template<typename ConstBuffers>
+    asio::const_buffer _join (const ConstBuffers &buffers) {
+      auto it { asio::buffer_sequence_begin (buffers) };
+      const auto end { asio::buffer_sequence_end (buffers) };
+
+      while ((it != end) && (asio::const_buffer { *it }.size() == 0))
+        ++it;
+
+      if (it == end)
+        return {};
+
+      const asio::const_buffer first { *it };
+
+      if ((first.size() >= kMaxRecordSize) || (std::next (it) == end))
+        return first;
+
+      _joined.clear();
+
+      for (; (it != end) && (_joined.size() < kMaxRecordSize); ++it) {
+        const asio::const_buffer b { *it };
+        _joined.append (static_cast<const char *> (b.data()), std::min (b.size(), kMaxRecordSize - _joined.size()));
+      }
+
+      return asio::buffer (_joined);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <atomic>
+#include <vector>
+
+#include <lightning/buffer_pool.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// FreeList
+// ----------------------------------------------------------------------------
+namespace {
+
+std::atomic<size_t> usedBytes { 0 };
+std::atomic<size_t> cachedBytes { 0 };
+
+struct FreeList {
+  size_t size { 0 };
+  std::vector<char *> buffers;
+
+  ~FreeList() {
+    cachedBytes.fetch_sub (size * buffers.size(), std::memory_order_relaxed);
+
+    for (char *b: buffers)
+      delete[] b;
+  }
+};
+
+thread_local FreeList freeList;
+
+}
+
+// ----------------------------------------------------------------------------
+// BufferPool::stats
+// ----------------------------------------------------------------------------
+BufferPool::Stats BufferPool::stats() {
+  return { usedBytes.load (std::memory_order_relaxed), cachedBytes.load (std::memory_order_relaxed) };
+}
+
+// ----------------------------------------------------------------------------
+// BufferPool::acquire
+// ----------------------------------------------------------------------------
+char * BufferPool::acquire (size_t size) {
+  usedBytes.fetch_add (size, std::memory_order_relaxed);
+
+  if ((freeList.size == size) && !freeList.buffers.empty()) {
+    char *buffer { freeList.buffers.back() };
+    freeList.buffers.pop_back();
+
+    cachedBytes.fetch_sub (size, std::memory_order_relaxed);
+
+    return buffer;
+  }
+
+  // the cached size follows the demand
+  if (freeList.buffers.empty())
+    freeList.size = size;
+
+  return new char[size];
+}
+
+// ----------------------------------------------------------------------------
+// BufferPool::release
+// ----------------------------------------------------------------------------
+void BufferPool::release (char *buffer, size_t size) {
+  if (buffer == nullptr)
+    return;
+
+  usedBytes.fetch_sub (size, std::memory_order_relaxed);
+
+  if ((freeList.size == size) && (freeList.buffers.size() < kMaxCached)) {
+    freeList.buffers.push_back (buffer);
+
+    cachedBytes.fetch_add (size, std::memory_order_relaxed);
+  }
+  else {
+    delete[] buffer;
+  }
+}
+
+}
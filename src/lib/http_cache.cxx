@@ -0,0 +1,321 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <utility>
+
+#include <asio.hpp>
+
+#include <lightning/http_cache.h>
+#include <lightning/http_compression.h>
+#include <lightning/http_conditional.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// hasDirective
+// ----------------------------------------------------------------------------
+// Whether a Cache-Control value has a directive, e.g. "no-store" in "private, no-store"
+static bool hasDirective (std::string_view value, std::string_view directive) {
+  while (!value.empty()) {
+    const auto comma { value.find (',') };
+    const auto token { StringUtil::trim (value.substr (0, std::min (comma, value.find ('=')))) };
+
+    if (StringUtil::iequals (token, directive))
+      return true;
+
+    value.remove_prefix ((comma == std::string_view::npos) ? value.size() : comma + 1);
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+HttpResponseCache::HttpResponseCache (const HttpCacheConfig &config, bool autoETag):
+  _config { config },
+  _autoETag { autoETag }
+{
+  // empty
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::handle
+// ----------------------------------------------------------------------------
+void HttpResponseCache::handle (const HttpRequest &request, HttpResponse &response, const RequestHandler &handler) {
+  auto key { this->key (request) };
+  const auto now { std::chrono::steady_clock::now() };
+  std::shared_ptr<const HttpCachedResponse> cached;
+  std::shared_ptr<Flight> flight;
+
+  {
+    std::lock_guard lock { _mutex };
+
+    if (const auto it { _entries.find (key) }; it != _entries.end()) {
+      if (now < it->second.expires) {
+        _lru.splice (_lru.begin(), _lru, it->second.lru);
+        cached = it->second.response;
+      }
+      else {
+        _erase (it);
+      }
+    }
+
+    if (!cached) {
+      if (const auto it { _flights.find (key) }; it != _flights.end()) {
+        // the handler is already running for this key
+        it->second->waiters.push_back ({ &response, response.defer() });
+        return;
+      }
+
+      flight = std::make_shared<Flight>();
+      flight->key = std::move (key);
+      _flights.emplace (flight->key, flight);
+    }
+  }
+
+  if (cached) {
+    _replay (cached, response);
+    return;
+  }
+
+  // A deferred response lands when it is finished; if its responder is dropped
+  // instead, the guard lands the flight without a response.
+  auto factory { response.responderFactory() };
+
+  response.setResponderFactory ([ this, flight, factory, &response ] {
+    const std::shared_ptr<Flight> guard { flight.get(), [ this, flight ] (Flight *) { _land (flight, nullptr); } };
+    auto responder { factory() };
+    const auto executor { responder.executor() };
+
+    return HttpResponder {
+      executor,
+      [ this, guard, responder = std::move (responder), &response ] () mutable {
+        // a streamed response has been queued (and the response reset) already
+        _land (guard, (response.statusCode() != 0) ? &response : nullptr);
+        responder.finish();
+      }
+    };
+  });
+
+  try {
+    handler (request, response);
+  }
+  catch (...) {
+    response.setResponderFactory (std::move (factory));
+    _land (flight, nullptr);
+
+    throw;
+  }
+
+  response.setResponderFactory (std::move (factory));
+
+  // streamed responses are neither cached nor shared with the waiting requests
+  if (response.streaming())
+    _land (flight, nullptr);
+  else if (!response.deferred())
+    _land (flight, &response);
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::key
+// ----------------------------------------------------------------------------
+std::string HttpResponseCache::key (const HttpRequest &request) const {
+  std::string key;
+  key.reserve (request.path.size() + request.query.size() + 2);
+
+  key.push_back (static_cast<char> (request.method));
+  key.append (request.path);
+  key.push_back ('?');
+  key.append (request.query);
+
+  for (const auto &name: _config.varyHeaders) {
+    const auto value { request.headers.get (name) };
+
+    // a missing header is not the same as an empty one
+    key.push_back (value ? '\n' : '\0');
+    key.append (value.value_or (""));
+  }
+
+  return key;
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::_land
+// ----------------------------------------------------------------------------
+// Completes a flight: caches the response and hands it to the waiting requests, each
+// one on the thread of its connection. `response` is null if the handler failed.
+void HttpResponseCache::_land (const std::shared_ptr<Flight> &flight, HttpResponse *response) {
+  std::shared_ptr<const HttpCachedResponse> cached;
+  bool cacheable { false };
+  std::vector<Flight::Waiter> waiters;
+
+  {
+    std::lock_guard lock { _mutex };
+
+    // any copy of a deferred responder may finish, but only the first lands the flight
+    if (std::exchange (flight->landed, true))
+      return;
+  }
+
+  if (response) {
+    cached = _capture (*response, _autoETag);
+    cacheable = _cacheable (*response) && !cached->file;
+  }
+
+  {
+    std::lock_guard lock { _mutex };
+
+    _flights.erase (flight->key);
+    waiters.swap (flight->waiters);
+
+    if (cacheable)
+      _insert (flight->key, cached);
+  }
+
+  for (auto &waiter: waiters) {
+    const auto executor { waiter.responder.executor() };
+
+    asio::post (executor, [ cached, waiter = std::move (waiter) ] () mutable {
+      if (cached)
+        _replay (cached, *waiter.response);
+      else
+        waiter.response->status (503).send ("");
+
+      waiter.responder.finish();
+    });
+  }
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::_insert
+// ----------------------------------------------------------------------------
+void HttpResponseCache::_insert (const std::string &key, std::shared_ptr<const HttpCachedResponse> cached) {
+  const size_t size { key.size() + cached->size() };
+
+  if (size > _config.maxBytes)
+    return;
+
+  if (const auto it { _entries.find (key) }; it != _entries.end())
+    _erase (it);
+
+  _lru.push_front (key);
+  _entries.emplace (key, Entry { std::move (cached), std::chrono::steady_clock::now() + _config.ttl, _lru.begin() });
+  _bytes += size;
+
+  // responses still being written stay alive until then
+  while (_bytes > _config.maxBytes)
+    _erase (_entries.find (_lru.back()));
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::_erase
+// ----------------------------------------------------------------------------
+void HttpResponseCache::_erase (std::unordered_map<std::string, Entry>::iterator it) {
+  _bytes -= it->first.size() + it->second.response->size();
+  _lru.erase (it->second.lru);
+  _entries.erase (it);
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::_capture
+// ----------------------------------------------------------------------------
+// Copies the headers of a response and takes its body, which is given back to the
+// response as a shared one. An automatic ETag is added before, so the body is hashed
+// once rather than by every response served from the cache.
+std::shared_ptr<HttpCachedResponse> HttpResponseCache::_capture (HttpResponse &response, bool autoETag) {
+  auto cached { std::make_shared<HttpCachedResponse>() };
+  auto &headers { response.headers() };
+
+  cached->status = response.statusCode();
+
+  if (autoETag && (cached->status == 200) && !headers.contains (HttpHeaderName::kETag)) {
+    if (const auto body { response.body() }; !body.empty())
+      headers.set (HttpHeaderName::kETag, response.store (HttpConditional::etag (body)));
+  }
+
+  size_t size { 0 };
+  for (auto it = headers.cbegin(); it != headers.cend(); ++it)
+    size += it->name.size() + it->value.size();
+
+  // every connection adds its own Connection header
+  cached->headerData.reserve (size);
+  cached->headers.reserve (headers.size());
+
+  for (auto it = headers.cbegin(); it != headers.cend(); ++it) {
+    if (HttpHeader::lookup (it->name) == HttpHeaderName::kConnection)
+      continue;
+
+    const auto start { cached->headerData.size() };
+    cached->headerData.append (it->name).append (it->value);
+
+    const std::string_view data { cached->headerData };
+    cached->headers.push_back ({ data.substr (start, it->name.size()), data.substr (start + it->name.size(), it->value.size()) });
+  }
+
+  auto body { response.takeBody() };
+
+  if (body.file)
+    cached->file = std::move (body.file);
+  else if (body.shared)
+    cached->body = std::move (body.shared);
+  else
+    cached->body = std::make_shared<const std::string> (std::move (body.data));
+
+  // responses served from the cache share the compressed forms of the body too
+  cached->compressed = std::move (body.compressed);
+
+  if (!cached->compressed && !cached->file)
+    cached->compressed = std::make_shared<HttpCompressedBodies>();
+
+  if (cached->file)
+    response.send (cached->file, cached->compressed);
+  else
+    response.send (cached->body, cached->compressed);
+
+  return cached;
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::_cacheable
+// ----------------------------------------------------------------------------
+bool HttpResponseCache::_cacheable (const HttpResponse &response) {
+  const auto &headers { response.headers() };
+
+  if ((response.statusCode() != 200) || headers.contains (HttpHeaderName::kSetCookie))
+    return false;
+
+  if (const auto control { headers.get (HttpHeaderName::kCacheControl) }) {
+    if (hasDirective (*control, "no-store") || hasDirective (*control, "private"))
+      return false;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponseCache::_replay
+// ----------------------------------------------------------------------------
+// No copies: the headers point into the cached response, which the response keeps
+// alive until it has been written.
+void HttpResponseCache::_replay (const std::shared_ptr<const HttpCachedResponse> &cached, HttpResponse &response) {
+  auto &headers { response.headers() };
+
+  for (const auto &h: cached->headers)
+    headers.set (h.name, h.value);
+
+  response.status (cached->status);
+  response.retain (cached);
+
+  if (cached->file)
+    response.send (cached->file, cached->compressed);
+  else
+    response.send (cached->body, cached->compressed);
+}
+
+}
@@ -0,0 +1,308 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <array>
+#include <climits>
+#include <memory>
+
+#include <zlib.h>
+
+#include <lightning/http_compression.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// parseWeight
+// ----------------------------------------------------------------------------
+// Quality value ("q=0.5") in thousandths; 1000 if there is none
+static int parseWeight (std::string_view params) {
+  while (!params.empty()) {
+    const auto semicolon { params.find (';') };
+    const auto param { StringUtil::trim (params.substr (0, semicolon)) };
+
+    params.remove_prefix ((semicolon == std::string_view::npos) ? params.size() : semicolon + 1);
+
+    if ((param.size() < 3) || (StringUtil::toLower (param[0]) != 'q') || (param[1] != '='))
+      continue;
+
+    const auto value { param.substr (2) };
+    int weight { (value[0] == '1') ? 1000 : 0 };
+
+    // "0.xyz": the leading digits after the dot
+    if ((value[0] == '0') && (value.size() > 2) && (value[1] == '.')) {
+      int scale { 100 };
+
+      for (size_t i { 2 }; (i < value.size()) && (i < 5) && (value[i] >= '0') && (value[i] <= '9'); ++i, scale /= 10)
+        weight += (value[i] - '0') * scale;
+    }
+
+    return weight;
+  }
+
+  return 1000;
+}
+
+// ----------------------------------------------------------------------------
+// Deflaters
+// ----------------------------------------------------------------------------
+// Deflate streams and output buffer of an I/O thread
+class Deflaters {
+  public:
+    Deflaters() = default;
+
+    Deflaters (const Deflaters &) = delete;
+    Deflaters & operator= (const Deflaters &) = delete;
+
+    ~Deflaters() {
+      for (size_t i { 0 }; i < _streams.size(); ++i) {
+        if (_levels[i] != kNone)
+          ::deflateEnd (&_streams[i]);
+      }
+    }
+
+    /// @brief Stream ready to compress a new body
+    z_stream * stream (HttpCompression::Encoding encoding, int level) {
+      const size_t index { (encoding == HttpCompression::Encoding::kGzip) ? 0u : 1u };
+      auto &stream { _streams[index] };
+      auto &current { _levels[index] };
+
+      if (current == level)
+        return (::deflateReset (&stream) == Z_OK) ? &stream : nullptr;
+
+      if (current != kNone) {
+        ::deflateEnd (&stream);
+        current = kNone;
+      }
+
+      // 31: gzip wrapper, 15: zlib wrapper (the "deflate" coding)
+      const int windowBits { (index == 0) ? 31 : 15 };
+
+      stream = {};
+      if (::deflateInit2 (&stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return nullptr;
+
+      current = level;
+
+      return &stream;
+    }
+
+    /// @brief Output buffer of at least `size` bytes
+    Bytef * output (size_t size) {
+      if (size > _outputSize) {
+        _output = std::make_unique_for_overwrite<Bytef[]> (size);
+        _outputSize = size;
+      }
+
+      return _output.get();
+    }
+
+  private:
+    static constexpr int kNone { INT_MIN }; // level of a stream not initialized
+
+    std::array<z_stream, 2> _streams {};
+    std::array<int, 2> _levels { kNone, kNone };
+    std::unique_ptr<Bytef[]> _output;
+    size_t _outputSize { 0 };
+};
+
+// ----------------------------------------------------------------------------
+// HttpCompression::apply
+// ----------------------------------------------------------------------------
+void HttpCompression::apply (const HttpRequest &request, HttpResponse &response, const HttpConfig &config) {
+  const auto status { response.statusCode() };
+
+  if ((status < 200) || (status == 204) || (status == 206) || (status == 304))
+    return;
+
+  auto &headers { response.headers() };
+
+  if (headers.contains (HttpHeaderName::kContentEncoding) || headers.contains (HttpHeaderName::kContentLength))
+    return;
+
+  // bodies sent with sendfile(2) are not in memory, and the bytes of a mapped file are only
+  // compressed into its own store, not again for every response
+  const auto body { response.body() };
+  const auto &bodies { response.compressedBodies() };
+
+  if ((body.size() < config.compressionMinSize) || (body.size() != response.contentSize()))
+    return;
+
+  if (response.fileBody() && !bodies)
+    return;
+
+  const auto contentType { headers.get (HttpHeaderName::kContentType) };
+
+  if (!contentType || !compressible (*contentType, config.compressionTypes))
+    return;
+
+  // from now on, the response depends on the Accept-Encoding of the request
+  if (const auto vary { headers.get (HttpHeaderName::kVary) }) {
+    if (!StringUtil::hasToken (*vary, "accept-encoding") && !StringUtil::hasToken (*vary, "*"))
+      headers.set (HttpHeaderName::kVary, response.store (std::string { *vary } + ", Accept-Encoding"));
+  }
+  else {
+    headers.set (HttpHeaderName::kVary, "Accept-Encoding");
+  }
+
+  const auto acceptEncoding { request.headers.get (HttpHeaderName::kAcceptEncoding) };
+  const auto encoding { acceptEncoding ? negotiate (*acceptEncoding) : Encoding::kIdentity };
+
+  if (encoding == Encoding::kIdentity)
+    return;
+
+  std::shared_ptr<const std::string> shared;
+  std::string compressed;
+
+  if (bodies) {
+    shared = bodies->get (encoding, body, config.compressionLevel);
+
+    if (!shared)
+      return;
+  }
+  else if (!compress (encoding, body, config.compressionLevel, compressed)) {
+    return;
+  }
+
+  headers.set (HttpHeaderName::kContentEncoding, name (encoding));
+
+  // the compressed bytes are not the ones the strong validator stands for
+  if (const auto etag { headers.get (HttpHeaderName::kETag) }; etag && !etag->starts_with ("W/"))
+    headers.set (HttpHeaderName::kETag, response.store ("W/" + std::string { *etag }));
+
+  if (shared)
+    response.send (std::move (shared));
+  else
+    response.send (std::move (compressed));
+}
+
+// ----------------------------------------------------------------------------
+// HttpCompression::negotiate
+// ----------------------------------------------------------------------------
+HttpCompression::Encoding HttpCompression::negotiate (std::string_view acceptEncoding) {
+  int gzip { -1 };
+  int deflate { -1 };
+  int any { -1 };
+
+  while (!acceptEncoding.empty()) {
+    const auto comma { acceptEncoding.find (',') };
+    const auto element { acceptEncoding.substr (0, comma) };
+    const auto semicolon { element.find (';') };
+    const auto coding { StringUtil::trim (element.substr (0, semicolon)) };
+    const int weight { (semicolon == std::string_view::npos) ? 1000 : parseWeight (element.substr (semicolon + 1)) };
+
+    if (StringUtil::iequals (coding, "gzip") || StringUtil::iequals (coding, "x-gzip"))
+      gzip = weight;
+    else if (StringUtil::iequals (coding, "deflate"))
+      deflate = weight;
+    else if (coding == "*")
+      any = weight;
+
+    acceptEncoding.remove_prefix ((comma == std::string_view::npos) ? acceptEncoding.size() : comma + 1);
+  }
+
+  if (gzip < 0)
+    gzip = any;
+
+  if (deflate < 0)
+    deflate = any;
+
+  if ((gzip > 0) && (gzip >= deflate))
+    return Encoding::kGzip;
+
+  return (deflate > 0) ? Encoding::kDeflate : Encoding::kIdentity;
+}
+
+// ----------------------------------------------------------------------------
+// HttpCompression::compressible
+// ----------------------------------------------------------------------------
+bool HttpCompression::compressible (std::string_view contentType, const std::vector<std::string> &types) {
+  for (const auto &type: types) {
+    if ((contentType.size() >= type.size()) && StringUtil::iequals (contentType.substr (0, type.size()), type))
+      return true;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// HttpCompression::compress
+// ----------------------------------------------------------------------------
+bool HttpCompression::compress (Encoding encoding, std::string_view data, int level, std::string &out) {
+  static thread_local Deflaters deflaters;
+
+  if ((encoding == Encoding::kIdentity) || (data.size() > UINT_MAX))
+    return false;
+
+  auto *stream { deflaters.stream (encoding, level) };
+  if (!stream)
+    return false;
+
+  // a single call, into a buffer big enough for the worst case
+  const auto bound { ::deflateBound (stream, static_cast<uLong> (data.size())) };
+  auto *output { deflaters.output (bound) };
+
+  stream->next_in = reinterpret_cast<Bytef *> (const_cast<char *> (data.data()));
+  stream->avail_in = static_cast<uInt> (data.size());
+  stream->next_out = output;
+  stream->avail_out = static_cast<uInt> (bound);
+
+  if ((::deflate (stream, Z_FINISH) != Z_STREAM_END) || (stream->total_out >= data.size()))
+    return false;
+
+  out.assign (reinterpret_cast<const char *> (output), stream->total_out);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// HttpCompressedBodies::get
+// ----------------------------------------------------------------------------
+// The body is compressed without the mutex locked: two responses that need the same
+// coding at once may both compress it, and the first one is kept.
+std::shared_ptr<const std::string> HttpCompressedBodies::get (HttpCompression::Encoding encoding, std::string_view data, int level) {
+  if (encoding == HttpCompression::Encoding::kIdentity)
+    return nullptr;
+
+  auto &slot { _slots[(encoding == HttpCompression::Encoding::kGzip) ? 0 : 1] };
+
+  {
+    std::lock_guard lock { _mutex };
+
+    if (slot.tried)
+      return slot.body;
+  }
+
+  std::string compressed;
+  std::shared_ptr<const std::string> body;
+
+  if (HttpCompression::compress (encoding, data, level, compressed))
+    body = std::make_shared<const std::string> (std::move (compressed));
+
+  std::lock_guard lock { _mutex };
+
+  if (!slot.tried) {
+    slot.body = std::move (body);
+    slot.tried = true;
+  }
+
+  return slot.body;
+}
+
+// ----------------------------------------------------------------------------
+// HttpCompression::name
+// ----------------------------------------------------------------------------
+std::string_view HttpCompression::name (Encoding encoding) {
+  switch (encoding) {
+    case Encoding::kGzip: return "gzip";
+    case Encoding::kDeflate: return "deflate";
+    case Encoding::kIdentity: break;
+  }
+
+  return "identity";
+}
+
+}
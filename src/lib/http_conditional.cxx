@@ -0,0 +1,429 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+#include <lightning/http_conditional.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// parseNumber
+// ----------------------------------------------------------------------------
+// Digits only: the whole string must be a number.
+template<typename T>
+static std::optional<T> parseNumber (std::string_view s) {
+  T value {};
+
+  if (s.empty())
+    return std::nullopt;
+
+  const auto [ end, ec ] { std::from_chars (s.data(), s.data() + s.size(), value) };
+
+  if ((ec != std::errc {}) || (end != s.data() + s.size()))
+    return std::nullopt;
+
+  return value;
+}
+
+// ----------------------------------------------------------------------------
+// appendNumber
+// ----------------------------------------------------------------------------
+static void appendNumber (std::string &out, uint64_t value) {
+  char buffer[24];
+  const auto end { std::to_chars (std::begin (buffer), std::end (buffer), value).ptr };
+
+  out.append (buffer, end);
+}
+
+// ----------------------------------------------------------------------------
+// appendHash
+// ----------------------------------------------------------------------------
+// Fixed width: 16 hexadecimal digits
+static void appendHash (std::string &out, uint64_t hash) {
+  char buffer[16];
+  const auto end { std::to_chars (std::begin (buffer), std::end (buffer), hash, 16).ptr };
+
+  out.append (std::end (buffer) - end, '0').append (buffer, end);
+}
+
+// ----------------------------------------------------------------------------
+// contentRange
+// ----------------------------------------------------------------------------
+static std::string contentRange (const HttpResponseBody::Range &range, uint64_t size) {
+  std::string value { "bytes " };
+
+  appendNumber (value, range.offset);
+  value.push_back ('-');
+  appendNumber (value, range.offset + range.length - 1);
+  value.push_back ('/');
+  appendNumber (value, size);
+
+  return value;
+}
+
+// ----------------------------------------------------------------------------
+// opaqueTag
+// ----------------------------------------------------------------------------
+// An entity tag without its weakness indicator
+static std::string_view opaqueTag (std::string_view etag) {
+  return etag.starts_with ("W/") ? etag.substr (2) : etag;
+}
+
+// ----------------------------------------------------------------------------
+// replaceLength
+// ----------------------------------------------------------------------------
+// A Content-Length set by the handler stands for the whole body, so it is replaced
+// by the length of what is sent instead (the ranges, or nothing)
+static void replaceLength (HttpResponse &response, uint64_t length) {
+  auto &headers { response.headers() };
+
+  if (!headers.contains (HttpHeaderName::kContentLength))
+    return;
+
+  std::string value;
+  appendNumber (value, length);
+
+  headers.set (HttpHeaderName::kContentLength, response.store (value));
+}
+
+// ----------------------------------------------------------------------------
+// HttpConditional::evaluate
+// ----------------------------------------------------------------------------
+void HttpConditional::evaluate (const HttpRequest &request, HttpResponse &response, bool autoETag) {
+  auto &headers { response.headers() };
+
+  if (autoETag && !headers.contains (HttpHeaderName::kETag)) {
+    if (const auto body { response.body() }; !body.empty())
+      headers.set (HttpHeaderName::kETag, response.store (etag (body)));
+  }
+
+  const auto etag { headers.get (HttpHeaderName::kETag).value_or ("") };
+  const auto lastModified { headers.get (HttpHeaderName::kLastModified) };
+
+  // If-Modified-Since is only evaluated without If-None-Match
+  bool notModified { false };
+
+  if (const auto ifNoneMatch { request.headers.get (HttpHeaderName::kIfNoneMatch) }) {
+    notModified = matchesAny (*ifNoneMatch, etag);
+  }
+  else if (const auto ifModifiedSince { request.headers.get (HttpHeaderName::kIfModifiedSince) }; ifModifiedSince && lastModified) {
+    const auto since { parseDate (*ifModifiedSince) };
+    const auto modified { parseDate (*lastModified) };
+
+    notModified = since && modified && (*modified <= *since);
+  }
+
+  if (notModified) {
+    response.status (304);
+    response.discardBody();
+
+    return;
+  }
+
+  const auto range { request.headers.get (HttpHeaderName::kRange) };
+
+  if (!range || (request.method != HttpMethod::kGet))
+    return;
+
+  // the ranges are only sent if the representation is the one the client has part of
+  if (const auto ifRange { request.headers.get (HttpHeaderName::kIfRange) }) {
+    bool matches { false };
+
+    if (ifRange->starts_with ('"') || ifRange->starts_with ("W/")) {
+      matches = !etag.empty() && !etag.starts_with ("W/") && (*ifRange == etag);
+    }
+    else if (lastModified) {
+      const auto date { parseDate (*ifRange) };
+      const auto modified { parseDate (*lastModified) };
+
+      matches = date && modified && (*date == *modified);
+    }
+
+    if (!matches)
+      return;
+  }
+
+  const uint64_t size { response.contentSize() };
+  auto ranges { parseRanges (*range, size) };
+
+  if (!ranges)
+    return;
+
+  if (ranges->empty()) {
+    std::string value { "bytes */" };
+    appendNumber (value, size);
+
+    headers.set (HttpHeaderName::kContentRange, response.store (value));
+    response.status (416);
+    response.discardBody();
+    replaceLength (response, 0);
+
+    return;
+  }
+
+  response.status (206);
+
+  if (ranges->size() == 1) {
+    headers.set (HttpHeaderName::kContentRange, response.store (contentRange (ranges->front(), size)));
+    replaceLength (response, ranges->front().length);
+    response.setRanges (std::move (*ranges), {});
+
+    return;
+  }
+
+  // multipart/byteranges: every range is preceded by its own headers
+  std::string boundary { "lightning-" };
+  appendHash (boundary, hash (etag) ^ size);
+
+  const std::string contentType { headers.get (HttpHeaderName::kContentType).value_or ("application/octet-stream") };
+  std::string framing;
+
+  for (auto &r: *ranges) {
+    framing.append ("\r\n--").append (boundary);
+    framing.append ("\r\ncontent-type: ").append (contentType);
+    framing.append ("\r\ncontent-range: ").append (contentRange (r, size));
+    framing.append ("\r\n\r\n");
+
+    r.framingEnd = framing.size();
+  }
+
+  framing.append ("\r\n--").append (boundary).append ("--\r\n");
+
+  uint64_t length { framing.size() };
+  for (const auto &r: *ranges)
+    length += r.length;
+
+  replaceLength (response, length);
+
+  headers.set (HttpHeaderName::kContentType, response.store ("multipart/byteranges; boundary=" + boundary));
+  response.setRanges (std::move (*ranges), std::move (framing));
+}
+
+// ----------------------------------------------------------------------------
+// HttpConditional::hash
+// ----------------------------------------------------------------------------
+// xxHash64 algorithm: four independent lanes consume 32 bytes per iteration.
+uint64_t HttpConditional::hash (std::string_view data) {
+  constexpr uint64_t kPrime1 { 0x9e3779b185ebca87 };
+  constexpr uint64_t kPrime2 { 0xc2b2ae3d27d4eb4f };
+  constexpr uint64_t kPrime3 { 0x165667b19e3779f9 };
+  constexpr uint64_t kPrime4 { 0x85ebca77c2b2ae63 };
+  constexpr uint64_t kPrime5 { 0x27d4eb2f165667c5 };
+
+  const auto read64 = [] (const char *p) { uint64_t v; std::memcpy (&v, p, sizeof (v)); return v; };
+  const auto read32 = [] (const char *p) { uint32_t v; std::memcpy (&v, p, sizeof (v)); return v; };
+
+  const auto round = [] (uint64_t acc, uint64_t input) {
+    return std::rotl (acc + input * kPrime2, 31) * kPrime1;
+  };
+
+  const auto merge = [ &round ] (uint64_t acc, uint64_t lane) {
+    return (acc ^ round (0, lane)) * kPrime1 + kPrime4;
+  };
+
+  const char *p { data.data() };
+  const char *const end { p + data.size() };
+  uint64_t h;
+
+  if (data.size() >= 32) {
+    uint64_t v1 { kPrime1 + kPrime2 };
+    uint64_t v2 { kPrime2 };
+    uint64_t v3 { 0 };
+    uint64_t v4 { 0 - kPrime1 };
+
+    for (; p + 32 <= end; p += 32) {
+      v1 = round (v1, read64 (p));
+      v2 = round (v2, read64 (p + 8));
+      v3 = round (v3, read64 (p + 16));
+      v4 = round (v4, read64 (p + 24));
+    }
+
+    h = std::rotl (v1, 1) + std::rotl (v2, 7) + std::rotl (v3, 12) + std::rotl (v4, 18);
+    h = merge (h, v1);
+    h = merge (h, v2);
+    h = merge (h, v3);
+    h = merge (h, v4);
+  }
+  else {
+    h = kPrime5;
+  }
+
+  h += data.size();
+
+  for (; p + 8 <= end; p += 8)
+    h = std::rotl (h ^ round (0, read64 (p)), 27) * kPrime1 + kPrime4;
+
+  if (p + 4 <= end) {
+    h = std::rotl (h ^ (read32 (p) * kPrime1), 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+
+  for (; p < end; ++p)
+    h = std::rotl (h ^ (static_cast<uint8_t> (*p) * kPrime5), 11) * kPrime1;
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConditional::etag
+// ----------------------------------------------------------------------------
+std::string HttpConditional::etag (std::string_view body) {
+  std::string value { "\"" };
+  appendHash (value, hash (body));
+  value.push_back ('"');
+
+  return value;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConditional::parseDate
+// ----------------------------------------------------------------------------
+std::optional<int64_t> HttpConditional::parseDate (std::string_view date) {
+  static constexpr std::array<std::string_view, 12> kMonths {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+  };
+
+  // "Sun, 06 Nov 1994 08:49:37 GMT"
+  if ((date.size() != 29) || (date.substr (3, 2) != ", ") || !date.ends_with (" GMT"))
+    return std::nullopt;
+
+  const auto month { std::find (kMonths.begin(), kMonths.end(), date.substr (8, 3)) };
+  const auto day { parseNumber<unsigned> (date.substr (5, 2)) };
+  const auto year { parseNumber<int> (date.substr (12, 4)) };
+  const auto hours { parseNumber<int> (date.substr (17, 2)) };
+  const auto minutes { parseNumber<int> (date.substr (20, 2)) };
+  const auto seconds { parseNumber<int> (date.substr (23, 2)) };
+
+  if ((month == kMonths.end()) || !day || !year || !hours || !minutes || !seconds)
+    return std::nullopt;
+
+  const std::chrono::year_month_day ymd {
+    std::chrono::year { *year },
+    std::chrono::month { static_cast<unsigned> (month - kMonths.begin() + 1) },
+    std::chrono::day { *day }
+  };
+
+  if (!ymd.ok() || (*hours > 23) || (*minutes > 59) || (*seconds > 60))
+    return std::nullopt;
+
+  const auto days { std::chrono::sys_days { ymd }.time_since_epoch().count() };
+
+  return static_cast<int64_t> (days) * 86400 + *hours * 3600 + *minutes * 60 + *seconds;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConditional::parseRanges
+// ----------------------------------------------------------------------------
+std::optional<std::vector<HttpResponseBody::Range>> HttpConditional::parseRanges (std::string_view value, uint64_t size) {
+  constexpr std::string_view kUnit { "bytes=" };
+
+  if ((value.size() < kUnit.size()) || !StringUtil::iequals (value.substr (0, kUnit.size()), kUnit))
+    return std::nullopt;
+
+  value.remove_prefix (kUnit.size());
+
+  std::vector<HttpResponseBody::Range> ranges;
+  bool valid { false }; // at least one range specification
+
+  while (!value.empty()) {
+    const auto comma { value.find (',') };
+    const auto spec { StringUtil::trim (value.substr (0, comma)) };
+
+    value.remove_prefix ((comma == std::string_view::npos) ? value.size() : comma + 1);
+
+    if (spec.empty())
+      continue;
+
+    const auto dash { spec.find ('-') };
+    if (dash == std::string_view::npos)
+      return std::nullopt;
+
+    const auto first { spec.substr (0, dash) };
+    const auto last { spec.substr (dash + 1) };
+    uint64_t start, end;
+
+    if (first.empty()) {
+      // suffix: the last N bytes
+      const auto length { parseNumber<uint64_t> (last) };
+      if (!length)
+        return std::nullopt;
+
+      valid = true;
+
+      if ((*length == 0) || (size == 0))
+        continue;
+
+      start = size - std::min (*length, size);
+      end = size - 1;
+    }
+    else {
+      const auto a { parseNumber<uint64_t> (first) };
+      const auto b { last.empty() ? std::optional<uint64_t> { UINT64_MAX } : parseNumber<uint64_t> (last) };
+
+      if (!a || !b || (*b < *a))
+        return std::nullopt;
+
+      valid = true;
+
+      if (*a >= size)
+        continue;
+
+      start = *a;
+      end = std::min (*b, size - 1);
+    }
+
+    if (ranges.size() == kMaxRanges)
+      return std::nullopt;
+
+    ranges.push_back ({ start, end - start + 1, 0 });
+  }
+
+  if (!valid)
+    return std::nullopt;
+
+  return ranges;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConditional::matchesAny
+// ----------------------------------------------------------------------------
+bool HttpConditional::matchesAny (std::string_view list, std::string_view etag) {
+  if (etag.empty())
+    return false;
+
+  if (StringUtil::trim (list) == "*")
+    return true;
+
+  const auto tag { opaqueTag (etag) };
+
+  while (!list.empty()) {
+    const auto comma { list.find (',') };
+
+    if (opaqueTag (StringUtil::trim (list.substr (0, comma))) == tag)
+      return true;
+
+    list.remove_prefix ((comma == std::string_view::npos) ? list.size() : comma + 1);
+  }
+
+  return false;
+}
+
+}
@@ -3,26 +3,182 @@
 //
 // Copyright (c) 2024 Carlos Carrasco
 // ----------------------------------------------------------------------------
+#include <cerrno>
+#include <charconv>
 #include <sstream>
 #include <algorithm>
 #include <iterator>
 #include <string>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
 #include <asio.hpp>
 
+#include <lightning/http_compression.h>
+#include <lightning/http_conditional.h>
 #include <lightning/http_connection.h>
+#include <lightning/string_util.h>
 
 
 namespace lightning {
 
+// ----------------------------------------------------------------------------
+// HttpConnection::_readSome
+// ----------------------------------------------------------------------------
+template<typename Handler>
+void HttpConnection::_readSome (asio::mutable_buffer buffer, Handler &&handler) {
+  if (_tls)
+    _tls->async_read_some (buffer, std::forward<Handler> (handler));
+  else if (_ring)
+    _ring->receive (_socket.native_handle(), buffer, std::forward<Handler> (handler));
+  else
+    _socket.async_read_some (buffer, std::forward<Handler> (handler));
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_writeAll
+// ----------------------------------------------------------------------------
+template<typename Handler>
+void HttpConnection::_writeAll (std::span<const asio::const_buffer> buffers, Handler &&handler) {
+  if (_tls)
+    asio::async_write (*_tls, buffers, std::forward<Handler> (handler));
+  else if (_ring)
+    _ring->send (_socket.native_handle(), buffers, std::forward<Handler> (handler));
+  else
+    asio::async_write (_socket, buffers, std::forward<Handler> (handler));
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::reuse
+// ----------------------------------------------------------------------------
+void HttpConnection::reuse (asio::ip::tcp::socket &&socket) {
+  _socket = std::move (socket);
+
+  if (_tls)
+    _tls->reset();
+
+  _inputBuffer.clear (_config.get().inputBufferSize);
+  _outputBuffer.clear();
+  _queued.clear();
+  _requests = 0;
+  _closing = false;
+  _deadline = Deadline::kNone;
+  _fileOffset = 0;
+  _stream.reset();
+  _streamChunks.clear();
+  _streamedRequest = SIZE_MAX;
+  _wsFragmented = false;
+  _wsCloseCode = 1006;
+  _request.reset();
+  _response.reset();
+  _arena.release();
+
+  _open();
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::close
+// ----------------------------------------------------------------------------
+void HttpConnection::close() {
+  // the wheel may shut the socket down from another thread until the deadline is cancelled
+  _setDeadline (Deadline::kNone);
+
+  if (_tls && _socket.is_open())
+    _tls->shutdown();
+
+  asio::error_code ignored;
+
+  // operations of the ring hold the socket: once submitted, the shutdown completes them
+  if (_ring && _socket.is_open()) {
+    _ring->submit();
+    _socket.shutdown (asio::ip::tcp::socket::shutdown_both, ignored);
+  }
+
+  _socket.close (ignored);
+
+  if (_stream)
+    _streamFailed (std::make_error_code (std::errc::broken_pipe));
+
+  // the handle (and so the connection) is released when the function returns
+  const auto webSocket { std::move (_webSocket) };
+
+  if (const auto handler { std::exchange (_wsHandler, nullptr) }; handler && handler->onClose) {
+    auto ws { webSocket };
+    handler->onClose (ws, _wsCloseCode);
+  }
+
+  // a closed (or pooled) connection holds no buffer
+  _inputBuffer.release();
+  _wsMessage = {};
+  _fileBuffer = {};
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_open
+// ----------------------------------------------------------------------------
+void HttpConnection::_open() {
+  asio::error_code ec;
+
+  // responses are written whole, so there is nothing to gain from delaying small segments
+  _socket.set_option (asio::ip::tcp::no_delay (true), ec);
+
+  // resolved once, requests only keep a view of it
+  if (const auto endpoint { _socket.remote_endpoint (ec) }; !ec)
+    _ip = endpoint.address().to_string();
+  else
+    _ip.clear();
+
+  _request.initParser (_parser);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::start
+// ----------------------------------------------------------------------------
+void HttpConnection::start() {
+  if (_tls)
+    _handshake();
+  else
+    waitForHttpMessage();
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_handshake
+// ----------------------------------------------------------------------------
+// The handshake is limited by the header timeout, as the first request would be.
+void HttpConnection::_handshake() {
+  _setDeadline (Deadline::kHeaders);
+
+  _tls->async_handshake ([ this, ctx = shared_from_this() ] (std::error_code ec) {
+    if (ec) {
+      _logger.get().debug ("TLS handshake failed: {}", ec.message());
+      return close();
+    }
+
+    _logger.get().debug ("TLS handshake done, resumed={} ktls={}/{}", _tls->resumed(), _tls->kernelSend(), _tls->kernelReceive());
+
+    waitForHttpMessage();
+  });
+}
+
 // ----------------------------------------------------------------------------
 // HttpConnection::waitForHttpMessage
 // ----------------------------------------------------------------------------
 void HttpConnection::waitForHttpMessage() {
-  if (_inputBuffer.length() != 0) {
+  if (_closing) {
+    // Requests after the last one are ignored
+    _flush (true);
+  }
+  else if (!_inputBuffer.unparsed().empty()) {
     // If pipeline requests were sent by client then the beginning (or even entire request) of it
     // is in the buffer obtained from socket in previous read operation.
-    _consumeData (_inputBuffer.bytes(), _inputBuffer.length());
+    _consumeData();
+  }
+  else if (!_queued.empty()) {
+    // Responses are written before waiting for more requests
+    _flush();
   }
   else {
     // Next request (if any) must be obtained from socket
@@ -34,9 +190,60 @@ void HttpConnection::waitForHttpMessage() {
 // HttpConnection::_consumeMessage
 // ----------------------------------------------------------------------------
 void HttpConnection::_consumeMessage() {
-  _socket.async_read_some(
+  if (_inputBuffer.length() > 0) {
+    _setDeadline (_request.headersComplete() ? Deadline::kBody : Deadline::kHeaders);
+  }
+  else {
+    _setDeadline (_requests > 0 ? Deadline::kIdle : Deadline::kHeaders);
+
+    // Without a message in progress, the buffer is only taken when the client sends something:
+    // with io_uring, the kernel picks one of the ring as it arrives
+    if (_ring && _ring->providesBuffers()) {
+      _inputBuffer.release();
+
+      _ring->receiveProvided (_socket.native_handle(), [ this, ctx = shared_from_this() ] (std::error_code ec, std::string_view data) {
+        _afterIdleRead (ec, data);
+      });
+
+      return;
+    }
+
+    // otherwise, the connection waits for the socket to be readable (unless TLS has decrypted
+    // something already)
+    if (_config.get().releaseIdleBuffers && !(_tls && _tls->pending())) {
+      _inputBuffer.release();
+
+      _socket.async_wait(
+        asio::ip::tcp::socket::wait_read,
+        [ this, ctx = shared_from_this() ] (std::error_code ec) {
+          if (ec)
+            close();
+          else
+            _read();
+        }
+      );
+
+      return;
+    }
+  }
+
+  _read();
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_read
+// ----------------------------------------------------------------------------
+void HttpConnection::_read() {
+  const char *message { _inputBuffer.message() };
+
+  _inputBuffer.reserve();
+
+  if ((_inputBuffer.length() > 0) && (_inputBuffer.message() != message))
+    _request.rebase (message, _inputBuffer.message());
+
+  _readSome(
     _inputBuffer.makeAsioBuffer(),
-    [ this, ctx = shared_from_this() ] (auto ec, std::size_t length) {
+    [ this, ctx = shared_from_this() ] (std::error_code ec, std::size_t length) {
       this->_afterRead (ec, length);
     }
   );
@@ -48,71 +255,1003 @@ void HttpConnection::_consumeMessage() {
 void HttpConnection::_afterRead (const std::error_code &ec, std::size_t length) {
   if (!ec) {
     _inputBuffer.obtainedBytes (length);
-    _consumeData (_inputBuffer.bytes(), length);
+    _consumeData();
   }
   else {
-    _socket.close();
+    close();
   }
 }
 
+// ----------------------------------------------------------------------------
+// HttpConnection::_afterIdleRead
+// ----------------------------------------------------------------------------
+// The data, in a buffer of the ring as big as the input buffer, is copied to the input
+// buffer, and the one of the ring goes back to the kernel.
+void HttpConnection::_afterIdleRead (const std::error_code &ec, std::string_view data) {
+  // every buffer of the ring is in use
+  if (ec == std::errc::no_buffer_space)
+    return _read();
+
+  if (ec)
+    return close();
+
+  _inputBuffer.reserve();
+
+  const auto buffer { _inputBuffer.makeAsioBuffer() };
+  const size_t length { std::min (data.size(), buffer.size()) };
+
+  std::copy_n (data.data(), length, static_cast<char *> (buffer.data()));
+  _inputBuffer.obtainedBytes (length);
+
+  _consumeData();
+}
+
 // ----------------------------------------------------------------------------
 // HttpConnection::_consumeData
 // ----------------------------------------------------------------------------
-void HttpConnection::_consumeData (const char *data, std::size_t length) {
-  bool messageComplete = false;
-  const char *d = data;
+void HttpConnection::_consumeData() {
+  for (;;) {
+    // The next message begins: the previous one and its response are not referenced
+    // anymore, so the arena is released even if the buffer is never empty (pipelining).
+    if (_request.messageComplete()) {
+      _request.reset();
+      _arena.release();
+    }
 
-  // Assume "\r\n\r\n" - the end of message will never happened to be split in 2 read operations.
-  for (; d <= data + length - 4; ++d) {
-    if (d[0] == '\r' && d[1] == '\n' && d[2] == '\r' && d[3] == '\n') {
-      messageComplete = true;
-      break;
+    const std::string_view data { _inputBuffer.unparsed() };
+
+    // Only the bytes not seen yet are fed to the parser, which keeps its state between reads.
+    const llhttp_errno_t err { llhttp_execute (&_parser, data.data(), data.size()) };
+
+    if ((err == HPE_PAUSED) && !_request.messageComplete()) {
+      // The parser stops at the end of the headers, before the body.
+      _inputBuffer.parsedBytes (llhttp_get_error_pos (&_parser) - data.data());
+
+      if (!_beginBody())
+        return;
+
+      llhttp_resume (&_parser);
+    }
+    else if ((err == HPE_PAUSED) || (err == HPE_PAUSED_UPGRADE)) {
+      // The parser stops at the end of every message, leaving pipelined requests unparsed.
+      _inputBuffer.parsedBytes (llhttp_get_error_pos (&_parser) - data.data());
+
+      if (_request.streamingBody())
+        _inputBuffer.discardParsed (_bodyOffset);
+      else if (_request.body.size() > _config.get().maxBodySize)
+        return _writeError (413);
+
+      _request.ip = _ip;
+      _request.protocol = _tls ? ProtocolType::kHttps : ProtocolType::kHttp;
+
+      _response.reset();
+
+      _handling = true;
+      _route->handler (_request, _response);
+      _handling = false;
+
+      if (_response.webSocket())
+        return _beginWebSocket();
+
+      if (_response.streaming())
+        return _beginStream();
+
+      // a deferred response is queued when its responder finishes it
+      if (_response.deferred())
+        return _setDeadline (Deadline::kNone);
+
+      _completeMessage();
+
+      // responses of every complete request in the buffer are written together
+      if (_closing || _inputBuffer.unparsed().empty())
+        return _flush (_closing);
+    }
+    else if (err != HPE_OK) {
+      _logger.get().error ("HTTP parsing error: {} ({})", llhttp_errno_name (err), llhttp_get_error_reason (&_parser));
+
+      return _writeError (400);
+    }
+    else {
+      _inputBuffer.parsedBytes (data.size());
+
+      if (!_request.headersComplete()) {
+        if (_inputBuffer.length() > _config.get().maxHeaderSize) {
+          _logger.get().error ("HTTP parsing error: headers bigger than {} bytes", _config.get().maxHeaderSize);
+
+          return _writeError (431);
+        }
+      }
+      else if (_request.streamingBody()) {
+        // streamed bytes are not needed anymore, so memory does not grow with the body
+        _inputBuffer.discardParsed (_bodyOffset);
+      }
+      else if (_request.body.size() > _config.get().maxBodySize) {
+        return _writeError (413);
+      }
+
+      return _queued.empty() ? _consumeMessage() : _flush();
     }
   }
+}
 
-  if (messageComplete) {
-    HttpRequest request { _logger };
-    HttpResponse response;
+// ----------------------------------------------------------------------------
+// HttpConnection::_beginBody
+// ----------------------------------------------------------------------------
+// Called when the headers of a message have been parsed: the request is routed, so its
+// body can be streamed to the route. Returns false if parsing must not continue now.
+bool HttpConnection::_beginBody() {
+  _route = &_findRoute (_request);
+
+  if (_route->onBody) {
+    _request.streamBody (&_route->onBody);
+    _bodyOffset = _inputBuffer.parsedLength();
+  }
+  else if ((_parser.flags & F_CONTENT_LENGTH) && (_parser.content_length > _config.get().maxBodySize)) {
+    _writeError (413);
+    return false;
+  }
+
+  const auto expect { _request.headers.get (HttpHeaderName::kExpect) };
+
+  if (expect && StringUtil::iequals (*expect, "100-continue") && (_request.version.minor > 0)) {
+    // written, after the responses of previous requests, once the parser needs the body
+    _outputBuffer.append ("HTTP/1.1 100 Continue\r\n\r\n");
+    _queued.push_back ({ _outputBuffer.size(), {} });
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_completeMessage
+// ----------------------------------------------------------------------------
+void HttpConnection::_completeMessage() {
+  const auto maxRequests { _config.get().maxRequestsPerConnection };
+  const auto connection { _response.headers().get (HttpHeaderName::kConnection) };
 
-    _inputBuffer.consumedBytes (d - data + 4);
+  // HTTP/1.1 connections persist unless "Connection: close" is sent (by the client or
+  // the handler); HTTP/1.0 ones only with "Connection: keep-alive".
+  ++_requests;
 
-    request.parse (_inputBuffer.str());
+  _closing = !llhttp_should_keep_alive (&_parser) ||
+    ((maxRequests > 0) && (_requests >= maxRequests)) ||
+    (connection && StringUtil::iequals (*connection, "close"));
 
-    request.ip = _socket.remote_endpoint().address().to_string();
-    request.protocol = ProtocolType::kHttp; // FIXME: support more protocols
+  // an upgraded connection ends with the new protocol (its handshake says "Connection: Upgrade")
+  if (_response.webSocket())
+    _closing = true;
+  else if (_closing)
+    _response.headers().set (HttpHeaderName::kConnection, "close");
+  else if (_request.version.minor == 0)
+    _response.headers().set (HttpHeaderName::kConnection, "keep-alive");
 
-    _onReceivedRequest (request, response);
+  // a streamed body is not known yet
+  if (!_response.streaming()) {
+    if (((_request.method == HttpMethod::kGet) || (_request.method == HttpMethod::kHead)) && (_response.statusCode() == 200))
+      HttpConditional::evaluate (_request, _response, _config.get().autoETag);
 
-    _writeResponseMessage (response);
+    if (_config.get().compression)
+      HttpCompression::apply (_request, _response, _config.get());
   }
-  else {
-    _inputBuffer.consumedBytes (length);
-    _consumeMessage();
+
+  _queueResponse();
+
+  // The message is not referenced anymore; the request itself (and the arena) is reset
+  // when the next message begins.
+  _inputBuffer.consumedBytes();
+
+  if (llhttp_get_errno (&_parser) == HPE_PAUSED_UPGRADE)
+    llhttp_resume_after_upgrade (&_parser);
+  else
+    llhttp_resume (&_parser);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_setDeadline
+// ----------------------------------------------------------------------------
+// The header and idle deadlines cover the whole wait, however many reads it takes;
+// the body deadline is renewed by every read and the write one by every flush.
+void HttpConnection::_setDeadline (Deadline deadline) {
+  if ((deadline == _deadline) && ((deadline == Deadline::kHeaders) || (deadline == Deadline::kIdle)))
+    return;
+
+  const auto &config { _config.get() };
+  std::chrono::milliseconds timeout { 0 };
+
+  switch (deadline) {
+    case Deadline::kHeaders: timeout = config.headerTimeout; break;
+    case Deadline::kBody: timeout = config.bodyTimeout; break;
+    case Deadline::kIdle: timeout = config.keepAliveTimeout; break;
+    case Deadline::kWrite: timeout = config.writeTimeout; break;
+    case Deadline::kNone: break;
   }
+
+  if (timeout.count() > 0)
+    _timers.get().schedule (_timeout, timeout);
+  else if (_deadline != Deadline::kNone)
+    _timers.get().cancel (_timeout);
+
+  _deadline = deadline;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_expired
+// ----------------------------------------------------------------------------
+// Called by the timing wheel, possibly from another thread, so the socket is only shut
+// down: the pending read or write fails and the connection is closed by its own handler.
+void HttpConnection::_expired() {
+  _logger.get().debug ("connection timed out");
+
+  asio::error_code ignored;
+  _socket.shutdown (asio::ip::tcp::socket::shutdown_both, ignored);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_makeResponder
+// ----------------------------------------------------------------------------
+HttpResponder HttpConnection::_makeResponder() {
+  const auto executor { _socket.get_executor() };
+
+  // the write is posted, so it never runs inside the handler nor outside the connection's thread
+  return HttpResponder {
+    executor,
+    [ executor, ctx = shared_from_this(), request = _requests ] {
+      asio::post (executor, [ ctx, request ] {
+        // another copy of the responder has finished the request already, or a response
+        // streamed by the handler has been queued
+        if ((ctx->_requests != request) || (ctx->_streamedRequest == request))
+          return;
+
+        ctx->_completeMessage();
+        ctx->waitForHttpMessage();
+      });
+    }
+  };
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_writeError
+// ----------------------------------------------------------------------------
+void HttpConnection::_writeError (uint32_t status) {
+  _response.reset();
+  _response.headers().set (HttpHeaderName::kConnection, "close");
+  _response.status (status).send ("");
+
+  _queueResponse();
+  _flush (true);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_queueResponse
+// ----------------------------------------------------------------------------
+void HttpConnection::_queueResponse() {
+  _response.serialize (_outputBuffer);
+
+  // a HEAD response has the headers of the GET one (its Content-Length included), never a body
+  if (_request.method == HttpMethod::kHead)
+    _response.discardBody();
+
+  _queued.push_back ({ _outputBuffer.size(), _response.takeBody() });
+
+  _response.reset();
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_flush
+// ----------------------------------------------------------------------------
+// Writes every queued response: header blocks and bodies are owned by the connection
+// until they have been written.
+void HttpConnection::_flush (bool close) {
+  _logger.get().verbose ("sending {} responses ...\n{}", _queued.size(), _outputBuffer);
+
+  _setDeadline (Deadline::kWrite);
+
+  _write (0, 0, close);
 }
 
 // ----------------------------------------------------------------------------
-// HttpConnection::_writeResponseMessage
+// HttpConnection::_write
 // ----------------------------------------------------------------------------
-void HttpConnection::_writeResponseMessage (const HttpResponse &response) {
-  const std::string data { response.data() };
+// Writes the queued responses from range `range` of response `first` on with a single
+// gather write, up to the first range of a body that is sent from a file (which follows
+// its header block and framing).
+void HttpConnection::_write (size_t first, size_t range, bool close) {
+  const std::string_view output { _outputBuffer };
+  size_t index { first };
+  bool sendFile { false };
+
+  const auto push = [ this ] (std::string_view data) {
+    if (!data.empty())
+      _writeBuffers.push_back (asio::buffer (data.data(), data.size()));
+  };
+
+  _writeBuffers.clear();
+
+  while (index < _queued.size()) {
+    const auto &q { _queued[index] };
+    const std::string_view framing { q.body.framing };
+    const auto content { q.body.view() };
+
+    if (range == 0) {
+      const size_t start { (index > 0) ? _queued[index - 1].headersEnd : 0 };
+      push (output.substr (start, q.headersEnd - start));
+    }
+
+    for (; range < q.body.rangeCount(); ++range) {
+      const auto r { q.body.range (range) };
+      const size_t framingStart { (range > 0) ? q.body.range (range - 1).framingEnd : 0 };
+
+      push (framing.substr (framingStart, r.framingEnd - framingStart));
+
+      if (q.body.sendFile())
+        break;
 
-  _logger.get().verbose ("sending response ...\n{}", data);
+      push (content.substr (r.offset, r.length));
+    }
+
+    if (range < q.body.rangeCount()) {
+      sendFile = true;
+      break;
+    }
+
+    push (framing.substr (q.body.ranges.empty() ? 0 : q.body.ranges.back().framingEnd));
+
+    ++index;
+    range = 0;
+  }
 
-  asio::async_write(
-    _socket,
-    asio::buffer (data.data(), data.size()),
-    [ this, ctx = shared_from_this() ] (std::error_code ec, std::size_t) {
+  if (_writeBuffers.empty()) {
+    if (sendFile)
+      _sendFile (index, range, close);
+    else
+      _written (close);
+
+    return;
+  }
+
+  _writeAll(
+    _writeBuffers,
+    [ this, ctx = shared_from_this(), index, range, sendFile, close ] (std::error_code ec, std::size_t) {
       if (ec) {
         if (ec != asio::error::operation_aborted)
-          _socket.close();
+          this->close();
+      }
+      else if (sendFile) {
+        _sendFile (index, range, close);
       }
       else {
-        ctx->waitForHttpMessage();
+        _written (close);
+      }
+    }
+  );
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_sendFile
+// ----------------------------------------------------------------------------
+// Sends a range of the file body of a response with sendfile(2), from the kernel's page
+// cache straight to the socket (encrypted by the kernel, with kTLS). The write deadline
+// is renewed whenever the socket becomes writable again, so it limits stalls rather
+// than the whole transfer.
+void HttpConnection::_sendFile (size_t index, size_t range, bool close) {
+#ifdef __linux__
+  if (_tls && !_tls->kernelSend())
+    return _readFile (index, range, close);
+
+  const auto &body { _queued[index].body };
+  const auto r { body.range (range) };
+
+  if (!_socket.native_non_blocking()) {
+    asio::error_code ignored;
+    _socket.native_non_blocking (true, ignored);
+  }
+
+  while (_fileOffset < r.length) {
+    off_t offset { static_cast<off_t> (r.offset + _fileOffset) };
+    const ssize_t n {
+      _tls ? _tls->sendFile (body.file->fd(), offset, r.length - _fileOffset)
+           : ::sendfile (_socket.native_handle(), body.file->fd(), &offset, r.length - _fileOffset)
+    };
+
+    if (n > 0) {
+      _fileOffset += static_cast<uint64_t> (n);
+    }
+    else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      _setDeadline (Deadline::kWrite);
+
+      _socket.async_wait(
+        asio::ip::tcp::socket::wait_write,
+        [ this, ctx = shared_from_this(), index, range, close ] (std::error_code ec) {
+          if (!ec)
+            _sendFile (index, range, close);
+          else if (ec != asio::error::operation_aborted)
+            this->close();
+        }
+      );
+
+      return;
+    }
+    else if ((n < 0) && (errno == EINTR)) {
+      continue;
+    }
+    else {
+      // the peer is gone, or the file has been truncated since it was opened
+      _logger.get().debug ("sendfile failed, sent={} length={}", _fileOffset, r.length);
+
+      return this->close();
+    }
+  }
+
+  _fileOffset = 0;
+#endif
+
+  _write (index, range + 1, close);
+}
+
+#ifdef __linux__
+// ----------------------------------------------------------------------------
+// HttpConnection::_readFile
+// ----------------------------------------------------------------------------
+// Without kTLS, records are encrypted in user space: a file range is read into a
+// buffer, piece by piece, and written through the TLS stream.
+void HttpConnection::_readFile (size_t index, size_t range, bool close) {
+  constexpr uint64_t kPieceSize { 64 * 1024 };
+
+  const auto &body { _queued[index].body };
+  const auto r { body.range (range) };
+
+  if (_fileOffset == r.length) {
+    _fileOffset = 0;
+    return _write (index, range + 1, close);
+  }
+
+  _fileBuffer.resize (static_cast<size_t> (std::min (kPieceSize, r.length - _fileOffset)));
+
+  const ssize_t n { ::pread (body.file->fd(), _fileBuffer.data(), _fileBuffer.size(), static_cast<off_t> (r.offset + _fileOffset)) };
+
+  if (n <= 0) {
+    // the file has been truncated since it was opened
+    _logger.get().debug ("pread failed, sent={} length={}", _fileOffset, r.length);
+
+    return this->close();
+  }
+
+  _fileOffset += static_cast<uint64_t> (n);
+
+  _setDeadline (Deadline::kWrite);
+
+  _writeBuffers.assign (1, asio::buffer (_fileBuffer.data(), static_cast<size_t> (n)));
+
+  _writeAll(
+    _writeBuffers,
+    [ this, ctx = shared_from_this(), index, range, close ] (std::error_code ec, std::size_t) {
+      if (!ec)
+        _readFile (index, range, close);
+      else if (ec != asio::error::operation_aborted)
+        this->close();
+    }
+  );
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_written
+// ----------------------------------------------------------------------------
+void HttpConnection::_written (bool close) {
+  // the header block of a streamed response has been sent, its chunks follow
+  if (_stream) {
+    _outputBuffer.clear();
+    _queued.clear();
+
+    // from now on, a WebSocket reads and writes at the same time, on its strand
+    if (_wsHandler) {
+      return asio::post (_stream->executor, [ this, ctx = shared_from_this() ] {
+        // unless aborted meanwhile
+        if (_stream) {
+          _streamFlush();
+          _readFrames();
+        }
+      });
+    }
+
+    return _streamFlush();
+  }
+
+  if (close) {
+    if (_tls)
+      _tls->shutdown();
+
+    asio::error_code ignored;
+    _socket.shutdown (asio::ip::tcp::socket::shutdown_both, ignored);
+    this->close();
+  }
+  else {
+    _outputBuffer.clear();
+    _queued.clear();
+
+    // without a message in progress, an idle connection keeps no memory beyond the arena's buffer
+    if (_inputBuffer.length() == 0) {
+      _request.reset();
+      _arena.release();
+    }
+
+    waitForHttpMessage();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::StreamSink
+// ----------------------------------------------------------------------------
+// Shared by the handles of a stream, which keep the connection alive. The connection
+// takes the chunks whenever it is done sending; if it is idle, the writer wakes it up.
+class HttpConnection::StreamSink: public HttpStream::Sink {
+  public:
+    StreamSink (std::shared_ptr<HttpConnection> ctx, std::shared_ptr<StreamState> state):
+      _ctx { std::move (ctx) },
+      _state { std::move (state) }
+    {
+      // empty
+    }
+
+    bool write (HttpStream::Chunk chunk, HttpStream::Completion done) override {
+      std::error_code ec;
+      bool idle { false };
+
+      {
+        std::lock_guard lock { _state->mutex };
+
+        if (_state->error || _state->ended) {
+          ec = _state->error ? _state->error : std::make_error_code (std::errc::broken_pipe);
+        }
+        else if (!chunk.view().empty()) {
+          _state->pendingBytes += chunk.view().size();
+          _state->chunks.push_back (std::move (chunk));
+
+          if (done && (_state->pendingBytes > _ctx->_config.get().streamHighWaterMark))
+            _state->blocked.push_back (std::exchange (done, nullptr));
+
+          idle = !std::exchange (_state->writing, true);
+        }
+      }
+
+      if (done)
+        done (ec);
+
+      if (idle)
+        _wakeUp();
+
+      return !ec;
+    }
+
+    void end() override {
+      {
+        std::lock_guard lock { _state->mutex };
+
+        if (_state->error || std::exchange (_state->ended, true))
+          return;
+
+        if (std::exchange (_state->writing, true))
+          return;
       }
+
+      _wakeUp();
+    }
+
+    void abort() override {
+      asio::post (_state->executor, [ ctx = _ctx, state = _state ] {
+        if (ctx->_stream == state)
+          ctx->close();
+      });
     }
+
+    size_t pendingBytes() const override {
+      std::lock_guard lock { _state->mutex };
+      return _state->pendingBytes;
+    }
+
+  private:
+    std::shared_ptr<HttpConnection> _ctx;
+    std::shared_ptr<StreamState> _state;
+
+    void _wakeUp() {
+      asio::post (_state->executor, [ ctx = _ctx, state = _state ] {
+        if (ctx->_stream == state)
+          ctx->_streamFlush();
+      });
+    }
+};
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_makeStream
+// ----------------------------------------------------------------------------
+HttpStream HttpConnection::_makeStream() {
+  const auto executor { _socket.get_executor() };
+  const auto state { _openStream (executor) };
+
+  // the stream of a handler that has already returned begins now
+  if (!_handling)
+    asio::post (executor, [ this, ctx = shared_from_this(), state ] { if (_stream == state) _beginStream(); });
+
+  return HttpStream { executor, std::make_shared<StreamSink> (shared_from_this(), state) };
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_openStream
+// ----------------------------------------------------------------------------
+std::shared_ptr<HttpConnection::StreamState> HttpConnection::_openStream (asio::any_io_executor executor) {
+  auto state { std::make_shared<StreamState>() };
+  state->executor = std::move (executor);
+
+  _stream = state;
+  _streamedRequest = _requests;
+
+  return state;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_beginStream
+// ----------------------------------------------------------------------------
+// Queues the header block of a streamed response and writes it, after the responses
+// of the requests before it.
+void HttpConnection::_beginStream() {
+  _streamChunked = (_request.version.major > 1) || (_request.version.minor > 0);
+  _streamBody = (_request.method != HttpMethod::kHead);
+
+  if (_streamChunked)
+    _response.headers().set (HttpHeaderName::kTransferEncoding, "chunked");
+  else
+    _response.headers().set (HttpHeaderName::kConnection, "close"); // the body ends with the connection
+
+  _completeMessage();
+  _flush (_closing);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_streamFlush
+// ----------------------------------------------------------------------------
+// Sends the chunks written so far with a single gather write, or waits for the
+// handler to write more.
+void HttpConnection::_streamFlush() {
+  bool end;
+
+  {
+    std::lock_guard lock { _stream->mutex };
+
+    _streamChunks.swap (_stream->chunks);
+    end = _stream->ended;
+
+    if (_streamChunks.empty() && !end) {
+      _stream->writing = false;
+      return _setDeadline (Deadline::kNone);
+    }
+  }
+
+  constexpr std::string_view kCrLf { "\r\n" };
+  constexpr std::string_view kLastChunk { "0\r\n\r\n" };
+
+  _writeBuffers.clear();
+  _chunkHeaders.clear();
+  _chunkHeaders.reserve (_streamChunks.size() * 18); // views are taken as it grows
+
+  for (const auto &chunk: _streamChunks) {
+    const auto data { chunk.view() };
+
+    if (!_streamBody)
+      continue;
+
+    if (_streamChunked) {
+      char size[16];
+      const auto sizeEnd { std::to_chars (std::begin (size), std::end (size), data.size(), 16).ptr };
+      const auto start { _chunkHeaders.size() };
+
+      _chunkHeaders.append (size, sizeEnd).append (kCrLf);
+      _writeBuffers.push_back (asio::buffer (_chunkHeaders.data() + start, _chunkHeaders.size() - start));
+    }
+
+    _writeBuffers.push_back (asio::buffer (data));
+
+    if (_streamChunked)
+      _writeBuffers.push_back (asio::buffer (kCrLf.data(), kCrLf.size()));
+  }
+
+  if (end && _streamBody && _streamChunked)
+    _writeBuffers.push_back (asio::buffer (kLastChunk.data(), kLastChunk.size()));
+
+  if (_writeBuffers.empty())
+    return _streamWritten ({}, end);
+
+  _setDeadline (Deadline::kWrite);
+
+  _writeAll(
+    _writeBuffers,
+    asio::bind_executor (_stream->executor, [ this, ctx = shared_from_this(), end ] (std::error_code ec, std::size_t) {
+      _streamWritten (ec, end);
+    })
   );
 }
 
+// ----------------------------------------------------------------------------
+// HttpConnection::_streamWritten
+// ----------------------------------------------------------------------------
+void HttpConnection::_streamWritten (const std::error_code &ec, bool end) {
+  if (ec) {
+    if (ec != asio::error::operation_aborted)
+      close();
+
+    return;
+  }
+
+  // closed while writing (e.g. by the reader of a WebSocket)
+  if (!_stream)
+    return;
+
+  size_t sent { 0 };
+  for (const auto &chunk: _streamChunks)
+    sent += chunk.view().size();
+
+  _streamChunks.clear();
+
+  std::vector<HttpStream::Completion> unblocked;
+
+  {
+    std::lock_guard lock { _stream->mutex };
+
+    _stream->pendingBytes -= sent;
+
+    if (_stream->pendingBytes <= _config.get().streamHighWaterMark)
+      unblocked.swap (_stream->blocked);
+  }
+
+  for (auto &done: unblocked)
+    done ({});
+
+  if (!end)
+    return _streamFlush();
+
+  // the response is complete: back to the requests
+  _stream.reset();
+  _written (_closing);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_streamFailed
+// ----------------------------------------------------------------------------
+void HttpConnection::_streamFailed (const std::error_code &ec) {
+  const auto stream { std::exchange (_stream, nullptr) };
+  std::vector<HttpStream::Completion> blocked;
+
+  {
+    std::lock_guard lock { stream->mutex };
+
+    stream->error = ec;
+    blocked.swap (stream->blocked);
+  }
+
+  for (auto &done: blocked)
+    done (ec);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_beginWebSocket
+// ----------------------------------------------------------------------------
+// Queues the 101 response of an accepted handshake. Once it has been written, the
+// connection reads frames and writes the ones of its WebSocket through the stream.
+void HttpConnection::_beginWebSocket() {
+  _wsHandler = _response.webSocket();
+  _wsFragmented = false;
+  _wsCloseCode = 1006;
+
+  const auto state { _openStream (asio::make_strand (_socket.get_executor())) };
+
+  _streamChunked = false;
+  _streamBody = true;
+  _webSocket = WebSocket { HttpStream { state->executor, std::make_shared<StreamSink> (shared_from_this(), state) } };
+
+  _completeMessage();
+
+  _request.protocol = _tls ? ProtocolType::kWss : ProtocolType::kWs;
+
+  if (_wsHandler->onOpen)
+    _wsHandler->onOpen (_request, _webSocket);
+
+  _flush (_closing);
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_readFrames
+// ----------------------------------------------------------------------------
+// Handles the complete frames in the input buffer, then reads more. The buffer holds
+// the frame being received, growing to fit it.
+void HttpConnection::_readFrames() {
+  const size_t maxSize { _config.get().maxWebSocketMessageSize };
+
+  while (_wsHandler) {
+    WebSocketFrameHeader header;
+    const auto data { _inputBuffer.unparsed() };
+
+    if (!WebSocketFrameHeader::parse (data, header))
+      break;
+
+    const bool control { static_cast<uint8_t> (header.opcode) >= 0x8 };
+
+    // clients mask every frame; control frames are small and never fragmented
+    if ((header.rsv != 0) || !header.masked || (control && (!header.fin || (header.payloadLength > 125)))) {
+      _webSocket.close (1002);
+      return;
+    }
+
+    if ((header.payloadLength > maxSize) || (!control && (_wsMessage.size() + header.payloadLength > maxSize))) {
+      _webSocket.close (1009);
+      return;
+    }
+
+    if (data.size() - header.headerLength < header.payloadLength)
+      break;
+
+    char *payload { _inputBuffer.unparsedData() + header.headerLength };
+    const size_t length { static_cast<size_t> (header.payloadLength) };
+
+    WebSocket::unmask (payload, length, header.key);
+    _inputBuffer.parsedBytes (header.headerLength + length);
+
+    const bool more { _webSocketFrame (header.opcode, header.fin, { payload, length }) };
+
+    _inputBuffer.consumedBytes();
+
+    if (!more)
+      return;
+  }
+
+  if (!_wsHandler)
+    return;
+
+  _inputBuffer.reserve();
+
+  _readSome(
+    _inputBuffer.makeAsioBuffer(),
+    asio::bind_executor (_stream ? _stream->executor : _socket.get_executor(), [ this, ctx = shared_from_this() ] (std::error_code ec, std::size_t length) {
+      _framesRead (ec, length);
+    })
+  );
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_framesRead
+// ----------------------------------------------------------------------------
+void HttpConnection::_framesRead (const std::error_code &ec, size_t length) {
+  if (ec) {
+    if (ec != asio::error::operation_aborted)
+      close();
+
+    return;
+  }
+
+  _inputBuffer.obtainedBytes (length);
+  _readFrames();
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnection::_webSocketFrame
+// ----------------------------------------------------------------------------
+// Returns false if no more frames must be read
+bool HttpConnection::_webSocketFrame (WebSocketOpcode opcode, bool fin, std::string_view payload) {
+  switch (opcode) {
+    case WebSocketOpcode::kText:
+    case WebSocketOpcode::kBinary:
+      if (_wsFragmented)
+        break;
+
+      if (!fin) {
+        _wsMessage.assign (payload);
+        _wsBinary = (opcode == WebSocketOpcode::kBinary);
+        _wsFragmented = true;
+      }
+      else if (_wsHandler->onMessage) {
+        _wsHandler->onMessage (_webSocket, payload, opcode == WebSocketOpcode::kBinary);
+      }
+
+      return true;
+
+    case WebSocketOpcode::kContinuation:
+      if (!_wsFragmented)
+        break;
+
+      _wsMessage.append (payload);
+
+      if (fin) {
+        _wsFragmented = false;
+
+        if (_wsHandler->onMessage)
+          _wsHandler->onMessage (_webSocket, _wsMessage, _wsBinary);
+
+        _wsMessage.clear();
+      }
+
+      return true;
+
+    case WebSocketOpcode::kPing:
+      _webSocket.send (WebSocket::frame (payload, WebSocketOpcode::kPong));
+      return true;
+
+    case WebSocketOpcode::kPong:
+      return true;
+
+    case WebSocketOpcode::kClose:
+      if (payload.size() == 1)
+        break;
+
+      // the close frame is echoed, and the connection closed once it has been written
+      _wsCloseCode = (payload.size() >= 2) ? static_cast<uint16_t> ((uint8_t (payload[0]) << 8) | uint8_t (payload[1])) : 1005;
+      _webSocket.close ((_wsCloseCode == 1005) ? 1000 : _wsCloseCode);
+
+      return false;
+
+    default:
+      break;
+  }
+
+  // protocol error
+  _webSocket.close (1002);
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// HttpConnectionPool::acquire
+// ----------------------------------------------------------------------------
+std::shared_ptr<HttpConnection> HttpConnectionPool::acquire (asio::ip::tcp::socket &&socket) {
+  std::unique_ptr<HttpConnection> connection;
+
+  {
+    std::lock_guard lock { _mutex };
+
+    if (!_free.empty()) {
+      connection = std::move (_free.back());
+      _free.pop_back();
+    }
+  }
+
+  _active.fetch_add (1, std::memory_order_relaxed);
+
+  if (connection)
+    connection->reuse (std::move (socket));
+  else
+    connection = std::make_unique<HttpConnection> (std::move (socket), _findRoute, _timers, _config, _logger, _tls, _ring);
+
+  // the pool is only weakly referenced: the deleter lives as long as the control block,
+  // which the connection itself keeps alive (enable_shared_from_this) while it is pooled
+  return std::shared_ptr<HttpConnection> {
+    connection.release(),
+    [ pool = weak_from_this() ] (HttpConnection *c) {
+      if (const auto p { pool.lock() })
+        p->_release (c);
+      else
+        delete c;
+    }
+  };
 }
 
+// ----------------------------------------------------------------------------
+// HttpConnectionPool::_release
+// ----------------------------------------------------------------------------
+void HttpConnectionPool::_release (HttpConnection *connection) {
+  std::unique_ptr<HttpConnection> c { connection };
+
+  c->close();
+
+  _active.fetch_sub (1, std::memory_order_relaxed);
+
+  {
+    std::lock_guard lock { _mutex };
+
+    if (_free.size() < _config.get().connectionPoolSize)
+      _free.push_back (std::move (c));
+  }
+
+  c.reset(); // not pooled: destroyed outside the lock
+
+  if (_closed)
+    _closed();
+}
+
+}
@@ -0,0 +1,201 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <charconv>
+#include <utility>
+
+#include <lightning/http_events.h>
+
+
+namespace lightning {
+
+static constexpr std::string_view kData { "data: " };
+
+// ----------------------------------------------------------------------------
+// forEachLine
+// ----------------------------------------------------------------------------
+// Lines of a payload, split at CRLF, CR or LF (as the client splits them)
+template<typename Function>
+static void forEachLine (std::string_view data, Function &&f) {
+  for (;;) {
+    const auto end { data.find_first_of ("\r\n") };
+
+    f (data.substr (0, end));
+
+    if (end == std::string_view::npos)
+      return;
+
+    const bool crlf { (data[end] == '\r') && (end + 1 < data.size()) && (data[end + 1] == '\n') };
+    data.remove_prefix (end + (crlf ? 2 : 1));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// appendField
+// ----------------------------------------------------------------------------
+// A single-line field: the characters that would end it (or, for the id, make the
+// client ignore it) are left out, so a value cannot add fields or end the event.
+static void appendField (std::string &out, std::string_view name, std::string_view value, std::string_view forbidden) {
+  out.append (name);
+
+  while (!value.empty()) {
+    const auto end { std::min (value.find_first_of (forbidden), value.size()) };
+
+    out.append (value.data(), end);
+    value.remove_prefix (std::min (end + 1, value.size()));
+  }
+
+  out.push_back ('\n');
+}
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+HttpEventChannel::HttpEventChannel (const HttpEventChannelConfig &config):
+  _config { config }
+{
+  // empty
+}
+
+// ----------------------------------------------------------------------------
+// Destructor
+// ----------------------------------------------------------------------------
+HttpEventChannel::~HttpEventChannel() {
+  close();
+}
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel::subscribe
+// ----------------------------------------------------------------------------
+void HttpEventChannel::subscribe (HttpResponse &response) {
+  auto &headers { response.headers() };
+
+  headers.set (HttpHeaderName::kContentType, "text/event-stream");
+  headers.set (HttpHeaderName::kCacheControl, "no-cache");
+
+  if (response.statusCode() == 0)
+    response.status (200);
+
+  auto stream { response.stream() };
+
+  if (_config.retry.count() > 0) {
+    char retry[32];
+    const auto end { std::to_chars (std::begin (retry), std::end (retry), _config.retry.count()).ptr };
+
+    stream.push (std::make_shared<const std::string> ("retry: " + std::string { retry, end } + "\n\n"));
+  }
+
+  std::lock_guard lock { _mutex };
+  _subscribers.push_back (std::move (stream));
+}
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel::publish
+// ----------------------------------------------------------------------------
+size_t HttpEventChannel::publish (std::string_view data, std::string_view event, std::string_view id) {
+  return publish (format (data, event, id));
+}
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel::publish
+// ----------------------------------------------------------------------------
+size_t HttpEventChannel::publish (std::shared_ptr<const std::string> event) {
+  size_t queued { 0 };
+  uint64_t dropped { 0 };
+
+  std::lock_guard lock { _mutex };
+
+  for (size_t i { 0 }; i < _subscribers.size();) {
+    auto &stream { _subscribers[i] };
+    bool remove { false };
+
+    if (stream.pendingBytes() > _config.maxQueuedBytes) {
+      if (_config.overflow == HttpEventChannelConfig::Overflow::kDisconnect) {
+        stream.abort();
+        remove = true;
+      }
+
+      ++dropped;
+    }
+    else if (stream.push (event)) {
+      ++queued;
+    }
+    else {
+      remove = true; // the connection is gone
+    }
+
+    if (remove) {
+      // the order of the subscribers does not matter
+      if (i + 1 < _subscribers.size())
+        stream = std::move (_subscribers.back());
+
+      _subscribers.pop_back();
+    }
+    else {
+      ++i;
+    }
+  }
+
+  _dropped.fetch_add (dropped, std::memory_order_relaxed);
+
+  return queued;
+}
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel::ping
+// ----------------------------------------------------------------------------
+size_t HttpEventChannel::ping() {
+  static const auto comment { std::make_shared<const std::string> (":\n\n") };
+
+  return publish (comment);
+}
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel::close
+// ----------------------------------------------------------------------------
+void HttpEventChannel::close() {
+  std::vector<HttpStream> subscribers;
+
+  {
+    std::lock_guard lock { _mutex };
+    subscribers.swap (_subscribers);
+  }
+
+  for (auto &stream: subscribers)
+    stream.end();
+}
+
+// ----------------------------------------------------------------------------
+// HttpEventChannel::format
+// ----------------------------------------------------------------------------
+std::shared_ptr<const std::string> HttpEventChannel::format (std::string_view data, std::string_view event, std::string_view id) {
+  size_t size { 1 };
+
+  if (!event.empty())
+    size += event.size() + 8; // "event: " and LF
+
+  if (!id.empty())
+    size += id.size() + 5; // "id: " and LF
+
+  forEachLine (data, [ &size ] (std::string_view line) { size += kData.size() + line.size() + 1; });
+
+  auto out { std::make_shared<std::string>() };
+  out->reserve (size);
+
+  if (!event.empty())
+    appendField (*out, "event: ", event, "\r\n");
+
+  if (!id.empty())
+    appendField (*out, "id: ", id, std::string_view { "\r\n\0", 3 });
+
+  forEachLine (data, [ &out ] (std::string_view line) { out->append (kData).append (line).push_back ('\n'); });
+
+  out->push_back ('\n');
+
+  return out;
+}
+
+}
@@ -3,7 +3,7 @@
 //
 // Copyright (c) 2024 Carlos Carrasco
 // ----------------------------------------------------------------------------
-#include <algorithm>
+#include <utility>
 
 #include <lightning/http_header.h>
 
@@ -14,27 +14,25 @@ namespace lightning {
 // HttpHeaders::contains
 // ----------------------------------------------------------------------------
 bool HttpHeader::contains (std::string_view name) const {
-  std::string lower;
-  lower.resize(name.size());
-  std::transform (std::begin (name), std::end (name), std::begin(lower), [] (unsigned char c) {
-    return std::tolower (c);
-  });
-
-  return _headers.find (lower) != _headers.end();
+  return _find (name) != nullptr;
 }
 
 // ----------------------------------------------------------------------------
 // HttpHeader::get
 // ----------------------------------------------------------------------------
 std::optional<std::string_view> HttpHeader::get (std::string_view name) const {
-  std::string lower;
-  lower.resize(name.size());
-  std::transform (std::begin (name), std::end (name), std::begin (lower), [] (unsigned char c) {
-    return std::tolower (c);
-  });
+  if (const auto h = _find (name); h != nullptr)
+    return { h->value };
+
+  return std::nullopt;
+}
 
-  if (auto it = _headers.find (lower); it != _headers.end())
-    return { it->second };
+// ----------------------------------------------------------------------------
+// HttpHeader::get
+// ----------------------------------------------------------------------------
+std::optional<std::string_view> HttpHeader::get (HttpHeaderName id) const {
+  if (const auto pos = _known[static_cast<size_t> (id)]; pos != 0)
+    return { _headers[pos - 1].value };
 
   return std::nullopt;
 }
@@ -43,14 +41,64 @@ std::optional<std::string_view> HttpHeader::get (std::string_view name) const {
 // HttpHeader::set
 // ----------------------------------------------------------------------------
 void HttpHeader::set (std::string_view name, std::string_view value) {
-  std::string lower;
-  lower.resize(name.size());
-  std::transform (std::begin (name), std::end (name), std::begin (lower), [] (unsigned char c) {
-    return std::tolower (c);
-  });
-
-  _headers[lower] = std::move(value);
-  _last = _headers.find (lower);
+  if (const auto id = lookup (name); id != HttpHeaderName::kUnknown) {
+    auto &pos { _known[static_cast<size_t> (id)] };
+
+    if (pos != 0) {
+      _headers[pos - 1].value = value;
+    }
+    else {
+      _headers.push_back (HeaderData { name, value });
+      pos = static_cast<uint16_t> (_headers.size());
+    }
+  }
+  else if (auto h = _find (name); h != nullptr) {
+    h->value = value;
+  }
+  else {
+    _headers.push_back (HeaderData { name, value });
+  }
+}
+
+// ----------------------------------------------------------------------------
+// HttpHeader::set
+// ----------------------------------------------------------------------------
+void HttpHeader::set (HttpHeaderName id, std::string_view value) {
+  auto &pos { _known[static_cast<size_t> (id)] };
+
+  if (pos != 0) {
+    _headers[pos - 1].value = value;
+  }
+  else {
+    _headers.push_back (HeaderData { name (id), value });
+    pos = static_cast<uint16_t> (_headers.size());
+  }
+}
+
+// ----------------------------------------------------------------------------
+// HttpHeader::_find
+// ----------------------------------------------------------------------------
+HttpHeader::HeaderData * HttpHeader::_find (std::string_view name) {
+  return const_cast<HeaderData *> (std::as_const (*this)._find (name));
+}
+
+// ----------------------------------------------------------------------------
+// HttpHeader::_find
+// ----------------------------------------------------------------------------
+const HttpHeader::HeaderData * HttpHeader::_find (std::string_view name) const {
+  if (const auto id = lookup (name); id != HttpHeaderName::kUnknown) {
+    const auto pos { _known[static_cast<size_t> (id)] };
+
+    return (pos != 0) ? &_headers[pos - 1] : nullptr;
+  }
+
+  // unknown names are not indexed, but requests rarely carry more than a few of them
+  for (const auto &h: _headers) {
+    if (StringUtil::iequals (h.name, name))
+      return &h;
+  }
+
+  return nullptr;
 }
 
 }
@@ -6,7 +6,6 @@
 #include <cassert>
 #include <cstring>
 #include <exception>
-#include <regex>
 
 #include <llhttp.h>
 
@@ -17,165 +16,276 @@
 namespace lightning {
 
 // ----------------------------------------------------------------------------
-// HttpRequest::parse
+// extend
 // ----------------------------------------------------------------------------
-bool HttpRequest::parse (std::string_view buffer) {
-  llhttp_t parser;
-  llhttp_settings_t settings;
+// llhttp reports a token split between two reads with two callbacks. As the input
+// buffer is contiguous, the second part always follows the first one.
+static inline std::string_view extend (std::string_view view, const char *at, size_t length) {
+  if (view.empty())
+    return std::string_view { at, length };
 
-  llhttp_settings_init (&settings);
-  settings.on_method = [] (llhttp_t *parser, const char *at, size_t length) {
-    auto request { static_cast<HttpRequest *> (parser->data) };
-    assert (request);
+  return std::string_view { view.data(), view.size() + length };
+}
+
+// ----------------------------------------------------------------------------
+// rebase
+// ----------------------------------------------------------------------------
+static inline std::string_view rebase (std::string_view view, const char *from, const char *to) {
+  if (view.empty())
+    return view;
+
+  return std::string_view { to + (view.data() - from), view.size() };
+}
+
+// ----------------------------------------------------------------------------
+// HttpParams::rebase
+// ----------------------------------------------------------------------------
+void HttpParams::rebase (const char *from, const char *to) {
+  for (auto &p: _params)
+    p.value = lightning::rebase (p.value, from, to);
+}
+
+// ----------------------------------------------------------------------------
+// HttpRequest::initParser
+// ----------------------------------------------------------------------------
+void HttpRequest::initParser (llhttp_t &parser) {
+  static const llhttp_settings_t settings { [] {
+    llhttp_settings_t settings;
+
+    llhttp_settings_init (&settings);
+
+    settings.on_message_begin = [] (llhttp_t *parser) {
+      auto request { static_cast<HttpRequest *> (parser->data) };
+      assert (request);
+
+      request->reset();
+
+      return 0;
+    };
+
+    settings.on_url = [] (llhttp_t* parser, const char *at, size_t length) {
+      auto request { static_cast<HttpRequest *> (parser->data) };
+
+      request->url = extend (request->url, at, length);
 
-    if (std::strncmp ("GET", at, length) == 0) request->method = HttpMethod::kGet;
-    else if (std::strncmp ("HEAD", at, length) == 0) request->method = HttpMethod::kHead;
-    else if (std::strncmp ("POST", at, length) == 0) request->method = HttpMethod::kPost;
-    else if (std::strncmp ("PUT", at, length) == 0) request->method = HttpMethod::kPut;
-    else if (std::strncmp ("DELETE", at, length) == 0) request->method = HttpMethod::kDelete;
-    else if (std::strncmp ("CONNECT", at, length) == 0) request->method = HttpMethod::kConnect;
-    else if (std::strncmp ("OPTIONS", at, length) == 0) request->method = HttpMethod::kOptions;
-    else if (std::strncmp ("TRACE", at, length) == 0) request->method = HttpMethod::kTrace;
-    else if (std::strncmp ("PATCH", at, length) == 0) request->method = HttpMethod::kPatch;
-    else {
-      request->_logger.get().error ("HTTP parsing error: unsupported HTTP method {}", std::string_view { at, length });
+      return 0;
+    };
 
-      return -1;
-    }
+    settings.on_url_complete = [] (llhttp_t* parser) {
+      auto request { static_cast<HttpRequest *> (parser->data) };
 
-    return 0;
-  };
+      request->_logger.get().verbose ("HTTP URL parser: {}", request->url);
 
-  settings.on_status = [] (llhttp_t *parser, const char *at, [[maybe_unused]] size_t length) {
-    auto request { static_cast<HttpRequest *> (parser->data) };
+      // <path>[?<query>][#<fragment>]
+      const auto end { request->url.find ('#') };
+      const auto pos { request->url.find ('?') };
 
-    char *end { nullptr };
-    request->statusCode = std::strtol (at, &end, 10);
+      if (pos < end) {
+        request->path = request->url.substr (0, pos);
+        request->query = request->url.substr (pos + 1, end == std::string_view::npos ? end : end - pos - 1);
+      }
+      else {
+        request->path = request->url.substr (0, end);
+      }
 
-    if (end == nullptr) {
-      request->_logger.get().error ("Error parsing status code");
+      request->_queryParams.assign (request->query);
 
-      return -1;
-    }
+      return 0;
+    };
 
-    return 0;
-  };
+    settings.on_header_field = [] (llhttp_t *parser, const char *at, size_t length) {
+      auto request { static_cast<HttpRequest *> (parser->data) };
 
-  settings.on_url = [] (llhttp_t* parser, const char *at, size_t length) {
-    auto request { static_cast<HttpRequest *> (parser->data) };
+      request->_headerName = extend (request->_headerName, at, length);
 
-    request->_logger.get().verbose ("HTTP URL parser: {}", std::string_view { at, length });
+      return 0;
+    };
 
-    request->url.assign (at, length);
+    settings.on_header_value = [] (llhttp_t *parser, const char *at, size_t length) {
+      auto request { static_cast<HttpRequest*>(parser->data) };
 
-    const std::regex pattern { "^([^?]*)(\\?([^#]*))?" };
-    std::smatch parts;
+      request->_headerValue = extend (request->_headerValue, at, length);
 
-    if (std::regex_search(request->url, parts, pattern)) {
-      request->path = parts[1].str();
-      request->query = parts[3].str(); // Part 3 is the query without the '?'
-    }
+      return 0;
+    };
 
-    return 0;
-  };
+    settings.on_header_value_complete = [] (llhttp_t *parser) {
+      auto request { static_cast<HttpRequest*>(parser->data) };
 
-  settings.on_header_field = [] (llhttp_t *parser, const char *at, size_t length) {
-    auto request { static_cast<HttpRequest *> (parser->data) };
+      const std::string_view value { request->_headerValue };
 
-    request->_logger.get().verbose ("HTTP header name parser: {}", std::string_view { at, length });
+      request->_logger.get().verbose ("HTTP header parser: {}: {}", request->_headerName, value);
 
-    request->headers.set (std::string_view { at, length}, std::string_view {}); // empty value
+      if (request->headers.contains (request->_headerName)) {
+        request->_logger.get().warn ("HTTP parsing warning: header '{}' already set", request->_headerName);
+      }
+      else {
+        request->headers.set (request->_headerName, value);
 
-    return 0;
-  };
+        if (StringUtil::iequals (request->_headerName, "host"))
+          request->host = value.substr (0, value.find (':'));
+      }
 
-  settings.on_header_value = [] (llhttp_t *parser, const char *at, size_t length) {
-    auto request { static_cast<HttpRequest*>(parser->data) };
+      request->_headerName = {};
+      request->_headerValue = {};
 
-    const std::string_view value { at, length };
+      return 0;
+    };
 
-    request->_logger.get().verbose ("HTTP header value parser: {}", value);
+    settings.on_headers_complete = [] (llhttp_t *parser) {
+      auto request { static_cast<HttpRequest*>(parser->data) };
 
-    if (request->headers.last()->second.empty())
-      request->headers.last()->second = value;
-    else
-      request->_logger.get().warn ("HTTP parsing warning: header '{}' already set", request->headers.last()->first);
+      switch (llhttp_get_method (parser)) {
+        case HTTP_GET: request->method = HttpMethod::kGet; break;
+        case HTTP_HEAD: request->method = HttpMethod::kHead; break;
+        case HTTP_POST: request->method = HttpMethod::kPost; break;
+        case HTTP_PUT: request->method = HttpMethod::kPut; break;
+        case HTTP_DELETE: request->method = HttpMethod::kDelete; break;
+        case HTTP_CONNECT: request->method = HttpMethod::kConnect; break;
+        case HTTP_OPTIONS: request->method = HttpMethod::kOptions; break;
+        case HTTP_TRACE: request->method = HttpMethod::kTrace; break;
+        case HTTP_PATCH: request->method = HttpMethod::kPatch; break;
+        default:
+          request->_logger.get().error (
+            "HTTP parsing error: unsupported HTTP method {}",
+            llhttp_method_name (static_cast<llhttp_method_t> (llhttp_get_method (parser)))
+          );
 
-    if (request->headers.last()->first.compare ("host") == 0) {
-      if (const auto pos = value.find (':'); pos != std::string_view::npos)
-        request->host.assign (at, pos);
-      else
-        request->host.assign (at, length);
-    }
+          return -1;
+      }
 
-    return 0;
-  };
+      request->version.major = llhttp_get_http_major (parser);
+      request->version.minor = llhttp_get_http_minor (parser);
 
-  settings.on_version = [] (llhttp_t *parser, const char *at, size_t length) {
-    auto request { static_cast<HttpRequest*>(parser->data) };
+      request->_headersComplete = true;
 
-    request->_logger.get().verbose ("HTTP version parser: {}", std::string_view { at, length });
+      // Stop, so the connection can route the request before its body is parsed.
+      return static_cast<int> (HPE_PAUSED);
+    };
 
-    const std::regex pattern { "^(\\d+)\\.(\\d+)$" };
-    std::cmatch parts;
+    settings.on_body = [] (llhttp_t *parser, const char *at, size_t length) {
+      auto request { static_cast<HttpRequest*>(parser->data) };
 
-    if (std::regex_search(at, at + length, parts, pattern)) {
-      request->version.major = std::atoi (parts[1].str().c_str());
-      request->version.minor = std::atoi (parts[2].str().c_str());
-    }
-    else {
-      request->_logger.get().error ("HTTP parsing error: unknown version {}", std::string_view { at, length });
-    }
+      request->_logger.get().verbose ("HTTP body parser: {}", StringUtil::fmtBuffer (at, length, 0, 16, 8));
 
-    return 0;
-  };
+      if (request->_onBody) {
+        (*request->_onBody) (*request, std::string_view { at, length });
+      }
+      else if (request->body.empty() || (request->body.data() + request->body.size() == at)) {
+        request->body = extend (request->body, at, length);
+      }
+      else {
+        // Chunks are separated by their (already parsed) headers: the data is moved back
+        // over them, so the body is kept contiguous without copying it elsewhere.
+        auto end { const_cast<char *> (request->body.data() + request->body.size()) };
+        std::memmove (end, at, length);
+        request->body = std::string_view { request->body.data(), request->body.size() + length };
+      }
 
-  settings.on_body = [] (llhttp_t *parser, const char *at, size_t length) {
-    auto request { static_cast<HttpRequest*>(parser->data) };
+      return 0;
+    };
 
-    request->_logger.get().verbose ("HTTP body parser: {}", StringUtil::fmtBuffer (at, length, 0, 16, 8));
+    settings.on_message_complete = [] (llhttp_t *parser) {
+      auto request { static_cast<HttpRequest*>(parser->data) };
 
-    request->body.reserve (length);
-    request->body.assign (length, reinterpret_cast<const uint8_t *>(at));
+      request->_messageComplete = true;
+      request->_assignForm();
 
-    return 0;
-  };
+      // Stop after every message so the connection can handle it before parsing the next one.
+      return static_cast<int> (HPE_PAUSED);
+    };
 
-  _logger.get().verbose ("HTTP parsing buffer: {}", StringUtil::fmtBuffer (buffer.data(), buffer.size(), 0, 16, 8));
+    return settings;
+  }() };
 
-  llhttp_init (&parser, HTTP_BOTH, &settings);
+  llhttp_init (&parser, HTTP_REQUEST, &settings);
   parser.data = this;
+}
 
-  // Parse the HTTP data
-  if (const llhttp_errno err = llhttp_execute (&parser, buffer.data(), buffer.size()); err != HPE_OK) {
-    _logger.get().error ("HTTP parsing error: {}", llhttp_errno_name (err));
-    return false;
+// ----------------------------------------------------------------------------
+// HttpRequest::rebase
+// ----------------------------------------------------------------------------
+void HttpRequest::rebase (const char *from, const char *to) {
+  for (auto &h: headers) {
+    h.name = lightning::rebase (h.name, from, to);
+    h.value = lightning::rebase (h.value, from, to);
   }
 
-  return true;
+  body = lightning::rebase (body, from, to);
+  path = lightning::rebase (path, from, to);
+  query = lightning::rebase (query, from, to);
+  url = lightning::rebase (url, from, to);
+  host = lightning::rebase (host, from, to);
+
+  // values of the route params are views of the path
+  params.rebase (from, to);
+
+  _headerName = lightning::rebase (_headerName, from, to);
+  _headerValue = lightning::rebase (_headerValue, from, to);
+
+  // split again from the moved views, if they are ever accessed
+  _queryParams.assign (query);
+
+  if (_messageComplete)
+    _assignForm();
 }
 
+// ----------------------------------------------------------------------------
+// HttpRequest::reset
+// ----------------------------------------------------------------------------
+void HttpRequest::reset() {
+  path = {};
+  query = {};
+  url = {};
+  version = { 0, 0 };
+  host = {};
+  ip = {};
+  protocol = ProtocolType::kUnknown;
+  headers.reset();
+  params.reset();
+  statusCode = 0;
+  body = {};
+
+  _headerName = {};
+  _headerValue = {};
+  _headersComplete = false;
+  _messageComplete = false;
+  _onBody = nullptr;
+  _queryParams.reset();
+  _formParams.reset();
+  _json.reset();
+  _jsonValid.reset();
+}
 
 // ----------------------------------------------------------------------------
-// HttpRequest::queryParser
+// HttpRequest::_assignForm
 // ----------------------------------------------------------------------------
-// void HttpRequest::queryParser (HttpRequest &req) {
-//  if (!req.query.empty()) {
-//    // TODO
-//  }
-// }
+void HttpRequest::_assignForm() {
+  const auto type { headers.get (HttpHeaderName::kContentType) };
 
-// // ----------------------------------------------------------------------------
-// // HttpRequest::bodyParser
-// // ----------------------------------------------------------------------------
-// void HttpRequest::bodyParser (HttpRequest &req) {
-//  if (!req.body.empty()) {
-//   //  if (req.headers.get ("content-type").compare (0, 16, "application/json") == 0) {
-//     // FIXME
-//     //  rapidjson::Document doc;
-//     //  doc.Parse (reinterpret_cast<char  *> (req.body.data()));
-//   //  }
-//  }
-// }
+  if (!type || streamingBody())
+    return;
+
+  const auto media { StringUtil::trim (type->substr (0, type->find (';'))) };
+
+  if (StringUtil::iequals (media, "application/x-www-form-urlencoded"))
+    _formParams.assign (body);
+}
+
+// ----------------------------------------------------------------------------
+// HttpRequest::json
+// ----------------------------------------------------------------------------
+const JsonValue * HttpRequest::json() const {
+  if (!_jsonValid) {
+    // the body lies in the input buffer of the connection, which is not read from again
+    // until the response has been written
+    _jsonValid = !body.empty() && _json.parse (const_cast<char *> (body.data()), body.size());
+
+    if (!*_jsonValid)
+      _logger.get().debug ("HTTP body is not valid JSON (offset {})", _json.errorOffset());
+  }
+
+  return *_jsonValid ? &_json.root() : nullptr;
+}
 
 }
@@ -3,8 +3,10 @@
 //
 // Copyright (c) 2024 Carlos Carrasco
 // ----------------------------------------------------------------------------
-// #include "rapidjson/stringbuffer.h"
-// #include "rapidjson/writer.h"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <stdexcept>
 
 #include <lightning/http_response.h>
 
@@ -14,59 +16,168 @@ namespace lightning {
 // ----------------------------------------------------------------------------
 // HttpResponse::send
 // ----------------------------------------------------------------------------
-HttpResponse & HttpResponse::send (const std::string &data) {
-  if (!_headers.contains ("content-type"))
-    _headers.set ("content-type", "text/plain; charset=utf-8");
+HttpResponse & HttpResponse::send (std::string data) {
+  if (!_headers.contains (HttpHeaderName::kContentType))
+    _headers.set (HttpHeaderName::kContentType, "text/plain; charset=utf-8");
 
-  _data = data;
+  _body.data = std::move (data);
+  _body.shared.reset();
+  _body.file.reset();
+  _body.compressed.reset();
 
   return *this;
 }
 
-// // ----------------------------------------------------------------------------
-// // HttpResponse::send
-// // ----------------------------------------------------------------------------
-// HttpResponse & HttpResponse::send (const rapidjson::Document &document) {
-//   if (!_headers.has ("Content-Type"))
-//     _headers.set ("Content-Type", "application/json");
+// ----------------------------------------------------------------------------
+// HttpResponse::send
+// ----------------------------------------------------------------------------
+HttpResponse & HttpResponse::send (std::shared_ptr<const std::string> data, std::shared_ptr<HttpCompressedBodies> compressed) {
+  if (!_headers.contains (HttpHeaderName::kContentType))
+    _headers.set (HttpHeaderName::kContentType, "text/plain; charset=utf-8");
+
+  _body.data.clear();
+  _body.shared = std::move (data);
+  _body.file.reset();
+  _body.compressed = std::move (compressed);
+
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponse::send
+// ----------------------------------------------------------------------------
+HttpResponse & HttpResponse::send (std::shared_ptr<const StaticFile> file, std::shared_ptr<HttpCompressedBodies> compressed) {
+  if (!_headers.contains (HttpHeaderName::kContentType))
+    _headers.set (HttpHeaderName::kContentType, file->contentType());
+
+  _body.data.clear();
+  _body.shared.reset();
+  _body.file = std::move (file);
+  _body.compressed = std::move (compressed);
 
-//   rapidjson::StringBuffer buffer;
-//   rapidjson::Writer<rapidjson::StringBuffer> writer (buffer);
-//   document.Accept (writer);
-//   _data.assign (buffer.GetString());
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponse::json
+// ----------------------------------------------------------------------------
+JsonWriter HttpResponse::json() {
+  if (!_headers.contains (HttpHeaderName::kContentType))
+    _headers.set (HttpHeaderName::kContentType, "application/json");
+
+  _body.data.clear();
+  _body.shared.reset();
+  _body.file.reset();
+  _body.compressed.reset();
 
-//   return *this;
-// }
+  // most documents fit, so the body grows once at most
+  _body.data.reserve (1024);
+
+  return JsonWriter { _body.data };
+}
 
 // ----------------------------------------------------------------------------
-// HttpResponse::data
+// HttpResponse::serialize
 // ----------------------------------------------------------------------------
-std::string HttpResponse::data() const {
-  std::string res;
+void HttpResponse::serialize (std::string &out) const {
+  constexpr std::string_view kVersion { "HTTP/1.1 " };
+  constexpr std::string_view kContentLength { "content-length: " };
+  constexpr std::string_view kServer { "server: lightning\r\n" };
+
+  char status[16];
+  const auto statusEnd { std::to_chars (std::begin (status), std::end (status), _status).ptr };
+
+  char length[24];
+  const auto lengthEnd { std::to_chars (std::begin (length), std::end (length), _body.size()).ptr };
+
+  // 1xx, 204 and 304 responses have no body to measure, and a streamed one is not known yet
+  const bool addLength {
+    !_headers.contains (HttpHeaderName::kContentLength) && !_streaming && (_status >= 200) && (_status != 204) && (_status != 304)
+  };
+
+  // compute the exact size first, so the buffer is (re)allocated at most once
+  size_t size { kVersion.size() + (statusEnd - status) + 3 + kServer.size() + 2 };
 
-  res.append ("HTTP/1.1 ");
-  res.append (std::to_string (_status));
-  res.append (" \r\n");
+  for (auto it = _headers.cbegin(); it != _headers.cend(); it++)
+    size += it->name.size() + it->value.size() + 4;
+
+  if (addLength)
+    size += kContentLength.size() + (lengthEnd - length) + 2;
+
+  if (out.capacity() < out.size() + size)
+    out.reserve (std::max (out.size() + size, out.capacity() * 2));
+
+  out.append (kVersion);
+  out.append (status, statusEnd);
+  out.append (" \r\n");
 
   for (auto it = _headers.cbegin(); it != _headers.cend(); it++) {
-    res.append (it->first);
-    res.append (": ");
-    res.append (it->second);
-    res.append ("\r\n");
+    out.append (it->name);
+    out.append (": ");
+    out.append (it->value);
+    out.append ("\r\n");
   }
 
-  if (!_headers.contains ("content-length")) {
-    res.append ("content-length: ");
-    res.append (std::to_string (_data.size()));
-    res.append ("\r\n");
+  if (addLength) {
+    out.append (kContentLength);
+    out.append (length, lengthEnd);
+    out.append ("\r\n");
   }
 
-  res.append ("server: lightning");
-  res.append ("\r\n");
-  res.append ("\r\n");
-  res.append (_data);
+  out.append (kServer);
+  out.append ("\r\n");
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponse::store
+// ----------------------------------------------------------------------------
+std::string_view HttpResponse::store (std::string_view value) {
+  if (value.empty())
+    return {};
+
+  auto data { static_cast<char *> (_strings.allocate (value.size(), alignof (char))) };
+  std::copy (value.begin(), value.end(), data);
+
+  return { data, value.size() };
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponse::defer
+// ----------------------------------------------------------------------------
+HttpResponder HttpResponse::defer() {
+  if (!_responderFactory)
+    throw std::logic_error { "response not owned by a connection" };
+
+  _deferred = true;
+
+  return _responderFactory();
+}
+
+// ----------------------------------------------------------------------------
+// HttpResponse::stream
+// ----------------------------------------------------------------------------
+HttpStream HttpResponse::stream() {
+  if (!_streamFactory)
+    throw std::logic_error { "response not owned by a connection" };
+
+  _deferred = true;
+  _streaming = true;
+
+  return _streamFactory();
+}
 
-  return res;
+// ----------------------------------------------------------------------------
+// HttpResponse::reset
+// ----------------------------------------------------------------------------
+void HttpResponse::reset() {
+  _status = 0;
+  _deferred = false;
+  _streaming = false;
+  _webSocket.reset();
+  _headers.reset();
+  _body = {}; // do not keep the memory of a big body
+  _strings.release();
+  _retained.reset();
 }
 
 }
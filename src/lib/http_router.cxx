@@ -0,0 +1,162 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <lightning/http_router.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// HttpRouter::add
+// ----------------------------------------------------------------------------
+void HttpRouter::add (std::string_view path, RequestHandler &&handler, BodyHandler &&onBody) {
+  Node *node { &_root };
+
+  while (!path.empty()) {
+    if (path[0] == ':') {
+      const auto name { path.substr (1, path.find ('/') - 1) };
+
+      if (name.empty())
+        throw std::invalid_argument ("route parameter without name");
+
+      if (!node->param) {
+        node->param = std::make_unique<Node>();
+        node->paramName = name;
+      }
+      else if (node->paramName != name) {
+        throw std::invalid_argument ("route parameter :" + std::string { name } + " conflicts with :" + node->paramName);
+      }
+
+      node = node->param.get();
+      path.remove_prefix (name.size() + 1);
+    }
+    else if (path[0] == '*') {
+      const auto name { path.substr (1) };
+
+      if (name.find ('/') != std::string_view::npos)
+        throw std::invalid_argument ("route wildcard must be the last element");
+
+      if (!node->wildcard) {
+        node->wildcard = std::make_unique<Node>();
+        node->wildcardName = name;
+      }
+      else if (node->wildcardName != name) {
+        throw std::invalid_argument ("route wildcard *" + std::string { name } + " conflicts with *" + node->wildcardName);
+      }
+
+      node = node->wildcard.get();
+      path = {};
+    }
+    else {
+      const auto text { path.substr (0, path.find_first_of (":*")) };
+
+      node = _insertStatic (node, text);
+      path.remove_prefix (text.size());
+    }
+  }
+
+  if (node->route.handler)
+    throw std::invalid_argument ("duplicated route");
+
+  node->route = { std::move (handler), std::move (onBody) };
+}
+
+// ----------------------------------------------------------------------------
+// HttpRouter::find
+// ----------------------------------------------------------------------------
+const HttpRoute * HttpRouter::find (std::string_view path, HttpParams &params) const {
+  params.clear();
+
+  return _match (_root, path, params);
+}
+
+// ----------------------------------------------------------------------------
+// HttpRouter::_insertStatic
+// ----------------------------------------------------------------------------
+HttpRouter::Node * HttpRouter::_insertStatic (Node *node, std::string_view text) {
+  while (!text.empty()) {
+    const auto pos { node->indices.find (text[0]) };
+
+    if (pos == std::string::npos) {
+      auto child { std::make_unique<Node>() };
+      child->prefix = text;
+
+      node->indices.push_back (text[0]);
+      node->children.push_back (std::move (child));
+
+      return node->children.back().get();
+    }
+
+    Node *child { node->children[pos].get() };
+
+    const auto common {
+      static_cast<size_t> (std::mismatch (child->prefix.begin(), child->prefix.end(), text.begin(), text.end()).first - child->prefix.begin())
+    };
+
+    if (common < child->prefix.size()) {
+      // split the child: it keeps the common part and the rest goes down one level
+      auto rest { std::make_unique<Node>() };
+      std::swap (*rest, *child);
+
+      child->prefix = rest->prefix.substr (0, common);
+      rest->prefix.erase (0, common);
+
+      child->indices.push_back (rest->prefix[0]);
+      child->children.push_back (std::move (rest));
+    }
+
+    node = child;
+    text.remove_prefix (common);
+  }
+
+  return node;
+}
+
+// ----------------------------------------------------------------------------
+// HttpRouter::_match
+// ----------------------------------------------------------------------------
+// Every character of the path is compared once unless a static branch fails deeper
+// in the tree, in which case the parameter (then the wildcard) of the node is tried.
+const HttpRoute * HttpRouter::_match (const Node &node, std::string_view path, HttpParams &params) {
+  if (path.empty()) {
+    if (node.route.handler)
+      return &node.route;
+  }
+  else if (const auto pos = node.indices.find (path[0]); pos != std::string::npos) {
+    const Node &child { *node.children[pos] };
+
+    if (path.starts_with (child.prefix)) {
+      if (const auto route = _match (child, path.substr (child.prefix.size()), params))
+        return route;
+    }
+  }
+
+  if (node.param && !path.empty()) {
+    const auto value { path.substr (0, path.find ('/')) };
+
+    if (!value.empty()) {
+      params.push_back ({ node.paramName, value });
+
+      if (const auto route = _match (*node.param, path.substr (value.size()), params))
+        return route;
+
+      params.pop_back();
+    }
+  }
+
+  if (node.wildcard && node.wildcard->route.handler) {
+    params.push_back ({ node.wildcardName, path });
+
+    return &node.wildcard->route;
+  }
+
+  return nullptr;
+}
+
+}
@@ -3,122 +3,477 @@
 //
 // Copyright (c) 2024 Carlos Carrasco
 // ----------------------------------------------------------------------------
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
 #include <iostream>
 
-#include <lightning/http_connection.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#endif
+
+#include <lightning/buffer_pool.h>
 #include <lightning/http_server.h>
 
 
 namespace lightning {
 
+#ifdef SO_REUSEPORT
+using ReusePort = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+// ----------------------------------------------------------------------------
+// pinThread
+// ----------------------------------------------------------------------------
+static bool pinThread (std::thread &thread, size_t index) {
+#ifdef __linux__
+  const size_t cores { std::max (std::thread::hardware_concurrency(), 1u) };
+
+  cpu_set_t cpus;
+  CPU_ZERO (&cpus);
+  CPU_SET (index % cores, &cpus);
+
+  return pthread_setaffinity_np (thread.native_handle(), sizeof (cpus), &cpus) == 0;
+#else
+  (void) thread;
+  (void) index;
+
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// adoptSocket
+// ----------------------------------------------------------------------------
+// A socket of `io` for a connection accepted by a ring (the server listens on IPv4)
+static asio::ip::tcp::socket adoptSocket (asio::io_context &io, int fd) {
+  asio::ip::tcp::socket socket { io };
+
+  // a new socket, so it cannot fail
+  asio::error_code ignored;
+  socket.assign (asio::ip::tcp::v4(), fd, ignored);
+
+  return socket;
+}
+
+// ----------------------------------------------------------------------------
+// configureSessions
+// ----------------------------------------------------------------------------
+// Session resumption: a server-side cache (session IDs, and TLS 1.3 tickets that refer
+// to it) and stateless tickets, encrypted with keys that OpenSSL generates for the context.
+static void configureSessions (asio::ssl::context &tls, const HttpConfig &config) {
+  static constexpr std::string_view kSessionContext { "lightning" };
+
+  SSL_CTX *ctx { tls.native_handle() };
+
+  SSL_CTX_set_session_id_context (ctx, reinterpret_cast<const unsigned char *> (kSessionContext.data()), kSessionContext.size());
+  SSL_CTX_set_timeout (ctx, static_cast<long> (config.tlsSessionTimeout.count()));
+
+  if (config.tlsSessionCacheSize > 0) {
+    SSL_CTX_set_session_cache_mode (ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size (ctx, static_cast<long> (config.tlsSessionCacheSize));
+  }
+  else {
+    SSL_CTX_set_session_cache_mode (ctx, SSL_SESS_CACHE_OFF);
+  }
+
+  if (config.tlsSessionTickets)
+    SSL_CTX_clear_options (ctx, SSL_OP_NO_TICKET);
+  else
+    SSL_CTX_set_options (ctx, SSL_OP_NO_TICKET);
+}
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+HttpServer::HttpServer (uint16_t port, std::size_t poolSize, LogLevel logLevel, const HttpConfig &config):
+  HttpServer { port, poolSize, logLevel, config, std::nullopt }
+{
+  // empty
+}
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+HttpServer::HttpServer (uint16_t port, std::size_t poolSize, LogLevel logLevel, asio::ssl::context &&tls, const HttpConfig &config):
+  HttpServer { port, poolSize, logLevel, config, std::optional<asio::ssl::context> { std::move (tls) } }
+{
+  // empty
+}
+
 // ----------------------------------------------------------------------------
 // Constructor
 // ----------------------------------------------------------------------------
-HttpServer::HttpServer (uint16_t port, std::size_t poolSize, LogLevel logLevel): _logger { logLevel } {
+HttpServer::HttpServer (
+  uint16_t port,
+  std::size_t poolSize,
+  LogLevel logLevel,
+  const HttpConfig &config,
+  std::optional<asio::ssl::context> &&tls
+):
+  _logger { logLevel },
+  _config { config },
+  _tls { std::move (tls) },
+  _routeNotFound { [] (const HttpRequest &, HttpResponse &response) {
+    response.headers().set ("Content-Type", "text/plain; charset=utf-8");
+    response.status (404).send ("Not found");
+  }, nullptr }
+{
   _logger.transport (cxxlog::transport::OutputStream { std::cout });
 
+#ifdef SIGPIPE
+  // sendfile(2) and OpenSSL write to the sockets without MSG_NOSIGNAL: a client that is gone
+  // must be an EPIPE error, not a signal that terminates the process
+  std::signal (SIGPIPE, SIG_IGN);
+#endif
+
+  if (_tls)
+    configureSessions (*_tls, _config);
+
   asio::ip::tcp::endpoint ep { asio::ip::tcp::v4(), port };
 
   ep.address (asio::ip::address::from_string ("127.0.0.1"));
 
-  _acceptor.open (ep.protocol());
+  poolSize = std::max<std::size_t> (poolSize, 1);
+
+  const std::size_t numWorkers { _config.sharded ? poolSize : 1 };
+
+#ifdef SO_REUSEPORT
+  _reusePort = _config.sharded;
+#else
+  if (_config.sharded)
+    _logger.warn ("SO_REUSEPORT not available, sockets are handed to the workers round-robin");
+#endif
+
+  _workers.reserve (numWorkers);
+  for (std::size_t i = 0; i < numWorkers; ++i) {
+    auto &worker { _workers.emplace_back (std::make_unique<Worker>()) };
 
-  _acceptor.set_option (asio::ip::tcp::acceptor::reuse_address (true));
+    if (_config.ioUring) {
+      std::error_code ec;
+      worker->ring = IoUring::create (worker->ioContext, _config.ioUringEntries, _config.ioUringBuffers, _config.inputBufferSize, ec);
+
+      if (!worker->ring)
+        _logger.warn ("io_uring not available ({}), worker {} uses epoll", ec.message(), i);
+    }
+
+    worker->connections = std::make_shared<HttpConnectionPool> (
+      [ this ] (HttpRequest &request) -> const HttpRoute & { return _findRoute (request); },
+      [ this ] { _connectionClosed(); },
+      worker->timers,
+      _config,
+      _logger,
+      _tls ? &*_tls : nullptr,
+      worker->ring.get()
+    );
+  }
 
-  _acceptor.bind (ep);
-  _acceptor.listen (asio::socket_base::max_connections);
+  for (auto &worker: _workers) {
+    // without SO_REUSEPORT the first acceptor feeds every worker
+    if (_reusePort || (worker == _workers.front())) {
+      _listen (*worker, ep);
+      _acceptNext (*worker);
+    }
+  }
 
-  _acceptNext();
+  for (std::size_t i = 0; i < poolSize; ++i) {
+    auto &worker { *_workers[i % numWorkers] };
+    auto &thread { worker.threads.emplace_back ([ &worker ] { worker.ioContext.run(); }) };
 
-  _asioPool.reserve (poolSize);
-  for (std::size_t i = 0; i < poolSize; ++i)
-    _asioPool.emplace_back ([ this ] { _ioService.run(); });
+    if (_config.sharded && _config.pinWorkers && !pinThread (thread, i))
+      _logger.warn ("unable to pin worker {} to a core", i);
+  }
 
-  _logger.info ("Listening, port={}", port);
+  _logger.info ("Listening, port={} threads={} sharded={} tls={} io_uring={}", port, poolSize, _config.sharded, _tls.has_value(), ioUring());
 }
 
 // ----------------------------------------------------------------------------
 // Destructor
 // ----------------------------------------------------------------------------
 HttpServer::~HttpServer () {
-  _ioService.post ([ & ] { _acceptor.close(); });
+  for (auto &worker: _workers) {
+    asio::post (worker->ioContext, [ &worker ] {
+#ifdef __linux__
+      // the ring holds the listening socket while it accepts: the shutdown ends the accept
+      if (worker->ring && worker->acceptor.is_open()) {
+        worker->ring->submit();
+        ::shutdown (worker->acceptor.native_handle(), SHUT_RDWR);
+      }
+#endif
 
-  for (auto &t: _asioPool) {
-    t.join();
+      worker->acceptor.close();
+    });
+  }
+
+  for (auto &worker: _workers) {
+    for (auto &t: worker->threads)
+      t.join();
   }
 }
 
 // ----------------------------------------------------------------------------
-// HttpServer:addRoute
+// HttpServer::memoryUsage
 // ----------------------------------------------------------------------------
-void HttpServer::addRoute (HttpMethod method, std::string_view path, RequestHandler &&handler) {
+HttpMemoryUsage HttpServer::memoryUsage() const {
+  HttpMemoryUsage usage {};
+
+  for (const auto &worker: _workers) {
+    usage.connections += worker->connections->active();
+    usage.pooledConnections += worker->connections->size();
+  }
+
+  const auto buffers { BufferPool::stats() };
+
+  usage.connectionBytes = (usage.connections + usage.pooledConnections) * (sizeof (HttpConnection) + _config.arenaSize);
+  usage.inputBufferBytes = buffers.usedBytes;
+  usage.cachedBufferBytes = buffers.cachedBytes;
+
+  return usage;
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer:_addRoute
+// ----------------------------------------------------------------------------
+void HttpServer::_addRoute (HttpMethod method, std::string_view path, RequestHandler &&handler, BodyHandler &&onBody) {
   const auto index { static_cast<decltype(_routes)::size_type> (method) };
 
-  _routes[index].push_back (Route { path, handler });
+  _routes[index].add (path, std::move (handler), std::move (onBody));
 }
 
+// ----------------------------------------------------------------------------
+// HttpServer::_addCachedRoute
+// ----------------------------------------------------------------------------
+std::shared_ptr<HttpResponseCache> HttpServer::_addCachedRoute (
+  HttpMethod method,
+  std::string_view path,
+  RequestHandler &&handler,
+  const HttpCacheConfig &config
+) {
+  const auto cache { std::make_shared<HttpResponseCache> (config, _config.autoETag) };
 
+  _addRoute (method, path, [ cache, handler = std::move (handler) ] (const HttpRequest &request, HttpResponse &response) {
+    cache->handle (request, response, handler);
+  }, nullptr);
+
+  return cache;
+}
 
 // ----------------------------------------------------------------------------
-// HttpServer::_acceptNext
+// HttpServer::addStaticRoute
 // ----------------------------------------------------------------------------
-void HttpServer::_acceptNext () {
-  _acceptor.async_accept (
-    _socket,
-    [ this ] (const auto errCode) {
-      _logger.debug ("accepting {} ...", errCode.value());
+void HttpServer::addStaticRoute (std::string_view prefix, const std::filesystem::path &directory, const HttpStaticConfig &config) {
+  const auto files { std::make_shared<HttpStaticFiles> (directory, config) };
+
+  std::string path { prefix };
+  if (path.empty() || (path.back() != '/'))
+    path.push_back ('/');
+
+  path.append ("*path");
+
+  for (const auto method: { HttpMethod::kGet, HttpMethod::kHead }) {
+    _addRoute (method, path, [ files ] (const HttpRequest &request, HttpResponse &response) {
+      files->serve (request, response);
+    }, nullptr);
+  }
+}
 
-      if (_acceptor.is_open()) {
-        if (!errCode) {
-          _logger.debug ("creating connection ...");
-
-          const auto connection = std::make_shared<HttpConnection> (
-            std::move (_socket),
-            [ this ] (const HttpRequest &request, HttpResponse &response) {
-              _logger.debug ("handling connection ...");
-              if (const auto handler = _find (request); handler.has_value()) {
-                handler.value() (request, response);
-              }
-              else {
-                if (_routeNotFound == nullptr) {
-                  response.headers().set ("Content-Type", "text/plain; charset=utf-8");
-                  response.status (404).send ("Not found");
-                }
-                else {
-                  _routeNotFound (request, response);
-                }
-              }
-            },
-            _logger
-          );
-
-          if (connection)
-            connection->waitForHttpMessage();
+// ----------------------------------------------------------------------------
+// HttpServer::addWebSocketRoute
+// ----------------------------------------------------------------------------
+void HttpServer::addWebSocketRoute (std::string_view path, WebSocketHandler handler) {
+  const auto shared { std::make_shared<const WebSocketHandler> (std::move (handler)) };
+
+  _addRoute (HttpMethod::kGet, path, [ shared ] (const HttpRequest &request, HttpResponse &response) {
+    if (WebSocket::accept (request, response))
+      response.upgrade (shared);
+  }, nullptr);
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer::_makeAsync
+// ----------------------------------------------------------------------------
+RequestHandler HttpServer::_makeAsync (AsyncRequestHandler &&handler) {
+  return [ handler = std::move (handler) ] (const HttpRequest &request, HttpResponse &response) {
+    auto responder { response.defer() };
+    const auto executor { responder.executor() };
+
+    // the coroutine runs on the connection's executor and the response is written when it completes
+    asio::co_spawn (
+      executor,
+      handler (request, response),
+      [ &response, responder = std::move (responder) ] (std::exception_ptr e) mutable {
+        if (e) {
+          response.reset();
+          response.status (500).send ("");
         }
 
-        this->_acceptNext();
+        responder.finish();
       }
+    );
+  };
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer::_listen
+// ----------------------------------------------------------------------------
+void HttpServer::_listen (Worker &worker, const asio::ip::tcp::endpoint &ep) {
+  worker.acceptor.open (ep.protocol());
+
+  worker.acceptor.set_option (asio::ip::tcp::acceptor::reuse_address (true));
+
+#ifdef SO_REUSEPORT
+  if (_reusePort)
+    worker.acceptor.set_option (ReusePort (true));
+#endif
+
+  worker.acceptor.bind (ep);
+  worker.acceptor.listen (asio::socket_base::max_connections);
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer::_acceptNext
+// ----------------------------------------------------------------------------
+void HttpServer::_acceptNext (Worker &worker) {
+  if (!worker.acceptor.is_open())
+    return;
+
+  // without a limit of connections, a multishot accept takes all of them
+  if (worker.ring && worker.multishotAccept && (_config.maxConnections == 0))
+    return _acceptMultishot (worker);
+
+  // a slot is taken for the connection before accepting it, so the limit is never exceeded
+  if (_config.maxConnections > 0) {
+    std::lock_guard lock { _acceptMutex };
+
+    if (_openConnections >= _config.maxConnections) {
+      _logger.debug ("too many connections, accepting paused");
+
+      worker.acceptPaused = true; // resumed by _connectionClosed
+      return;
+    }
+
+    ++_openConnections;
+  }
+  else {
+    ++_openConnections;
+  }
+
+  // the new socket is bound to the io_context of the worker that will own the connection
+  auto &target { _reusePort ? worker : *_workers[_nextWorker++ % _workers.size()] };
+
+  if (worker.ring) {
+    worker.ring->accept (worker.acceptor.native_handle(), false, [ this, &worker, &target ] (int result, bool) {
+      _logger.debug ("accepting {} ...", result);
+
+      if (result < 0)
+        _connectionClosed();
+      else
+        _accepted (worker, target, adoptSocket (target.ioContext, result));
+
+      _acceptNext (worker);
+    });
+
+    return;
+  }
+
+  worker.acceptor.async_accept (
+    target.ioContext,
+    [ this, &worker, &target ] (const auto errCode, asio::ip::tcp::socket socket) {
+      _logger.debug ("accepting {} ...", errCode.value());
+
+      if (errCode)
+        _connectionClosed();
+      else
+        _accepted (worker, target, std::move (socket));
+
+      this->_acceptNext (worker);
     }
   );
 }
 
 // ----------------------------------------------------------------------------
-// HttpServer::_find
+// HttpServer::_acceptMultishot
 // ----------------------------------------------------------------------------
-std::optional<RequestHandler> HttpServer::_find (const HttpRequest &request) const {
-  const auto index { static_cast<decltype(_routes)::size_type> (request.method) };
+// A single accept of the ring completes for every connection, until it fails. There
+// is no limit of connections, so no slot is taken before accepting them.
+void HttpServer::_acceptMultishot (Worker &worker) {
+  worker.ring->accept (worker.acceptor.native_handle(), true, [ this, &worker ] (int result, bool more) {
+    _logger.debug ("accepting {} ...", result);
 
-  _logger.debug ("searching {} ...", request.path);
+    if (result >= 0) {
+      ++_openConnections;
+
+      auto &target { _reusePort ? worker : *_workers[_nextWorker++ % _workers.size()] };
+      _accepted (worker, target, adoptSocket (target.ioContext, result));
+    }
+
+    if (more)
+      return;
+
+    // refused by kernels without multishot accepts (an open acceptor is still valid)
+    if ((result == -EINVAL) && worker.acceptor.is_open()) {
+      _logger.debug ("multishot accept not supported");
+      worker.multishotAccept = false;
+    }
 
-  // FIXME: replace vector by unordered_map
-  const auto it = std::find_if (_routes[index].begin(), _routes[index].end(), [ &request ] (const Route &r) {
-    return request.path.compare (r.path.data()) == 0;
+    _acceptNext (worker);
   });
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer::_accepted
+// ----------------------------------------------------------------------------
+void HttpServer::_accepted (Worker &worker, Worker &target, asio::ip::tcp::socket &&socket) {
+  if (!worker.acceptor.is_open()) {
+    _connectionClosed();
+    return;
+  }
+
+  _logger.debug ("creating connection ...");
+
+  const auto connection { target.connections->acquire (std::move (socket)) };
+
+  if (&target == &worker)
+    connection->start();
+  else
+    asio::post (target.ioContext, [ connection ] { connection->start(); });
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer::_connectionClosed
+// ----------------------------------------------------------------------------
+void HttpServer::_connectionClosed() {
+  if (_config.maxConnections == 0) {
+    --_openConnections;
+    return;
+  }
+
+  std::lock_guard lock { _acceptMutex };
+
+  --_openConnections;
+
+  for (auto &worker: _workers) {
+    if (worker->acceptPaused) {
+      worker->acceptPaused = false;
+      asio::post (worker->ioContext, [ this, &worker = *worker ] { _acceptNext (worker); });
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// HttpServer::_findRoute
+// ----------------------------------------------------------------------------
+const HttpRoute & HttpServer::_findRoute (HttpRequest &request) const {
+  const auto index { static_cast<decltype(_routes)::size_type> (request.method) };
+
+  _logger.debug ("searching {} ...", request.path);
 
-  if (it == _routes[index].end())
-    return std::nullopt;
+  if (const auto route = _routes[index].find (request.path, request.params); route != nullptr)
+    return *route;
 
-  return { it->handler };
+  return _routeNotFound;
 }
 
 }
@@ -0,0 +1,232 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <utility>
+
+#include <sys/stat.h>
+
+#include <lightning/http_compression.h>
+#include <lightning/http_static.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+HttpStaticFiles::HttpStaticFiles (std::filesystem::path root, const HttpStaticConfig &config):
+  _root { std::move (root) },
+  _config { config }
+{
+  // empty
+}
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles::serve
+// ----------------------------------------------------------------------------
+void HttpStaticFiles::serve (const HttpRequest &request, HttpResponse &response) {
+  auto path { decodePath (request.params.get ("path").value_or ("")) };
+
+  if (!path) {
+    response.status (400).send ("Bad request");
+    return;
+  }
+
+  if (path->empty() || (path->back() == '/'))
+    path->append (_config.indexFile);
+
+  const auto [ file, gzip, compressed ] { _find (*path) };
+
+  if (!file) {
+    response.status (404).send ("Not found");
+    return;
+  }
+
+  auto &headers { response.headers() };
+  auto body { file };
+  auto bodyCompressed { compressed };
+
+  if (gzip) {
+    const auto acceptEncoding { request.headers.get (HttpHeaderName::kAcceptEncoding) };
+
+    if (acceptEncoding && (HttpCompression::negotiate (*acceptEncoding) == HttpCompression::Encoding::kGzip)) {
+      body = gzip;
+      bodyCompressed.reset();
+      headers.set (HttpHeaderName::kContentEncoding, "gzip");
+    }
+
+    headers.set (HttpHeaderName::kVary, "Accept-Encoding");
+  }
+
+  // the body may be dropped before the headers are written (e.g. a 304), so the values are copied
+  headers.set (HttpHeaderName::kLastModified, response.store (body->lastModified()));
+  headers.set (HttpHeaderName::kETag, response.store (body->etag()));
+  headers.set (HttpHeaderName::kAcceptRanges, "bytes");
+  headers.set (HttpHeaderName::kContentType, file->contentType()); // of the original, not of its .gz
+
+  // HEAD as well: the connection writes the headers of the GET response only
+  response.status (200).send (std::move (body), std::move (bodyCompressed));
+}
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles::find
+// ----------------------------------------------------------------------------
+std::shared_ptr<const StaticFile> HttpStaticFiles::find (const std::string &path) {
+  return _find (path).file;
+}
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles::findWithGzip
+// ----------------------------------------------------------------------------
+std::pair<std::shared_ptr<const StaticFile>, std::shared_ptr<const StaticFile>> HttpStaticFiles::findWithGzip (const std::string &path) {
+  auto found { _find (path) };
+
+  return { std::move (found.file), std::move (found.gzip) };
+}
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles::_find
+// ----------------------------------------------------------------------------
+HttpStaticFiles::Found HttpStaticFiles::_find (const std::string &path) {
+  const auto now { std::chrono::steady_clock::now() };
+  Found cached;
+
+  {
+    std::lock_guard lock { _mutex };
+
+    if (const auto it { _files.find (path) }; it != _files.end()) {
+      _lru.splice (_lru.begin(), _lru, it->second.lru);
+
+      if (now - it->second.checked < _config.revalidateAfter)
+        return it->second.found;
+
+      cached = it->second.found;
+    }
+  }
+
+  // the file system is only accessed outside the lock
+  const auto fullPath { _root / path };
+  struct stat st;
+
+  if ((::stat (fullPath.c_str(), &st) != 0) || !S_ISREG (st.st_mode)) {
+    std::lock_guard lock { _mutex };
+
+    if (const auto it { _files.find (path) }; it != _files.end()) {
+      _lru.erase (it->second.lru);
+      _files.erase (it);
+    }
+
+    return {};
+  }
+
+  std::shared_ptr<const StaticFile> gzip;
+
+  if (_config.precompressed) {
+    auto gzipPath { fullPath };
+    gzipPath += ".gz";
+
+    struct stat gzipSt;
+
+    if ((::stat (gzipPath.c_str(), &gzipSt) == 0) && S_ISREG (gzipSt.st_mode))
+      gzip = (cached.gzip && !cached.gzip->changed (gzipSt)) ? cached.gzip : StaticFile::open (gzipPath, _config.mmapThreshold);
+  }
+
+  if (cached.file && !cached.file->changed (st)) {
+    cached.gzip = gzip;
+
+    std::lock_guard lock { _mutex };
+
+    if (const auto it { _files.find (path) }; (it != _files.end()) && (it->second.found.file == cached.file)) {
+      it->second.found.gzip = gzip;
+      it->second.checked = now;
+    }
+
+    return cached;
+  }
+
+  // a new file: what was compressed from the old one is not valid anymore
+  Found found { StaticFile::open (fullPath, _config.mmapThreshold), std::move (gzip), std::make_shared<HttpCompressedBodies>() };
+
+  if (!found.file)
+    return {};
+
+  _insert (path, found);
+
+  return found;
+}
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles::decodePath
+// ----------------------------------------------------------------------------
+std::optional<std::string> HttpStaticFiles::decodePath (std::string_view path) {
+  std::string decoded;
+  decoded.reserve (path.size());
+
+  for (size_t i { 0 }; i < path.size(); ++i) {
+    if (path[i] != '%') {
+      decoded.push_back (path[i]);
+      continue;
+    }
+
+    if (i + 2 >= path.size())
+      return std::nullopt;
+
+    const int high { StringUtil::hexValue (path[i + 1]) };
+    const int low { StringUtil::hexValue (path[i + 2]) };
+
+    if ((high < 0) || (low < 0))
+      return std::nullopt;
+
+    decoded.push_back (static_cast<char> (high * 16 + low));
+    i += 2;
+  }
+
+  // relative to the root, whatever the number of leading slashes
+  const auto start { decoded.find_first_not_of ('/') };
+  decoded.erase (0, (start == std::string::npos) ? decoded.size() : start);
+
+  if (decoded.find ('\0') != std::string::npos)
+    return std::nullopt;
+
+  for (size_t pos { 0 }; pos <= decoded.size();) {
+    const auto end { std::min (decoded.find ('/', pos), decoded.size()) };
+
+    if (std::string_view { decoded }.substr (pos, end - pos) == "..")
+      return std::nullopt;
+
+    pos = end + 1;
+  }
+
+  return decoded;
+}
+
+// ----------------------------------------------------------------------------
+// HttpStaticFiles::_insert
+// ----------------------------------------------------------------------------
+void HttpStaticFiles::_insert (const std::string &path, const Found &found) {
+  const auto now { std::chrono::steady_clock::now() };
+
+  std::lock_guard lock { _mutex };
+
+  if (const auto it { _files.find (path) }; it != _files.end()) {
+    it->second.found = found;
+    it->second.checked = now;
+    _lru.splice (_lru.begin(), _lru, it->second.lru);
+
+    return;
+  }
+
+  _lru.push_front (path);
+  _files.emplace (path, Entry { found, now, _lru.begin() });
+
+  // files still being sent stay open until their responses have been written
+  while (_files.size() > _config.maxOpenFiles) {
+    _files.erase (_lru.back());
+    _lru.pop_back();
+  }
+}
+
+}
@@ -0,0 +1,151 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <lightning/http_url_encoded.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// escaped
+// ----------------------------------------------------------------------------
+static inline bool escaped (std::string_view text) {
+  return text.find_first_of ("%+") != std::string_view::npos;
+}
+
+// ----------------------------------------------------------------------------
+// decodeNext
+// ----------------------------------------------------------------------------
+// Decodes the character at `pos` of an encoded text and moves past it
+static inline char decodeNext (std::string_view encoded, size_t &pos) {
+  const char c { encoded[pos++] };
+
+  if (c == '+')
+    return ' ';
+
+  if ((c == '%') && (pos + 1 < encoded.size())) {
+    const int hi { StringUtil::hexValue (encoded[pos]) };
+    const int lo { StringUtil::hexValue (encoded[pos + 1]) };
+
+    if ((hi >= 0) && (lo >= 0)) {
+      pos += 2;
+      return static_cast<char> ((hi << 4) | lo);
+    }
+  }
+
+  return c;
+}
+
+// ----------------------------------------------------------------------------
+// decodedEquals
+// ----------------------------------------------------------------------------
+// Compares an encoded text with a plain one, decoding it on the fly
+static bool decodedEquals (std::string_view encoded, std::string_view plain) {
+  size_t pos { 0 };
+
+  for (const char c: plain) {
+    if ((pos == encoded.size()) || (decodeNext (encoded, pos) != c))
+      return false;
+  }
+
+  return pos == encoded.size();
+}
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded::assign
+// ----------------------------------------------------------------------------
+void HttpUrlEncoded::assign (std::string_view source) {
+  _source = source;
+  _params.clear();
+  _parsed = false;
+}
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded::reset
+// ----------------------------------------------------------------------------
+void HttpUrlEncoded::reset() {
+  _source = {};
+  _params.reset();
+  _parsed = true;
+}
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded::_parse
+// ----------------------------------------------------------------------------
+// "name=value" pairs separated by "&"; empty ones are skipped
+void HttpUrlEncoded::_parse() const {
+  if (_parsed)
+    return;
+
+  _parsed = true;
+
+  std::string_view rest { _source };
+
+  while (!rest.empty()) {
+    const auto end { rest.find ('&') };
+    const auto pair { rest.substr (0, end) };
+
+    rest = (end == std::string_view::npos) ? std::string_view {} : rest.substr (end + 1);
+
+    if (pair.empty())
+      continue;
+
+    const auto equals { pair.find ('=') };
+
+    if (equals == std::string_view::npos)
+      _params.push_back ({ pair, {} });
+    else
+      _params.push_back ({ pair.substr (0, equals), pair.substr (equals + 1) });
+  }
+}
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded::get
+// ----------------------------------------------------------------------------
+std::optional<std::string_view> HttpUrlEncoded::get (std::string_view name) const {
+  for (const auto &p: *this) {
+    if (escaped (p.name) ? decodedEquals (p.name, name) : (p.name == name))
+      return { p.value };
+  }
+
+  return std::nullopt;
+}
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded::decoded
+// ----------------------------------------------------------------------------
+std::optional<std::string_view> HttpUrlEncoded::decoded (std::string_view name) const {
+  const auto raw { get (name) };
+
+  if (!raw || !escaped (*raw))
+    return raw;
+
+  // decoding never makes it longer
+  auto *data { static_cast<char *> (_resource->allocate (raw->size(), alignof (char))) };
+
+  return decode (*raw, { data, raw->size() });
+}
+
+// ----------------------------------------------------------------------------
+// HttpUrlEncoded::decode
+// ----------------------------------------------------------------------------
+std::optional<std::string_view> HttpUrlEncoded::decode (std::string_view encoded, std::span<char> buffer) {
+  if (!escaped (encoded))
+    return encoded;
+
+  size_t length { 0 };
+
+  for (size_t pos { 0 }; pos < encoded.size(); ) {
+    if (length == buffer.size())
+      return std::nullopt;
+
+    buffer[length++] = decodeNext (encoded, pos);
+  }
+
+  return std::string_view { buffer.data(), length };
+}
+
+}
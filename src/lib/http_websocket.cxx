@@ -0,0 +1,281 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LIGHTNING_WEBSOCKET_SIMD
+#include <immintrin.h>
+#endif
+
+#include <openssl/sha.h>
+
+#include <lightning/http_request.h>
+#include <lightning/http_response.h>
+#include <lightning/http_websocket.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// base64
+// ----------------------------------------------------------------------------
+static std::string base64 (const uint8_t *data, size_t size) {
+  static constexpr char kAlphabet[] { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" };
+
+  std::string out;
+  out.reserve ((size + 2) / 3 * 4);
+
+  for (size_t i { 0 }; i < size; i += 3) {
+    const uint32_t n {
+      (uint32_t { data[i] } << 16) |
+      ((i + 1 < size) ? (uint32_t { data[i + 1] } << 8) : 0) |
+      ((i + 2 < size) ? uint32_t { data[i + 2] } : 0)
+    };
+
+    out.push_back (kAlphabet[(n >> 18) & 0x3f]);
+    out.push_back (kAlphabet[(n >> 12) & 0x3f]);
+    out.push_back ((i + 1 < size) ? kAlphabet[(n >> 6) & 0x3f] : '=');
+    out.push_back ((i + 2 < size) ? kAlphabet[n & 0x3f] : '=');
+  }
+
+  return out;
+}
+
+#ifdef LIGHTNING_WEBSOCKET_SIMD
+// ----------------------------------------------------------------------------
+// unmaskAvx2
+// ----------------------------------------------------------------------------
+// Returns the bytes processed (a multiple of 32)
+__attribute__ ((target ("avx2")))
+static size_t unmaskAvx2 (char *data, size_t size, uint32_t key) {
+  const __m256i mask { _mm256_set1_epi32 (static_cast<int> (key)) };
+  size_t i { 0 };
+
+  for (; i + 32 <= size; i += 32) {
+    auto *p { reinterpret_cast<__m256i *> (data + i) };
+    _mm256_storeu_si256 (p, _mm256_xor_si256 (_mm256_loadu_si256 (p), mask));
+  }
+
+  return i;
+}
+
+// ----------------------------------------------------------------------------
+// unmaskSse2
+// ----------------------------------------------------------------------------
+// Returns the bytes processed (a multiple of 16). SSE2 is part of x86-64.
+static size_t unmaskSse2 (char *data, size_t size, uint32_t key) {
+  const __m128i mask { _mm_set1_epi32 (static_cast<int> (key)) };
+  size_t i { 0 };
+
+  for (; i + 16 <= size; i += 16) {
+    auto *p { reinterpret_cast<__m128i *> (data + i) };
+    _mm_storeu_si128 (p, _mm_xor_si128 (_mm_loadu_si128 (p), mask));
+  }
+
+  return i;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// WebSocket::close
+// ----------------------------------------------------------------------------
+void WebSocket::close (uint16_t code, std::string_view reason) {
+  char payload[125];
+
+  payload[0] = static_cast<char> (code >> 8);
+  payload[1] = static_cast<char> (code & 0xff);
+
+  // control frames are limited to 125 bytes
+  reason = reason.substr (0, sizeof (payload) - 2);
+  std::copy (reason.begin(), reason.end(), payload + 2);
+
+  _stream.push (frame ({ payload, reason.size() + 2 }, WebSocketOpcode::kClose));
+  _stream.end();
+}
+
+// ----------------------------------------------------------------------------
+// WebSocket::frame
+// ----------------------------------------------------------------------------
+std::shared_ptr<const std::string> WebSocket::frame (std::string_view payload, WebSocketOpcode opcode) {
+  auto out { std::make_shared<std::string>() };
+  out->reserve (payload.size() + 10);
+
+  appendFrame (*out, payload, opcode);
+
+  return out;
+}
+
+// ----------------------------------------------------------------------------
+// WebSocket::appendFrame
+// ----------------------------------------------------------------------------
+void WebSocket::appendFrame (std::string &out, std::string_view payload, WebSocketOpcode opcode) {
+  const uint64_t size { payload.size() };
+
+  out.push_back (static_cast<char> (0x80 | static_cast<uint8_t> (opcode))); // FIN
+
+  if (size < 126) {
+    out.push_back (static_cast<char> (size));
+  }
+  else if (size <= 0xffff) {
+    out.push_back (126);
+    out.push_back (static_cast<char> (size >> 8));
+    out.push_back (static_cast<char> (size & 0xff));
+  }
+  else {
+    out.push_back (127);
+
+    for (int shift { 56 }; shift >= 0; shift -= 8)
+      out.push_back (static_cast<char> ((size >> shift) & 0xff));
+  }
+
+  out.append (payload);
+}
+
+// ----------------------------------------------------------------------------
+// WebSocket::accept
+// ----------------------------------------------------------------------------
+bool WebSocket::accept (const HttpRequest &request, HttpResponse &response) {
+  const auto &headers { request.headers };
+  const auto upgrade { headers.get (HttpHeaderName::kUpgrade) };
+  const auto connection { headers.get (HttpHeaderName::kConnection) };
+
+  if (!upgrade || !StringUtil::hasToken (*upgrade, "websocket") || !connection || !StringUtil::hasToken (*connection, "upgrade")) {
+    response.headers().set (HttpHeaderName::kUpgrade, "websocket");
+    response.status (426).send ("");
+    return false;
+  }
+
+  const auto version { headers.get (HttpHeaderName::kSecWebSocketVersion) };
+
+  if (!version || (StringUtil::trim (*version) != "13")) {
+    response.headers().set (HttpHeaderName::kSecWebSocketVersion, "13");
+    response.status (426).send ("");
+    return false;
+  }
+
+  // 16 random bytes, in base64
+  const auto key { headers.get (HttpHeaderName::kSecWebSocketKey) };
+
+  if (!key || (StringUtil::trim (*key).size() != 24) || (request.version.major != 1) || (request.version.minor != 1)) {
+    response.status (400).send ("");
+    return false;
+  }
+
+  response.headers().set (HttpHeaderName::kUpgrade, "websocket");
+  response.headers().set (HttpHeaderName::kConnection, "Upgrade");
+  response.headers().set (HttpHeaderName::kSecWebSocketAccept, response.store (acceptKey (StringUtil::trim (*key))));
+  response.status (101);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// WebSocket::acceptKey
+// ----------------------------------------------------------------------------
+std::string WebSocket::acceptKey (std::string_view key) {
+  constexpr std::string_view kGuid { "258EAFA5-E914-47DA-95CA-C5AB0DC85B11" };
+
+  char data[64];
+  key = key.substr (0, sizeof (data) - kGuid.size());
+
+  std::memcpy (data, key.data(), key.size());
+  std::memcpy (data + key.size(), kGuid.data(), kGuid.size());
+
+  // SHA-1 is only used here, where RFC 6455 mandates it
+  uint8_t digest[SHA_DIGEST_LENGTH];
+  ::SHA1 (reinterpret_cast<const unsigned char *> (data), key.size() + kGuid.size(), digest);
+
+  return base64 (digest, sizeof (digest));
+}
+
+// ----------------------------------------------------------------------------
+// WebSocket::unmask
+// ----------------------------------------------------------------------------
+void WebSocket::unmask (char *data, size_t size, const std::array<uint8_t, 4> &key, size_t offset) {
+  // the key, rotated so that its first byte applies to data[0]
+  uint8_t rotated[8];
+  for (size_t i { 0 }; i < sizeof (rotated); ++i)
+    rotated[i] = key[(offset + i) & 3];
+
+  uint32_t key32;
+  uint64_t key64;
+  std::memcpy (&key32, rotated, sizeof (key32));
+  std::memcpy (&key64, rotated, sizeof (key64));
+
+  // every step processes a multiple of 4 bytes, so the key stays aligned
+  size_t i { 0 };
+
+#ifdef LIGHTNING_WEBSOCKET_SIMD
+  static const bool avx2 { __builtin_cpu_supports ("avx2") != 0 };
+
+  if (avx2 && (size >= 32))
+    i = unmaskAvx2 (data, size, key32);
+
+  i += unmaskSse2 (data + i, size - i, key32);
+#endif
+
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy (&word, data + i, sizeof (word));
+    word ^= key64;
+    std::memcpy (data + i, &word, sizeof (word));
+  }
+
+  for (; i < size; ++i)
+    data[i] = static_cast<char> (data[i] ^ rotated[i & 3]);
+}
+
+// ----------------------------------------------------------------------------
+// WebSocketFrameHeader::parse
+// ----------------------------------------------------------------------------
+bool WebSocketFrameHeader::parse (std::string_view data, WebSocketFrameHeader &header) {
+  if (data.size() < 2)
+    return false;
+
+  const auto *p { reinterpret_cast<const uint8_t *> (data.data()) };
+
+  header.fin = (p[0] & 0x80) != 0;
+  header.rsv = p[0] & 0x70;
+  header.opcode = static_cast<WebSocketOpcode> (p[0] & 0x0f);
+  header.masked = (p[1] & 0x80) != 0;
+  header.payloadLength = p[1] & 0x7f;
+
+  size_t length { 2 };
+
+  if (header.payloadLength == 126) {
+    if (data.size() < 4)
+      return false;
+
+    header.payloadLength = (uint64_t { p[2] } << 8) | p[3];
+    length = 4;
+  }
+  else if (header.payloadLength == 127) {
+    if (data.size() < 10)
+      return false;
+
+    header.payloadLength = 0;
+    for (size_t i { 2 }; i < 10; ++i)
+      header.payloadLength = (header.payloadLength << 8) | p[i];
+
+    length = 10;
+  }
+
+  if (header.masked) {
+    if (data.size() < length + 4)
+      return false;
+
+    std::memcpy (header.key.data(), p + length, 4);
+    length += 4;
+  }
+
+  header.headerLength = length;
+
+  return true;
+}
+
+}
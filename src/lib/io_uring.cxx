@@ -0,0 +1,608 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#if defined (__linux__) && __has_include (<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <lightning/io_uring.h>
+
+// multishot accept and provided buffer rings came with Linux 5.19
+#ifdef IORING_ACCEPT_MULTISHOT
+#define LIGHTNING_HAS_IO_URING
+#endif
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+IoUring::IoUring (asio::io_context &io):
+  _executor { io.get_executor() },
+  _event { io }
+{
+  // empty
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_error
+// ----------------------------------------------------------------------------
+// A completion result as an error: -errno, or 0 for the end of a stream if `eof`
+std::error_code IoUring::_error (int result, bool eof) {
+  if (result < 0)
+    return std::error_code { -result, std::system_category() };
+
+  if ((result == 0) && eof)
+    return asio::error_code { asio::error::eof };
+
+  return {};
+}
+
+#ifdef LIGHTNING_HAS_IO_URING
+
+static constexpr uint16_t kBufferGroup { 0 };
+
+// ----------------------------------------------------------------------------
+// System calls (there is no wrapper in the C library)
+// ----------------------------------------------------------------------------
+static int setupRing (unsigned entries, io_uring_params &params) {
+  return static_cast<int> (::syscall (__NR_io_uring_setup, entries, &params));
+}
+
+static int enterRing (int fd, unsigned submit, unsigned flags = 0) {
+  return static_cast<int> (::syscall (__NR_io_uring_enter, fd, submit, 0, flags, nullptr, 0));
+}
+
+static int registerRing (int fd, unsigned opcode, void *arg, unsigned count) {
+  return static_cast<int> (::syscall (__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+static std::error_code lastError() {
+  return std::error_code { errno, std::system_category() };
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::create
+// ----------------------------------------------------------------------------
+std::unique_ptr<IoUring> IoUring::create (asio::io_context &io, size_t entries, size_t buffers, size_t bufferSize, std::error_code &ec) {
+  std::unique_ptr<IoUring> ring { new IoUring { io } };
+
+  ec = ring->_setup (entries);
+  if (ec)
+    return nullptr;
+
+  if ((buffers > 0) && (bufferSize > 0))
+    ring->_provideBuffers (buffers, bufferSize);
+
+  return ring;
+}
+
+// ----------------------------------------------------------------------------
+// Destructor
+// ----------------------------------------------------------------------------
+// The io_context is not running anymore: operations still in flight are dropped
+// with the ring.
+IoUring::~IoUring() {
+  asio::error_code ignored;
+  _event.close (ignored);
+
+  while (_operations != nullptr)
+    delete std::exchange (_operations, _operations->next);
+
+  if (_bufferRing != nullptr)
+    ::munmap (_bufferRing, _bufferRingSize);
+
+  if (_sqes != nullptr)
+    ::munmap (_sqes, _sqesSize);
+
+  if (_rings != nullptr)
+    ::munmap (_rings, _ringsSize);
+
+  if (_fd >= 0)
+    ::close (_fd);
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_setup
+// ----------------------------------------------------------------------------
+// Creates the ring and maps it. Kernels that lack any of the features or operations
+// used are refused, so the server falls back to the reactor of asio.
+std::error_code IoUring::_setup (size_t entries) {
+  io_uring_params params {};
+  params.flags = IORING_SETUP_CLAMP;
+
+  _fd = setupRing (static_cast<unsigned> (std::bit_ceil (std::max<size_t> (entries, 1))), params);
+  if (_fd < 0)
+    return lastError();
+
+  constexpr uint32_t kFeatures { IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL };
+
+  if ((params.features & kFeatures) != kFeatures)
+    return std::make_error_code (std::errc::not_supported);
+
+  constexpr unsigned kProbeOps { 256 };
+  std::vector<std::byte> probeBuffer (sizeof (io_uring_probe) + kProbeOps * sizeof (io_uring_probe_op));
+  auto *probe { reinterpret_cast<io_uring_probe *> (probeBuffer.data()) };
+
+  if (registerRing (_fd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0)
+    return lastError();
+
+  for (const unsigned op: { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG }) {
+    if ((op > probe->last_op) || ((probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0))
+      return std::make_error_code (std::errc::not_supported);
+  }
+
+  _ringsSize = std::max (
+    params.sq_off.array + params.sq_entries * sizeof (unsigned),
+    params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe)
+  );
+
+  _rings = ::mmap (nullptr, _ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+  if (_rings == MAP_FAILED) {
+    _rings = nullptr;
+    return lastError();
+  }
+
+  _sqesSize = params.sq_entries * sizeof (io_uring_sqe);
+  _sqes = ::mmap (nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+  if (_sqes == MAP_FAILED) {
+    _sqes = nullptr;
+    return lastError();
+  }
+
+  char *rings { static_cast<char *> (_rings) };
+
+  _sqHead = reinterpret_cast<unsigned *> (rings + params.sq_off.head);
+  _sqTail = reinterpret_cast<unsigned *> (rings + params.sq_off.tail);
+  _sqMask = *reinterpret_cast<unsigned *> (rings + params.sq_off.ring_mask);
+  _sqEntries = params.sq_entries;
+  _sqFlags = reinterpret_cast<unsigned *> (rings + params.sq_off.flags);
+
+  _cqHead = reinterpret_cast<unsigned *> (rings + params.cq_off.head);
+  _cqTail = reinterpret_cast<unsigned *> (rings + params.cq_off.tail);
+  _cqMask = *reinterpret_cast<unsigned *> (rings + params.cq_off.ring_mask);
+  _cqes = rings + params.cq_off.cqes;
+
+  // entries are always taken in order, so the indirection array is the identity
+  auto *array { reinterpret_cast<unsigned *> (rings + params.sq_off.array) };
+  for (unsigned i { 0 }; i < params.sq_entries; ++i)
+    array[i] = i;
+
+  int event { ::eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) };
+  if (event < 0)
+    return lastError();
+
+  asio::error_code ec;
+  _event.assign (event, ec);
+  if (ec) {
+    ::close (event);
+    return ec;
+  }
+
+  if (registerRing (_fd, IORING_REGISTER_EVENTFD, &event, 1) < 0)
+    return lastError();
+
+  return {};
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_provideBuffers
+// ----------------------------------------------------------------------------
+// Registers a ring of provided buffers (group 0). Without one, which is not an error,
+// receiveProvided() must not be used.
+void IoUring::_provideBuffers (size_t buffers, size_t bufferSize) {
+  const auto count { static_cast<unsigned> (std::bit_ceil (std::min<size_t> (buffers, 1u << 15))) };
+
+  _bufferRingSize = count * sizeof (io_uring_buf);
+
+  void *ring { ::mmap (nullptr, _bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) };
+  if (ring == MAP_FAILED)
+    return;
+
+  io_uring_buf_reg reg {};
+  reg.ring_addr = reinterpret_cast<uintptr_t> (ring);
+  reg.ring_entries = count;
+  reg.bgid = kBufferGroup;
+
+  if (registerRing (_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    ::munmap (ring, _bufferRingSize);
+    return;
+  }
+
+  _bufferRing = ring;
+  _buffers.reset (new char[count * bufferSize]);
+  _bufferSize = bufferSize;
+  _bufferCount = count;
+
+  for (unsigned id { 0 }; id < count; ++id)
+    _recycle (static_cast<uint16_t> (id));
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::accept
+// ----------------------------------------------------------------------------
+void IoUring::accept (int fd, bool multishot, AcceptHandler handler) {
+  auto *op { new AcceptOperation };
+  op->handler = std::move (handler);
+
+  std::lock_guard lock { _mutex };
+
+  _track (op);
+
+  int error;
+  auto *sqe { static_cast<io_uring_sqe *> (_entry (error)) };
+
+  if (sqe == nullptr)
+    return _fail (op, error);
+
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->ioprio = multishot ? IORING_ACCEPT_MULTISHOT : 0;
+  sqe->user_data = reinterpret_cast<uintptr_t> (op);
+
+  _queue();
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::AcceptOperation::complete
+// ----------------------------------------------------------------------------
+bool IoUring::AcceptOperation::complete (IoUring &, int result, uint32_t flags) {
+  const bool more { (flags & IORING_CQE_F_MORE) != 0 };
+
+  handler (result, more);
+
+  return !more;
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_receive
+// ----------------------------------------------------------------------------
+void IoUring::_receive (Operation *op, int fd, void *data, size_t size) {
+  std::lock_guard lock { _mutex };
+
+  _track (op);
+
+  int error;
+  auto *sqe { static_cast<io_uring_sqe *> (_entry (error)) };
+
+  if (sqe == nullptr)
+    return _fail (op, error);
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uintptr_t> (data);
+  sqe->len = static_cast<uint32_t> (std::min<size_t> (size, UINT32_MAX));
+  sqe->user_data = reinterpret_cast<uintptr_t> (op);
+
+  if (data == nullptr) {
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+  }
+
+  _queue();
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_send
+// ----------------------------------------------------------------------------
+// Sends (again, if `again`) the buffers of `op` that have not been sent yet.
+void IoUring::_send (SendOperation *op, bool again) {
+  if (op->first == op->iov.size()) {
+    op->done (*this, {});
+    delete op;
+
+    return;
+  }
+
+  op->message.msg_iov = op->iov.data() + op->first;
+  op->message.msg_iovlen = std::min<size_t> (op->iov.size() - op->first, IOV_MAX);
+
+  std::lock_guard lock { _mutex };
+
+  if (!again)
+    _track (op);
+
+  int error;
+  auto *sqe { static_cast<io_uring_sqe *> (_entry (error)) };
+
+  if (sqe == nullptr)
+    return _fail (op, error);
+
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = op->fd;
+  sqe->addr = reinterpret_cast<uintptr_t> (&op->message);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = reinterpret_cast<uintptr_t> (op);
+
+  _queue();
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::SendOperation::complete
+// ----------------------------------------------------------------------------
+bool IoUring::SendOperation::complete (IoUring &ring, int result, uint32_t) {
+  if (result < 0) {
+    done (ring, _error (result, false));
+    return true;
+  }
+
+  sent += static_cast<size_t> (result);
+
+  auto bytes { static_cast<size_t> (result) };
+
+  while ((first < iov.size()) && (bytes >= iov[first].iov_len))
+    bytes -= iov[first++].iov_len;
+
+  if (first == iov.size()) {
+    done (ring, {});
+    return true;
+  }
+
+  iov[first].iov_base = static_cast<char *> (iov[first].iov_base) + bytes;
+  iov[first].iov_len -= bytes;
+
+  ring._send (this, true);
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::submit
+// ----------------------------------------------------------------------------
+void IoUring::submit() {
+  std::lock_guard lock { _mutex };
+
+  _flushPosted = false;
+  _submit();
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_track
+// ----------------------------------------------------------------------------
+// Called with the mutex locked
+void IoUring::_track (Operation *op) {
+  op->prev = nullptr;
+  op->next = _operations;
+
+  if (_operations != nullptr)
+    _operations->prev = op;
+
+  _operations = op;
+  ++_pending;
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_entry
+// ----------------------------------------------------------------------------
+// Next free entry of the submission ring, cleared; the queued ones are submitted
+// first if it is full. If the kernel does not take them (EBUSY or EAGAIN, until the
+// completions are reaped) it returns nullptr and the error: waiting for room with the
+// mutex locked could block the thread that reaps them. Called with the mutex locked.
+void * IoUring::_entry (int &error) {
+  const unsigned tail { *_sqTail };
+  std::atomic_ref<unsigned> head { *_sqHead };
+
+  if (tail - head.load (std::memory_order_acquire) >= _sqEntries) {
+    error = _submit();
+
+    if (tail - head.load (std::memory_order_acquire) >= _sqEntries) {
+      if (error == 0)
+        error = EBUSY;
+
+      return nullptr;
+    }
+  }
+
+  auto *sqe { static_cast<io_uring_sqe *> (_sqes) + (tail & _sqMask) };
+  std::memset (sqe, 0, sizeof (io_uring_sqe));
+
+  return sqe;
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_queue
+// ----------------------------------------------------------------------------
+// Publishes the entry filled after _entry(). The first one of a batch posts the
+// handler that submits them. Called with the mutex locked.
+void IoUring::_queue() {
+  std::atomic_ref<unsigned> { *_sqTail }.store (*_sqTail + 1, std::memory_order_release);
+  ++_queued;
+
+  if (!_flushPosted) {
+    _flushPosted = true;
+    asio::post (_executor, [ this ] { submit(); });
+  }
+
+  _arm();
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_fail
+// ----------------------------------------------------------------------------
+// Completes an operation that could not be queued with an error (errno). Its handler
+// runs from the io_context, not with the mutex locked. Called with the mutex locked.
+void IoUring::_fail (Operation *op, int error) {
+  asio::post (_executor, [ this, op, error ] {
+    if (op->complete (*this, -error, 0))
+      _finish (op);
+  });
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_submit
+// ----------------------------------------------------------------------------
+// Returns 0, or the error (errno) that stopped the submission; the entries that were
+// not taken stay queued. Called with the mutex locked.
+int IoUring::_submit() {
+  while (_queued > 0) {
+    const int submitted { enterRing (_fd, _queued) };
+
+    if (submitted > 0)
+      _queued -= static_cast<unsigned> (submitted);
+    else if (submitted == 0)
+      return EAGAIN;
+    else if (errno != EINTR)
+      return errno;
+  }
+
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_arm
+// ----------------------------------------------------------------------------
+// Waits for the eventfd while there are operations in flight. A read, rather than
+// a wait for readability, so completions posted before it started are not missed.
+// Called with the mutex locked.
+void IoUring::_arm() {
+  if (_armed || (_pending == 0))
+    return;
+
+  _armed = true;
+
+  _event.async_read_some (asio::buffer (&_eventCount, sizeof (_eventCount)), [ this ] (std::error_code ec, size_t) {
+    if (ec == asio::error::operation_aborted)
+      return;
+
+    _reap();
+
+    std::lock_guard lock { _mutex };
+
+    // entries the kernel refused while completions were waiting to be reaped
+    if (_queued > 0)
+      _submit();
+
+    _armed = false;
+    _arm();
+  });
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_reap
+// ----------------------------------------------------------------------------
+// Completes the operations of the entries of the completion ring. Every entry is
+// released before its operation runs, which may submit new ones. Completions that
+// did not fit in the ring wait in the kernel until an io_uring_enter(2) asks for them.
+void IoUring::_reap() {
+  std::atomic_ref<unsigned> head { *_cqHead };
+  std::atomic_ref<unsigned> tail { *_cqTail };
+  const auto *cqes { static_cast<const io_uring_cqe *> (_cqes) };
+
+  for (;;) {
+    unsigned h { head.load (std::memory_order_relaxed) };
+    const unsigned t { tail.load (std::memory_order_acquire) };
+
+    if (h == t) {
+      if ((std::atomic_ref<unsigned> { *_sqFlags }.load (std::memory_order_acquire) & IORING_SQ_CQ_OVERFLOW) == 0)
+        return;
+
+      enterRing (_fd, 0, IORING_ENTER_GETEVENTS);
+      continue;
+    }
+
+    for (; h != t; ++h) {
+      const io_uring_cqe &cqe { cqes[h & _cqMask] };
+      auto *op { reinterpret_cast<Operation *> (static_cast<uintptr_t> (cqe.user_data)) };
+      const int result { cqe.res };
+      const uint32_t flags { cqe.flags };
+
+      head.store (h + 1, std::memory_order_release);
+
+      if (op->complete (*this, result, flags))
+        _finish (op);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_finish
+// ----------------------------------------------------------------------------
+// The handler of the operation may hold the last reference to whatever started it,
+// so it is destroyed without the mutex locked.
+void IoUring::_finish (Operation *op) {
+  {
+    std::lock_guard lock { _mutex };
+
+    if (op->prev != nullptr)
+      op->prev->next = op->next;
+    else
+      _operations = op->next;
+
+    if (op->next != nullptr)
+      op->next->prev = op->prev;
+
+    --_pending;
+  }
+
+  delete op;
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_provided
+// ----------------------------------------------------------------------------
+// The provided buffer that a completion filled: its id (-1 if none) and its data
+std::pair<int, std::string_view> IoUring::_provided (int result, uint32_t flags) const {
+  if ((flags & IORING_CQE_F_BUFFER) == 0)
+    return { -1, {} };
+
+  const auto id { static_cast<uint16_t> (flags >> IORING_CQE_BUFFER_SHIFT) };
+
+  return { id, { _buffers.get() + id * _bufferSize, static_cast<size_t> (std::max (result, 0)) } };
+}
+
+// ----------------------------------------------------------------------------
+// IoUring::_recycle
+// ----------------------------------------------------------------------------
+// Gives a buffer back to the kernel. Only the thread reaping completions does it.
+void IoUring::_recycle (uint16_t id) {
+  auto *ring { static_cast<io_uring_buf_ring *> (_bufferRing) };
+
+  // not ring->bufs: in C++ the empty struct before that flexible array takes a byte,
+  // which moves it. The tail overlaps the reserved field of the first entry.
+  auto &buf { static_cast<io_uring_buf *> (_bufferRing)[_bufferTail & (_bufferCount - 1)] };
+
+  buf.addr = reinterpret_cast<uintptr_t> (_buffers.get() + id * _bufferSize);
+  buf.len = static_cast<uint32_t> (_bufferSize);
+  buf.bid = id;
+
+  std::atomic_ref<uint16_t> { ring->tail }.store (++_bufferTail, std::memory_order_release);
+}
+
+#else
+
+// ----------------------------------------------------------------------------
+// Without io_uring, no ring is ever created: the rest is never called
+// ----------------------------------------------------------------------------
+std::unique_ptr<IoUring> IoUring::create (asio::io_context &, size_t, size_t, size_t, std::error_code &ec) {
+  ec = std::make_error_code (std::errc::not_supported);
+  return nullptr;
+}
+
+IoUring::~IoUring() {}
+void IoUring::accept (int, bool, AcceptHandler) {}
+bool IoUring::AcceptOperation::complete (IoUring &, int, uint32_t) { return true; }
+bool IoUring::SendOperation::complete (IoUring &, int, uint32_t) { return true; }
+void IoUring::submit() {}
+void IoUring::_receive (Operation *, int, void *, size_t) {}
+void IoUring::_send (SendOperation *, bool) {}
+std::pair<int, std::string_view> IoUring::_provided (int, uint32_t) const { return { -1, {} }; }
+void IoUring::_recycle (uint16_t) {}
+
+#endif
+
+}
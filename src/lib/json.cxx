@@ -0,0 +1,573 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <lightning/json.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// SWAR helpers
+// ----------------------------------------------------------------------------
+// Eight bytes of a string are checked at once for a quote, a backslash or a control
+// character: the rest of the bytes need no unescaping. The checks may report a byte
+// that is not there (after a real match), which is only a hint to look byte by byte.
+static constexpr uint64_t kOnes { 0x0101010101010101ull };
+static constexpr uint64_t kHighs { 0x8080808080808080ull };
+
+static inline uint64_t hasZero (uint64_t v) {
+  return (v - kOnes) & ~v & kHighs;
+}
+
+static inline bool plainChunk (const char *p) {
+  uint64_t v;
+  std::memcpy (&v, p, sizeof (v));
+
+  const uint64_t quote { hasZero (v ^ (kOnes * '"')) };
+  const uint64_t backslash { hasZero (v ^ (kOnes * '\\')) };
+  const uint64_t control { (v - kOnes * 0x20) & ~v & kHighs };
+
+  return (quote | backslash | control) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// JsonParser
+// ----------------------------------------------------------------------------
+// Recursive descent over the text. The elements of the containers being parsed are
+// collected on a per-thread stack, and copied to the memory resource, at their final
+// size, when the container ends.
+class JsonParser {
+  public:
+    JsonParser (char *data, size_t size, std::pmr::memory_resource *resource):
+      _begin { data },
+      _p { data },
+      _end { data + size },
+      _resource { resource },
+      _stack { _scratch() },
+      _base { _stack.size() }
+    {
+      // empty
+    }
+
+    ~JsonParser() {
+      _stack.resize (_base);
+    }
+
+    bool parse (JsonValue &root) {
+      _skipWhitespace();
+
+      if (!_parseValue (root, 0))
+        return false;
+
+      _skipWhitespace();
+
+      return _p == _end;
+    }
+
+    inline size_t offset() const { return static_cast<size_t> (_p - _begin); }
+
+  private:
+    char *_begin;
+    char *_p;
+    char *_end;
+    std::pmr::memory_resource *_resource;
+    std::vector<JsonMember> &_stack;
+    size_t _base;
+
+    // shared by the parses of the thread, so a warm thread collects without allocating
+    static std::vector<JsonMember> & _scratch() {
+      static thread_local std::vector<JsonMember> stack;
+      return stack;
+    }
+
+    inline void _skipWhitespace() {
+      while ((_p < _end) && ((*_p == ' ') || (*_p == '\n') || (*_p == '\r') || (*_p == '\t')))
+        ++_p;
+    }
+
+    bool _literal (std::string_view literal) {
+      if ((static_cast<size_t> (_end - _p) < literal.size()) || (std::memcmp (_p, literal.data(), literal.size()) != 0))
+        return false;
+
+      _p += literal.size();
+
+      return true;
+    }
+
+    bool _parseValue (JsonValue &value, size_t depth) {
+      if (_p == _end)
+        return false;
+
+      switch (*_p) {
+        case '{': return _parseObject (value, depth + 1);
+        case '[': return _parseArray (value, depth + 1);
+
+        case '"': {
+          std::string_view s;
+          if (!_parseString (s))
+            return false;
+
+          value._type = JsonValue::Type::kString;
+          value._data = s.data();
+          value._size = static_cast<uint32_t> (s.size());
+
+          return true;
+        }
+
+        case 't':
+          value._type = JsonValue::Type::kBool;
+          value._bool = true;
+          return _literal ("true");
+
+        case 'f':
+          value._type = JsonValue::Type::kBool;
+          value._bool = false;
+          return _literal ("false");
+
+        case 'n':
+          value._type = JsonValue::Type::kNull;
+          return _literal ("null");
+
+        default:
+          return _parseNumber (value);
+      }
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool _parseNumber (JsonValue &value) {
+      const char *start { _p };
+
+      const auto digits = [ this ] {
+        const char *from { _p };
+
+        while ((_p < _end) && (*_p >= '0') && (*_p <= '9'))
+          ++_p;
+
+        return _p - from;
+      };
+
+      if ((_p < _end) && (*_p == '-'))
+        ++_p;
+
+      if ((_p < _end) && (*_p == '0'))
+        ++_p;
+      else if (digits() == 0)
+        return false;
+
+      if ((_p < _end) && (*_p == '.')) {
+        ++_p;
+
+        if (digits() == 0)
+          return false;
+      }
+
+      if ((_p < _end) && ((*_p == 'e') || (*_p == 'E'))) {
+        ++_p;
+
+        if ((_p < _end) && ((*_p == '+') || (*_p == '-')))
+          ++_p;
+
+        if (digits() == 0)
+          return false;
+      }
+
+      value._type = JsonValue::Type::kNumber;
+      value._data = start;
+      value._size = static_cast<uint32_t> (_p - start);
+
+      return true;
+    }
+
+    // The content is a view of the text: unescaped over itself if it has escapes, which
+    // always makes it shorter.
+    bool _parseString (std::string_view &s) {
+      char *start { ++_p };
+
+      while ((_end - _p >= 8) && plainChunk (_p))
+        _p += 8;
+
+      while ((_p < _end) && (*_p != '"') && (*_p != '\\') && (static_cast<unsigned char> (*_p) >= 0x20))
+        ++_p;
+
+      char *out { _p };
+
+      while (_p < _end) {
+        const char c { *_p };
+
+        if (c == '"') {
+          ++_p;
+          s = std::string_view { start, static_cast<size_t> (out - start) };
+
+          return true;
+        }
+
+        if (static_cast<unsigned char> (c) < 0x20)
+          return false;
+
+        if (c != '\\') {
+          *out++ = *_p++;
+          continue;
+        }
+
+        if (++_p == _end)
+          return false;
+
+        switch (*_p++) {
+          case '"': *out++ = '"'; break;
+          case '\\': *out++ = '\\'; break;
+          case '/': *out++ = '/'; break;
+          case 'b': *out++ = '\b'; break;
+          case 'f': *out++ = '\f'; break;
+          case 'n': *out++ = '\n'; break;
+          case 'r': *out++ = '\r'; break;
+          case 't': *out++ = '\t'; break;
+
+          case 'u': {
+            uint32_t cp;
+            if (!_hex4 (cp))
+              return false;
+
+            // a surrogate pair: the low half must follow
+            if ((cp >= 0xD800) && (cp <= 0xDBFF)) {
+              uint32_t low;
+              if (!_literal ("\\u") || !_hex4 (low) || (low < 0xDC00) || (low > 0xDFFF))
+                return false;
+
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if ((cp >= 0xDC00) && (cp <= 0xDFFF)) {
+              return false;
+            }
+
+            out = _utf8 (out, cp);
+            break;
+          }
+
+          default:
+            return false;
+        }
+      }
+
+      return false;
+    }
+
+    bool _hex4 (uint32_t &cp) {
+      if (_end - _p < 4)
+        return false;
+
+      cp = 0;
+
+      for (int i { 0 }; i < 4; ++i) {
+        const int v { StringUtil::hexValue (*_p++) };
+        if (v < 0)
+          return false;
+
+        cp = (cp << 4) | static_cast<uint32_t> (v);
+      }
+
+      return true;
+    }
+
+    static char * _utf8 (char *out, uint32_t cp) {
+      if (cp < 0x80) {
+        *out++ = static_cast<char> (cp);
+      }
+      else if (cp < 0x800) {
+        *out++ = static_cast<char> (0xC0 | (cp >> 6));
+        *out++ = static_cast<char> (0x80 | (cp & 0x3F));
+      }
+      else if (cp < 0x10000) {
+        *out++ = static_cast<char> (0xE0 | (cp >> 12));
+        *out++ = static_cast<char> (0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char> (0x80 | (cp & 0x3F));
+      }
+      else {
+        *out++ = static_cast<char> (0xF0 | (cp >> 18));
+        *out++ = static_cast<char> (0x80 | ((cp >> 12) & 0x3F));
+        *out++ = static_cast<char> (0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char> (0x80 | (cp & 0x3F));
+      }
+
+      return out;
+    }
+
+    // Elements from `base` to the top of the stack, moved to the resource
+    template<typename T, typename Fn>
+    const T * _collect (size_t base, Fn &&element) {
+      const size_t count { _stack.size() - base };
+      if (count == 0)
+        return nullptr;
+
+      auto *elements { static_cast<T *> (_resource->allocate (count * sizeof (T), alignof (T))) };
+
+      for (size_t i { 0 }; i < count; ++i)
+        new (elements + i) T { element (_stack[base + i]) };
+
+      _stack.resize (base);
+
+      return elements;
+    }
+
+    bool _parseArray (JsonValue &value, size_t depth) {
+      if (depth > JsonDocument::kMaxDepth)
+        return false;
+
+      ++_p;
+      _skipWhitespace();
+
+      const size_t base { _stack.size() };
+
+      if ((_p < _end) && (*_p == ']')) {
+        ++_p;
+      }
+      else {
+        for (;;) {
+          JsonValue element;
+          if (!_parseValue (element, depth))
+            return false;
+
+          _stack.push_back ({ {}, element });
+          _skipWhitespace();
+
+          if (_p == _end)
+            return false;
+
+          if (*_p++ == ']')
+            break;
+
+          if (_p[-1] != ',')
+            return false;
+
+          _skipWhitespace();
+        }
+      }
+
+      const size_t count { _stack.size() - base };
+
+      value._type = JsonValue::Type::kArray;
+      value._size = static_cast<uint32_t> (count);
+      value._data = _collect<JsonValue> (base, [] (const JsonMember &m) { return m.value; });
+
+      return true;
+    }
+
+    bool _parseObject (JsonValue &value, size_t depth) {
+      if (depth > JsonDocument::kMaxDepth)
+        return false;
+
+      ++_p;
+      _skipWhitespace();
+
+      const size_t base { _stack.size() };
+
+      if ((_p < _end) && (*_p == '}')) {
+        ++_p;
+      }
+      else {
+        for (;;) {
+          JsonMember member;
+
+          if ((_p == _end) || (*_p != '"') || !_parseString (member.name))
+            return false;
+
+          _skipWhitespace();
+
+          if ((_p == _end) || (*_p++ != ':'))
+            return false;
+
+          _skipWhitespace();
+
+          if (!_parseValue (member.value, depth))
+            return false;
+
+          _stack.push_back (member);
+          _skipWhitespace();
+
+          if (_p == _end)
+            return false;
+
+          if (*_p++ == '}')
+            break;
+
+          if (_p[-1] != ',')
+            return false;
+
+          _skipWhitespace();
+        }
+      }
+
+      const size_t count { _stack.size() - base };
+
+      value._type = JsonValue::Type::kObject;
+      value._size = static_cast<uint32_t> (count);
+      value._data = _collect<JsonMember> (base, [] (const JsonMember &m) { return m; });
+
+      return true;
+    }
+};
+
+// ----------------------------------------------------------------------------
+// JsonValue::find
+// ----------------------------------------------------------------------------
+const JsonValue * JsonValue::find (std::string_view name) const {
+  for (const auto &m: members()) {
+    if (m.name == name)
+      return &m.value;
+  }
+
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// JsonDocument::parse
+// ----------------------------------------------------------------------------
+bool JsonDocument::parse (char *data, size_t size) {
+  reset();
+
+  JsonParser parser { data, size, _resource };
+
+  if (parser.parse (_root))
+    return true;
+
+  _root = {};
+  _errorOffset = parser.offset();
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// JsonWriter::key
+// ----------------------------------------------------------------------------
+JsonWriter & JsonWriter::key (std::string_view name) {
+  _separate();
+  quote (_out, name);
+  _out.push_back (':');
+  _comma = false;
+
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// JsonWriter::value
+// ----------------------------------------------------------------------------
+JsonWriter & JsonWriter::value (std::string_view s) {
+  _separate();
+  quote (_out, s);
+  _comma = true;
+
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// JsonWriter::value
+// ----------------------------------------------------------------------------
+JsonWriter & JsonWriter::value (bool b) {
+  _separate();
+  _out.append (b ? "true" : "false");
+  _comma = true;
+
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// JsonWriter::value
+// ----------------------------------------------------------------------------
+JsonWriter & JsonWriter::value (std::nullptr_t) {
+  _separate();
+  _out.append ("null");
+  _comma = true;
+
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// JsonWriter::value
+// ----------------------------------------------------------------------------
+JsonWriter & JsonWriter::value (const JsonValue &v) {
+  switch (v.type()) {
+    case JsonValue::Type::kNull:
+      return value (nullptr);
+
+    case JsonValue::Type::kBool:
+      return value (*v.getBool());
+
+    case JsonValue::Type::kString:
+      return value (v.text());
+
+    case JsonValue::Type::kNumber:
+      // as it was written
+      _separate();
+      _out.append (v.text());
+      _comma = true;
+
+      return *this;
+
+    case JsonValue::Type::kArray:
+      startArray();
+
+      for (const auto &e: v.items())
+        value (e);
+
+      return endArray();
+
+    case JsonValue::Type::kObject:
+      startObject();
+
+      for (const auto &m: v.members())
+        key (m.name).value (m.value);
+
+      return endObject();
+  }
+
+  return *this;
+}
+
+// ----------------------------------------------------------------------------
+// JsonWriter::quote
+// ----------------------------------------------------------------------------
+// Runs of characters that need no escaping are appended at once
+void JsonWriter::quote (std::string &out, std::string_view s) {
+  static constexpr char kHex[] { "0123456789abcdef" };
+
+  out.push_back ('"');
+
+  size_t run { 0 };
+
+  for (size_t i { 0 }; i < s.size(); ++i) {
+    const auto c { static_cast<unsigned char> (s[i]) };
+
+    if ((c >= 0x20) && (c != '"') && (c != '\\'))
+      continue;
+
+    out.append (s.data() + run, i - run);
+    run = i + 1;
+
+    switch (c) {
+      case '"': out.append ("\\\""); break;
+      case '\\': out.append ("\\\\"); break;
+      case '\b': out.append ("\\b"); break;
+      case '\f': out.append ("\\f"); break;
+      case '\n': out.append ("\\n"); break;
+      case '\r': out.append ("\\r"); break;
+      case '\t': out.append ("\\t"); break;
+
+      default: {
+        const char escape[] { '\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF] };
+        out.append (escape, sizeof (escape));
+      }
+    }
+  }
+
+  out.append (s.data() + run, s.size() - run);
+  out.push_back ('"');
+}
+
+}
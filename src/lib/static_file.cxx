@@ -0,0 +1,161 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <array>
+#include <charconv>
+#include <ctime>
+#include <iterator>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <lightning/static_file.h>
+#include <lightning/string_util.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// Media types by extension
+// ----------------------------------------------------------------------------
+static constexpr std::array<std::pair<std::string_view, std::string_view>, 28> kContentTypes { {
+  { "avif", "image/avif" },
+  { "css", "text/css; charset=utf-8" },
+  { "csv", "text/csv; charset=utf-8" },
+  { "gif", "image/gif" },
+  { "gz", "application/gzip" },
+  { "htm", "text/html; charset=utf-8" },
+  { "html", "text/html; charset=utf-8" },
+  { "ico", "image/x-icon" },
+  { "jpeg", "image/jpeg" },
+  { "jpg", "image/jpeg" },
+  { "js", "text/javascript; charset=utf-8" },
+  { "json", "application/json" },
+  { "map", "application/json" },
+  { "mjs", "text/javascript; charset=utf-8" },
+  { "mp3", "audio/mpeg" },
+  { "mp4", "video/mp4" },
+  { "pdf", "application/pdf" },
+  { "png", "image/png" },
+  { "svg", "image/svg+xml" },
+  { "ttf", "font/ttf" },
+  { "txt", "text/plain; charset=utf-8" },
+  { "wasm", "application/wasm" },
+  { "webm", "video/webm" },
+  { "webp", "image/webp" },
+  { "woff", "font/woff" },
+  { "woff2", "font/woff2" },
+  { "xml", "application/xml" },
+  { "zip", "application/zip" }
+} };
+
+// ----------------------------------------------------------------------------
+// modifiedTime
+// ----------------------------------------------------------------------------
+static int64_t modifiedTime (const struct stat &st) {
+#ifdef __APPLE__
+  const auto &ts { st.st_mtimespec };
+#else
+  const auto &ts { st.st_mtim };
+#endif
+
+  return static_cast<int64_t> (ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+// StaticFile::open
+// ----------------------------------------------------------------------------
+std::shared_ptr<const StaticFile> StaticFile::open (const std::filesystem::path &path, uint64_t mmapThreshold) {
+  const int fd { ::open (path.c_str(), O_RDONLY | O_CLOEXEC) };
+  if (fd < 0)
+    return nullptr;
+
+  std::shared_ptr<StaticFile> file { new StaticFile() };
+  file->_fd = fd;
+
+  struct stat st;
+  if ((::fstat (fd, &st) != 0) || !S_ISREG (st.st_mode))
+    return nullptr;
+
+  file->_size = static_cast<uint64_t> (st.st_size);
+  file->_device = st.st_dev;
+  file->_inode = st.st_ino;
+  file->_modified = modifiedTime (st);
+  file->_contentType = contentType (path.filename().native());
+
+  struct tm tm;
+  const time_t seconds { st.st_mtime };
+  const auto length { std::strftime (file->_lastModifiedData, sizeof (file->_lastModifiedData), "%a, %d %b %Y %H:%M:%S GMT", ::gmtime_r (&seconds, &tm)) };
+  file->_lastModified = std::string_view { file->_lastModifiedData, length };
+
+  char *etag { file->_etagData };
+  const auto etagEnd { std::end (file->_etagData) };
+  *etag++ = '"';
+  etag = std::to_chars (etag, etagEnd, file->_size, 16).ptr;
+  *etag++ = '-';
+  etag = std::to_chars (etag, etagEnd, static_cast<uint64_t> (file->_modified), 16).ptr;
+  *etag++ = '"';
+  file->_etag = std::string_view { file->_etagData, static_cast<size_t> (etag - file->_etagData) };
+
+#ifndef __linux__
+  mmapThreshold = file->_size; // no sendfile(2)
+#endif
+
+  if ((file->_size == 0) || (file->_size <= mmapThreshold)) {
+    if (file->_size > 0) {
+      void *map { ::mmap (nullptr, file->_size, PROT_READ, MAP_SHARED, fd, 0) };
+      if (map == MAP_FAILED)
+        return nullptr;
+
+      file->_map = map;
+    }
+
+    // the mapping does not need the descriptor
+    ::close (std::exchange (file->_fd, -1));
+  }
+
+  return file;
+}
+
+// ----------------------------------------------------------------------------
+// StaticFile::contentType
+// ----------------------------------------------------------------------------
+std::string_view StaticFile::contentType (std::string_view fileName) {
+  if (const auto dot { fileName.rfind ('.') }; dot != std::string_view::npos) {
+    const auto extension { fileName.substr (dot + 1) };
+
+    for (const auto &[ ext, type ]: kContentTypes) {
+      if (StringUtil::iequals (ext, extension))
+        return type;
+    }
+  }
+
+  return "application/octet-stream";
+}
+
+// ----------------------------------------------------------------------------
+// Destructor
+// ----------------------------------------------------------------------------
+StaticFile::~StaticFile() {
+  if (_map)
+    ::munmap (_map, _size);
+
+  if (_fd >= 0)
+    ::close (_fd);
+}
+
+// ----------------------------------------------------------------------------
+// StaticFile::changed
+// ----------------------------------------------------------------------------
+bool StaticFile::changed (const struct stat &st) const {
+  return (st.st_dev != _device) ||
+    (st.st_ino != _inode) ||
+    (static_cast<uint64_t> (st.st_size) != _size) ||
+    (modifiedTime (st) != _modified);
+}
+
+}
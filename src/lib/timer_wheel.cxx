@@ -0,0 +1,160 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <algorithm>
+
+#include <lightning/timer_wheel.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+TimerWheel::TimerWheel (const asio::any_io_executor &executor, Duration tick, size_t slots):
+  _timer { executor },
+  _tick { std::max (tick, Duration { 1 }) },
+  _slots (std::max<size_t> (slots, 1), nullptr)
+{
+  // empty
+}
+
+// ----------------------------------------------------------------------------
+// TimerWheel::schedule
+// ----------------------------------------------------------------------------
+void TimerWheel::schedule (Entry &entry, Duration timeout) {
+  std::lock_guard lock { _mutex };
+
+  const auto now { std::chrono::steady_clock::now() };
+
+  if (!_running) {
+    _running = true;
+    _next = now + _tick;
+    _wait();
+  }
+
+  if (entry._slot != kUnscheduled)
+    _unlink (entry);
+
+  // number of ticks to wait, counted from the next one (rounded up)
+  const auto untilNext { std::chrono::duration_cast<Duration> (_next - now) };
+  const auto remaining { std::max (timeout - untilNext, Duration { 0 }) };
+  const size_t ticks { static_cast<size_t> ((remaining + _tick - Duration { 1 }) / _tick) + 1 };
+
+  entry._rounds = (ticks - 1) / _slots.size();
+
+  _link (entry, (_current + ticks) % _slots.size());
+}
+
+// ----------------------------------------------------------------------------
+// TimerWheel::cancel
+// ----------------------------------------------------------------------------
+void TimerWheel::cancel (Entry &entry) {
+  std::lock_guard lock { _mutex };
+
+  if (entry._slot == kUnscheduled)
+    return;
+
+  _unlink (entry);
+
+  // nothing left to wait for, the io_context is not kept busy until the next tick
+  if ((_size == 0) && _running) {
+    _running = false;
+    _timer.cancel();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// TimerWheel::_link
+// ----------------------------------------------------------------------------
+void TimerWheel::_link (Entry &entry, size_t slot) {
+  auto &head { _slots[slot] };
+
+  entry._slot = slot;
+  entry._prev = nullptr;
+  entry._next = head;
+
+  if (head)
+    head->_prev = &entry;
+
+  head = &entry;
+
+  ++_size;
+}
+
+// ----------------------------------------------------------------------------
+// TimerWheel::_unlink
+// ----------------------------------------------------------------------------
+void TimerWheel::_unlink (Entry &entry) {
+  if (entry._prev)
+    entry._prev->_next = entry._next;
+  else
+    _slots[entry._slot] = entry._next;
+
+  if (entry._next)
+    entry._next->_prev = entry._prev;
+
+  entry._prev = entry._next = nullptr;
+  entry._slot = kUnscheduled;
+
+  --_size;
+}
+
+// ----------------------------------------------------------------------------
+// TimerWheel::_wait
+// ----------------------------------------------------------------------------
+void TimerWheel::_wait() {
+  _timer.expires_at (_next);
+  _timer.async_wait ([ this ] (std::error_code ec) {
+    if (ec)
+      return;
+
+    std::lock_guard lock { _mutex };
+
+    if (_running)
+      _advance();
+  });
+}
+
+// ----------------------------------------------------------------------------
+// TimerWheel::_advance
+// ----------------------------------------------------------------------------
+void TimerWheel::_advance() {
+  const auto now { std::chrono::steady_clock::now() };
+
+  // a late timer catches up with every tick it has missed
+  while (_next <= now) {
+    _current = (_current + 1) % _slots.size();
+
+    for (Entry *entry { _slots[_current] }; entry != nullptr;) {
+      Entry *next { entry->_next };
+
+      if (entry->_rounds == 0) {
+        _unlink (*entry);
+        _expired.push_back (entry);
+      }
+      else {
+        --entry->_rounds;
+      }
+
+      entry = next;
+    }
+
+    _next += _tick;
+  }
+
+  for (Entry *entry: _expired)
+    entry->_onExpire();
+
+  _expired.clear();
+
+  // an empty wheel does not keep the io_context busy
+  if (_size > 0)
+    _wait();
+  else
+    _running = false;
+}
+
+}
@@ -0,0 +1,188 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <cerrno>
+#include <new>
+
+#include <openssl/err.h>
+
+#include <lightning/tls_stream.h>
+
+
+namespace lightning {
+
+// ----------------------------------------------------------------------------
+// clearErrors
+// ----------------------------------------------------------------------------
+// SSL_get_error() only tells what happened to the last call if the thread's error
+// queue was empty before it
+static void clearErrors() {
+  ERR_clear_error();
+  errno = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Constructor
+// ----------------------------------------------------------------------------
+TlsStream::TlsStream (asio::ip::tcp::socket &socket, asio::ssl::context &context, bool kernelTls):
+  _socket { socket },
+  _context { context.native_handle() },
+  _kernelTls { kernelTls }
+{
+  reset();
+}
+
+// ----------------------------------------------------------------------------
+// Destructor
+// ----------------------------------------------------------------------------
+TlsStream::~TlsStream() {
+  SSL_free (_ssl);
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::reset
+// ----------------------------------------------------------------------------
+// A new SSL object, rather than SSL_clear(), which keeps settings negotiated with the
+// previous client.
+void TlsStream::reset() {
+  SSL_free (_ssl);
+
+  _ssl = SSL_new (_context);
+  if (_ssl == nullptr)
+    throw std::bad_alloc();
+
+  _failed = false;
+
+  // clients that just close the connection (without close_notify) are not an error for HTTP
+  SSL_set_options (_ssl, SSL_OP_IGNORE_UNEXPECTED_EOF | SSL_OP_NO_RENEGOTIATION | (_kernelTls ? SSL_OP_ENABLE_KTLS : 0));
+  SSL_set_accept_state (_ssl);
+
+  // OpenSSL reports that it would block instead of blocking
+  asio::error_code ignored;
+  _socket.native_non_blocking (true, ignored);
+
+  SSL_set_fd (_ssl, static_cast<int> (_socket.native_handle()));
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::sendFile
+// ----------------------------------------------------------------------------
+ssize_t TlsStream::sendFile (int fd, off_t offset, size_t size) {
+  clearErrors();
+
+  const ossl_ssize_t n { SSL_sendfile (_ssl, fd, offset, size, 0) };
+  if (n >= 0)
+    return static_cast<ssize_t> (n);
+
+  asio::error_code ec;
+  const auto status { _status (-1, ec) };
+
+  errno = (status == Status::kWantWrite) ? EAGAIN : EIO;
+
+  return -1;
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::shutdown
+// ----------------------------------------------------------------------------
+void TlsStream::shutdown() {
+  if (_failed || (SSL_is_init_finished (_ssl) != 1) || ((SSL_get_shutdown (_ssl) & SSL_SENT_SHUTDOWN) != 0))
+    return;
+
+  // the peer's close_notify is not waited for
+  clearErrors();
+  SSL_shutdown (_ssl);
+  ERR_clear_error();
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::kernelSend
+// ----------------------------------------------------------------------------
+bool TlsStream::kernelSend() const {
+  return BIO_get_ktls_send (SSL_get_wbio (_ssl));
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::kernelReceive
+// ----------------------------------------------------------------------------
+bool TlsStream::kernelReceive() const {
+  return BIO_get_ktls_recv (SSL_get_rbio (_ssl));
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::_handshake
+// ----------------------------------------------------------------------------
+TlsStream::Status TlsStream::_handshake (asio::error_code &ec) {
+  clearErrors();
+
+  const int result { SSL_do_handshake (_ssl) };
+
+  return (result == 1) ? Status::kDone : _status (result, ec);
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::_read
+// ----------------------------------------------------------------------------
+TlsStream::Status TlsStream::_read (asio::mutable_buffer buffer, asio::error_code &ec, size_t &bytes) {
+  clearErrors();
+
+  if (SSL_read_ex (_ssl, buffer.data(), buffer.size(), &bytes) == 1)
+    return Status::kDone;
+
+  return _status (0, ec);
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::_write
+// ----------------------------------------------------------------------------
+// A write that has to wait is retried with the same buffer, as OpenSSL requires.
+TlsStream::Status TlsStream::_write (asio::const_buffer buffer, asio::error_code &ec, size_t &bytes) {
+  if (buffer.size() == 0)
+    return Status::kDone;
+
+  clearErrors();
+
+  if (SSL_write_ex (_ssl, buffer.data(), buffer.size(), &bytes) == 1)
+    return Status::kDone;
+
+  return _status (0, ec);
+}
+
+// ----------------------------------------------------------------------------
+// TlsStream::_status
+// ----------------------------------------------------------------------------
+TlsStream::Status TlsStream::_status (int result, asio::error_code &ec) {
+  switch (SSL_get_error (_ssl, result)) {
+    case SSL_ERROR_WANT_READ:
+      return Status::kWantRead;
+
+    case SSL_ERROR_WANT_WRITE:
+      return Status::kWantWrite;
+
+    case SSL_ERROR_ZERO_RETURN:
+      // close_notify, or the end of the stream (SSL_OP_IGNORE_UNEXPECTED_EOF)
+      ec = asio::error::eof;
+      break;
+
+    case SSL_ERROR_SYSCALL:
+      _failed = true;
+
+      if (errno != 0)
+        ec = asio::error_code { errno, asio::error::get_system_category() };
+      else
+        ec = asio::error::eof;
+
+      break;
+
+    default:
+      _failed = true;
+      ec = asio::error_code { static_cast<int> (ERR_get_error()), asio::error::get_ssl_category() };
+      break;
+  }
+
+  return Status::kFailed;
+}
+
+}
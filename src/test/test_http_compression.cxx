@@ -0,0 +1,102 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_compression.h>
+
+#include "test_util.h"
+
+
+// ----------------------------------------------------------------------------
+// test_negotiate
+// ----------------------------------------------------------------------------
+TEST (HttpCompression, test_negotiate) {
+  using lightning::HttpCompression;
+  using Encoding = HttpCompression::Encoding;
+
+  ASSERT_EQ (HttpCompression::negotiate ("gzip, deflate, br"), Encoding::kGzip);
+  ASSERT_EQ (HttpCompression::negotiate ("deflate"), Encoding::kDeflate);
+  ASSERT_EQ (HttpCompression::negotiate ("GZIP;q=0.5, deflate;q=0.8"), Encoding::kDeflate);
+  ASSERT_EQ (HttpCompression::negotiate ("deflate;q=0.5, gzip;q=0.5"), Encoding::kGzip);
+  ASSERT_EQ (HttpCompression::negotiate ("*"), Encoding::kGzip);
+  ASSERT_EQ (HttpCompression::negotiate ("*;q=0.1, gzip;q=0"), Encoding::kDeflate);
+  ASSERT_EQ (HttpCompression::negotiate ("gzip;q=0.000, deflate; q=0"), Encoding::kIdentity);
+  ASSERT_EQ (HttpCompression::negotiate ("br, identity"), Encoding::kIdentity);
+  ASSERT_EQ (HttpCompression::negotiate (""), Encoding::kIdentity);
+}
+
+// ----------------------------------------------------------------------------
+// test_compressible
+// ----------------------------------------------------------------------------
+TEST (HttpCompression, test_compressible) {
+  using lightning::HttpCompression;
+
+  const std::vector<std::string> types { "text/", "application/json" };
+
+  ASSERT_TRUE (HttpCompression::compressible ("text/html; charset=utf-8", types));
+  ASSERT_TRUE (HttpCompression::compressible ("Application/JSON", types));
+  ASSERT_FALSE (HttpCompression::compressible ("image/png", types));
+  ASSERT_FALSE (HttpCompression::compressible ("text", types));
+}
+
+// ----------------------------------------------------------------------------
+// test_compress
+// ----------------------------------------------------------------------------
+TEST (HttpCompression, test_compress) {
+  using lightning::HttpCompression;
+  using Encoding = HttpCompression::Encoding;
+
+  std::string data;
+  for (int i { 0 }; i < 1000; ++i)
+    data += "{\"id\":" + std::to_string (i) + ",\"name\":\"item\"},";
+
+  // the streams of the thread are reused, with any level
+  for (const int level: { 6, 6, 1 }) {
+    std::string gzip;
+    ASSERT_TRUE (HttpCompression::compress (Encoding::kGzip, data, level, gzip));
+    ASSERT_LT (gzip.size(), data.size() / 5);
+    ASSERT_EQ (test::inflate (gzip, 31), data);
+
+    std::string deflate;
+    ASSERT_TRUE (HttpCompression::compress (Encoding::kDeflate, data, level, deflate));
+    ASSERT_EQ (test::inflate (deflate, 15), data);
+  }
+
+  // not worth it
+  std::string out;
+  ASSERT_FALSE (HttpCompression::compress (Encoding::kGzip, "abc", 6, out));
+  ASSERT_FALSE (HttpCompression::compress (Encoding::kIdentity, data, 6, out));
+}
+
+// ----------------------------------------------------------------------------
+// test_compressed_bodies
+// ----------------------------------------------------------------------------
+TEST (HttpCompression, test_compressed_bodies) {
+  using lightning::HttpCompression;
+
+  lightning::HttpCompressedBodies bodies;
+  const std::string data (4096, 'a');
+
+  // made the first time, then shared
+  const auto gzip { bodies.get (HttpCompression::Encoding::kGzip, data, 6) };
+  ASSERT_NE (gzip, nullptr);
+  ASSERT_EQ (test::inflate (*gzip, 31), data);
+  ASSERT_EQ (bodies.get (HttpCompression::Encoding::kGzip, data, 6), gzip);
+
+  const auto deflate { bodies.get (HttpCompression::Encoding::kDeflate, data, 6) };
+  ASSERT_NE (deflate, nullptr);
+  ASSERT_EQ (test::inflate (*deflate, 15), data);
+  ASSERT_EQ (bodies.get (HttpCompression::Encoding::kDeflate, data, 6), deflate);
+
+  ASSERT_EQ (bodies.get (HttpCompression::Encoding::kIdentity, data, 6), nullptr);
+
+  // not smaller: nothing is kept
+  lightning::HttpCompressedBodies tiny;
+  ASSERT_EQ (tiny.get (HttpCompression::Encoding::kGzip, "x", 6), nullptr);
+  ASSERT_EQ (tiny.get (HttpCompression::Encoding::kGzip, "x", 6), nullptr);
+}
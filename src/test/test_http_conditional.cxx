@@ -0,0 +1,110 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_conditional.h>
+
+
+// ----------------------------------------------------------------------------
+// test_parse_date
+// ----------------------------------------------------------------------------
+TEST (HttpConditional, test_parse_date) {
+  using lightning::HttpConditional;
+
+  ASSERT_EQ (HttpConditional::parseDate ("Thu, 01 Jan 1970 00:00:00 GMT"), 0);
+  ASSERT_EQ (HttpConditional::parseDate ("Sun, 06 Nov 1994 08:49:37 GMT"), 784111777);
+  ASSERT_EQ (HttpConditional::parseDate ("Tue, 29 Feb 2000 23:59:59 GMT"), 951868799);
+
+  ASSERT_FALSE (HttpConditional::parseDate (""));
+  ASSERT_FALSE (HttpConditional::parseDate ("Sunday, 06-Nov-94 08:49:37 GMT"));
+  ASSERT_FALSE (HttpConditional::parseDate ("Sun, 06 Nov 1994 08:49:37 UTC"));
+  ASSERT_FALSE (HttpConditional::parseDate ("Sun, 06 Now 1994 08:49:37 GMT"));
+  ASSERT_FALSE (HttpConditional::parseDate ("Sat, 30 Feb 2000 08:49:37 GMT"));
+  ASSERT_FALSE (HttpConditional::parseDate ("Sun, 06 Nov 1994 24:49:37 GMT"));
+}
+
+// ----------------------------------------------------------------------------
+// test_parse_ranges
+// ----------------------------------------------------------------------------
+TEST (HttpConditional, test_parse_ranges) {
+  using lightning::HttpConditional;
+
+  auto ranges { HttpConditional::parseRanges ("bytes=0-99", 1000) };
+  ASSERT_TRUE (ranges);
+  ASSERT_EQ (ranges->size(), 1);
+  ASSERT_EQ (ranges->at (0).offset, 0);
+  ASSERT_EQ (ranges->at (0).length, 100);
+
+  // open, suffix and clamped ranges; unsatisfiable ones are dropped
+  ranges = HttpConditional::parseRanges ("Bytes=900-, -10 ,990-2000, 1000-1001, -0", 1000);
+  ASSERT_TRUE (ranges);
+  ASSERT_EQ (ranges->size(), 3);
+  ASSERT_EQ (ranges->at (0).offset, 900);
+  ASSERT_EQ (ranges->at (0).length, 100);
+  ASSERT_EQ (ranges->at (1).offset, 990);
+  ASSERT_EQ (ranges->at (1).length, 10);
+  ASSERT_EQ (ranges->at (2).offset, 990);
+  ASSERT_EQ (ranges->at (2).length, 10);
+
+  ranges = HttpConditional::parseRanges ("bytes=-5000", 1000);
+  ASSERT_TRUE (ranges);
+  ASSERT_EQ (ranges->at (0).offset, 0);
+  ASSERT_EQ (ranges->at (0).length, 1000);
+
+  ranges = HttpConditional::parseRanges ("bytes=1000-", 1000);
+  ASSERT_TRUE (ranges);
+  ASSERT_TRUE (ranges->empty());
+
+  // invalid: ignored
+  ASSERT_FALSE (HttpConditional::parseRanges ("items=0-1", 1000));
+  ASSERT_FALSE (HttpConditional::parseRanges ("bytes=", 1000));
+  ASSERT_FALSE (HttpConditional::parseRanges ("bytes=5-1", 1000));
+  ASSERT_FALSE (HttpConditional::parseRanges ("bytes=a-b", 1000));
+  ASSERT_FALSE (HttpConditional::parseRanges ("bytes=1", 1000));
+  ASSERT_FALSE (HttpConditional::parseRanges ("bytes=-", 1000));
+
+  std::string many { "bytes=0-0" };
+  for (size_t i { 1 }; i <= HttpConditional::kMaxRanges; ++i)
+    many += "," + std::to_string (i) + "-" + std::to_string (i);
+
+  ASSERT_FALSE (HttpConditional::parseRanges (many, 1000));
+}
+
+// ----------------------------------------------------------------------------
+// test_matches_any
+// ----------------------------------------------------------------------------
+TEST (HttpConditional, test_matches_any) {
+  using lightning::HttpConditional;
+
+  ASSERT_TRUE (HttpConditional::matchesAny ("\"abc\"", "\"abc\""));
+  ASSERT_TRUE (HttpConditional::matchesAny ("\"x\", W/\"abc\"", "\"abc\""));
+  ASSERT_TRUE (HttpConditional::matchesAny ("\"abc\"", "W/\"abc\""));
+  ASSERT_TRUE (HttpConditional::matchesAny (" * ", "\"abc\""));
+
+  ASSERT_FALSE (HttpConditional::matchesAny ("\"abcd\"", "\"abc\""));
+  ASSERT_FALSE (HttpConditional::matchesAny ("*", ""));
+}
+
+// ----------------------------------------------------------------------------
+// test_hash
+// ----------------------------------------------------------------------------
+TEST (HttpConditional, test_hash) {
+  using lightning::HttpConditional;
+
+  // xxHash64 (seed 0)
+  ASSERT_EQ (HttpConditional::hash (""), 0xef46db3751d8e999);
+  ASSERT_EQ (HttpConditional::hash ("a"), 0xd24ec4f1a98c6e5b);
+
+  const std::string text (100, 'x');
+  ASSERT_EQ (HttpConditional::hash (text), HttpConditional::hash (std::string (100, 'x')));
+  ASSERT_NE (HttpConditional::hash (text), HttpConditional::hash (text.substr (1)));
+
+  // the ETag is the quoted hash, 16 hexadecimal digits
+  ASSERT_EQ (HttpConditional::etag ("a"), "\"d24ec4f1a98c6e5b\"");
+  ASSERT_EQ (HttpConditional::etag (""), "\"ef46db3751d8e999\"");
+}
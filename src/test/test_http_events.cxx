@@ -0,0 +1,42 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_events.h>
+
+
+// ----------------------------------------------------------------------------
+// test_format
+// ----------------------------------------------------------------------------
+TEST (HttpEventChannel, test_format) {
+  using lightning::HttpEventChannel;
+
+  ASSERT_EQ (*HttpEventChannel::format ("hello"), "data: hello\n\n");
+  ASSERT_EQ (*HttpEventChannel::format (""), "data: \n\n");
+  ASSERT_EQ (*HttpEventChannel::format ("{}", "update", "42"), "event: update\nid: 42\ndata: {}\n\n");
+
+  // every line has its own field, whatever its line break
+  ASSERT_EQ (*HttpEventChannel::format ("a\nb\r\nc\rd"), "data: a\ndata: b\ndata: c\ndata: d\n\n");
+  ASSERT_EQ (*HttpEventChannel::format ("a\n"), "data: a\ndata: \n\n");
+
+  // line breaks in the event type or the id cannot add fields nor end the event
+  ASSERT_EQ (*HttpEventChannel::format ("x", "up\r\ndata: injected\n\n", "1\nretry: 0"), "event: updata: injected\nid: 1retry: 0\ndata: x\n\n");
+  ASSERT_EQ (*HttpEventChannel::format ("x", {}, std::string_view { "4\0" "2\r", 4 }), "id: 42\ndata: x\n\n");
+}
+
+// ----------------------------------------------------------------------------
+// test_no_subscribers
+// ----------------------------------------------------------------------------
+TEST (HttpEventChannel, test_no_subscribers) {
+  lightning::HttpEventChannel channel;
+
+  ASSERT_EQ (channel.publish ("hello"), 0u);
+  ASSERT_EQ (channel.ping(), 0u);
+  ASSERT_EQ (channel.size(), 0u);
+  ASSERT_EQ (channel.dropped(), 0u);
+}
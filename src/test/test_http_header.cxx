@@ -3,6 +3,9 @@
 //
 // Copyright (c) 2024 Carlos Carrasco
 // ----------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <lightning/http_header.h>
@@ -77,15 +80,73 @@ TEST (HttpHeader, test_iterator) {
 
   header.set ("AA", "bb");
   for (auto it = header.begin(); it != header.end(); it++) {
-    ASSERT_EQ (it->first, "aa");
-    ASSERT_EQ (it->second, "bb");
+    ASSERT_EQ (it->name, "AA"); // names keep their original case
+    ASSERT_EQ (it->value, "bb");
   }
 
   header.set ("ccc", "ddd");
-  auto it = header.cbegin();
-  ASSERT_EQ (it->first, "ccc");
+  auto it = header.cbegin(); // insertion order
+  ASSERT_EQ (it->name, "AA");
+  ASSERT_EQ (it->value, "bb");
   it = std::next(it);
-  ASSERT_EQ (it->first, "aa");
-  ASSERT_EQ (it->second, "bb");
+  ASSERT_EQ (it->name, "ccc");
+  ASSERT_EQ (it->value, "ddd");
   ASSERT_EQ (std::next(it), header.cend());
 }
+
+// ----------------------------------------------------------------------------
+// test_known_headers
+// ----------------------------------------------------------------------------
+TEST (HttpHeader, test_known_headers) {
+  static_assert (lightning::HttpHeader::lookup ("Content-Length") == lightning::HttpHeaderName::kContentLength);
+  static_assert (lightning::HttpHeader::lookup ("x-forwarded-for") == lightning::HttpHeaderName::kXForwardedFor);
+  static_assert (lightning::HttpHeader::lookup ("x-request-id") == lightning::HttpHeaderName::kUnknown);
+  static_assert (lightning::HttpHeader::lookup ("") == lightning::HttpHeaderName::kUnknown);
+
+  for (size_t i = 0; i < lightning::kNumHttpHeaderNames; ++i) {
+    const auto id { static_cast<lightning::HttpHeaderName> (i) };
+    ASSERT_EQ (lightning::HttpHeader::lookup (lightning::HttpHeader::name (id)), id);
+  }
+
+  lightning::HttpHeader header;
+
+  header.set ("Content-Type", "text/plain");
+  header.set ("X-Custom", "1");
+  header.set (lightning::HttpHeaderName::kContentLength, "12");
+  ASSERT_TRUE (header.contains (lightning::HttpHeaderName::kContentType));
+  ASSERT_EQ (header.get (lightning::HttpHeaderName::kContentType), "text/plain");
+  ASSERT_EQ (header.get ("CONTENT-LENGTH"), "12");
+  ASSERT_FALSE (header.contains (lightning::HttpHeaderName::kHost));
+
+  header.set (lightning::HttpHeaderName::kContentType, "application/json");
+  ASSERT_EQ (header.get ("content-type"), "application/json");
+  ASSERT_EQ (header.size(), 3);
+
+  header.clear();
+  ASSERT_EQ (header.size(), 0);
+  ASSERT_FALSE (header.contains (lightning::HttpHeaderName::kContentType));
+}
+
+// ----------------------------------------------------------------------------
+// test_many_headers
+// ----------------------------------------------------------------------------
+TEST (HttpHeader, test_many_headers) {
+  lightning::HttpHeader header;
+  std::vector<std::string> names;
+
+  for (int i = 0; i < 100; ++i)
+    names.push_back ("x-header-" + std::to_string (i));
+
+  for (const auto &name: names)
+    header.set (name, name);
+  header.set (lightning::HttpHeaderName::kHost, "localhost");
+
+  ASSERT_EQ (header.size(), 101);
+  for (const auto &name: names)
+    ASSERT_EQ (header.get (name), name);
+  ASSERT_EQ (header.get ("Host"), "localhost");
+
+  lightning::HttpHeader copy { header };
+  ASSERT_EQ (copy.size(), 101);
+  ASSERT_EQ (copy.get ("x-header-99"), "x-header-99");
+}
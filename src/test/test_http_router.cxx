@@ -0,0 +1,133 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_router.h>
+
+
+// ----------------------------------------------------------------------------
+// makeHandler
+// ----------------------------------------------------------------------------
+static lightning::RequestHandler makeHandler (const std::string &name) {
+  return [ name ] (const auto &, auto &response) { response.send (name); };
+}
+
+// ----------------------------------------------------------------------------
+// route
+// ----------------------------------------------------------------------------
+// Name of the route matching a path ("" if none)
+static std::string route (const lightning::HttpRouter &router, std::string_view path, lightning::HttpParams &params) {
+  const auto route { router.find (path, params) };
+  if (route == nullptr)
+    return "";
+
+  static const lightning::Logger logger { lightning::LogLevel::kFatal };
+  const lightning::HttpRequest request { logger };
+  lightning::HttpResponse response;
+  route->handler (request, response);
+
+  return std::string { response.body() };
+}
+
+// ----------------------------------------------------------------------------
+// test_static
+// ----------------------------------------------------------------------------
+TEST (HttpRouter, test_static) {
+  lightning::HttpRouter router;
+  lightning::HttpParams params;
+
+  router.add ("/", makeHandler ("root"));
+  router.add ("/users", makeHandler ("users"));
+  router.add ("/users/new", makeHandler ("new"));
+  router.add ("/user", makeHandler ("user"));
+  router.add ("/uploads", makeHandler ("uploads"));
+
+  ASSERT_EQ (route (router, "/", params), "root");
+  ASSERT_EQ (route (router, "/users", params), "users");
+  ASSERT_EQ (route (router, "/users/new", params), "new");
+  ASSERT_EQ (route (router, "/user", params), "user");
+  ASSERT_EQ (route (router, "/uploads", params), "uploads");
+  ASSERT_EQ (route (router, "/u", params), "");
+  ASSERT_EQ (route (router, "/users/", params), "");
+  ASSERT_EQ (route (router, "/users/new/x", params), "");
+  ASSERT_EQ (route (router, "", params), "");
+  ASSERT_EQ (params.size(), 0);
+}
+
+// ----------------------------------------------------------------------------
+// test_params
+// ----------------------------------------------------------------------------
+TEST (HttpRouter, test_params) {
+  lightning::HttpRouter router;
+  lightning::HttpParams params;
+
+  router.add ("/users/:id", makeHandler ("user"));
+  router.add ("/users/:id/orders/:oid", makeHandler ("order"));
+  router.add ("/users/me", makeHandler ("me"));
+
+  ASSERT_EQ (route (router, "/users/42", params), "user");
+  ASSERT_EQ (params.size(), 1);
+  ASSERT_EQ (params.get ("id"), "42");
+
+  ASSERT_EQ (route (router, "/users/42/orders/abc", params), "order");
+  ASSERT_EQ (params.size(), 2);
+  ASSERT_EQ (params.get ("id"), "42");
+  ASSERT_EQ (params.get ("oid"), "abc");
+  ASSERT_FALSE (params.get ("other").has_value());
+
+  // static routes have priority
+  ASSERT_EQ (route (router, "/users/me", params), "me");
+  ASSERT_EQ (params.size(), 0);
+
+  // ... but the parameter is used when the static branch does not match
+  ASSERT_EQ (route (router, "/users/me/orders/1", params), "order");
+  ASSERT_EQ (params.get ("id"), "me");
+
+  ASSERT_EQ (route (router, "/users/", params), "");
+  ASSERT_EQ (route (router, "/users/42/orders", params), "");
+  ASSERT_EQ (params.size(), 0);
+}
+
+// ----------------------------------------------------------------------------
+// test_wildcard
+// ----------------------------------------------------------------------------
+TEST (HttpRouter, test_wildcard) {
+  lightning::HttpRouter router;
+  lightning::HttpParams params;
+
+  router.add ("/static/*file", makeHandler ("static"));
+  router.add ("/static/index.html", makeHandler ("index"));
+  router.add ("/static/:dir/config", makeHandler ("config"));
+
+  ASSERT_EQ (route (router, "/static/css/main.css", params), "static");
+  ASSERT_EQ (params.get ("file"), "css/main.css");
+
+  ASSERT_EQ (route (router, "/static/", params), "static");
+  ASSERT_EQ (params.get ("file"), "");
+
+  ASSERT_EQ (route (router, "/static/index.html", params), "index");
+  ASSERT_EQ (route (router, "/static/js/config", params), "config");
+  ASSERT_EQ (params.get ("dir"), "js");
+
+  ASSERT_EQ (route (router, "/static", params), "");
+}
+
+// ----------------------------------------------------------------------------
+// test_conflicts
+// ----------------------------------------------------------------------------
+TEST (HttpRouter, test_conflicts) {
+  lightning::HttpRouter router;
+
+  router.add ("/users/:id", makeHandler ("user"));
+
+  ASSERT_THROW (router.add ("/users/:id", makeHandler ("user")), std::invalid_argument);
+  ASSERT_THROW (router.add ("/users/:name/x", makeHandler ("x")), std::invalid_argument);
+  ASSERT_THROW (router.add ("/files/*path/x", makeHandler ("x")), std::invalid_argument);
+  ASSERT_THROW (router.add ("/users/:", makeHandler ("x")), std::invalid_argument);
+}
@@ -3,15 +3,24 @@
 //
 // Copyright (c) 2024 Carlos Carrasco
 // ----------------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include <gtest/gtest.h>
 
 #include <fmt/format.h>
 
+#include <lightning/http_conditional.h>
 #include <lightning/http_server.h>
 
+#include "test_util.h"
+
 // ----------------------------------------------------------------------------
 // getLogLevel
 // ----------------------------------------------------------------------------
@@ -57,6 +66,57 @@ static std::pair<int32_t, std::string> readResponse (
   return { std::stoi (statusLine), bodyContent };
 }
 
+// ----------------------------------------------------------------------------
+// sendRaw
+// ----------------------------------------------------------------------------
+static std::string sendRaw (const std::vector<std::string> &chunks, uint16_t port = 8080) {
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), port });
+
+  // every chunk is sent in a different segment so the server gets them in different reads
+  for (const auto &chunk: chunks) {
+    asio::write (socket, asio::buffer (chunk));
+    std::this_thread::sleep_for (std::chrono::milliseconds (5));
+  }
+
+  asio::error_code ec;
+  socket.shutdown (asio::ip::tcp::socket::shutdown_send, ec);
+
+  std::string response;
+  asio::read (socket, asio::dynamic_buffer (response), ec);
+
+  return response;
+}
+
+// ----------------------------------------------------------------------------
+// exchange
+// ----------------------------------------------------------------------------
+// Sends a request without closing the sending side and reads for up to `timeout`.
+// Returns the response and whether the server has closed the connection.
+static std::pair<std::string, bool> exchange (
+  const std::string &request,
+  std::chrono::milliseconds timeout = std::chrono::milliseconds (300),
+  uint16_t port = 8080
+) {
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), port });
+  asio::write (socket, asio::buffer (request));
+
+  std::string response;
+  bool closed { false };
+
+  asio::async_read (socket, asio::dynamic_buffer (response), [ &closed ] (std::error_code ec, size_t) {
+    closed = (ec == asio::error::eof);
+  });
+
+  io.run_for (timeout);
+
+  return { response, closed };
+}
 
 // ----------------------------------------------------------------------------
 // test_get_simple_text
@@ -118,6 +178,7 @@ TEST (HttpServer, test_post_simple_text) {
     ASSERT_TRUE (request.headers.contains("headername"));
     // ASSERT_EQ (request.headers.get("content-length"), std::to_string(body.size()));
     ASSERT_EQ (request.body.size(), body.size());
+    ASSERT_EQ (request.body, body);
     response.status(200).send ("Hello World!");
   });
 
@@ -199,19 +260,24 @@ TEST (HttpServer, test_head_simple_text) {
     response.status(200).send ("Hello World!");
   });
 
-  const auto [ statusFileName, bodyFileName ] = createTempFiles();
+  server.addRoute (lightning::HttpMethod::kGet, "/next", [] (const auto &, auto &response) {
+    response.status (200).send ("next");
+  });
 
-  const auto exit = std::system (fmt::format(
-    "curl -s -X HEAD 'http://localhost:8080/v1/hello?p=1' -H 'HeaderName: header value' -H 'Content-Type: text/plain' -d '{}' -w '%{{http_code}}' -o {} > {}",
-    body,
-    bodyFileName.string(),
-    statusFileName.string()
-  ).c_str());
-  ASSERT_EQ (exit, 0);
+  // the response has the length of the handler's body but not the body itself, so the
+  // pipelined request that follows is answered right after its headers
+  const auto response { sendRaw ({
+    "HEAD /v1/hello?p=1 HTTP/1.1\r\nHost: localhost\r\nHeaderName: header value\r\n"
+    "Content-Type: text/plain\r\nContent-Length: 5\r\n\r\n" + body +
+    "GET /next HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+  }) };
 
-  const auto [ resStatus, resBody ] = readResponse (statusFileName, bodyFileName);
-  ASSERT_EQ (resStatus, 200);
-  ASSERT_EQ (resBody, "Hello World!");
+  const auto end { response.find ("\r\n\r\n") };
+
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200 "));
+  ASSERT_NE (response.substr (0, end + 2).find ("content-length: 12\r\n"), std::string::npos);
+  ASSERT_TRUE (response.substr (end + 4).starts_with ("HTTP/1.1 200 "));
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nnext"));
 }
 
 // ----------------------------------------------------------------------------
@@ -405,3 +471,1713 @@ TEST (HttpServer, test_patch_simple_text) {
   ASSERT_EQ (resStatus, 200);
   ASSERT_EQ (resBody, "Hello World!");
 }
+
+// ----------------------------------------------------------------------------
+// test_get_split_headers
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_get_split_headers) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  const std::string cookie (20000, 'c');
+
+  server.addRoute (lightning::HttpMethod::kGet, "/split", [ &cookie ] (const auto &request, auto &response) {
+    ASSERT_EQ (request.path, "/split");
+    ASSERT_EQ (request.query, "a=1");
+    ASSERT_EQ (request.host, "localhost");
+    ASSERT_EQ (request.headers.get ("cookie"), cookie);
+    ASSERT_EQ (request.headers.get ("x-last"), "last");
+    response.status (200).send ("split");
+  });
+
+  const std::string message {
+    "GET /split?a=1 HTTP/1.1\r\nHost: localhost:8080\r\nCookie: " + cookie + "\r\nX-Last: last\r\n\r\n"
+  };
+
+  // split the message in small chunks, the last one in the middle of "\r\n\r\n"
+  std::vector<std::string> chunks;
+  for (size_t i = 0; i < message.size() - 3; i += 1000)
+    chunks.push_back (message.substr (i, std::min<size_t> (1000, message.size() - 3 - i)));
+  chunks.push_back (message.substr (message.size() - 3));
+
+  const auto response { sendRaw (chunks) };
+  ASSERT_EQ (response.substr (0, 12), "HTTP/1.1 200");
+  ASSERT_EQ (response.substr (response.size() - 5), "split");
+}
+
+// ----------------------------------------------------------------------------
+// test_header_too_large
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_header_too_large) {
+  lightning::HttpServer server { 8080, 1, getLogLevel (lightning::LogLevel::kFatal), { .maxHeaderSize = 1024 } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/large", [] (const auto &, auto &response) {
+    response.status (200).send ("large");
+  });
+
+  const auto response { sendRaw ({ "GET /large HTTP/1.1\r\nHost: localhost\r\nCookie: " + std::string (4096, 'c') + "\r\n\r\n" }) };
+  ASSERT_EQ (response.substr (0, 12), "HTTP/1.1 431");
+}
+
+// ----------------------------------------------------------------------------
+// test_request_reuse
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_request_reuse) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/first", [] (const auto &request, auto &response) {
+    ASSERT_EQ (request.query, "a=1");
+    ASSERT_EQ (request.url, "/first?a=1#fragment");
+    ASSERT_TRUE (request.headers.contains ("x-first"));
+    response.status (200).send ("first");
+  });
+
+  server.addRoute (lightning::HttpMethod::kPost, "/second", [] (const auto &request, auto &response) {
+    ASSERT_EQ (request.method, lightning::HttpMethod::kPost);
+    ASSERT_EQ (request.query, "");
+    ASSERT_EQ (request.url, "/second#fragment?b=2");
+    ASSERT_EQ (request.version.minor, 0);
+    ASSERT_FALSE (request.headers.contains ("x-first"));
+    response.status (200).send ("second");
+  });
+
+  const auto response { sendRaw ({
+    "GET /first?a=1#fragment HTTP/1.1\r\nHost: localhost\r\nX-First: 1\r\n\r\n"
+    "POST /second#fragment?b=2 HTTP/1.0\r\nHost: localhost\r\n\r\n"
+  }) };
+
+  ASSERT_NE (response.find ("first"), std::string::npos);
+  ASSERT_NE (response.find ("second"), std::string::npos);
+}
+
+// ----------------------------------------------------------------------------
+// test_send_large_body
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_send_large_body) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  const auto shared { std::make_shared<const std::string> (1 << 20, 's') };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/owned", [] (const auto &, auto &response) {
+    std::string body (1 << 20, 'o');
+    response.status (200).send (std::move (body));
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/shared", [ &shared ] (const auto &, auto &response) {
+    response.status (200).send (shared);
+  });
+
+  const auto response { sendRaw ({
+    "GET /owned HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "GET /shared HTTP/1.1\r\nHost: localhost\r\n\r\n"
+  }) };
+
+  const auto owned { response.find ("content-length: 1048576\r\n") };
+  ASSERT_NE (owned, std::string::npos);
+  ASSERT_EQ (response.substr (response.find ("\r\n\r\n") + 4, 1 << 20), std::string (1 << 20, 'o'));
+
+  ASSERT_NE (response.find ("content-length: 1048576\r\n", owned + 1), std::string::npos);
+  ASSERT_EQ (response.substr (response.size() - (1 << 20)), *shared);
+}
+
+// ----------------------------------------------------------------------------
+// test_route_params
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_route_params) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/users/:id/orders/:oid", [] (const auto &request, auto &response) {
+    ASSERT_EQ (request.params.get ("id"), "42");
+    ASSERT_EQ (request.params.get ("oid"), "7");
+    response.status (200).send ("order");
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/files/*path", [] (const auto &request, auto &response) {
+    response.status (200).send (std::string { request.params.get ("path").value() });
+  });
+
+  const auto [ statusFileName, bodyFileName ] = createTempFiles();
+
+  auto exit = std::system (fmt::format(
+    "curl -s -X GET 'http://localhost:8080/users/42/orders/7?x=1' -w '%{{http_code}}' -o {} > {}",
+    bodyFileName.string(),
+    statusFileName.string()
+  ).c_str());
+  ASSERT_EQ (exit, 0);
+
+  auto [ resStatus, resBody ] = readResponse (statusFileName, bodyFileName);
+  ASSERT_EQ (resStatus, 200);
+  ASSERT_EQ (resBody, "order");
+
+  exit = std::system (fmt::format(
+    "curl -s -X GET 'http://localhost:8080/files/a/b.txt' -w '%{{http_code}}' -o {} > {}",
+    bodyFileName.string(),
+    statusFileName.string()
+  ).c_str());
+  ASSERT_EQ (exit, 0);
+
+  std::tie (resStatus, resBody) = readResponse (statusFileName, bodyFileName);
+  ASSERT_EQ (resStatus, 200);
+  ASSERT_EQ (resBody, "a/b.txt");
+}
+
+// ----------------------------------------------------------------------------
+// test_route_params_large_body
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_route_params_large_body) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  // the params are found with the headers, before the body grows the input buffer
+  server.addRoute (lightning::HttpMethod::kPost, "/items/:id", [] (const auto &request, auto &response) {
+    response.status (200).send (std::string { request.params.get ("id").value() } + ":" + std::to_string (request.body.size()));
+  });
+
+  const auto response { sendRaw ({
+    "POST /items/1234 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Length: 20000\r\n\r\n",
+    std::string (20000, 'b')
+  }) };
+
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200 "));
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n1234:20000"));
+}
+
+// ----------------------------------------------------------------------------
+// test_query_and_form_params
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_query_and_form_params) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/search", [] (const auto &request, auto &response) {
+    const auto &query { request.queryParams() };
+
+    response.status (200).send (fmt::format (
+      "{}|{}|{}|{}",
+      query.decoded ("q").value_or ("-"),
+      query.template get<int> ("limit").value_or (-1),
+      query.size(),
+      request.formParams().size()
+    ));
+  });
+
+  server.addRoute (lightning::HttpMethod::kPost, "/form", [] (const auto &request, auto &response) {
+    const auto &form { request.formParams() };
+
+    response.status (200).send (fmt::format (
+      "{}|{}|{}",
+      form.decoded ("name").value_or ("-"),
+      form.template get<int> ("age").value_or (-1),
+      request.queryParams().get ("x").value_or ("-")
+    ));
+  });
+
+  auto [ response, closed ] = exchange ("GET /search?q=hello+world%21&limit=20&page HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nhello world!|20|3|0"));
+
+  std::tie (response, closed) = exchange ("GET /search HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n-|-1|0|0"));
+
+  std::tie (response, closed) = exchange (
+    "POST /form?x=1 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
+    "Content-Length: 25\r\n\r\nname=Ana+Mar%C3%ADa&age=7"
+  );
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nAna Mar\xC3\xAD" "a|7|1"));
+
+  // other bodies are not form fields
+  std::tie (response, closed) = exchange (
+    "POST /form HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nage=7"
+  );
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n-|-1|-"));
+}
+
+// ----------------------------------------------------------------------------
+// test_json
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_json) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kPost, "/orders", [] (const auto &request, auto &response) {
+    const auto *order { request.json() };
+
+    if (order == nullptr) {
+      response.status (400).send ("");
+      return;
+    }
+
+    const auto *items { order->find ("items") };
+
+    response.status (201).json()
+      .startObject()
+        .key ("customer").value (order->find ("customer")->getString().value_or (""))
+        .key ("count").value (items ? items->size() : 0)
+        .key ("items").value (items ? *items : lightning::JsonValue {})
+      .endObject();
+  });
+
+  const std::string body { R"({ "customer": "Jos\u00e9 \"J\"", "items": [ { "sku": "a", "qty": 2 }, { "sku": "b", "qty": 1 } ] })" };
+
+  auto [ response, closed ] = exchange (
+    "POST /orders HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\nConnection: close\r\n"
+    "Content-Length: " + std::to_string (body.size()) + "\r\n\r\n" + body
+  );
+
+  const std::string expected { R"({"customer":"Jos)" "\xC3\xA9" R"( \"J\"","count":2,"items":[{"sku":"a","qty":2},{"sku":"b","qty":1}]})" };
+
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 201"));
+  ASSERT_NE (response.find ("content-type: application/json\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("content-length: " + std::to_string (expected.size()) + "\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n" + expected));
+
+  std::tie (response, closed) = exchange (
+    "POST /orders HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Length: 8\r\n\r\n{\"a\": 1,"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 400"));
+}
+
+// ----------------------------------------------------------------------------
+// test_sharded
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_sharded) {
+  lightning::HttpServer server { 8080, 4, getLogLevel(), { .sharded = true } };
+
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+
+  server.addRoute (lightning::HttpMethod::kGet, "/shard", [ & ] (const auto &, auto &response) {
+    {
+      std::lock_guard lock { mutex };
+      threads.insert (std::this_thread::get_id());
+    }
+
+    response.status (200).send ("shard");
+  });
+
+  for (int i = 0; i < 32; ++i) {
+    const auto response { sendRaw ({ "GET /shard HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n" }) };
+
+    ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+    ASSERT_TRUE (response.ends_with ("\r\n\r\nshard"));
+  }
+
+  std::lock_guard lock { mutex };
+  ASSERT_GE (threads.size(), 1);
+  ASSERT_LE (threads.size(), 4);
+}
+
+// ----------------------------------------------------------------------------
+// test_async_handler
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_async_handler) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/async/:id", [] (const auto &request, auto &response) -> asio::awaitable<void> {
+    asio::steady_timer timer { co_await asio::this_coro::executor, std::chrono::milliseconds (20) };
+    co_await timer.async_wait (asio::use_awaitable);
+
+    response.status (200).send ("async " + std::string { request.params.get ("id").value() });
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/throw", [] (const auto &, auto &) -> asio::awaitable<void> {
+    co_await asio::post (co_await asio::this_coro::executor, asio::use_awaitable);
+
+    throw std::runtime_error { "failed" };
+  });
+
+  auto response { sendRaw ({ "GET /async/1 HTTP/1.1\r\nHost: localhost\r\n\r\nGET /async/2 HTTP/1.1\r\nHost: localhost\r\n\r\n" }) };
+  ASSERT_NE (response.find ("\r\n\r\nasync 1HTTP/1.1 200"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nasync 2"));
+
+  response = sendRaw ({ "GET /throw HTTP/1.1\r\nHost: localhost\r\n\r\n" });
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 500"));
+}
+
+// ----------------------------------------------------------------------------
+// test_deferred_handler
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_deferred_handler) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  // the slow response is finished by the fast request, which can only be served
+  // if the (single) I/O thread is not blocked by the pending one
+  std::mutex mutex;
+  lightning::HttpResponder pending;
+  lightning::HttpResponse *pendingResponse { nullptr };
+  std::thread finisher;
+
+  server.addRoute (lightning::HttpMethod::kGet, "/slow", [ & ] (const auto &, auto &response) {
+    std::lock_guard lock { mutex };
+    pending = response.defer();
+    pendingResponse = &response;
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/fast", [ & ] (const auto &, auto &response) {
+    response.status (200).send ("fast");
+
+    finisher = std::thread { [ & ] {
+      std::lock_guard lock { mutex };
+      pendingResponse->status (200).send ("slow");
+      pending.finish();
+    } };
+  });
+
+  std::string slow;
+  std::thread client { [ & ] { slow = sendRaw ({ "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n" }); } };
+
+  while (true) {
+    std::this_thread::sleep_for (std::chrono::milliseconds (5));
+    std::lock_guard lock { mutex };
+    if (pendingResponse != nullptr)
+      break;
+  }
+
+  const auto fast { sendRaw ({ "GET /fast HTTP/1.1\r\nHost: localhost\r\n\r\n" }) };
+  client.join();
+  finisher.join();
+
+  ASSERT_TRUE (fast.ends_with ("\r\n\r\nfast"));
+  ASSERT_TRUE (slow.ends_with ("\r\n\r\nslow"));
+}
+
+// ----------------------------------------------------------------------------
+// test_deferred_finish_copies
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_deferred_finish_copies) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  std::thread finisher;
+
+  // both copies are finished, but only one response is written for the request
+  server.addRoute (lightning::HttpMethod::kGet, "/twice", [ & ] (const auto &, auto &response) {
+    response.status (200).send ("twice");
+
+    const auto responder { response.defer() };
+    finisher = std::thread { [ first = responder, second = responder ] () mutable {
+      first.finish();
+      second.finish();
+    } };
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/next", [] (const auto &, auto &response) {
+    response.status (200).send ("next");
+  });
+
+  const auto response { sendRaw ({
+    "GET /twice HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "GET /next HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+  }) };
+  finisher.join();
+
+  const auto first { response.find ("HTTP/1.1 200") };
+  const auto second { response.find ("HTTP/1.1 200", first + 1) };
+
+  ASSERT_NE (second, std::string::npos);
+  ASSERT_EQ (response.find ("HTTP/1.1", second + 1), std::string::npos);
+  ASSERT_EQ (response.substr (response.find ("\r\n\r\n") + 4, 5), "twice");
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nnext"));
+}
+
+// ----------------------------------------------------------------------------
+// test_cached_deferred_finish_copies
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_cached_deferred_finish_copies) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  std::atomic<int> calls { 0 };
+  std::thread finisher;
+
+  // the copies of the wrapped responder race to land the flight; only the first captures
+  server.addCachedRoute (lightning::HttpMethod::kGet, "/twice", [ & ] (const auto &, auto &response) {
+    ++calls;
+    response.status (200).send ("twice");
+
+    const auto responder { response.defer() };
+    finisher = std::thread { [ first = responder, second = responder ] () mutable {
+      std::thread other { [ &second ] { second.finish(); } };
+      first.finish();
+      other.join();
+    } };
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/next", [] (const auto &, auto &response) {
+    response.status (200).send ("next");
+  });
+
+  const auto response { sendRaw ({
+    "GET /twice HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "GET /next HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+  }) };
+  finisher.join();
+
+  const auto first { response.find ("HTTP/1.1 200") };
+  const auto second { response.find ("HTTP/1.1 200", first + 1) };
+
+  ASSERT_NE (second, std::string::npos);
+  ASSERT_EQ (response.find ("HTTP/1.1", second + 1), std::string::npos);
+  ASSERT_EQ (response.substr (response.find ("\r\n\r\n") + 4, 5), "twice");
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nnext"));
+
+  // the captured response is the one that was written
+  ASSERT_TRUE (sendRaw ({ "GET /twice HTTP/1.1\r\nHost: localhost\r\n\r\n" }).ends_with ("\r\n\r\ntwice"));
+  ASSERT_EQ (calls, 1);
+}
+
+// ----------------------------------------------------------------------------
+// test_connection_reuse
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_connection_reuse) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/reuse/:n", [] (const auto &request, auto &response) {
+    const auto n { request.params.get ("n").value() };
+
+    // more fields than the inline storage, so they are allocated from the arena
+    ASSERT_EQ (request.headers.size(), 25);
+    ASSERT_EQ (request.headers.get ("x-header-24"), n);
+
+    response.headers().set ("x-echo", response.store (fmt::format ("echo-{}", n)));
+    response.status (200).send (std::string { request.ip });
+  });
+
+  // connections are closed and their objects reused by the next ones
+  for (int i = 0; i < 16; ++i) {
+    std::string message { fmt::format ("GET /reuse/{} HTTP/1.1\r\nHost: localhost\r\n", i) };
+
+    for (int h = 0; h < 24; ++h)
+      message += fmt::format ("X-Header-{}: {}\r\n", h + 1, i);
+
+    message += "\r\n";
+
+    const auto response { sendRaw ({ message, message }) };
+
+    ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+    ASSERT_NE (response.find (fmt::format ("x-echo: echo-{}\r\n", i)), std::string::npos);
+    ASSERT_TRUE (response.ends_with ("\r\n\r\n127.0.0.1"));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// test_chunked_body
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_chunked_body) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kPost, "/chunked", [] (const auto &request, auto &response) {
+    response.status (200).send (fmt::format ("[{}]", request.body));
+  });
+
+  // the body arrives in different reads, and chunks are joined in a contiguous view
+  const auto response { sendRaw ({
+    "POST /chunked HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n",
+    "5\r\nhello\r\n1",
+    "\r\n \r\n5\r\nwor",
+    "ld\r\n0\r\n\r\n",
+    "POST /chunked HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4\r\n\r\nab",
+    "cd"
+  }) };
+
+  ASSERT_NE (response.find ("\r\n\r\n[hello world]HTTP/1.1 200"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n[abcd]"));
+}
+
+// ----------------------------------------------------------------------------
+// test_body_too_large
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_body_too_large) {
+  lightning::HttpServer server { 8080, 1, getLogLevel(), { .maxBodySize = 1024 } };
+
+  server.addRoute (lightning::HttpMethod::kPost, "/small", [] (const auto &, auto &response) {
+    response.status (200).send ("");
+  });
+
+  auto response { sendRaw ({ "POST /small HTTP/1.1\r\nHost: localhost\r\nContent-Length: 2048\r\n\r\n" }) };
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 413"));
+
+  response = sendRaw ({
+    "POST /small HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n",
+    "400\r\n" + std::string (1024, 'a') + "\r\n",
+    "1\r\na\r\n0\r\n\r\n"
+  });
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 413"));
+}
+
+// ----------------------------------------------------------------------------
+// test_streaming_body
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_streaming_body) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  constexpr size_t kSize { 32 * 1024 * 1024 };
+
+  size_t received { 0 };
+  size_t maxChunk { 0 };
+  uint64_t sum { 0 };
+
+  server.addRoute (
+    lightning::HttpMethod::kPost,
+    "/upload",
+    [ & ] (const auto &request, auto &response) {
+      ASSERT_TRUE (request.body.empty());
+      response.status (200).send (fmt::format ("{} {}", received, sum));
+    },
+    [ & ] (const auto &, std::string_view chunk) {
+      received += chunk.size();
+      maxChunk = std::max (maxChunk, chunk.size());
+
+      for (const auto c: chunk)
+        sum += static_cast<uint8_t> (c);
+    }
+  );
+
+  const auto [ statusFileName, bodyFileName ] = createTempFiles();
+  const auto uploadFileName { std::filesystem::temp_directory_path() / "test_streaming_body.upload" };
+
+  uint64_t expected { 0 };
+
+  {
+    std::string data (kSize, '\0');
+    for (size_t i = 0; i < kSize; ++i) {
+      data[i] = static_cast<char> (i % 251);
+      expected += static_cast<uint8_t> (data[i]);
+    }
+
+    std::ofstream { uploadFileName, std::ios::binary } << data;
+  }
+
+  // big uploads are sent by curl with "Expect: 100-continue"
+  const auto exit = std::system (fmt::format(
+    "curl -s -X POST 'http://localhost:8080/upload' -H 'Expect: 100-continue' --data-binary @{} -w '%{{http_code}}' -o {} > {}",
+    uploadFileName.string(),
+    bodyFileName.string(),
+    statusFileName.string()
+  ).c_str());
+  ASSERT_EQ (exit, 0);
+
+  std::filesystem::remove (uploadFileName);
+
+  const auto [ resStatus, resBody ] = readResponse (statusFileName, bodyFileName);
+  ASSERT_EQ (resStatus, 200);
+  ASSERT_EQ (resBody, fmt::format ("{} {}", kSize, expected));
+
+  // the body has never been buffered whole
+  ASSERT_LE (maxChunk, 64 * 1024);
+}
+
+// ----------------------------------------------------------------------------
+// test_pipelining
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_pipelining) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  std::thread finisher;
+
+  server.addRoute (lightning::HttpMethod::kGet, "/p/:n", [] (const auto &request, auto &response) {
+    response.status (200).send (std::string { request.params.get ("n").value() });
+  });
+
+  // responses keep the order of the requests even if one of them is finished later
+  server.addRoute (lightning::HttpMethod::kGet, "/deferred", [ & ] (const auto &, auto &response) {
+    finisher = std::thread { [ &response, responder = response.defer() ] () mutable {
+      std::this_thread::sleep_for (std::chrono::milliseconds (20));
+      response.status (200).send ("d");
+      responder.finish();
+    } };
+  });
+
+  std::string requests;
+  std::string expected;
+
+  for (int i = 0; i < 16; ++i) {
+    const auto path { (i == 5) ? std::string { "deferred" } : fmt::format ("p/{}", i) };
+
+    requests += fmt::format ("GET /{} HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    expected += (i == 5) ? std::string { "d" } : std::to_string (i);
+  }
+
+  // all of them are sent in a single segment
+  const auto response { sendRaw ({ requests }) };
+  finisher.join();
+
+  std::string bodies;
+  for (size_t pos { 0 }; (pos = response.find ("\r\n\r\n", pos)) != std::string::npos; pos += 4) {
+    const auto next { response.find ("HTTP/1.1 ", pos) };
+    bodies += response.substr (pos + 4, (next == std::string::npos ? response.size() : next) - pos - 4);
+  }
+
+  ASSERT_EQ (bodies, expected);
+}
+
+// ----------------------------------------------------------------------------
+// test_pipelining_arena
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_pipelining_arena) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  std::vector<const char *> stored;
+
+  // every message starts from a released arena, so its strings take the same memory
+  server.addRoute (lightning::HttpMethod::kGet, "/arena", [ & ] (const auto &, auto &response) {
+    const auto value { response.store (std::string (512, 'x')) };
+
+    stored.push_back (value.data());
+    response.headers().set ("X-Stored", value);
+    response.status (200).send ("");
+  });
+
+  std::string requests;
+  for (int i = 0; i < 16; ++i)
+    requests += "GET /arena HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+  // the buffer is never empty when the responses are written: a partial request follows them
+  const auto response { sendRaw ({
+    requests + "GET /arena HTTP/1.1\r\nHo",
+    "st: localhost\r\nConnection: close\r\n\r\n"
+  }) };
+
+  ASSERT_EQ (stored.size(), 17);
+
+  for (const auto p: stored)
+    ASSERT_EQ (p, stored.front());
+}
+
+// ----------------------------------------------------------------------------
+// test_keep_alive
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_keep_alive) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/ka", [] (const auto &, auto &response) {
+    response.status (200).send ("ka");
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/bye", [] (const auto &, auto &response) {
+    response.headers().set ("Connection", "close");
+    response.status (200).send ("bye");
+  });
+
+  // HTTP/1.0 is closed unless keep-alive is requested
+  auto [ response, closed ] = exchange ("GET /ka HTTP/1.0\r\n\r\n");
+  ASSERT_TRUE (closed);
+  ASSERT_NE (response.find ("connection: close\r\n"), std::string::npos);
+
+  std::tie (response, closed) = exchange ("GET /ka HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+  ASSERT_FALSE (closed);
+  ASSERT_NE (response.find ("connection: keep-alive\r\n"), std::string::npos);
+
+  // HTTP/1.1 is kept open unless the client or the handler closes it
+  std::tie (response, closed) = exchange ("GET /ka HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  ASSERT_FALSE (closed);
+  ASSERT_EQ (response.find ("connection:"), std::string::npos);
+
+  std::tie (response, closed) = exchange (
+    "GET /ka HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"
+    "GET /ka HTTP/1.1\r\nHost: localhost\r\n\r\n"
+  );
+  ASSERT_TRUE (closed);
+  ASSERT_TRUE (response.ends_with ("connection: close\r\ncontent-length: 2\r\nserver: lightning\r\n\r\nka"));
+  ASSERT_EQ (response.find ("HTTP/1.1", 1), std::string::npos);
+
+  std::tie (response, closed) = exchange ("GET /bye HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  ASSERT_TRUE (closed);
+}
+
+// ----------------------------------------------------------------------------
+// test_max_requests_per_connection
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_max_requests_per_connection) {
+  lightning::HttpServer server { 8080, 1, getLogLevel(), { .maxRequestsPerConnection = 3 } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/n", [] (const auto &, auto &response) {
+    response.status (200).send ("n");
+  });
+
+  std::string requests;
+  for (int i = 0; i < 5; ++i)
+    requests += "GET /n HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+  const auto [ response, closed ] = exchange (requests);
+  ASSERT_TRUE (closed);
+
+  size_t count { 0 };
+  for (size_t pos { 0 }; (pos = response.find ("HTTP/1.1 200", pos)) != std::string::npos; ++pos)
+    ++count;
+
+  ASSERT_EQ (count, 3);
+  ASSERT_TRUE (response.ends_with ("connection: close\r\ncontent-length: 1\r\nserver: lightning\r\n\r\nn"));
+}
+
+// ----------------------------------------------------------------------------
+// test_max_connections
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_max_connections) {
+  lightning::HttpServer server { 8080, 1, getLogLevel(), { .maxConnections = 2 } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/c", [] (const auto &, auto &response) {
+    response.status (200).send ("c");
+  });
+
+  asio::io_context io;
+  const asio::ip::tcp::endpoint ep { asio::ip::address::from_string ("127.0.0.1"), 8080 };
+
+  asio::ip::tcp::socket first { io };
+  first.connect (ep);
+  asio::ip::tcp::socket second { io };
+  second.connect (ep);
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  // the third connection waits in the backlog until one of the others is closed
+  asio::ip::tcp::socket third { io };
+  third.connect (ep);
+  asio::write (third, asio::buffer (std::string_view { "GET /c HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n" }));
+
+  std::string response;
+  bool done { false };
+  asio::async_read (third, asio::dynamic_buffer (response), [ &done ] (std::error_code, size_t) { done = true; });
+
+  io.run_for (std::chrono::milliseconds (200));
+  ASSERT_FALSE (done);
+
+  first.close();
+
+  io.restart();
+  io.run_for (std::chrono::milliseconds (500));
+  ASSERT_TRUE (done);
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+}
+
+// ----------------------------------------------------------------------------
+// test_timeouts
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_timeouts) {
+  using namespace std::chrono_literals;
+
+  lightning::HttpServer server {
+    8080,
+    1,
+    getLogLevel(),
+    { .headerTimeout = 200ms, .bodyTimeout = 200ms, .keepAliveTimeout = 200ms, .writeTimeout = 200ms }
+  };
+
+  server.addRoute (lightning::HttpMethod::kPost, "/t", [] (const auto &, auto &response) {
+    response.status (200).send ("t");
+  });
+
+  // nothing is sent
+  auto [ response, closed ] = exchange ("", 1000ms);
+  ASSERT_TRUE (closed);
+  ASSERT_TRUE (response.empty());
+
+  // incomplete headers
+  std::tie (response, closed) = exchange ("POST /t HTTP/1.1\r\nHost: local", 1000ms);
+  ASSERT_TRUE (closed);
+  ASSERT_TRUE (response.empty());
+
+  // incomplete body
+  std::tie (response, closed) = exchange ("POST /t HTTP/1.1\r\nHost: localhost\r\nContent-Length: 10\r\n\r\nabc", 1000ms);
+  ASSERT_TRUE (closed);
+  ASSERT_TRUE (response.empty());
+
+  // idle after a response
+  std::tie (response, closed) = exchange ("POST /t HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n", 1000ms);
+  ASSERT_TRUE (closed);
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+
+  // headers sent a byte at a time do not extend the deadline
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), 8080 });
+
+  const std::string_view request { "POST /t HTTP/1.1\r\nHost: localhost\r\nX-Padding: aaaaaaaaaaaaaaaaaaaa\r\n\r\n" };
+  asio::error_code ec;
+
+  for (size_t i { 0 }; (i < request.size()) && !ec; ++i) {
+    asio::write (socket, asio::buffer (request.substr (i, 1)), ec);
+    std::this_thread::sleep_for (20ms);
+  }
+
+  ASSERT_TRUE (ec);
+}
+
+// ----------------------------------------------------------------------------
+// test_release_idle_buffers
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_release_idle_buffers) {
+  for (const bool release: { false, true }) {
+    lightning::HttpServer server { 8080, 1, getLogLevel(), { .releaseIdleBuffers = release } };
+
+    server.addRoute (lightning::HttpMethod::kGet, "/m", [] (const auto &, auto &response) {
+      response.status (200).send ("m");
+    });
+
+    asio::io_context io;
+    std::vector<asio::ip::tcp::socket> sockets;
+
+    const auto get = [] (asio::ip::tcp::socket &socket) {
+      asio::write (socket, asio::buffer (std::string_view { "GET /m HTTP/1.1\r\nHost: localhost\r\n\r\n" }));
+
+      std::string response;
+      asio::read_until (socket, asio::dynamic_buffer (response), "\r\n\r\nm");
+
+      return response;
+    };
+
+    for (size_t i { 0 }; i < 4; ++i) {
+      auto &socket { sockets.emplace_back (io) };
+
+      socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), 8080 });
+      ASSERT_TRUE (get (socket).starts_with ("HTTP/1.1 200"));
+    }
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+    const auto usage { server.memoryUsage() };
+    ASSERT_EQ (usage.connections, 4);
+    ASSERT_EQ (usage.inputBufferBytes, release ? 0 : 4 * lightning::HttpConfig {}.inputBufferSize);
+    ASSERT_GT (usage.perConnection(), 0);
+
+    // idle connections are woken up by the next request
+    for (auto &socket: sockets)
+      ASSERT_TRUE (get (socket).starts_with ("HTTP/1.1 200"));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// test_static_files
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_static_files) {
+  const auto root { std::filesystem::temp_directory_path() / "lightning_test_static_files" };
+  std::filesystem::create_directories (root / "css");
+
+  std::string big (1024 * 1024, '\0');
+  for (size_t i { 0 }; i < big.size(); ++i)
+    big[i] = static_cast<char> ('a' + i % 26);
+
+  std::ofstream { root / "big.bin", std::ios::binary } << big;
+  std::ofstream { root / "css" / "site.css" } << "body {}";
+  std::ofstream { root / "index.html" } << "<html></html>";
+
+  lightning::HttpServer server { 8080, 1, getLogLevel() };
+  server.addStaticRoute ("/static", root);
+
+  // a file sent with sendfile between two mapped ones, all of them pipelined
+  auto [ response, closed ] = exchange (
+    "GET /static/css/site.css HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "GET /static/big.bin HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "GET /static/ HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n",
+    std::chrono::milliseconds (2000)
+  );
+
+  ASSERT_TRUE (closed);
+
+  const auto css { response.find ("\r\n\r\nbody {}HTTP/1.1 200") };
+  ASSERT_NE (css, std::string::npos);
+  ASSERT_NE (response.find ("content-type: text/css; charset=utf-8\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("last-modified: "), std::string::npos);
+
+  const auto bin { response.find ("content-type: application/octet-stream\r\ncontent-length: 1048576\r\n") };
+  ASSERT_NE (bin, std::string::npos);
+
+  const auto binBody { response.find ("\r\n\r\n", bin) + 4 };
+  ASSERT_EQ (response.compare (binBody, big.size(), big), 0);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n<html></html>"));
+
+  // HEAD: the length of the file, without its body
+  std::tie (response, closed) = exchange ("HEAD /static/big.bin HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+  ASSERT_NE (response.find ("content-length: 1048576\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n"));
+
+  // and it is validated as a GET
+  const auto etag { response.find ("etag: ") + 6 };
+  std::tie (response, closed) = exchange (
+    "HEAD /static/big.bin HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nIf-None-Match: " +
+    response.substr (etag, response.find ("\r\n", etag) - etag) + "\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 304"));
+
+  std::tie (response, closed) = exchange ("GET /static/missing.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 404"));
+
+  std::tie (response, closed) = exchange ("GET /static/%2e%2e/etc/passwd HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 400"));
+
+  std::filesystem::remove_all (root);
+}
+
+// ----------------------------------------------------------------------------
+// test_conditional_requests
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_conditional_requests) {
+  const auto root { std::filesystem::temp_directory_path() / "lightning_test_conditional_requests" };
+  std::filesystem::create_directories (root);
+
+  std::string big (1024 * 1024, '\0');
+  for (size_t i { 0 }; i < big.size(); ++i)
+    big[i] = static_cast<char> ('a' + i % 26);
+
+  std::ofstream { root / "big.bin", std::ios::binary } << big;
+  std::ofstream { root / "small.txt" } << "0123456789";
+
+  lightning::HttpConfig config;
+  config.autoETag = true;
+
+  lightning::HttpServer server { 8080, 1, getLogLevel(), config };
+  server.addStaticRoute ("/static", root);
+
+  server.addRoute (lightning::HttpMethod::kGet, "/doc", [] (const lightning::HttpRequest &, lightning::HttpResponse &response) {
+    response.status (200).send ("a document");
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/sized", [] (const lightning::HttpRequest &, lightning::HttpResponse &response) {
+    response.headers().set (lightning::HttpHeaderName::kContentLength, "10");
+    response.status (200).send ("0123456789");
+  });
+
+  server.addCachedRoute (lightning::HttpMethod::kGet, "/cached", [] (const lightning::HttpRequest &, lightning::HttpResponse &response) {
+    response.status (200).send ("a cached document");
+  });
+
+  const auto header = [] (const std::string &response, std::string_view name) {
+    const auto start { response.find (name) + name.size() + 2 };
+    return response.substr (start, response.find ("\r\n", start) - start);
+  };
+
+  // validators of a file, then revalidation with each of them
+  auto [ response, closed ] = exchange ("GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+  ASSERT_NE (response.find ("accept-ranges: bytes\r\n"), std::string::npos);
+
+  const auto etag { header (response, "etag") };
+  const auto lastModified { header (response, "last-modified") };
+  ASSERT_TRUE (etag.starts_with ('"'));
+
+  std::tie (response, closed) = exchange (
+    "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: \"x\", " + etag + "\r\nConnection: close\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 304"));
+  ASSERT_EQ (response.find ("content-length"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n"));
+
+  std::tie (response, closed) = exchange (
+    "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nIf-Modified-Since: " + lastModified + "\r\nConnection: close\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 304"));
+
+  std::tie (response, closed) = exchange (
+    "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: \"x\"\r\nIf-Modified-Since: " + lastModified + "\r\nConnection: close\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+
+  // single ranges, from a mapped file and with sendfile, pipelined
+  std::tie (response, closed) = exchange (
+    "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nRange: bytes=2-4\r\n\r\n"
+    "GET /static/big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=-3\r\nConnection: close\r\n\r\n",
+    std::chrono::milliseconds (1000)
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 206"));
+  ASSERT_NE (response.find ("content-range: bytes 2-4/10\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("\r\n\r\n234HTTP/1.1 206"), std::string::npos);
+  ASSERT_NE (response.find ("content-range: bytes 1048573-1048575/1048576\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("content-length: 3\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n" + big.substr (big.size() - 3)));
+
+  // several ranges of a file sent with sendfile
+  std::tie (response, closed) = exchange (
+    "GET /static/big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=0-1, 100000-100002\r\nConnection: close\r\n\r\n",
+    std::chrono::milliseconds (1000)
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 206"));
+
+  const auto boundary { header (response, "content-type").substr (std::string_view { "multipart/byteranges; boundary=" }.size()) };
+  const auto body { response.substr (response.find ("\r\n\r\n") + 4) };
+
+  ASSERT_EQ (std::stoul (header (response, "content-length")), body.size());
+  ASSERT_EQ (
+    body,
+    "\r\n--" + boundary + "\r\ncontent-type: application/octet-stream\r\ncontent-range: bytes 0-1/1048576\r\n\r\n" + big.substr (0, 2) +
+    "\r\n--" + boundary + "\r\ncontent-type: application/octet-stream\r\ncontent-range: bytes 100000-100002/1048576\r\n\r\n" + big.substr (100000, 3) +
+    "\r\n--" + boundary + "--\r\n"
+  );
+
+  // unsatisfiable
+  std::tie (response, closed) = exchange ("GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nRange: bytes=10-\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 416"));
+  ASSERT_NE (response.find ("content-range: bytes */10\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("content-length: 0\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n"));
+
+  // If-Range with a stale validator: the whole file
+  std::tie (response, closed) = exchange (
+    "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nRange: bytes=2-4\r\nIf-Range: \"stale\"\r\nConnection: close\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n0123456789"));
+
+  std::tie (response, closed) = exchange (
+    "GET /static/small.txt HTTP/1.1\r\nHost: localhost\r\nRange: bytes=2-4\r\nIf-Range: " + etag + "\r\nConnection: close\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 206"));
+
+  // a Content-Length set by the handler is that of the ranges sent, so the next response follows
+  std::tie (response, closed) = exchange (
+    "GET /sized HTTP/1.1\r\nHost: localhost\r\nRange: bytes=2-4\r\n\r\n"
+    "GET /sized HTTP/1.1\r\nHost: localhost\r\nRange: bytes=0-0,9-9\r\n\r\n"
+    "GET /sized HTTP/1.1\r\nHost: localhost\r\nRange: bytes=10-\r\nConnection: close\r\n\r\n"
+  );
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 206"));
+  ASSERT_NE (response.find ("content-length: 3\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("\r\n\r\n234HTTP/1.1 206"), std::string::npos);
+
+  const auto multipart { response.substr (response.find ("HTTP/1.1 206", 1)) };
+  const auto multipartBody { multipart.substr (multipart.find ("\r\n\r\n") + 4) };
+  ASSERT_EQ (std::stoul (header (multipart, "content-length")), multipartBody.find ("HTTP/1.1 416"));
+  ASSERT_TRUE (multipartBody.ends_with ("\r\n\r\n"));
+  ASSERT_NE (multipartBody.find ("content-length: 0\r\n"), std::string::npos);
+
+  // automatic ETag of a handler's response
+  std::tie (response, closed) = exchange ("GET /doc HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  const auto docETag { header (response, "etag") };
+  ASSERT_EQ (docETag.size(), 18);
+
+  std::tie (response, closed) = exchange ("GET /doc HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: " + docETag + "\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 304"));
+
+  // the cache adds it once, when the response is captured, and every hit keeps it
+  const auto cachedETag { lightning::HttpConditional::etag ("a cached document") };
+
+  std::tie (response, closed) = exchange ("GET /cached HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_EQ (header (response, "etag"), cachedETag);
+
+  std::tie (response, closed) = exchange ("GET /cached HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  ASSERT_EQ (header (response, "etag"), cachedETag);
+
+  std::tie (response, closed) = exchange ("GET /cached HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: " + cachedETag + "\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 304"));
+
+  std::filesystem::remove_all (root);
+}
+
+// ----------------------------------------------------------------------------
+// test_response_cache
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_response_cache) {
+  lightning::HttpServer server { 8080, 4, getLogLevel() };
+
+  std::atomic<int> calls { 0 };
+  std::atomic<int> slowCalls { 0 };
+  std::atomic<int> privateCalls { 0 };
+
+  lightning::HttpCacheConfig config;
+  config.ttl = std::chrono::milliseconds (200);
+  config.varyHeaders = { "Accept-Language" };
+
+  const auto cache { server.addCachedRoute (lightning::HttpMethod::kGet, "/report/:id", [ & ] (const auto &request, auto &response) {
+    const auto n { ++calls };
+
+    response.headers().set ("X-Call", response.store (std::to_string (n)));
+    response.status (200).send ("report " + std::string { request.params.get ("id").value() });
+  }, config) };
+
+  server.addCachedRoute (lightning::HttpMethod::kGet, "/private", [ & ] (const auto &, auto &response) {
+    ++privateCalls;
+
+    response.headers().set (lightning::HttpHeaderName::kCacheControl, "Private, max-age=10");
+    response.status (200).send ("mine");
+  });
+
+  server.addCachedRoute (lightning::HttpMethod::kGet, "/slow", [ & ] (const auto &, auto &response) -> asio::awaitable<void> {
+    ++slowCalls;
+
+    asio::steady_timer timer { co_await asio::this_coro::executor, std::chrono::milliseconds (100) };
+    co_await timer.async_wait (asio::use_awaitable);
+
+    response.status (200).send ("slow");
+  });
+
+  const auto get = [] (const std::string &target, const std::string &headers = "") {
+    return sendRaw ({ "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n" });
+  };
+
+  // hits keep the headers and the body of the first response
+  auto response { get ("/report/1") };
+  ASSERT_NE (response.find ("X-Call: 1\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nreport 1"));
+
+  response = get ("/report/1");
+  ASSERT_NE (response.find ("X-Call: 1\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nreport 1"));
+  ASSERT_EQ (calls, 1);
+
+  // query and selected headers are part of the key
+  ASSERT_NE (get ("/report/1?page=2").find ("X-Call: 2\r\n"), std::string::npos);
+  ASSERT_NE (get ("/report/1", "Accept-Language: es\r\n").find ("X-Call: 3\r\n"), std::string::npos);
+  ASSERT_NE (get ("/report/1", "Accept-Language: es\r\n").find ("X-Call: 3\r\n"), std::string::npos);
+  ASSERT_NE (get ("/report/1", "Accept-Language: fr\r\n").find ("X-Call: 4\r\n"), std::string::npos);
+  ASSERT_EQ (cache->size(), 4);
+
+  // expired
+  std::this_thread::sleep_for (std::chrono::milliseconds (250));
+  ASSERT_NE (get ("/report/1").find ("X-Call: 5\r\n"), std::string::npos);
+
+  // not cacheable
+  get ("/private");
+  get ("/private");
+  ASSERT_EQ (privateCalls, 2);
+
+  // concurrent misses call the handler once
+  std::vector<std::string> responses (8);
+  std::vector<std::thread> clients;
+
+  for (auto &r: responses)
+    clients.emplace_back ([ &r, &get ] { r = get ("/slow"); });
+
+  for (auto &client: clients)
+    client.join();
+
+  ASSERT_EQ (slowCalls, 1);
+
+  for (const auto &r: responses) {
+    ASSERT_TRUE (r.starts_with ("HTTP/1.1 200"));
+    ASSERT_TRUE (r.ends_with ("\r\n\r\nslow"));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// test_compression
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_compression) {
+  const auto root { std::filesystem::temp_directory_path() / "lightning_test_compression" };
+  std::filesystem::create_directories (root);
+
+  std::ofstream { root / "app.js" } << "plain";
+  std::ofstream { root / "app.js.gz", std::ios::binary } << "compressed";
+
+  std::string css;
+  for (int i { 0 }; i < 100; ++i)
+    css += ".c" + std::to_string (i) + " { color: red; }\n";
+
+  std::ofstream { root / "site.css" } << css;
+
+  lightning::HttpConfig config;
+  config.compression = true;
+  config.compressionMinSize = 100;
+
+  lightning::HttpServer server { 8080, 1, getLogLevel(), config };
+  server.addStaticRoute ("/static", root);
+
+  std::string json { "[" };
+  for (int i { 0 }; i < 100; ++i)
+    json += "{\"id\":" + std::to_string (i) + "},";
+  json.back() = ']';
+
+  server.addRoute (lightning::HttpMethod::kGet, "/json", [ & ] (const auto &, auto &response) {
+    response.headers().set (lightning::HttpHeaderName::kContentType, "application/json");
+    response.headers().set (lightning::HttpHeaderName::kETag, "\"v1\"");
+    response.status (200).send (json);
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/small", [] (const auto &, auto &response) {
+    response.status (200).send ("small");
+  });
+
+  // a file sent without a place for its compressed forms is not compressed for every request
+  server.addRoute (lightning::HttpMethod::kGet, "/file", [ & ] (const auto &, auto &response) {
+    response.status (200).send (lightning::StaticFile::open (root / "site.css", 64 * 1024));
+  });
+
+  server.addCachedRoute (lightning::HttpMethod::kGet, "/cached", [ & ] (const auto &, auto &response) {
+    response.headers().set (lightning::HttpHeaderName::kContentType, "application/json");
+    response.status (200).send (json);
+  });
+
+  const auto get = [] (const std::string &target, const std::string &headers = "") {
+    return sendRaw ({ "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n" });
+  };
+
+  auto response { get ("/json", "Accept-Encoding: gzip, deflate\r\n") };
+  ASSERT_NE (response.find ("content-encoding: gzip\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("vary: Accept-Encoding\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("etag: W/\"v1\"\r\n"), std::string::npos);
+
+  const auto body { response.substr (response.find ("\r\n\r\n") + 4) };
+  ASSERT_LT (body.size(), json.size());
+  ASSERT_EQ (test::inflate (body, 31), json);
+
+  // the weak validator still matches
+  response = get ("/json", "Accept-Encoding: gzip\r\nIf-None-Match: W/\"v1\"\r\n");
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 304"));
+
+  response = get ("/json", "Accept-Encoding: deflate\r\n");
+  ASSERT_NE (response.find ("content-encoding: deflate\r\n"), std::string::npos);
+  ASSERT_EQ (test::inflate (response.substr (response.find ("\r\n\r\n") + 4), 15), json);
+
+  response = get ("/json");
+  ASSERT_EQ (response.find ("content-encoding"), std::string::npos);
+  ASSERT_NE (response.find ("vary: Accept-Encoding\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with (json));
+
+  response = get ("/small", "Accept-Encoding: gzip\r\n");
+  ASSERT_EQ (response.find ("content-encoding"), std::string::npos);
+
+  // precompressed sibling
+  response = get ("/static/app.js", "Accept-Encoding: gzip\r\n");
+  ASSERT_NE (response.find ("content-encoding: gzip\r\n"), std::string::npos);
+  ASSERT_NE (response.find ("content-type: text/javascript; charset=utf-8\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\ncompressed"));
+
+  response = get ("/static/app.js");
+  ASSERT_NE (response.find ("vary: Accept-Encoding\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nplain"));
+
+  // compressed once, kept with the cached file or response, and sent again from there
+  for (const std::string target: { "/static/site.css", "/static/site.css", "/cached", "/cached" }) {
+    response = get (target, "Accept-Encoding: gzip\r\n");
+    ASSERT_NE (response.find ("content-encoding: gzip\r\n"), std::string::npos) << target;
+    ASSERT_EQ (test::inflate (response.substr (response.find ("\r\n\r\n") + 4), 31), target.starts_with ("/static") ? css : json);
+  }
+
+  response = get ("/file", "Accept-Encoding: gzip\r\n");
+  ASSERT_EQ (response.find ("content-encoding"), std::string::npos);
+  ASSERT_TRUE (response.ends_with (css));
+
+  response = get ("/cached", "Accept-Encoding: deflate\r\n");
+  ASSERT_NE (response.find ("content-encoding: deflate\r\n"), std::string::npos);
+  ASSERT_EQ (test::inflate (response.substr (response.find ("\r\n\r\n") + 4), 15), json);
+
+  response = get ("/cached");
+  ASSERT_EQ (response.find ("content-encoding"), std::string::npos);
+  ASSERT_TRUE (response.ends_with (json));
+
+  std::filesystem::remove_all (root);
+}
+
+// ----------------------------------------------------------------------------
+// test_streaming_response
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_streaming_response) {
+  lightning::HttpServer server { 8080, getLogLevel() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/async", [] (const auto &, auto &response) -> asio::awaitable<void> {
+    response.status (200);
+    response.headers().set (lightning::HttpHeaderName::kContentType, "text/plain");
+
+    auto stream { response.stream() };
+
+    for (const auto *chunk: { "a", "bb", "ccc" })
+      co_await stream.write (chunk, asio::use_awaitable);
+
+    stream.end();
+  });
+
+  const auto sync = [] (const lightning::HttpRequest &, lightning::HttpResponse &response) {
+    response.status (200);
+
+    auto stream { response.stream() };
+    stream.write ("hello ", asio::detached);
+    stream.write ("world", asio::detached);
+    stream.end();
+  };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/sync", sync);
+  server.addRoute (lightning::HttpMethod::kHead, "/sync", sync);
+
+  server.addRoute (lightning::HttpMethod::kGet, "/plain", [] (const auto &, auto &response) {
+    response.status (200).send ("plain");
+  });
+
+  auto response { sendRaw ({ "GET /async HTTP/1.1\r\nHost: localhost\r\n\r\n" }) };
+  ASSERT_NE (response.find ("transfer-encoding: chunked\r\n"), std::string::npos);
+  ASSERT_EQ (response.find ("content-length"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n1\r\na\r\n2\r\nbb\r\n3\r\nccc\r\n0\r\n\r\n"));
+
+  // the connection goes on with the next request once the stream has ended
+  response = sendRaw ({ "GET /sync HTTP/1.1\r\nHost: localhost\r\n\r\nGET /plain HTTP/1.1\r\nHost: localhost\r\n\r\n" });
+  ASSERT_NE (response.find ("\r\n\r\n6\r\nhello \r\n5\r\nworld\r\n0\r\n\r\nHTTP/1.1 200"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\nplain"));
+
+  response = sendRaw ({ "HEAD /sync HTTP/1.1\r\nHost: localhost\r\n\r\n" });
+  ASSERT_NE (response.find ("transfer-encoding: chunked\r\n"), std::string::npos);
+  ASSERT_TRUE (response.ends_with ("\r\n\r\n"));
+
+  // HTTP/1.0 has no chunks: the body ends with the connection
+  const auto [ raw, closed ] { exchange ("GET /sync HTTP/1.0\r\nConnection: keep-alive\r\n\r\n") };
+  ASSERT_TRUE (closed);
+  ASSERT_EQ (raw.find ("transfer-encoding"), std::string::npos);
+  ASSERT_TRUE (raw.ends_with ("\r\n\r\nhello world"));
+}
+
+// ----------------------------------------------------------------------------
+// test_streaming_backpressure
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_streaming_backpressure) {
+  constexpr size_t kChunks { 64 };
+  constexpr size_t kChunkSize { 256 * 1024 };
+
+  lightning::HttpConfig config;
+  config.streamHighWaterMark = 64 * 1024;
+
+  lightning::HttpServer server { 8080, 1, getLogLevel(), config };
+
+  std::atomic<size_t> completed { 0 };
+  std::atomic<bool> failed { false };
+  std::mutex mutex;
+  std::vector<std::thread> producers;
+
+  // the producer waits for every write before the next one, from its own thread
+  server.addRoute (lightning::HttpMethod::kGet, "/big", [ & ] (const auto &, auto &response) {
+    std::lock_guard lock { mutex };
+
+    producers.emplace_back ([ &, stream = response.status (200).stream() ] () mutable {
+      for (size_t i { 0 }; i < kChunks; ++i) {
+        std::promise<std::error_code> written;
+        stream.write (std::string (kChunkSize, static_cast<char> ('a' + (i % 26))), [ &written ] (std::error_code ec) {
+          written.set_value (ec);
+        });
+
+        if (written.get_future().get()) {
+          failed = true;
+          break;
+        }
+
+        ++completed;
+      }
+
+      stream.end();
+    });
+  });
+
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), 8080 });
+  asio::write (socket, asio::buffer (std::string { "GET /big HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n" }));
+
+  // while the client does not read, the producer is held back by the socket buffers
+  std::this_thread::sleep_for (std::chrono::milliseconds (300));
+  ASSERT_LT (completed.load(), kChunks);
+
+  std::string response;
+  asio::error_code ec;
+  asio::read (socket, asio::dynamic_buffer (response), ec);
+
+  ASSERT_EQ (completed.load(), kChunks);
+  ASSERT_FALSE (failed.load());
+
+  // decode the chunks
+  size_t pos { response.find ("\r\n\r\n") + 4 };
+  std::string body;
+
+  for (;;) {
+    const auto lineEnd { response.find ("\r\n", pos) };
+    const auto size { std::stoul (response.substr (pos, lineEnd - pos), nullptr, 16) };
+
+    if (size == 0)
+      break;
+
+    body.append (response, lineEnd + 2, size);
+    pos = lineEnd + 2 + size + 2;
+  }
+
+  ASSERT_EQ (body.size(), kChunks * kChunkSize);
+  ASSERT_EQ (body[kChunkSize], 'b');
+
+  // the writes of a stream whose client is gone fail
+  completed = 0;
+
+  {
+    asio::ip::tcp::socket gone { io };
+    gone.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), 8080 });
+    asio::write (gone, asio::buffer (std::string { "GET /big HTTP/1.1\r\nHost: localhost\r\n\r\n" }));
+    std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  }
+
+  for (int i { 0 }; (i < 100) && !failed; ++i)
+    std::this_thread::sleep_for (std::chrono::milliseconds (10));
+
+  ASSERT_TRUE (failed.load());
+
+  std::lock_guard lock { mutex };
+  for (auto &producer: producers)
+    producer.join();
+}
+
+// ----------------------------------------------------------------------------
+// test_event_stream
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_event_stream) {
+  lightning::HttpServer server { 8080, 2, getLogLevel() };
+
+  lightning::HttpEventChannel channel { { .retry = std::chrono::milliseconds (500) } };
+  lightning::HttpEventChannel slow { { .maxQueuedBytes = 64 * 1024, .overflow = lightning::HttpEventChannelConfig::Overflow::kDrop } };
+  lightning::HttpEventChannel strict { { .maxQueuedBytes = 64 * 1024, .overflow = lightning::HttpEventChannelConfig::Overflow::kDisconnect } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/events", [ & ] (const auto &, auto &response) { channel.subscribe (response); });
+  server.addRoute (lightning::HttpMethod::kGet, "/slow", [ & ] (const auto &, auto &response) { slow.subscribe (response); });
+  server.addRoute (lightning::HttpMethod::kGet, "/strict", [ & ] (const auto &, auto &response) { strict.subscribe (response); });
+
+  const auto waitFor = [] (const auto &condition) {
+    for (int i { 0 }; (i < 200) && !condition(); ++i)
+      std::this_thread::sleep_for (std::chrono::milliseconds (5));
+
+    return condition();
+  };
+
+  const auto subscribe = [] (asio::ip::tcp::socket &socket, const std::string &target) {
+    socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), 8080 });
+    asio::write (socket, asio::buffer ("GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+  };
+
+  // every subscriber gets the same events
+  asio::io_context io;
+  std::vector<asio::ip::tcp::socket> clients;
+
+  for (int i { 0 }; i < 3; ++i)
+    subscribe (clients.emplace_back (io), "/events");
+
+  ASSERT_TRUE (waitFor ([ & ] { return channel.size() == 3; }));
+  ASSERT_EQ (channel.publish ("one"), 3u);
+  ASSERT_EQ (channel.publish ("two\nlines", "update", "2"), 3u);
+
+  const std::string expected { "data: one\n\nevent: update\nid: 2\ndata: two\ndata: lines\n\n" };
+
+  for (auto &client: clients) {
+    std::string received;
+
+    while (received.find ("data: lines") == std::string::npos) {
+      char data[1024];
+      received.append (data, client.read_some (asio::buffer (data)));
+    }
+
+    ASSERT_TRUE (received.starts_with ("HTTP/1.1 200"));
+    ASSERT_NE (received.find ("content-type: text/event-stream\r\n"), std::string::npos);
+    ASSERT_NE (received.find ("transfer-encoding: chunked\r\n"), std::string::npos);
+    ASSERT_NE (received.find ("retry: 500\n\n"), std::string::npos);
+
+    // strip the chunk framing
+    std::string events;
+    for (size_t pos { received.find ("\r\n\r\n") + 4 }; pos < received.size();) {
+      const auto lineEnd { received.find ("\r\n", pos) };
+      const auto size { std::stoul (received.substr (pos, lineEnd - pos), nullptr, 16) };
+
+      events.append (received, lineEnd + 2, size);
+      pos = lineEnd + 2 + size + 2;
+    }
+
+    ASSERT_TRUE (events.ends_with (expected));
+  }
+
+  // the subscribers that are gone are removed by the next event
+  clients.pop_back();
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  channel.publish ("three");
+  ASSERT_TRUE (waitFor ([ & ] { channel.ping(); return channel.size() == 2; }));
+
+  channel.close();
+  ASSERT_EQ (channel.size(), 0u);
+
+  // subscribers that do not read: the events are dropped or they are disconnected
+  const auto big { std::string (256 * 1024, 'x') };
+
+  asio::ip::tcp::socket dropped { io };
+  subscribe (dropped, "/slow");
+  asio::ip::tcp::socket disconnected { io };
+  subscribe (disconnected, "/strict");
+
+  ASSERT_TRUE (waitFor ([ & ] { return (slow.size() == 1) && (strict.size() == 1); }));
+
+  for (int i { 0 }; i < 128; ++i) {
+    slow.publish (big);
+    strict.publish (big);
+  }
+
+  ASSERT_GT (slow.dropped(), 0u);
+  ASSERT_EQ (slow.size(), 1u);
+  ASSERT_EQ (strict.size(), 0u);
+
+  // the server closes the connection, once the bytes that made it to the socket have been read
+  std::string rest;
+  asio::error_code ec;
+  asio::read (disconnected, asio::dynamic_buffer (rest), ec);
+  ASSERT_TRUE (ec); // end of file or reset
+}
+
+// ----------------------------------------------------------------------------
+// test_websocket
+// ----------------------------------------------------------------------------
+TEST (HttpServer, test_websocket) {
+  // outlive the server, whose connections call onClose until it stops
+  std::mutex mutex;
+  std::vector<lightning::WebSocket> sockets;
+  std::multiset<uint16_t> closeCodes;
+
+  lightning::HttpServer server { 8080, 2, getLogLevel() };
+
+  server.addWebSocketRoute ("/ws/:room", {
+    .onOpen = [ & ] (const auto &request, auto &ws) {
+      ASSERT_EQ (request.protocol, lightning::ProtocolType::kWs);
+      ws.send ("welcome to " + std::string { *request.params.get ("room") });
+
+      std::lock_guard lock { mutex };
+      sockets.push_back (ws);
+    },
+    .onMessage = [] (auto &ws, std::string_view message, bool binary) {
+      if (message == "bye")
+        ws.close (4000, "done");
+      else
+        ws.send (message, binary); // echo
+    },
+    .onClose = [ & ] (auto &, uint16_t code) {
+      std::lock_guard lock { mutex };
+      closeCodes.insert (code);
+    }
+  });
+
+  // masked client frames
+  const auto frame = [] (std::string_view payload, uint8_t opcode, bool fin = true) {
+    std::string out;
+    out.push_back (static_cast<char> ((fin ? 0x80 : 0) | opcode));
+
+    if (payload.size() < 126) {
+      out.push_back (static_cast<char> (0x80 | payload.size()));
+    }
+    else {
+      out.push_back (static_cast<char> (0x80 | 126));
+      out.push_back (static_cast<char> (payload.size() >> 8));
+      out.push_back (static_cast<char> (payload.size() & 0xff));
+    }
+
+    const std::array<uint8_t, 4> key { 0x12, 0x34, 0x56, 0x78 };
+    out.append (reinterpret_cast<const char *> (key.data()), key.size());
+
+    for (size_t i { 0 }; i < payload.size(); ++i)
+      out.push_back (static_cast<char> (payload[i] ^ key[i % 4]));
+
+    return out;
+  };
+
+  asio::io_context io;
+
+  const auto connect = [ & ] (asio::ip::tcp::socket &socket, std::string &received) {
+    socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), 8080 });
+    asio::write (socket, asio::buffer (std::string {
+      "GET /ws/lobby HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: keep-alive, Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+    }));
+
+    asio::read_until (socket, asio::dynamic_buffer (received), "\r\n\r\n");
+  };
+
+  // reads server frames (unmasked) until there are `count` of them
+  const auto readFrames = [] (asio::ip::tcp::socket &socket, std::string &received, size_t count) {
+    std::vector<std::pair<uint8_t, std::string>> frames;
+
+    while (frames.size() < count) {
+      lightning::WebSocketFrameHeader header;
+
+      if (lightning::WebSocketFrameHeader::parse (received, header) && (received.size() >= header.headerLength + header.payloadLength)) {
+        frames.emplace_back (static_cast<uint8_t> (header.opcode), received.substr (header.headerLength, header.payloadLength));
+        received.erase (0, header.headerLength + header.payloadLength);
+        continue;
+      }
+
+      char data[4096];
+      received.append (data, socket.read_some (asio::buffer (data)));
+    }
+
+    return frames;
+  };
+
+  asio::ip::tcp::socket client { io };
+  std::string received;
+  connect (client, received);
+
+  ASSERT_TRUE (received.starts_with ("HTTP/1.1 101"));
+  ASSERT_NE (received.find ("sec-websocket-accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"), std::string::npos);
+  ASSERT_NE (received.find ("upgrade: websocket\r\n"), std::string::npos);
+  received.erase (0, received.find ("\r\n\r\n") + 4);
+
+  // echo of a small, a 16-bit length and a fragmented message, and a ping, all in one write
+  const std::string big (1000, 'b');
+  asio::write (client, asio::buffer (
+    frame ("hello", 0x1) + frame (big, 0x2) + frame ("frag", 0x1, false) + frame ("ping", 0x9) + frame ("mented", 0x0)
+  ));
+
+  auto frames { readFrames (client, received, 5) };
+  ASSERT_EQ (frames[0], std::make_pair (uint8_t { 0x1 }, std::string { "welcome to lobby" }));
+  ASSERT_EQ (frames[1], std::make_pair (uint8_t { 0x1 }, std::string { "hello" }));
+  ASSERT_EQ (frames[2], std::make_pair (uint8_t { 0x2 }, big));
+  ASSERT_EQ (frames[3], std::make_pair (uint8_t { 0xa }, std::string { "ping" }));
+  ASSERT_EQ (frames[4], std::make_pair (uint8_t { 0x1 }, std::string { "fragmented" }));
+
+  // a broadcast frame, built once for every connection
+  asio::ip::tcp::socket other { io };
+  std::string otherReceived;
+  connect (other, otherReceived);
+  otherReceived.erase (0, otherReceived.find ("\r\n\r\n") + 4);
+
+  {
+    const auto news { lightning::WebSocket::frame ("news") };
+
+    std::lock_guard lock { mutex };
+    ASSERT_EQ (sockets.size(), 2u);
+
+    for (auto &ws: sockets)
+      ASSERT_TRUE (ws.send (news));
+  }
+
+  ASSERT_EQ (readFrames (client, received, 1)[0].second, "news");
+  ASSERT_EQ (readFrames (other, otherReceived, 2)[1].second, "news");
+
+  // closing handshake started by the server
+  asio::write (client, asio::buffer (frame ("bye", 0x1)));
+  frames = readFrames (client, received, 1);
+  ASSERT_EQ (frames[0].first, 0x8);
+  ASSERT_EQ (frames[0].second, std::string ("\x0f\xa0" "done", 6)); // 4000
+
+  asio::error_code ec;
+  asio::read (client, asio::dynamic_buffer (received), ec);
+  ASSERT_TRUE (ec); // closed
+
+  // closing handshake started by the client: the code is echoed
+  asio::write (other, asio::buffer (frame ("\x03\xe8", 0x8)));
+  frames = readFrames (other, otherReceived, 1);
+  ASSERT_EQ (frames[0], std::make_pair (uint8_t { 0x8 }, std::string { "\x03\xe8" }));
+
+  for (int i { 0 }; i < 100; ++i) {
+    std::this_thread::sleep_for (std::chrono::milliseconds (5));
+    std::lock_guard lock { mutex };
+    if (closeCodes.size() == 2)
+      break;
+  }
+
+  {
+    // the server closed the first one without a close frame from the client
+    std::lock_guard lock { mutex };
+    ASSERT_EQ (closeCodes, (std::multiset<uint16_t> { 1000, 1006 }));
+
+    for (auto &ws: sockets)
+      ASSERT_FALSE (ws.send ("too late"));
+
+    sockets.clear(); // the connections are released with their handles
+  }
+
+  // unmasked frames are a protocol error
+  asio::ip::tcp::socket rogue { io };
+  std::string rogueReceived;
+  connect (rogue, rogueReceived);
+  rogueReceived.erase (0, rogueReceived.find ("\r\n\r\n") + 4);
+
+  asio::write (rogue, asio::buffer (std::string { "\x81\x02hi" }));
+  frames = readFrames (rogue, rogueReceived, 2);
+  ASSERT_EQ (frames[1], std::make_pair (uint8_t { 0x8 }, std::string { "\x03\xea" })); // 1002
+
+  {
+    std::lock_guard lock { mutex };
+    sockets.clear();
+  }
+
+  // not a handshake
+  auto response { sendRaw ({ "GET /ws/lobby HTTP/1.1\r\nHost: localhost\r\n\r\n" }) };
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 426"));
+
+  response = sendRaw ({ "GET /ws/lobby HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 8\r\n\r\n" });
+  ASSERT_TRUE (response.starts_with ("HTTP/1.1 426"));
+  ASSERT_NE (response.find ("sec-websocket-version: 13\r\n"), std::string::npos);
+}
@@ -0,0 +1,120 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_static.h>
+
+
+// ----------------------------------------------------------------------------
+// makeRoot
+// ----------------------------------------------------------------------------
+static std::filesystem::path makeRoot() {
+  const std::string name { ::testing::UnitTest::GetInstance()->current_test_info()->name() };
+  const auto root { std::filesystem::temp_directory_path() / ("lightning_" + name) };
+
+  std::filesystem::remove_all (root);
+  std::filesystem::create_directories (root);
+
+  return root;
+}
+
+// ----------------------------------------------------------------------------
+// test_decode_path
+// ----------------------------------------------------------------------------
+TEST (HttpStaticFiles, test_decode_path) {
+  using lightning::HttpStaticFiles;
+
+  ASSERT_EQ (HttpStaticFiles::decodePath ("css/site.css"), "css/site.css");
+  ASSERT_EQ (HttpStaticFiles::decodePath ("my%20file.txt"), "my file.txt");
+  ASSERT_EQ (HttpStaticFiles::decodePath ("//etc/passwd"), "etc/passwd");
+  ASSERT_EQ (HttpStaticFiles::decodePath ("a/..b/c"), "a/..b/c");
+  ASSERT_EQ (HttpStaticFiles::decodePath (""), "");
+
+  ASSERT_FALSE (HttpStaticFiles::decodePath (".."));
+  ASSERT_FALSE (HttpStaticFiles::decodePath ("a/../../b"));
+  ASSERT_FALSE (HttpStaticFiles::decodePath ("%2e%2E/b"));
+  ASSERT_FALSE (HttpStaticFiles::decodePath ("a/%2"));
+  ASSERT_FALSE (HttpStaticFiles::decodePath ("a/%zz"));
+  ASSERT_FALSE (HttpStaticFiles::decodePath ("a%00.txt"));
+}
+
+// ----------------------------------------------------------------------------
+// test_open
+// ----------------------------------------------------------------------------
+TEST (HttpStaticFiles, test_open) {
+  const auto root { makeRoot() };
+
+  std::ofstream { root / "small.js" } << "let a;";
+  std::ofstream { root / "big.png" } << std::string (1000, 'x');
+  std::ofstream { root / "empty.txt" };
+
+  const auto small { lightning::StaticFile::open (root / "small.js", 100) };
+  ASSERT_TRUE (small);
+  ASSERT_EQ (small->mapped(), "let a;");
+  ASSERT_EQ (small->fd(), -1);
+  ASSERT_EQ (small->contentType(), "text/javascript; charset=utf-8");
+  ASSERT_TRUE (small->lastModified().ends_with (" GMT"));
+
+  const auto big { lightning::StaticFile::open (root / "big.png", 100) };
+  ASSERT_TRUE (big);
+  ASSERT_EQ (big->size(), 1000);
+  ASSERT_EQ (big->contentType(), "image/png");
+#ifdef __linux__
+  ASSERT_GE (big->fd(), 0);
+  ASSERT_TRUE (big->mapped().empty());
+#endif
+
+  const auto empty { lightning::StaticFile::open (root / "empty.txt", 100) };
+  ASSERT_TRUE (empty);
+  ASSERT_EQ (empty->size(), 0);
+
+  ASSERT_FALSE (lightning::StaticFile::open (root / "missing", 100));
+  ASSERT_FALSE (lightning::StaticFile::open (root, 100)); // not a regular file
+
+  ASSERT_EQ (lightning::StaticFile::contentType ("INDEX.HTML"), "text/html; charset=utf-8");
+  ASSERT_EQ (lightning::StaticFile::contentType ("README"), "application/octet-stream");
+
+  std::filesystem::remove_all (root);
+}
+
+// ----------------------------------------------------------------------------
+// test_cache
+// ----------------------------------------------------------------------------
+TEST (HttpStaticFiles, test_cache) {
+  const auto root { makeRoot() };
+
+  std::ofstream { root / "a.txt" } << "a";
+  std::ofstream { root / "b.txt" } << "b";
+  std::ofstream { root / "c.txt" } << "c";
+
+  lightning::HttpStaticFiles files { root, { .maxOpenFiles = 2, .revalidateAfter = std::chrono::milliseconds (0) } };
+
+  const auto a { files.find ("a.txt") };
+  ASSERT_TRUE (a);
+  ASSERT_EQ (files.find ("a.txt"), a); // not modified
+
+  // a modified file is opened again
+  std::ofstream { root / "a.txt" } << "a2";
+  const auto a2 { files.find ("a.txt") };
+  ASSERT_NE (a2, a);
+  ASSERT_EQ (a2->mapped(), "a2");
+
+  // the least recently used file is closed
+  ASSERT_TRUE (files.find ("b.txt"));
+  ASSERT_TRUE (files.find ("c.txt"));
+  ASSERT_EQ (files.size(), 2);
+
+  // a deleted file is forgotten
+  std::filesystem::remove (root / "c.txt");
+  ASSERT_FALSE (files.find ("c.txt"));
+  ASSERT_EQ (files.size(), 1);
+
+  std::filesystem::remove_all (root);
+}
@@ -0,0 +1,113 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_url_encoded.h>
+
+
+// ----------------------------------------------------------------------------
+// test_get
+// ----------------------------------------------------------------------------
+TEST (HttpUrlEncoded, test_get) {
+  lightning::HttpUrlEncoded params;
+  ASSERT_TRUE (params.empty());
+
+  params.assign ("limit=10&&sort=name&flag&empty=&sort=other&q%20x=a+b");
+
+  ASSERT_EQ (params.size(), 6u);
+  ASSERT_EQ (params.get ("limit"), "10");
+  ASSERT_EQ (params.get ("sort"), "name"); // the first one
+  ASSERT_EQ (params.get ("flag"), "");
+  ASSERT_EQ (params.get ("empty"), "");
+  ASSERT_FALSE (params.get ("missing").has_value());
+  ASSERT_TRUE (params.contains ("flag"));
+  ASSERT_FALSE (params.contains ("fla"));
+
+  // names are compared decoded, values are returned as they are
+  ASSERT_EQ (params.get ("q x"), "a+b");
+  ASSERT_FALSE (params.get ("q%20x").has_value());
+
+  std::vector<std::string> names;
+  for (const auto &[ name, value ]: params)
+    names.emplace_back (name);
+
+  ASSERT_EQ (names, (std::vector<std::string> { "limit", "sort", "flag", "empty", "sort", "q%20x" }));
+
+  params.reset();
+  ASSERT_TRUE (params.empty());
+}
+
+// ----------------------------------------------------------------------------
+// test_get_number
+// ----------------------------------------------------------------------------
+TEST (HttpUrlEncoded, test_get_number) {
+  lightning::HttpUrlEncoded params;
+  params.assign ("limit=25&offset=-3&ratio=0.5&big=99999999999&bad=12x&empty=&escaped=%31%32");
+
+  ASSERT_EQ (params.get<int> ("limit"), 25);
+  ASSERT_EQ (params.get<int> ("offset"), -3);
+  ASSERT_EQ (params.get<double> ("ratio"), 0.5);
+  ASSERT_EQ (params.get<int64_t> ("big"), 99999999999);
+  ASSERT_EQ (params.get<int> ("escaped"), 12);
+
+  ASSERT_FALSE (params.get<int> ("big").has_value()); // out of range
+  ASSERT_FALSE (params.get<unsigned> ("offset").has_value());
+  ASSERT_FALSE (params.get<int> ("bad").has_value());
+  ASSERT_FALSE (params.get<int> ("empty").has_value());
+  ASSERT_FALSE (params.get<int> ("missing").has_value());
+}
+
+// ----------------------------------------------------------------------------
+// test_decode
+// ----------------------------------------------------------------------------
+TEST (HttpUrlEncoded, test_decode) {
+  char buffer[32];
+
+  // without escapes, the text itself
+  constexpr std::string_view plain { "plain" };
+  ASSERT_EQ (lightning::HttpUrlEncoded::decode (plain, buffer)->data(), plain.data());
+
+  ASSERT_EQ (lightning::HttpUrlEncoded::decode ("a+b%2Fc%2fd", buffer), "a b/c/d");
+  ASSERT_EQ (lightning::HttpUrlEncoded::decode ("%E2%82%AC", buffer), "\xE2\x82\xAC");
+
+  // invalid escapes are kept
+  ASSERT_EQ (lightning::HttpUrlEncoded::decode ("100%", buffer), "100%");
+  ASSERT_EQ (lightning::HttpUrlEncoded::decode ("%zz%4", buffer), "%zz%4");
+
+  // the buffer is too small
+  ASSERT_FALSE (lightning::HttpUrlEncoded::decode ("a+b+c", std::span<char> { buffer, 4 }).has_value());
+  ASSERT_EQ (lightning::HttpUrlEncoded::decode ("a%20b", std::span<char> { buffer, 3 }), "a b");
+}
+
+// ----------------------------------------------------------------------------
+// test_decoded
+// ----------------------------------------------------------------------------
+TEST (HttpUrlEncoded, test_decoded) {
+  std::byte arena[256];
+  std::pmr::monotonic_buffer_resource resource { arena, sizeof (arena), std::pmr::null_memory_resource() };
+
+  lightning::HttpUrlEncoded params { &resource };
+
+  const std::string source { "name=John+Smith&city=M%C3%A1laga&plain=value" };
+  params.assign (source);
+
+  // only escaped values are copied, to the arena
+  const auto name { params.decoded ("name") };
+  ASSERT_EQ (name, "John Smith");
+  ASSERT_TRUE ((name->data() >= reinterpret_cast<char *> (arena)) && (name->data() < reinterpret_cast<char *> (arena + sizeof (arena))));
+
+  ASSERT_EQ (params.decoded ("city"), "M\xC3\xA1laga");
+
+  const auto plain { params.decoded ("plain") };
+  ASSERT_EQ (plain, "value");
+  ASSERT_EQ (plain->data(), source.data() + source.find ("value"));
+
+  ASSERT_FALSE (params.decoded ("missing").has_value());
+}
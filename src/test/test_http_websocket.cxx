@@ -0,0 +1,79 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_websocket.h>
+
+
+// ----------------------------------------------------------------------------
+// test_accept_key
+// ----------------------------------------------------------------------------
+TEST (WebSocket, test_accept_key) {
+  // example of RFC 6455, section 1.3
+  ASSERT_EQ (lightning::WebSocket::acceptKey ("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+// ----------------------------------------------------------------------------
+// test_unmask
+// ----------------------------------------------------------------------------
+TEST (WebSocket, test_unmask) {
+  const std::array<uint8_t, 4> key { 0x37, 0xfa, 0x21, 0x3d };
+
+  // every size around the vector widths, from every position of the key, at an unaligned address
+  for (size_t size { 0 }; size < 200; ++size) {
+    for (size_t offset { 0 }; offset < 4; ++offset) {
+      std::string data (size + 1, '\0');
+      for (size_t i { 0 }; i < data.size(); ++i)
+        data[i] = static_cast<char> (i * 7);
+
+      auto expected { data };
+      for (size_t i { 0 }; i < size; ++i)
+        expected[i + 1] = static_cast<char> (expected[i + 1] ^ key[(offset + i) % 4]);
+
+      lightning::WebSocket::unmask (data.data() + 1, size, key, offset);
+      ASSERT_EQ (data, expected) << "size=" << size << " offset=" << offset;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// test_frames
+// ----------------------------------------------------------------------------
+TEST (WebSocket, test_frames) {
+  using lightning::WebSocket;
+  using lightning::WebSocketFrameHeader;
+  using lightning::WebSocketOpcode;
+
+  for (const size_t size: { 0, 125, 126, 65535, 65536, 100000 }) {
+    const auto frame { WebSocket::frame (std::string (size, 'a'), WebSocketOpcode::kBinary) };
+
+    WebSocketFrameHeader header;
+    ASSERT_TRUE (WebSocketFrameHeader::parse (*frame, header));
+    ASSERT_TRUE (header.fin);
+    ASSERT_FALSE (header.masked);
+    ASSERT_EQ (header.opcode, WebSocketOpcode::kBinary);
+    ASSERT_EQ (header.payloadLength, size);
+    ASSERT_EQ (header.headerLength + size, frame->size());
+
+    // incomplete headers
+    ASSERT_FALSE (WebSocketFrameHeader::parse (std::string_view { *frame }.substr (0, header.headerLength - 1), header));
+  }
+
+  // a masked frame from a client (RFC 6455, section 5.7)
+  const std::string masked { "\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58", 11 };
+
+  WebSocketFrameHeader header;
+  ASSERT_TRUE (WebSocketFrameHeader::parse (masked, header));
+  ASSERT_TRUE (header.masked);
+  ASSERT_EQ (header.headerLength, 6u);
+  ASSERT_EQ (header.payloadLength, 5u);
+
+  std::string payload { masked.substr (6) };
+  WebSocket::unmask (payload.data(), payload.size(), header.key);
+  ASSERT_EQ (payload, "Hello");
+}
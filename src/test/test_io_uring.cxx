@@ -0,0 +1,310 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lightning/http_server.h>
+#include <lightning/io_uring.h>
+
+
+static constexpr uint16_t kPort { 8082 };
+
+// ----------------------------------------------------------------------------
+// connect
+// ----------------------------------------------------------------------------
+static void connect (asio::ip::tcp::socket &socket) {
+  socket.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+}
+
+// ----------------------------------------------------------------------------
+// get
+// ----------------------------------------------------------------------------
+// Sends a request and reads its response (which must have a Content-Length)
+static std::string get (asio::ip::tcp::socket &socket, std::string_view path) {
+  asio::write (socket, asio::buffer ("GET " + std::string { path } + " HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+
+  std::string response;
+  const size_t headers { asio::read_until (socket, asio::dynamic_buffer (response), "\r\n\r\n") };
+
+  constexpr std::string_view kLength { "content-length: " };
+  const auto start { response.find (kLength) + kLength.size() };
+
+  size_t length { 0 };
+  std::from_chars (response.data() + start, response.data() + response.size(), length);
+
+  if (response.size() < headers + length)
+    asio::read (socket, asio::dynamic_buffer (response), asio::transfer_exactly (headers + length - response.size()));
+
+  return response;
+}
+
+// ----------------------------------------------------------------------------
+// test_requests
+// ----------------------------------------------------------------------------
+TEST (IoUring, test_requests) {
+  const auto file { std::filesystem::temp_directory_path() / "lightning_io_uring" / "big.bin" };
+  std::filesystem::create_directories (file.parent_path());
+
+  const std::string content (300 * 1024 + 17, 'f');
+  std::ofstream { file, std::ios::binary } << content;
+
+  // the server works the same whether the kernel lets it use io_uring or not
+  lightning::HttpServer server { kPort, 2, lightning::LogLevel::kWarn, { .ioUring = true } };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/hello", [] (const auto &, auto &response) {
+    response.status (200).send ("hello");
+  });
+
+  // short sends: the rest is sent again
+  server.addRoute (lightning::HttpMethod::kGet, "/big", [] (const auto &, auto &response) {
+    response.status (200).send (std::string (4 * 1024 * 1024, 'b'));
+  });
+
+  server.addRoute (lightning::HttpMethod::kPost, "/echo", [] (const auto &request, auto &response) {
+    response.status (200).send (std::string { request.body });
+  });
+
+  server.addStaticRoute ("/files", file.parent_path());
+
+  server.addWebSocketRoute ("/ws", {
+    .onMessage = [] (auto &ws, std::string_view message, bool binary) { ws.send (message, binary); }
+  });
+
+  asio::io_context io;
+  asio::ip::tcp::socket socket { io };
+  connect (socket);
+
+  // every request after the first one finds the connection idle
+  for (int i { 0 }; i < 3; ++i)
+    ASSERT_TRUE (get (socket, "/hello").ends_with ("\r\n\r\nhello"));
+
+  const auto big { get (socket, "/big") };
+  ASSERT_TRUE (big.starts_with ("HTTP/1.1 200"));
+  ASSERT_EQ (big.substr (big.find ("\r\n\r\n") + 4), std::string (4 * 1024 * 1024, 'b'));
+
+  const auto served { get (socket, "/files/big.bin") };
+  ASSERT_TRUE (served.starts_with ("HTTP/1.1 200"));
+  ASSERT_TRUE (served.substr (served.find ("\r\n\r\n") + 4) == content);
+
+  // a body bigger than the input buffer (and the provided ones)
+  const std::string body (200 * 1024, 'p');
+  asio::write (socket, asio::buffer ("POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + std::to_string (body.size()) + "\r\n\r\n" + body));
+
+  std::string echoed;
+  const size_t headers { asio::read_until (socket, asio::dynamic_buffer (echoed), "\r\n\r\n") };
+  asio::read (socket, asio::dynamic_buffer (echoed), asio::transfer_exactly (headers + body.size() - echoed.size()));
+  ASSERT_EQ (echoed.substr (headers), body);
+
+  // pipelined requests, the last one closing the connection
+  asio::write (socket, asio::buffer (std::string { "GET /hello HTTP/1.1\r\nHost: a\r\n\r\nGET /hello HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n" }));
+
+  std::string responses;
+  asio::error_code ec;
+  asio::read (socket, asio::dynamic_buffer (responses), ec);
+
+  size_t count { 0 };
+  for (auto pos { responses.find ("\r\n\r\nhello") }; pos != std::string::npos; pos = responses.find ("\r\n\r\nhello", pos + 1))
+    ++count;
+
+  ASSERT_EQ (count, 2u);
+  ASSERT_EQ (ec, asio::error_code { asio::error::eof });
+
+  // WebSocket messages, read on the strand of the connection
+  asio::ip::tcp::socket ws { io };
+  connect (ws);
+
+  asio::write (ws, asio::buffer (std::string {
+    "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+  }));
+
+  std::string upgraded;
+  const size_t upgradeHeaders { asio::read_until (ws, asio::dynamic_buffer (upgraded), "\r\n\r\n") };
+  ASSERT_TRUE (upgraded.starts_with ("HTTP/1.1 101"));
+  upgraded.erase (0, upgradeHeaders);
+
+  // masked with a zero key, so the payload is sent as is
+  asio::write (ws, asio::buffer (std::string { "\x81\x82\0\0\0\0hi\x81\x82\0\0\0\0yo", 16 }));
+  asio::read (ws, asio::dynamic_buffer (upgraded), asio::transfer_exactly (8 - upgraded.size()));
+  ASSERT_EQ (upgraded, std::string ("\x81\x02hi\x81\x02yo"));
+
+  std::filesystem::remove_all (file.parent_path());
+}
+
+// ----------------------------------------------------------------------------
+// test_idle_connections
+// ----------------------------------------------------------------------------
+TEST (IoUring, test_idle_connections) {
+  using namespace std::chrono_literals;
+
+  // fewer provided buffers than connections: buffers are given back as soon as the data is copied
+  for (const size_t buffers: { 256, 2 }) {
+    lightning::HttpServer server { kPort, 1, lightning::LogLevel::kWarn, { .keepAliveTimeout = 500ms, .ioUring = true, .ioUringBuffers = buffers } };
+
+    if (!server.ioUring())
+      GTEST_SKIP() << "io_uring not available";
+
+    server.addRoute (lightning::HttpMethod::kGet, "/m", [] (const auto &, auto &response) {
+      response.status (200).send ("m");
+    });
+
+    asio::io_context io;
+    std::vector<asio::ip::tcp::socket> sockets;
+
+    for (size_t i { 0 }; i < 4; ++i) {
+      auto &socket { sockets.emplace_back (io) };
+      connect (socket);
+
+      ASSERT_TRUE (get (socket, "/m").ends_with ("\r\n\r\nm"));
+    }
+
+    std::this_thread::sleep_for (50ms);
+
+    // the kernel takes a buffer of the ring only when a request arrives
+    const auto usage { server.memoryUsage() };
+    ASSERT_EQ (usage.connections, 4);
+    ASSERT_EQ (usage.inputBufferBytes, 0);
+
+    // requests sent together, to the connections waiting for a provided buffer and the others
+    for (auto &socket: sockets)
+      asio::write (socket, asio::buffer (std::string_view { "GET /m HTTP/1.1\r\nHost: localhost\r\n\r\n" }));
+
+    for (auto &socket: sockets) {
+      std::string response;
+      asio::read_until (socket, asio::dynamic_buffer (response), "\r\n\r\nm");
+      ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+    }
+
+    // the keep-alive timeout ends the pending receives
+    std::this_thread::sleep_for (1s);
+
+    for (auto &socket: sockets) {
+      char c;
+      asio::error_code ec;
+      socket.read_some (asio::buffer (&c, 1), ec);
+      ASSERT_EQ (ec, asio::error_code { asio::error::eof });
+    }
+
+    ASSERT_EQ (server.memoryUsage().connections, 0);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// test_accept
+// ----------------------------------------------------------------------------
+TEST (IoUring, test_accept) {
+  using namespace std::chrono_literals;
+
+  // with a limit, connections are accepted one at a time, each one taking a slot first
+  for (const size_t maxConnections: { 0, 2 }) {
+    lightning::HttpServer server { kPort, 2, lightning::LogLevel::kWarn, { .maxConnections = maxConnections, .ioUring = true } };
+
+    server.addRoute (lightning::HttpMethod::kGet, "/c", [] (const auto &, auto &response) {
+      response.status (200).send ("c");
+    });
+
+    // connections that arrive together
+    std::vector<std::thread> clients;
+    std::atomic<size_t> served { 0 };
+
+    for (size_t i { 0 }; i < 16; ++i) {
+      clients.emplace_back ([ &served ] {
+        asio::io_context io;
+        asio::ip::tcp::socket socket { io };
+        connect (socket);
+
+        for (int r { 0 }; r < 10; ++r) {
+          if (get (socket, "/c").ends_with ("\r\n\r\nc"))
+            ++served;
+        }
+      });
+    }
+
+    for (auto &c: clients)
+      c.join();
+
+    ASSERT_EQ (served, 160u);
+
+    if (maxConnections == 0)
+      continue;
+
+    asio::io_context io;
+    asio::ip::tcp::socket first { io };
+    connect (first);
+    asio::ip::tcp::socket second { io };
+    connect (second);
+
+    std::this_thread::sleep_for (50ms);
+
+    // the third connection waits in the backlog until one of the others is closed
+    asio::ip::tcp::socket third { io };
+    connect (third);
+    asio::write (third, asio::buffer (std::string_view { "GET /c HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n" }));
+
+    std::string response;
+    bool done { false };
+    asio::async_read (third, asio::dynamic_buffer (response), [ &done ] (std::error_code, size_t) { done = true; });
+
+    io.run_for (200ms);
+    ASSERT_FALSE (done);
+
+    first.close();
+
+    io.restart();
+    io.run_for (500ms);
+    ASSERT_TRUE (done);
+    ASSERT_TRUE (response.starts_with ("HTTP/1.1 200"));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// test_full_ring
+// ----------------------------------------------------------------------------
+TEST (IoUring, test_full_ring) {
+  using namespace std::chrono_literals;
+
+  asio::io_context io;
+
+  std::error_code ec;
+  const auto ring { lightning::IoUring::create (io, 2, 0, 0, ec) };
+
+  if (!ring)
+    GTEST_SKIP() << "io_uring not available: " << ec.message();
+
+  // more operations than entries, whose completions do not fit in the completion ring
+  // either: the queued ones are submitted to make room, and the others are flushed
+  constexpr size_t kSockets { 16 };
+
+  std::vector<asio::local::stream_protocol::socket> sockets;
+  std::vector<asio::local::stream_protocol::socket> peers;
+  std::vector<char> buffers (kSockets);
+  size_t received { 0 };
+
+  for (size_t i { 0 }; i < kSockets; ++i) {
+    sockets.emplace_back (io);
+    peers.emplace_back (io);
+    asio::local::connect_pair (sockets.back(), peers.back());
+
+    ring->receive (sockets.back().native_handle(), asio::buffer (&buffers[i], 1), [ &received ] (std::error_code ec, size_t length) {
+      if (!ec && (length == 1))
+        ++received;
+    });
+  }
+
+  for (auto &p: peers)
+    asio::write (p, asio::buffer (std::string_view { "x" }));
+
+  io.run_for (500ms);
+  ASSERT_EQ (received, kSockets);
+}
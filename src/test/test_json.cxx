@@ -0,0 +1,172 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lightning/json.h>
+
+
+// ----------------------------------------------------------------------------
+// test_parse
+// ----------------------------------------------------------------------------
+TEST (Json, test_parse) {
+  std::string text {
+    R"( { "id": 42, "price": -1.5e2, "name": "plain text", "tags": [ "a", "b", [] ], )"
+    R"("active": true, "deleted": false, "parent": null, "empty": {}, "nested": { "x": [ 1, { "y": 0 } ] } } )"
+  };
+
+  lightning::JsonDocument document;
+  ASSERT_TRUE (document.parse (text.data(), text.size()));
+
+  const auto &root { document.root() };
+  ASSERT_TRUE (root.isObject());
+  ASSERT_EQ (root.size(), 9u);
+
+  ASSERT_EQ (root.find ("id")->get<int>(), 42);
+  ASSERT_EQ (root.find ("id")->get<double>(), 42.0);
+  ASSERT_EQ (root.find ("price")->get<double>(), -150.0);
+  ASSERT_FALSE (root.find ("price")->get<int>().has_value());
+  ASSERT_EQ (root.find ("price")->text(), "-1.5e2");
+
+  // strings without escapes are views of the text
+  const auto name { root.find ("name")->getString() };
+  ASSERT_EQ (name, "plain text");
+  ASSERT_EQ (name->data(), text.data() + text.find ("plain text"));
+
+  const auto &tags { *root.find ("tags") };
+  ASSERT_TRUE (tags.isArray());
+  ASSERT_EQ (tags.size(), 3u);
+  ASSERT_EQ (tags.at (1)->getString(), "b");
+  ASSERT_TRUE (tags.at (2)->isArray());
+  ASSERT_EQ (tags.at (2)->size(), 0u);
+  ASSERT_EQ (tags.at (3), nullptr);
+
+  ASSERT_EQ (root.find ("active")->getBool(), true);
+  ASSERT_EQ (root.find ("deleted")->getBool(), false);
+  ASSERT_TRUE (root.find ("parent")->isNull());
+  ASSERT_TRUE (root.find ("empty")->isObject());
+  ASSERT_EQ (root.find ("missing"), nullptr);
+  ASSERT_EQ (root.find ("nested")->find ("x")->at (1)->find ("y")->get<int>(), 0);
+
+  // members keep the order of the text
+  std::vector<std::string> names;
+  for (const auto &m: root.members())
+    names.emplace_back (m.name);
+
+  ASSERT_EQ (names, (std::vector<std::string> { "id", "price", "name", "tags", "active", "deleted", "parent", "empty", "nested" }));
+
+  // scalars are valid documents too
+  std::string scalar { " \"s\" " };
+  ASSERT_TRUE (document.parse (scalar.data(), scalar.size()));
+  ASSERT_EQ (document.root().getString(), "s");
+}
+
+// ----------------------------------------------------------------------------
+// test_parse_escapes
+// ----------------------------------------------------------------------------
+TEST (Json, test_parse_escapes) {
+  std::string text { R"({ "a\"b": "line\nbreak \\ \/ \u00e9 \u20ac \ud83d\ude00 tab\t", "long": "0123456789abcdef0123456789\"x" })" };
+
+  lightning::JsonDocument document;
+  ASSERT_TRUE (document.parse (text.data(), text.size()));
+
+  const auto &root { document.root() };
+
+  // unescaped over the text
+  const auto value { root.find ("a\"b")->getString() };
+  ASSERT_EQ (value, "line\nbreak \\ / \xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 tab\t");
+  ASSERT_TRUE ((value->data() >= text.data()) && (value->data() < text.data() + text.size()));
+
+  // an escape after the first eight bytes
+  ASSERT_EQ (root.find ("long")->getString(), "0123456789abcdef0123456789\"x");
+}
+
+// ----------------------------------------------------------------------------
+// test_parse_errors
+// ----------------------------------------------------------------------------
+TEST (Json, test_parse_errors) {
+  lightning::JsonDocument document;
+
+  for (std::string text: {
+    "", " ", "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "01", "1.", "-", "1e", ".5", "tru", "nul",
+    "\"unterminated", "\"bad \\x escape\"", "\"\\ud83d alone\"", "\"\\u12\"", "\"control \x01\"", "{} []", "{a:1}"
+  }) {
+    ASSERT_FALSE (document.parse (text.data(), text.size())) << text;
+    ASSERT_TRUE (document.root().isNull());
+  }
+
+  std::string text { "[1, 2, x]" };
+  ASSERT_FALSE (document.parse (text.data(), text.size()));
+  ASSERT_EQ (document.errorOffset(), 7u);
+
+  // too deep
+  std::string deep (lightning::JsonDocument::kMaxDepth + 1, '[');
+  deep.append (lightning::JsonDocument::kMaxDepth + 1, ']');
+  ASSERT_FALSE (document.parse (deep.data(), deep.size()));
+
+  deep = deep.substr (1, deep.size() - 2);
+  ASSERT_TRUE (document.parse (deep.data(), deep.size()));
+}
+
+// ----------------------------------------------------------------------------
+// test_parse_arena
+// ----------------------------------------------------------------------------
+TEST (Json, test_parse_arena) {
+  std::byte arena[1024];
+  std::pmr::monotonic_buffer_resource resource { arena, sizeof (arena), std::pmr::null_memory_resource() };
+
+  // the elements are allocated from the resource
+  lightning::JsonDocument document { &resource };
+
+  std::string text { R"({ "list": [ 1, 2, 3 ], "n": 4 })" };
+  ASSERT_TRUE (document.parse (text.data(), text.size()));
+
+  const auto items { document.root().find ("list")->items() };
+  ASSERT_EQ (items.size(), 3u);
+  ASSERT_TRUE ((reinterpret_cast<const std::byte *> (items.data()) >= arena) && (reinterpret_cast<const std::byte *> (items.data()) < arena + sizeof (arena)));
+}
+
+// ----------------------------------------------------------------------------
+// test_write
+// ----------------------------------------------------------------------------
+TEST (Json, test_write) {
+  std::string out;
+  lightning::JsonWriter writer { out };
+
+  writer.startObject()
+    .key ("id").value (42)
+    .key ("ratio").value (0.25)
+    .key ("big").value (std::numeric_limits<int64_t>::max())
+    .key ("nan").value (std::nan (""))
+    .key ("name").value ("quote \" backslash \\ newline \n control \x01 \xC3\xA9")
+    .key ("ok").value (true)
+    .key ("none").value (nullptr)
+    .key ("list").startArray().value (1).startArray().endArray().startObject().endObject().value ("x").endArray()
+    .key ("empty").startObject().endObject()
+  .endObject();
+
+  ASSERT_EQ (out,
+    R"({"id":42,"ratio":0.25,"big":9223372036854775807,"nan":null,)"
+    R"("name":"quote \" backslash \\ newline \n control \u0001 )" "\xC3\xA9" R"(","ok":true,"none":null,)"
+    R"("list":[1,[],{},"x"],"empty":{}})"
+  );
+
+  // a parsed document written back
+  std::string text { R"( { "a" : [ 1.50, "x\ty", { } ], "b" : null } )" };
+
+  lightning::JsonDocument document;
+  ASSERT_TRUE (document.parse (text.data(), text.size()));
+
+  out.clear();
+  lightning::JsonWriter { out }.value (document.root());
+
+  ASSERT_EQ (out, R"({"a":[1.50,"x\ty",{}],"b":null})");
+}
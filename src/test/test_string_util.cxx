@@ -0,0 +1,44 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <gtest/gtest.h>
+
+#include <lightning/string_util.h>
+
+
+// ----------------------------------------------------------------------------
+// test_trim
+// ----------------------------------------------------------------------------
+TEST (StringUtil, test_trim) {
+  ASSERT_EQ (lightning::StringUtil::trim (" \tgzip \t"), "gzip");
+  ASSERT_EQ (lightning::StringUtil::trim ("no-cache"), "no-cache");
+  ASSERT_EQ (lightning::StringUtil::trim ("a b"), "a b");
+  ASSERT_EQ (lightning::StringUtil::trim (" \t "), "");
+  ASSERT_EQ (lightning::StringUtil::trim (""), "");
+}
+
+// ----------------------------------------------------------------------------
+// test_has_token
+// ----------------------------------------------------------------------------
+TEST (StringUtil, test_has_token) {
+  ASSERT_TRUE (lightning::StringUtil::hasToken ("keep-alive, Upgrade", "upgrade"));
+  ASSERT_TRUE (lightning::StringUtil::hasToken ("Upgrade", "upgrade"));
+  ASSERT_TRUE (lightning::StringUtil::hasToken (" a ,\tb\t, c", "b"));
+  ASSERT_FALSE (lightning::StringUtil::hasToken ("upgraded, keep-alive", "upgrade"));
+  ASSERT_FALSE (lightning::StringUtil::hasToken ("", "upgrade"));
+  ASSERT_FALSE (lightning::StringUtil::hasToken (",,", "upgrade"));
+}
+
+// ----------------------------------------------------------------------------
+// test_hex_value
+// ----------------------------------------------------------------------------
+TEST (StringUtil, test_hex_value) {
+  ASSERT_EQ (lightning::StringUtil::hexValue ('0'), 0);
+  ASSERT_EQ (lightning::StringUtil::hexValue ('9'), 9);
+  ASSERT_EQ (lightning::StringUtil::hexValue ('a'), 10);
+  ASSERT_EQ (lightning::StringUtil::hexValue ('F'), 15);
+  ASSERT_EQ (lightning::StringUtil::hexValue ('g'), -1);
+  ASSERT_EQ (lightning::StringUtil::hexValue ('%'), -1);
+}
@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <chrono>
+#include <optional>
+
+#include <gtest/gtest.h>
+
+#include <asio.hpp>
+
+#include <lightning/timer_wheel.h>
+
+
+using namespace std::chrono_literals;
+
+using Clock = std::chrono::steady_clock;
+
+// ----------------------------------------------------------------------------
+// test_expire
+// ----------------------------------------------------------------------------
+TEST (TimerWheel, test_expire) {
+  asio::io_context io;
+  lightning::TimerWheel wheel { io.get_executor(), 10ms, 8 };
+
+  const auto start { Clock::now() };
+  std::optional<Clock::duration> first, second;
+
+  lightning::TimerWheel::Entry a { [ & ] { first = Clock::now() - start; } };
+  lightning::TimerWheel::Entry b { [ & ] { second = Clock::now() - start; } };
+
+  wheel.schedule (a, 30ms);
+  wheel.schedule (b, 200ms); // several turns of the wheel
+  ASSERT_EQ (wheel.size(), 2);
+
+  // the io_context has no work left once the wheel is empty
+  io.run();
+
+  ASSERT_EQ (wheel.size(), 0);
+  ASSERT_TRUE (first && second);
+  ASSERT_GE (*first, 30ms);
+  ASSERT_GE (*second, 200ms);
+  ASSERT_LT (*first, *second);
+}
+
+// ----------------------------------------------------------------------------
+// test_cancel
+// ----------------------------------------------------------------------------
+TEST (TimerWheel, test_cancel) {
+  asio::io_context io;
+  lightning::TimerWheel wheel { io.get_executor(), 10ms, 8 };
+
+  size_t expired { 0 };
+
+  lightning::TimerWheel::Entry a { [ & ] { ++expired; } };
+  lightning::TimerWheel::Entry b { [ & ] { ++expired; } };
+  lightning::TimerWheel::Entry c { [ & ] { ++expired; } };
+
+  wheel.schedule (a, 20ms);
+  wheel.schedule (b, 20ms);
+  wheel.schedule (c, 20ms);
+
+  wheel.cancel (b);
+  wheel.cancel (b); // not scheduled anymore
+  ASSERT_EQ (wheel.size(), 2);
+
+  io.run();
+
+  ASSERT_EQ (expired, 2);
+}
+
+// ----------------------------------------------------------------------------
+// test_reschedule
+// ----------------------------------------------------------------------------
+TEST (TimerWheel, test_reschedule) {
+  asio::io_context io;
+  lightning::TimerWheel wheel { io.get_executor(), 10ms, 8 };
+
+  const auto start { Clock::now() };
+  std::optional<Clock::duration> when;
+  size_t expired { 0 };
+
+  lightning::TimerWheel::Entry entry { [ & ] { when = Clock::now() - start; ++expired; } };
+
+  wheel.schedule (entry, 20ms);
+  wheel.schedule (entry, 150ms);
+  ASSERT_EQ (wheel.size(), 1);
+
+  io.run();
+
+  ASSERT_EQ (expired, 1);
+  ASSERT_GE (*when, 150ms);
+}
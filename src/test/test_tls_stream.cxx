@@ -0,0 +1,236 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <lightning/http_server.h>
+
+
+static constexpr uint16_t kPort { 8443 };
+
+using TlsClient = asio::ssl::stream<asio::ip::tcp::socket>;
+
+// ----------------------------------------------------------------------------
+// serverContext
+// ----------------------------------------------------------------------------
+// A self-signed certificate for localhost, valid for an hour
+static asio::ssl::context serverContext() {
+  asio::ssl::context context { asio::ssl::context::tls_server };
+
+  EVP_PKEY *key { EVP_EC_gen ("P-256") };
+  X509 *cert { X509_new() };
+
+  ASN1_INTEGER_set (X509_get_serialNumber (cert), 1);
+  X509_gmtime_adj (X509_getm_notBefore (cert), 0);
+  X509_gmtime_adj (X509_getm_notAfter (cert), 3600);
+  X509_set_pubkey (cert, key);
+
+  X509_NAME *name { X509_get_subject_name (cert) };
+  X509_NAME_add_entry_by_txt (name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *> ("localhost"), -1, -1, 0);
+  X509_set_issuer_name (cert, name);
+  X509_sign (cert, key, EVP_sha256());
+
+  SSL_CTX_use_certificate (context.native_handle(), cert);
+  SSL_CTX_use_PrivateKey (context.native_handle(), key);
+
+  X509_free (cert);
+  EVP_PKEY_free (key);
+
+  return context;
+}
+
+// ----------------------------------------------------------------------------
+// connect
+// ----------------------------------------------------------------------------
+static void connect (TlsClient &client, SSL_SESSION *session = nullptr) {
+  client.next_layer().connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+
+  if (session != nullptr)
+    SSL_set_session (client.native_handle(), session);
+
+  client.handshake (asio::ssl::stream_base::client);
+}
+
+// ----------------------------------------------------------------------------
+// get
+// ----------------------------------------------------------------------------
+// Sends a GET request and reads its response (which must have a Content-Length)
+static std::string get (TlsClient &client, std::string_view path) {
+  asio::write (client, asio::buffer ("GET " + std::string { path } + " HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+
+  std::string response;
+  const size_t headers { asio::read_until (client, asio::dynamic_buffer (response), "\r\n\r\n") };
+
+  constexpr std::string_view kLength { "content-length: " };
+  const auto start { response.find (kLength) + kLength.size() };
+
+  size_t length { 0 };
+  std::from_chars (response.data() + start, response.data() + response.size(), length);
+
+  if (response.size() < headers + length)
+    asio::read (client, asio::dynamic_buffer (response), asio::transfer_exactly (headers + length - response.size()));
+
+  return response;
+}
+
+// ----------------------------------------------------------------------------
+// test_requests
+// ----------------------------------------------------------------------------
+TEST (TlsStream, test_requests) {
+  const auto file { std::filesystem::temp_directory_path() / "lightning_tls" / "big.bin" };
+  std::filesystem::create_directories (file.parent_path());
+
+  // bigger than the mmap threshold: sent from the descriptor, read and encrypted in user space
+  std::string content (300 * 1024 + 17, '\0');
+  for (size_t i { 0 }; i < content.size(); ++i)
+    content[i] = static_cast<char> (i * 31);
+
+  std::ofstream { file, std::ios::binary } << content;
+
+  lightning::HttpServer server { kPort, 2, lightning::LogLevel::kWarn, serverContext() };
+
+  server.addRoute (lightning::HttpMethod::kGet, "/hello", [] (const auto &request, auto &response) {
+    response.headers().set ("Content-Type", "text/plain");
+    response.status (200).send (request.protocol == lightning::ProtocolType::kHttps ? "hello https" : "wrong protocol");
+  });
+
+  server.addRoute (lightning::HttpMethod::kGet, "/big", [] (const auto &, auto &response) {
+    response.status (200).send (std::string (1024 * 1024, 'b'));
+  });
+
+  server.addStaticRoute ("/files", file.parent_path());
+
+  server.addWebSocketRoute ("/ws", {
+    .onOpen = [] (const auto &request, auto &) { ASSERT_EQ (request.protocol, lightning::ProtocolType::kWss); },
+    .onMessage = [] (auto &ws, std::string_view message, bool binary) { ws.send (message, binary); }
+  });
+
+  asio::io_context io;
+  asio::ssl::context context { asio::ssl::context::tls_client };
+  TlsClient client { io, context };
+  connect (client);
+
+  // several requests on a kept-alive connection
+  for (int i { 0 }; i < 3; ++i)
+    ASSERT_TRUE (get (client, "/hello").ends_with ("\r\n\r\nhello https"));
+
+  const auto big { get (client, "/big") };
+  ASSERT_TRUE (big.starts_with ("HTTP/1.1 200"));
+  ASSERT_EQ (big.substr (big.find ("\r\n\r\n") + 4), std::string (1024 * 1024, 'b'));
+
+  const auto served { get (client, "/files/big.bin") };
+  ASSERT_TRUE (served.starts_with ("HTTP/1.1 200"));
+  ASSERT_TRUE (served.substr (served.find ("\r\n\r\n") + 4) == content);
+
+  // pipelined requests, in a single record
+  asio::write (client, asio::buffer (std::string { "GET /hello HTTP/1.1\r\nHost: a\r\n\r\nGET /hello HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n" }));
+
+  std::string responses;
+  asio::error_code ec;
+  asio::read (client, asio::dynamic_buffer (responses), ec);
+
+  size_t count { 0 };
+  for (auto pos { responses.find ("\r\n\r\nhello https") }; pos != std::string::npos; pos = responses.find ("\r\n\r\nhello https", pos + 1))
+    ++count;
+
+  ASSERT_EQ (count, 2u);
+
+  // the server said goodbye with close_notify rather than just closing the socket
+  ASSERT_EQ (ec, asio::error_code { asio::error::eof });
+
+  // a client that does not speak TLS is dropped, and the server goes on
+  asio::ip::tcp::socket plain { io };
+  plain.connect (asio::ip::tcp::endpoint { asio::ip::address::from_string ("127.0.0.1"), kPort });
+  asio::write (plain, asio::buffer (std::string { "GET /hello HTTP/1.1\r\nHost: a\r\n\r\n" }));
+
+  std::string rejected;
+  asio::read (plain, asio::dynamic_buffer (rejected), ec);
+  ASSERT_TRUE (ec);
+  ASSERT_EQ (rejected.find ("hello"), std::string::npos);
+
+  TlsClient other { io, context };
+  connect (other);
+  ASSERT_TRUE (get (other, "/hello").ends_with ("hello https"));
+
+  // WebSocket messages, echoed while the next one is being read
+  asio::write (other, asio::buffer (std::string {
+    "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+  }));
+
+  std::string upgraded;
+  const size_t headers { asio::read_until (other, asio::dynamic_buffer (upgraded), "\r\n\r\n") };
+  ASSERT_TRUE (upgraded.starts_with ("HTTP/1.1 101"));
+  upgraded.erase (0, headers);
+
+  // masked with a zero key, so the payload is sent as is
+  asio::write (other, asio::buffer (std::string { "\x81\x82\0\0\0\0hi\x81\x82\0\0\0\0yo", 16 }));
+  asio::read (other, asio::dynamic_buffer (upgraded), asio::transfer_exactly (8 - upgraded.size()));
+  ASSERT_EQ (upgraded, std::string ("\x81\x02hi\x81\x02yo"));
+
+  std::filesystem::remove_all (file.parent_path());
+}
+
+// ----------------------------------------------------------------------------
+// test_session_resumption
+// ----------------------------------------------------------------------------
+TEST (TlsStream, test_session_resumption) {
+  // returns whether a second connection resumed the session of the first one
+  const auto resumed = [] (const lightning::HttpConfig &config, int version) {
+    lightning::HttpServer server { kPort, 1, lightning::LogLevel::kWarn, serverContext(), config };
+
+    server.addRoute (lightning::HttpMethod::kGet, "/", [] (const auto &, auto &response) {
+      response.status (200).send ("ok");
+    });
+
+    asio::io_context io;
+    asio::ssl::context context { asio::ssl::context::tls_client };
+    SSL_CTX_set_min_proto_version (context.native_handle(), version);
+    SSL_CTX_set_max_proto_version (context.native_handle(), version);
+
+    SSL_SESSION *session { nullptr };
+
+    {
+      TlsClient client { io, context };
+      connect (client);
+
+      // TLS 1.3 tickets come after the handshake, with the first response
+      get (client, "/");
+      session = SSL_get1_session (client.native_handle());
+
+      // sessions of connections that end without close_notify cannot be resumed
+      asio::error_code ignored;
+      client.shutdown (ignored);
+    }
+
+    TlsClient client { io, context };
+    connect (client, session);
+    get (client, "/");
+
+    SSL_SESSION_free (session);
+
+    return SSL_session_reused (client.native_handle()) == 1;
+  };
+
+  for (const int version: { TLS1_2_VERSION, TLS1_3_VERSION }) {
+    ASSERT_TRUE (resumed ({}, version)) << version;
+
+    // tickets only
+    ASSERT_TRUE (resumed ({ .tlsSessionCacheSize = 0 }, version)) << version;
+
+    // server-side cache only
+    ASSERT_TRUE (resumed ({ .tlsSessionTickets = false }, version)) << version;
+
+    ASSERT_FALSE (resumed ({ .tlsSessionCacheSize = 0, .tlsSessionTickets = false }, version)) << version;
+  }
+}
@@ -0,0 +1,40 @@
+// ----------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2024 Carlos Carrasco
+// ----------------------------------------------------------------------------
+#ifndef __LIGHTNING_TEST_UTIL_H__
+#define __LIGHTNING_TEST_UTIL_H__
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+
+namespace test {
+
+// ----------------------------------------------------------------------------
+// inflate
+// ----------------------------------------------------------------------------
+// Decompresses a body of up to 64 KB (windowBits 31: gzip, 15: deflate); empty if it is not valid.
+inline std::string inflate (std::string_view data, int windowBits) {
+  z_stream stream {};
+  inflateInit2 (&stream, windowBits);
+
+  std::string out (64 * 1024, '\0');
+  stream.next_in = reinterpret_cast<Bytef *> (const_cast<char *> (data.data()));
+  stream.avail_in = static_cast<uInt> (data.size());
+  stream.next_out = reinterpret_cast<Bytef *> (out.data());
+  stream.avail_out = static_cast<uInt> (out.size());
+
+  const int result { ::inflate (&stream, Z_FINISH) };
+  out.resize ((result == Z_STREAM_END) ? stream.total_out : 0);
+
+  inflateEnd (&stream);
+
+  return out;
+}
+
+}
+
+#endif